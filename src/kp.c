@@ -10,10 +10,24 @@
 
 #include "kp_cap.h"
 #include "kp_act.h"
+#include "kp_xact.h"
 #include "kp_shell.h"
 #include "kp_input.h"
 #include "kp_sample.h"
 #include "kp_meas.h"
+#include "kp_table.h"
+#include "kp_plan.h"
+#include "kp_pack.h"
+#include "kp_scope.h"
+#include "kp_dbnc.h"
+#include "kp_mon.h"
+#include "kp_map.h"
+#include "kp_endure.h"
+#include "kp_rapid.h"
+#include "kp_bench.h"
+#include "kp_ckpt.h"
+#include "kp_sketch.h"
+#include "kp_drv.h"
 #include "kp_misc.h"
 #include <stm32_ll_tim.h>
 #include <assert.h>
@@ -31,9 +45,17 @@
 #define KP_ACT_GPIO_NODE DT_NODELABEL(gpiob)
 /** Devicetree node identifier for the debug GPIO port */
 #define KP_DBG_GPIO_NODE DT_NODELABEL(gpioa)
+/** Devicetree node identifier for the capture inputs' GPIO port */
+#define KP_CAP_GPIO_NODE DT_NODELABEL(gpioa)
+/** Devicetree node identifier for the external stimulus GPIO port */
+#define KP_EXT_GPIO_NODE DT_NODELABEL(gpioa)
+/** Devicetree node identifier for the actuator driver's UART */
+#define KP_DRV_UART_NODE DT_NODELABEL(usart3)
 
 /** Devicetree node identifier for the timer */
 #define KP_TIMER_NODE DT_NODELABEL(timers1)
+/** Devicetree node identifier for the scope sampling timer */
+#define KP_SCOPE_TIMER_NODE DT_NODELABEL(timers3)
 
 /** The actuator GPIO port device */
 static const struct device *kp_act_gpio = DEVICE_DT_GET(KP_ACT_GPIO_NODE);
@@ -41,6 +63,27 @@ static const struct device *kp_act_gpio = DEVICE_DT_GET(KP_ACT_GPIO_NODE);
 /** The debug GPIO port device */
 static const struct device *kp_dbg_gpio = DEVICE_DT_GET(KP_DBG_GPIO_NODE);
 
+/** The capture inputs' GPIO port device */
+static const struct device *kp_cap_gpio = DEVICE_DT_GET(KP_CAP_GPIO_NODE);
+
+/** The external stimulus GPIO port device */
+static const struct device *kp_ext_gpio = DEVICE_DT_GET(KP_EXT_GPIO_NODE);
+
+/** The actuator driver's UART device */
+static const struct device *kp_drv_uart = DEVICE_DT_GET(KP_DRV_UART_NODE);
+
+/** The actuator driver's DIAG pin (on the actuator's GPIO port) */
+const gpio_pin_t kp_drv_pin_diag = 15;
+
+/** The external stimulus pin (the capture timer's ETR input) */
+const gpio_pin_t kp_ext_pin = 12;
+
+/** The capture trigger pin (the capture timer's CH1 input) */
+const gpio_pin_t kp_cap_pin_trig = 8;
+
+/** The base capture channel pin (the capture timer's CH2 input) */
+const gpio_pin_t kp_cap_pin_ch_base = 9;
+
 /** The pin for update interrupt debugging */
 const gpio_pin_t kp_dbg_pin_update = 3;
 
@@ -56,6 +99,12 @@ static int32_t kp_act_pos_top = KP_ACT_POS_INVALID;
 /** Bottom actuator position */
 static int32_t kp_act_pos_bottom = KP_ACT_POS_INVALID;
 
+/**
+ * Actuator position windows of each channel and direction.
+ * Only used when within the top and bottom positions.
+ */
+static struct kp_meas_wins kp_act_wins;
+
 /** Execute the "on" command */
 static int
 kp_cmd_on(const struct shell *shell, size_t argc, char **argv)
@@ -79,6 +128,9 @@ kp_cmd_off(const struct shell *shell, size_t argc, char **argv)
 	if (kp_act_off()) {
 		kp_act_pos_top = KP_ACT_POS_INVALID;
 		kp_act_pos_bottom = KP_ACT_POS_INVALID;
+		kp_meas_wins_clear(&kp_act_wins);
+		/* Positions are lost, and so is the trigger map */
+		kp_map_clear();
 	} else {
 		shell_info(shell, "Actuator is already off");
 	}
@@ -109,6 +161,20 @@ kp_parse_non_negative_number(const char *str, long *pn)
 	return true;
 }
 
+/**
+ * Report an actuator stall aborting a sampling command, after which the
+ * actuator position can't be trusted anymore.
+ *
+ * @param shell	The shell to report to.
+ */
+static void
+kp_print_stalled(const struct shell *shell)
+{
+	shell_error(shell, "Actuator stalled, positions may be off, aborted");
+	shell_info(shell,
+		   "Execute \"home\" command, and set the positions again");
+}
+
 /** Execute the "up [steps]" command */
 static int
 kp_cmd_up(const struct shell *shell, size_t argc, char **argv)
@@ -132,6 +198,9 @@ kp_cmd_up(const struct shell *shell, size_t argc, char **argv)
 		case KP_ACT_MOVE_RC_ABORTED:
 			shell_error(shell, "Aborted");
 			break;
+		case KP_ACT_MOVE_RC_STALLED:
+			shell_error(shell, "Actuator stalled, stopping");
+			break;
 		default:
 			break;
 	}
@@ -164,6 +233,9 @@ kp_cmd_down(const struct shell *shell, size_t argc, char **argv)
 		case KP_ACT_MOVE_RC_ABORTED:
 			shell_error(shell, "Aborted");
 			break;
+		case KP_ACT_MOVE_RC_STALLED:
+			shell_error(shell, "Actuator stalled, stopping");
+			break;
 		default:
 			break;
 	}
@@ -174,7 +246,130 @@ SHELL_CMD_ARG_REGISTER(down, NULL, "Move actuator down (n steps)",
 			kp_cmd_down, 1, 1);
 
 /**
- * Process input from the bypassed shell of a scheduled command.
+ * Output the status of the measurement being acquired, if any.
+ *
+ * @param shell	The shell to output to.
+ */
+static void
+kp_query_status(const struct shell *shell)
+{
+	struct kp_meas_progress progress;
+	uint32_t elapsed_ms;
+	uint32_t done;
+
+	kp_meas_get_progress(&progress);
+	if (!progress.acquiring) {
+		shell_print(shell, "Not acquiring a measurement");
+		return;
+	}
+	elapsed_ms = (uint32_t)(k_uptime_get() - progress.start_ms);
+	done = progress.passes - progress.start_passes;
+	shell_print(shell,
+		    "Passes: %u/%u (%u%%), captured: %u, elapsed: %us",
+		    progress.passes, progress.requested_passes,
+		    progress.passes * 100 / MAX(progress.requested_passes, 1),
+		    progress.captured_passes, elapsed_ms / 1000);
+	if (done != 0) {
+		shell_print(shell, "Remaining: about %us",
+			    (uint32_t)((uint64_t)elapsed_ms *
+				       (progress.requested_passes -
+					progress.passes) / done / 1000));
+	}
+}
+
+/**
+ * Output the statistics of the measurement being (or last) acquired, so far.
+ *
+ * @param shell	The shell to output to.
+ */
+static void
+kp_query_stats(const struct shell *shell)
+{
+	struct kp_meas_progress progress;
+	const struct kp_meas_ch_acc *ch_progress;
+	size_t ch;
+	enum kp_cap_ne_dirs ne_dirs;
+
+	kp_meas_get_progress(&progress);
+	if (progress.passes == 0) {
+		shell_print(shell, "No passes acquired yet");
+		return;
+	}
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		for (ne_dirs = KP_CAP_NE_DIRS_UP;
+		     ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			ch_progress = &progress.ch_list[ch][ne_dirs];
+			if (ch_progress->passes == 0) {
+				continue;
+			}
+			if (ch_progress->triggers == 0) {
+				shell_print(shell, "#%zu %4s: 0/%u triggers",
+					    ch,
+					    ne_dirs == KP_CAP_NE_DIRS_DOWN
+						? "Down" : "Up",
+					    ch_progress->passes);
+				continue;
+			}
+			shell_print(shell,
+				    "#%zu %4s: %u/%u triggers, "
+				    "min/mean/max: %u/%u/%u us",
+				    ch,
+				    ne_dirs == KP_CAP_NE_DIRS_DOWN
+					? "Down" : "Up",
+				    ch_progress->triggers,
+				    ch_progress->passes,
+				    ch_progress->min_us,
+				    (uint32_t)(ch_progress->sum_us /
+					       ch_progress->triggers),
+				    ch_progress->max_us);
+		}
+	}
+}
+
+/**
+ * Output an actuator position, if valid.
+ *
+ * @param shell	The shell to output to.
+ * @param name	The name of the position.
+ * @param pos	The position to output.
+ */
+static void
+kp_query_pos_print(const struct shell *shell, const char *name, int32_t pos)
+{
+	if (kp_act_pos_is_valid(pos)) {
+		shell_print(shell, "%s: %d", name, pos);
+	} else {
+		shell_print(shell, "%s: none", name);
+	}
+}
+
+/**
+ * Output the actuator positions.
+ *
+ * @param shell	The shell to output to.
+ */
+static void
+kp_query_pos(const struct shell *shell)
+{
+	struct kp_act_state state;
+
+	kp_act_get_state(&state);
+	if (state.off) {
+		kp_query_pos_print(shell, "Current", KP_ACT_POS_INVALID);
+	} else if (state.moving) {
+		shell_print(shell, "Current: %d, moving to: %d",
+			    state.pos, state.target);
+	} else {
+		kp_query_pos_print(shell, "Current", state.pos);
+	}
+	kp_query_pos_print(shell, "Top", kp_act_pos_top);
+	kp_query_pos_print(shell, "Bottom", kp_act_pos_bottom);
+	kp_query_pos_print(shell, "X", kp_xact_locate());
+}
+
+/**
+ * Process input from the bypassed shell of a scheduled command, answering
+ * queries right away, from snapshots, without involving the command.
  *
  * @param shell Shell instance.
  * @param data  Raw data from transport.
@@ -183,8 +378,24 @@ SHELL_CMD_ARG_REGISTER(down, NULL, "Move actuator down (n steps)",
 static void
 kp_input_bypass_cb(const struct shell *shell, uint8_t *data, size_t len)
 {
-	ARG_UNUSED(shell);
+	enum kp_input_query query;
+
 	kp_input_recv(data, len);
+	while (kp_input_get_query(&query) == 0) {
+		switch (query) {
+			case KP_INPUT_QUERY_STATUS:
+				kp_query_status(shell);
+				break;
+			case KP_INPUT_QUERY_STATS:
+				kp_query_stats(shell);
+				break;
+			case KP_INPUT_QUERY_POS:
+				kp_query_pos(shell);
+				break;
+		}
+		/* Have the live dashboard, if any, redraw below the answer */
+		kp_meas_live_interrupt();
+	}
 }
 
 /** Execute the "swing steps" command */
@@ -232,33 +443,46 @@ kp_cmd_swing(const struct shell *shell, size_t argc, char **argv)
 	shell_print(shell, "Swinging, press Enter to stop, Ctrl-C to abort");
 	rc = kp_act_move_by(steps / 2, kp_act_speed);
 	bool finished = false;
-	while (rc == KP_ACT_MOVE_RC_OK && !finished) {
-		bool moved = false;
+	/* Number of strokes started, but not finished */
+	size_t started = 0;
+	/* Keep the next stroke queued, so the turns aren't waiting for us */
+	while (rc == KP_ACT_MOVE_RC_OK && !finished && started < 2) {
 		steps = -steps;
 		kp_act_start_move_by(steps, kp_act_speed);
-		while (rc == KP_ACT_MOVE_RC_OK && !moved) {
-			while (k_poll(events, ARRAY_SIZE(events),
-				      K_FOREVER) != 0);
-
-			if (events[EVENT_IDX_INPUT].state) {
-				while (kp_input_get(&msg, K_FOREVER) != 0);
-				if (msg == KP_INPUT_MSG_ABORT) {
-					kp_act_abort();
-				} else if (msg == KP_INPUT_MSG_ENTER) {
-					finished = true;
-				}
+		started++;
+	}
+	while (started > 0) {
+		while (k_poll(events, ARRAY_SIZE(events), K_FOREVER) != 0);
+
+		if (events[EVENT_IDX_INPUT].state) {
+			while (kp_input_get(&msg, K_FOREVER) != 0);
+			if (msg == KP_INPUT_MSG_ABORT) {
+				kp_act_abort();
+			} else if (msg == KP_INPUT_MSG_ENTER) {
+				finished = true;
 			}
+		}
 
-			if (events[EVENT_IDX_ACT_FINISH_MOVE].state) {
+		if (events[EVENT_IDX_ACT_FINISH_MOVE].state) {
+			/* Keep the first failure, if any */
+			if (rc == KP_ACT_MOVE_RC_OK) {
 				rc = kp_act_finish_move(K_FOREVER);
-				moved = (rc == KP_ACT_MOVE_RC_OK);
+			} else {
+				kp_act_finish_move(K_FOREVER);
 			}
-
-			/* Reset event state */
-			for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
-				events[i].state = K_POLL_STATE_NOT_READY;
+			started--;
+			/* Queue the next stroke, unless stopping */
+			if (rc == KP_ACT_MOVE_RC_OK && !finished) {
+				steps = -steps;
+				kp_act_start_move_by(steps, kp_act_speed);
+				started++;
 			}
 		}
+
+		/* Reset event state */
+		for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
+			events[i].state = K_POLL_STATE_NOT_READY;
+		}
 	}
 
 	if (finished && rc == KP_ACT_MOVE_RC_OK) {
@@ -518,6 +742,12 @@ kp_cmd_set_bottom(const struct shell *shell, size_t argc, char **argv)
 /** Capture configuration */
 static struct kp_cap_conf kp_cap_conf;
 
+/**
+ * Alternative configuration lanes to interleave with the capture
+ * configuration and speed above, in measurements.
+ */
+static struct kp_meas_lanes kp_lanes;
+
 /** Execute the
  * "set ch <idx> none/up/down/both [rising/falling [<name>]]"
  * command */
@@ -595,6 +825,11 @@ kp_cmd_set_ch(const struct shell *shell, size_t argc, char **argv)
 		strcpy(conf.name, arg);
 	}
 
+	/* Forget the channel triggers, if their meaning changed */
+	if (conf.rising != kp_cap_conf.ch_list[idx].rising) {
+		kp_map_clear();
+	}
+
 	/* Store the parameters */
 	kp_cap_conf.ch_list[idx] = conf;
 
@@ -624,6 +859,8 @@ kp_cmd_set_timeout(const struct shell *shell, size_t argc, char **argv)
 		return 1;
 	};
 	kp_cap_conf.timeout_us = (uint32_t)timeout_us;
+	/* Triggers past the new timeout could be misses now, and vice versa */
+	kp_map_clear();
 	return 0;
 }
 
@@ -653,6 +890,166 @@ kp_cmd_set_bounce(const struct shell *shell, size_t argc, char **argv)
 	return 0;
 }
 
+/** Execute the "set trigger actuator/external" command */
+static int
+kp_cmd_set_trigger(const struct shell *shell, size_t argc, char **argv)
+{
+	enum kp_cap_trig trig;
+
+	assert(argc == 2);
+
+	if (!kp_cap_trig_from_str(argv[1], &trig)) {
+		shell_error(shell,
+			    "Invalid trigger source "
+			    "(actuator/external expected): %s",
+			    argv[1]);
+		return 1;
+	}
+	kp_cap_conf.trig = trig;
+	return 0;
+}
+
+/** Execute the "set monitor on/off" command */
+static int
+kp_cmd_set_monitor(const struct shell *shell, size_t argc, char **argv)
+{
+	assert(argc == 2);
+
+	if (kp_strcasecmp(argv[1], "on") == 0) {
+		kp_mon_set_enabled(true);
+	} else if (kp_strcasecmp(argv[1], "off") == 0) {
+		kp_mon_set_enabled(false);
+	} else {
+		shell_error(shell,
+			    "Invalid monitor state (on/off expected): %s",
+			    argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * True if measurement passes are timestamped on one free-running (global)
+ * timeline, false if each pass restarts the capture timer.
+ */
+static bool kp_timebase_global;
+
+/** Execute the "set timebase pass/global" command */
+static int
+kp_cmd_set_timebase(const struct shell *shell, size_t argc, char **argv)
+{
+	assert(argc == 2);
+
+	if (kp_strcasecmp(argv[1], "pass") == 0) {
+		kp_timebase_global = false;
+	} else if (kp_strcasecmp(argv[1], "global") == 0) {
+		kp_timebase_global = true;
+	} else {
+		shell_error(shell,
+			    "Invalid timebase (pass/global expected): %s",
+			    argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+/** Endurance run checkpoint period, seconds, zero to disable */
+static uint32_t kp_endure_ckpt_period_s = 60;
+
+/** Execute the "set checkpoint <seconds>" command */
+static int
+kp_cmd_set_checkpoint(const struct shell *shell, size_t argc, char **argv)
+{
+	long period_s;
+
+	assert(argc == 2);
+
+	if (!kp_parse_non_negative_number(argv[1], &period_s) ||
+	    period_s > UINT32_MAX / 1000) {
+		shell_error(shell, "Invalid checkpoint period: %s", argv[1]);
+		return 1;
+	}
+	kp_endure_ckpt_period_s = (uint32_t)period_s;
+	return 0;
+}
+
+/** Execute the "set interleave <cycles>" command */
+static int
+kp_cmd_set_interleave(const struct shell *shell, size_t argc, char **argv)
+{
+	long cycles;
+
+	assert(argc == 2);
+
+	if (!kp_parse_non_negative_number(argv[1], &cycles) || cycles == 0) {
+		shell_error(shell,
+			    "Invalid number of pass pairs per lane turn "
+			    "(positive integer expected): %s", argv[1]);
+		return 1;
+	}
+	kp_lanes.cycles = (size_t)cycles;
+	return 0;
+}
+
+/** Execute the "set debounce <period_us>" command */
+static int
+kp_cmd_set_debounce(const struct shell *shell, size_t argc, char **argv)
+{
+	long period_us;
+	struct kp_dbnc_conf conf;
+
+	assert(argc == 2);
+
+	if (!kp_parse_non_negative_number(argv[1], &period_us) ||
+	    !kp_scope_period_is_valid((uint32_t)period_us)) {
+		shell_error(shell,
+			    "Invalid sampling period (1-%u us expected): %s",
+			    KP_SCOPE_PERIOD_MAX_US, argv[1]);
+		return 1;
+	}
+	kp_dbnc_get_conf(&conf);
+	conf.period_us = (uint32_t)period_us;
+	kp_dbnc_set_conf(&conf);
+	return 0;
+}
+
+/** Execute the "set outliers <mads>" command */
+static int
+kp_cmd_set_outliers(const struct shell *shell, size_t argc, char **argv)
+{
+	long mads;
+
+	assert(argc == 2);
+
+	if (!kp_parse_non_negative_number(argv[1], &mads) ||
+	    mads > KP_MEAS_OUTLIER_MADS_MAX) {
+		shell_error(shell,
+			    "Invalid number of MADs (0-%u expected): %s",
+			    KP_MEAS_OUTLIER_MADS_MAX, argv[1]);
+		return 1;
+	}
+	kp_meas_set_outlier_mads((uint32_t)mads);
+	return 0;
+}
+
+/** Execute the "set windows common" command */
+static int
+kp_cmd_set_windows(const struct shell *shell, size_t argc, char **argv)
+{
+	assert(argc == 2);
+
+	if (kp_strcasecmp(argv[1], "common") != 0) {
+		shell_error(shell,
+			    "Invalid windows (common expected): %s",
+			    argv[1]);
+		shell_info(shell,
+			   "Use \"split\" command to set separate windows");
+		return 1;
+	}
+	kp_meas_wins_clear(&kp_act_wins);
+	return 0;
+}
+
 SHELL_STATIC_SUBCMD_SET_CREATE(set_subcmds,
 	SHELL_CMD_ARG(speed, NULL,
 			"Set speed: <percentage>",
@@ -671,6 +1068,39 @@ SHELL_STATIC_SUBCMD_SET_CREATE(set_subcmds,
 	SHELL_CMD_ARG(bounce, NULL,
 			"Set bounce time: <us>",
 			kp_cmd_set_bounce, 2, 0),
+	SHELL_CMD_ARG(trigger, NULL,
+			"Set capture trigger source: actuator/external",
+			kp_cmd_set_trigger, 2, 0),
+	SHELL_CMD_ARG(monitor, NULL,
+			"Set monitoring of channel edges between "
+			"measurement passes: on/off",
+			kp_cmd_set_monitor, 2, 0),
+	SHELL_CMD_ARG(timebase, NULL,
+			"Set measurement capture timebase: restarted every "
+			"pass, or one free-running timeline: pass/global",
+			kp_cmd_set_timebase, 2, 0),
+	SHELL_CMD_ARG(windows, NULL,
+			"Drop separate channel windows, and have measurement "
+			"passes traverse the whole range between top and "
+			"bottom positions: common",
+			kp_cmd_set_windows, 2, 0),
+	SHELL_CMD_ARG(checkpoint, NULL,
+			"Set endurance run checkpoint period: "
+			"<seconds>, 0 to disable",
+			kp_cmd_set_checkpoint, 2, 0),
+	SHELL_CMD_ARG(interleave, NULL,
+			"Set number of down/up pass pairs each configuration "
+			"lane makes in a turn: <cycles>",
+			kp_cmd_set_interleave, 2, 0),
+	SHELL_CMD_ARG(debounce, NULL,
+			"Set the period of channel sampling for debounce "
+			"emulation: <us>",
+			kp_cmd_set_debounce, 2, 0),
+	SHELL_CMD_ARG(outliers, NULL,
+			"Set the number of median absolute deviations from "
+			"the median flagging outliers in measurement "
+			"results: <mads>, 0 to disable",
+			kp_cmd_set_outliers, 2, 0),
 	SHELL_SUBCMD_SET_END
 );
 
@@ -779,6 +1209,139 @@ kp_cmd_get_bounce(const struct shell *shell, size_t argc, char **argv)
 	return 0;
 }
 
+/** Execute the "get trigger" command */
+static int
+kp_cmd_get_trigger(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	shell_print(shell, "%s", kp_cap_trig_to_lcstr(kp_cap_conf.trig));
+	return 0;
+}
+
+/** Execute the "get windows" command */
+static int
+kp_cmd_get_windows(const struct shell *shell, size_t argc, char **argv)
+{
+	size_t ch;
+	enum kp_cap_ne_dirs ne_dirs;
+	enum kp_cap_dirs dir;
+	const struct kp_meas_win *win;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	for (ch = 0; ch < ARRAY_SIZE(kp_cap_conf.ch_list); ch++) {
+		for (ne_dirs = KP_CAP_NE_DIRS_UP;
+		     ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			dir = kp_cap_dirs_from_ne(ne_dirs);
+			if (!(kp_cap_conf.ch_list[ch].dirs & dir)) {
+				continue;
+			}
+			win = &kp_act_wins.ch_list[ch][ne_dirs];
+			/* If the window is set and can be used */
+			if (kp_meas_win_is_set(win) &&
+			    kp_act_pos_is_valid(kp_act_pos_top) &&
+			    kp_act_pos_is_valid(kp_act_pos_bottom) &&
+			    win->top >= kp_act_pos_top &&
+			    win->bottom <= kp_act_pos_bottom) {
+				shell_print(shell, "#%zu %s: %d - %d",
+					    ch, kp_cap_dirs_to_lcstr(dir),
+					    win->top, win->bottom);
+			} else {
+				shell_print(shell, "#%zu %s: common",
+					    ch, kp_cap_dirs_to_lcstr(dir));
+			}
+		}
+	}
+	return 0;
+}
+
+/** Execute the "get checkpoint" command */
+static int
+kp_cmd_get_checkpoint(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	shell_print(shell, "%u", kp_endure_ckpt_period_s);
+	return 0;
+}
+
+/** Execute the "get interleave" command */
+static int
+kp_cmd_get_interleave(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	shell_print(shell, "%zu", kp_lanes.cycles);
+	return 0;
+}
+
+/** Execute the "get timebase" command */
+static int
+kp_cmd_get_timebase(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	shell_print(shell, "%s", kp_timebase_global ? "global" : "pass");
+	return 0;
+}
+
+/** Execute the "get debounce" command */
+static int
+kp_cmd_get_debounce(const struct shell *shell, size_t argc, char **argv)
+{
+	struct kp_dbnc_conf conf;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	kp_dbnc_get_conf(&conf);
+	shell_print(shell, "%u", conf.period_us);
+	return 0;
+}
+
+/** Execute the "get outliers" command */
+static int
+kp_cmd_get_outliers(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	shell_print(shell, "%u", kp_meas_get_outlier_mads());
+	return 0;
+}
+
+/** Execute the "get monitor" command */
+static int
+kp_cmd_get_monitor(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	shell_print(shell, "%s", kp_mon_is_enabled() ? "on" : "off");
+	return 0;
+}
+
+/**
+ * Check that captures are triggered by the actuator, and output an error, if
+ * not.
+ *
+ * @param shell	The shell to output the error to.
+ *
+ * @return True if captures are triggered by the actuator, false otherwise.
+ */
+static bool
+kp_check_trig_act(const struct shell *shell)
+{
+	if (kp_cap_conf.trig != KP_CAP_TRIG_ACT) {
+		shell_error(shell,
+			    "Captures are triggered externally, aborting");
+		shell_info(shell,
+			   "Use \"set trigger actuator\" command "
+			   "to trigger by the actuator");
+		return false;
+	}
+	return true;
+}
+
 SHELL_STATIC_SUBCMD_SET_CREATE(get_subcmds,
 	SHELL_CMD(speed, NULL,
 			"Get speed percentage",
@@ -797,21 +1360,240 @@ SHELL_STATIC_SUBCMD_SET_CREATE(get_subcmds,
 	SHELL_CMD(bounce, NULL,
 			"Get bounce time, us",
 			kp_cmd_get_bounce),
+	SHELL_CMD(trigger, NULL,
+			"Get capture trigger source -> actuator/external",
+			kp_cmd_get_trigger),
+	SHELL_CMD(monitor, NULL,
+			"Get monitoring of channel edges between "
+			"measurement passes -> on/off",
+			kp_cmd_get_monitor),
+	SHELL_CMD(timebase, NULL,
+			"Get measurement capture timebase -> pass/global",
+			kp_cmd_get_timebase),
+	SHELL_CMD(windows, NULL,
+			"Get windows of enabled channels and directions "
+			"-> <top> - <bottom>/common",
+			kp_cmd_get_windows),
+	SHELL_CMD(checkpoint, NULL,
+			"Get endurance run checkpoint period -> <seconds>",
+			kp_cmd_get_checkpoint),
+	SHELL_CMD(interleave, NULL,
+			"Get number of down/up pass pairs each configuration "
+			"lane makes in a turn -> <cycles>",
+			kp_cmd_get_interleave),
+	SHELL_CMD(debounce, NULL,
+			"Get the period of channel sampling for debounce "
+			"emulation -> <us>",
+			kp_cmd_get_debounce),
+	SHELL_CMD(outliers, NULL,
+			"Get the number of median absolute deviations from "
+			"the median flagging outliers -> <mads>",
+			kp_cmd_get_outliers),
 	SHELL_SUBCMD_SET_END
 );
 
 SHELL_CMD_REGISTER(get, &get_subcmds,
 			"Get parameters", NULL);
 
-/** Execute the "check" command */
+/** Execute the "lane add" command */
 static int
-kp_cmd_check(const struct shell *shell, size_t argc, char **argv)
+kp_cmd_lane_add(const struct shell *shell, size_t argc, char **argv)
 {
-	int32_t start;
-	long passes;
-	size_t triggers;
+	struct kp_meas_lane *lane;
 
-	/* Check for power */
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (kp_lanes.alt_num >= ARRAY_SIZE(kp_lanes.alt_list)) {
+		shell_error(shell, "Too many lanes, maximum is %zu",
+			    ARRAY_SIZE(kp_lanes.alt_list));
+		return 1;
+	}
+	lane = &kp_lanes.alt_list[kp_lanes.alt_num++];
+	lane->conf = kp_cap_conf;
+	lane->speed = kp_act_speed;
+	shell_print(shell, "Added lane #%zu", kp_lanes.alt_num);
+	return 0;
+}
+
+/**
+ * Output a configuration lane description to a shell.
+ *
+ * @param shell	The shell to output to.
+ * @param idx	The index of the lane.
+ * @param conf	The capture configuration of the lane.
+ * @param speed	The speed of the lane.
+ */
+static void
+kp_lane_print(const struct shell *shell, size_t idx,
+	      const struct kp_cap_conf *conf, uint32_t speed)
+{
+	size_t ch;
+
+	assert(kp_cap_conf_is_valid(conf));
+
+	shell_fprintf(shell, SHELL_NORMAL,
+		      "#%zu: speed %u%%, timeout %uus, bounce %uus",
+		      idx, speed, conf->timeout_us, conf->bounce_us);
+	for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+		if (conf->ch_list[ch].dirs) {
+			shell_fprintf(shell, SHELL_NORMAL, ", ch%zu %s",
+				      ch, conf->ch_list[ch].rising
+					? "rising" : "falling");
+		}
+	}
+	shell_fprintf(shell, SHELL_NORMAL, "\n");
+}
+
+/** Execute the "lane list" command */
+static int
+kp_cmd_lane_list(const struct shell *shell, size_t argc, char **argv)
+{
+	size_t i;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	/* The current configuration is the main lane */
+	kp_lane_print(shell, 0, &kp_cap_conf, kp_act_speed);
+	for (i = 0; i < kp_lanes.alt_num; i++) {
+		kp_lane_print(shell, i + 1, &kp_lanes.alt_list[i].conf,
+			      kp_lanes.alt_list[i].speed);
+	}
+	return 0;
+}
+
+/** Execute the "lane clear" command */
+static int
+kp_cmd_lane_clear(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(shell);
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	kp_lanes.alt_num = 0;
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(lane_subcmds,
+	SHELL_CMD(add, NULL,
+		  "Add the current channel configuration, timeout, bounce "
+		  "time, and speed as an alternative lane, interleaved with "
+		  "the (then) current ones by measurements",
+		  kp_cmd_lane_add),
+	SHELL_CMD(list, NULL,
+		  "List the lanes, starting with the current configuration",
+		  kp_cmd_lane_list),
+	SHELL_CMD(clear, NULL, "Remove all alternative lanes",
+		  kp_cmd_lane_clear),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(lane, &lane_subcmds,
+		   "Manage configuration lanes interleaved in measurements",
+		   NULL);
+
+/** Execute the "debounce add <algo> <us>" command */
+static int
+kp_cmd_debounce_add(const struct shell *shell, size_t argc, char **argv)
+{
+	struct kp_dbnc_conf conf;
+	struct kp_dbnc_model model;
+	long time_us;
+
+	assert(argc == 3);
+
+	if (!kp_dbnc_algo_from_str(argv[1], &model.algo)) {
+		shell_error(shell,
+			    "Invalid algorithm "
+			    "(eager/defer/integ/asym expected): %s",
+			    argv[1]);
+		return 1;
+	}
+	if (!kp_parse_non_negative_number(argv[2], &time_us) ||
+	    time_us > KP_CAP_TIME_MAX_US) {
+		shell_error(shell,
+			    "Invalid debounce time (0-%u us expected): %s",
+			    KP_CAP_TIME_MAX_US, argv[2]);
+		return 1;
+	}
+	model.time_us = (uint32_t)time_us;
+
+	kp_dbnc_get_conf(&conf);
+	if (conf.model_num >= ARRAY_SIZE(conf.model_list)) {
+		shell_error(shell, "Too many models, maximum is %zu",
+			    ARRAY_SIZE(conf.model_list));
+		return 1;
+	}
+	conf.model_list[conf.model_num++] = model;
+	kp_dbnc_set_conf(&conf);
+	shell_print(shell, "Added model #%zu", conf.model_num - 1);
+	return 0;
+}
+
+/** Execute the "debounce list" command */
+static int
+kp_cmd_debounce_list(const struct shell *shell, size_t argc, char **argv)
+{
+	struct kp_dbnc_conf conf;
+	size_t i;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	kp_dbnc_get_conf(&conf);
+	for (i = 0; i < conf.model_num; i++) {
+		shell_print(shell, "#%zu: %s %uus", i,
+			    kp_dbnc_algo_to_lcstr(conf.model_list[i].algo),
+			    conf.model_list[i].time_us);
+	}
+	return 0;
+}
+
+/** Execute the "debounce clear" command */
+static int
+kp_cmd_debounce_clear(const struct shell *shell, size_t argc, char **argv)
+{
+	struct kp_dbnc_conf conf;
+
+	ARG_UNUSED(shell);
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	kp_dbnc_get_conf(&conf);
+	conf.model_num = 0;
+	kp_dbnc_set_conf(&conf);
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(debounce_subcmds,
+	SHELL_CMD_ARG(add, NULL,
+		  "Add a debounce algorithm model to emulate over channel "
+		  "samples in measurements: eager/defer/integ/asym <us>",
+		  kp_cmd_debounce_add, 3, 0),
+	SHELL_CMD(list, NULL, "List the emulated debounce models",
+		  kp_cmd_debounce_list),
+	SHELL_CMD(clear, NULL,
+		  "Remove all debounce models, disabling the emulation",
+		  kp_cmd_debounce_clear),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(debounce, &debounce_subcmds,
+		   "Manage debounce algorithm models emulated in measurements",
+		   NULL);
+
+/** Execute the "check" command */
+static int
+kp_cmd_check(const struct shell *shell, size_t argc, char **argv)
+{
+	int32_t start;
+	long passes;
+	size_t triggers;
+
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return 1;
+	}
+	/* Check for power */
 	if (kp_act_is_off()) {
 		shell_error(shell, "Actuator is off, aborting");
 		return 1;
@@ -868,6 +1650,9 @@ kp_cmd_check(const struct shell *shell, size_t argc, char **argv)
 		case KP_SAMPLE_RC_OFF:
 			shell_error(shell, "Actuator is off, aborted");
 			return 1;
+		case KP_SAMPLE_RC_STALLED:
+			kp_print_stalled(shell);
+			return 1;
 		default:
 			shell_error(shell, "Unexpected error, aborted");
 			return 1;
@@ -911,6 +1696,132 @@ SHELL_CMD_ARG_REGISTER(check, NULL,
 			"specified number of passes (default is one)",
 			kp_cmd_check, 1, 1);
 
+/** The number of rapid-trigger search passes to make by default */
+#define KP_RAPID_PASSES_DEF	8
+
+/** The last rapid-trigger search results */
+static struct kp_rapid kp_rapid;
+
+/** Execute the "rapid" command */
+static int
+kp_cmd_rapid(const struct shell *shell, size_t argc, char **argv)
+{
+	int32_t start;
+	long passes;
+
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return 1;
+	}
+	/* Check for power */
+	if (kp_act_is_off()) {
+		shell_error(shell, "Actuator is off, aborting");
+		return 1;
+	}
+	/* Check for parameters */
+	if (!kp_act_pos_is_valid(kp_act_pos_top)) {
+		shell_error(shell, "Top position not set, aborting");
+		return 1;
+	}
+	if (!kp_act_pos_is_valid(kp_act_pos_bottom)) {
+		shell_error(shell, "Bottom position not set, aborting");
+		return 1;
+	}
+	if (kp_act_pos_top >= kp_act_pos_bottom) {
+		shell_error(shell,
+			    "Top position is not above bottom, aborting");
+		return 1;
+	}
+
+	/* Check that at least one channel is enabled */
+	if (kp_cap_conf_ch_num(&kp_cap_conf, KP_CAP_DIRS_BOTH) == 0) {
+		shell_error(shell, "No enabled channels, aborting");
+		shell_info(shell,
+			   "Use \"set ch\" command to enable channels");
+		return 1;
+	}
+
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_rapid, kp_input_bypass_cb);
+	kp_input_reset();
+
+	if (argc < 2) {
+		passes = KP_RAPID_PASSES_DEF;
+	} else {
+		if (!kp_parse_non_negative_number(argv[1], &passes) ||
+				passes == 0) {
+			shell_error(
+				shell,
+				"Invalid number of passes "
+				"(a number greater than zero expected): %s",
+				argv[1]
+			);
+			return 1;
+		}
+	}
+
+	/* Remember the start position */
+	start = kp_act_locate();
+
+	/* Search for the re-actuation distances */
+	switch (kp_rapid_run(&kp_rapid, kp_act_pos_top, kp_act_pos_bottom,
+			     kp_act_speed, &kp_cap_conf, (size_t)passes)) {
+		case KP_SAMPLE_RC_OK:
+			break;
+		case KP_SAMPLE_RC_ABORTED:
+			shell_error(shell, "Aborted");
+			return 1;
+		case KP_SAMPLE_RC_OFF:
+			shell_error(shell, "Actuator is off, aborted");
+			return 1;
+		case KP_SAMPLE_RC_STALLED:
+			kp_print_stalled(shell);
+			return 1;
+		default:
+			shell_error(shell, "Unexpected error, aborted");
+			return 1;
+	}
+
+	kp_rapid_print(shell, &kp_cap_conf, &kp_rapid);
+
+	/* Return to the start position */
+	switch (kp_act_move_to(start, kp_act_speed)) {
+		case KP_ACT_MOVE_RC_OK:
+			break;
+		case KP_ACT_MOVE_RC_ABORTED:
+			shell_warn(
+				shell,
+				"Move back to the start position "
+				"was aborted"
+			);
+			break;
+		case KP_ACT_MOVE_RC_OFF:
+			shell_warn(
+				shell,
+				"Couldn't move back to the start position - "
+				"actuator is off"
+			);
+			break;
+		default:
+			shell_error(
+				shell,
+				"Unexpected error moving back to the start "
+				"position"
+			);
+			break;
+	}
+
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(rapid, NULL,
+			"Search for the minimum re-actuation (rapid-trigger) "
+			"distance of each channel, reversing from the bottom "
+			"position by up to the top position, with the "
+			"specified number of passes per distance (default is "
+			"8)",
+			kp_cmd_rapid, 1, 1);
+
 /**
  * Adjust the value of the specified top and bottom positions to be within a
  * number of positions around the trigger point, assuming it's between the
@@ -959,14 +1870,25 @@ kp_tighten(int32_t *ptop, int32_t *pbottom,
 	next_top = *ptop;
 	next_bottom = *pbottom;
 
+/* Check a range, sampling only if the trigger map doesn't know the result */
 #define CHECK(_top, _bottom, _ptriggers) \
-	do {                                                    \
-		assert((_top) < (_bottom));                     \
-		rc = kp_sample_check(_top, _bottom, speed,      \
-				     passes, conf, _ptriggers); \
-		if (rc != KP_SAMPLE_RC_OK) {                    \
-			return rc;                              \
-		}                                               \
+	do {                                                            \
+		assert((_top) < (_bottom));                             \
+		switch (kp_map_check(_top, _bottom, conf, passes)) {    \
+		case KP_MAP_VERDICT_TRIGGERS:                           \
+			*(_ptriggers) = passes;                         \
+			break;                                          \
+		case KP_MAP_VERDICT_MISSES:                             \
+			*(_ptriggers) = 0;                              \
+			break;                                          \
+		default:                                                \
+			rc = kp_sample_check(_top, _bottom, speed,      \
+					     passes, conf, _ptriggers); \
+			if (rc != KP_SAMPLE_RC_OK) {                    \
+				return rc;                              \
+			}                                               \
+			break;                                          \
+		}                                                       \
 	} while (0)
 
 	while (true) {
@@ -1040,6 +1962,10 @@ kp_cmd_tighten(const struct shell *shell, size_t argc, char **argv)
 	int32_t bottom = kp_act_pos_bottom;
 	int result = 1;
 
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return 1;
+	}
 	/* Check for parameters */
 	if (!kp_act_pos_is_valid(kp_act_pos_top)) {
 		shell_error(shell, "Top position not set, aborting");
@@ -1110,6 +2036,9 @@ kp_cmd_tighten(const struct shell *shell, size_t argc, char **argv)
 			shell_error(shell,
 				"Actuator is off, aborted");
 			return 1;
+		case KP_SAMPLE_RC_STALLED:
+			kp_print_stalled(shell);
+			return 1;
 		default:
 			shell_error(shell,
 				"Unexpected error, aborted");
@@ -1171,70 +2100,327 @@ SHELL_CMD_ARG_REGISTER(tighten, NULL,
 			"specified number of passes (default 2).",
 			kp_cmd_tighten, 1, 2);
 
-/** Last measurement */
-struct kp_meas kp_meas = KP_MEAS_INVALID;
-
-/** Execute an "acquire"/"print"/"measure" command */
+/** Execute the "split" command */
 static int
-kp_cmd_meas(const struct shell *shell, size_t argc, char **argv)
+kp_cmd_split(const struct shell *shell, size_t argc, char **argv)
 {
 	const char *arg;
-	/* True if a measurement has to be acquired */
-	bool acquire = false;
-	/* Number of measurement passes to make */
-	long acquire_passes = 1;
-	/* Measurement start position */
-	int32_t acquire_start_pos = KP_ACT_POS_INVALID;
-	/* True if measurement's even passes are directed down, false if up */
-	bool acquire_even_down = UINT8_MAX;
-	/* True if the measurement has to be printed */
-	bool print = false;
-	/* True if the measurement must be printed in verbose format */
-	bool print_verbose = false;
-
-	size_t i;
-	enum kp_sample_rc rc;
+	long steps;
+	long passes;
+	int32_t start;
+	size_t ch;
+	enum kp_cap_ne_dirs ne_dirs;
+	enum kp_cap_dirs dir;
+	struct kp_cap_conf conf;
+	struct kp_meas_win *win;
+	int32_t top;
+	int32_t bottom;
+	int result = 0;
+
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return 1;
+	}
+	/* Check for parameters */
+	if (!kp_act_pos_is_valid(kp_act_pos_top)) {
+		shell_error(shell, "Top position not set, aborting");
+		return 1;
+	}
+	if (!kp_act_pos_is_valid(kp_act_pos_bottom)) {
+		shell_error(shell, "Bottom position not set, aborting");
+		return 1;
+	}
 
-	arg = argv[0];
-	if (strcmp(arg, "acquire") == 0) {
-		acquire = true;
-	} else if (strcmp(arg, "print") == 0) {
-		print = true;
-	} else if (strcmp(arg, "measure") == 0) {
-		acquire = true;
-		print = true;
-	} else {
-		assert(!"Unknown command name");
+	/* Check that at least one channel is enabled */
+	if (kp_cap_conf_ch_num(&kp_cap_conf, KP_CAP_DIRS_BOTH) == 0) {
+		shell_error(shell, "No enabled channels, aborting");
+		shell_info(shell,
+			   "Use \"set ch\" command to enable channels");
 		return 1;
 	}
-	/* NOTE: Don't move to next argument yet, as argc is special here */
 
-	if (acquire) {
-		/* Check for power and remember the start position */
-		if (!kp_act_pos_is_valid(
-			acquire_start_pos = kp_act_locate()
-		)) {
-			shell_error(shell, "Actuator is off, aborting");
-			return 1;
-		}
-		/* Check for parameters */
-		if (!kp_act_pos_is_valid(kp_act_pos_top)) {
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_split, kp_input_bypass_cb);
+	kp_input_reset();
+
+	/* Parse the number of steps to tighten to */
+	if (argc < 2) {
+		steps = 1;
+	} else {
+		arg = argv[1];
+		if (!kp_parse_non_negative_number(arg, &steps) ||
+				steps == 0) {
+			shell_error(
+				shell,
+				"Invalid number of steps to tighten to "
+				"(a number greater than zero expected): %s",
+				arg
+			);
+			return 1;
+		}
+	}
+
+	/* Parse the number of passes to use for verifying */
+	if (argc < 3) {
+		passes = 2;
+	} else {
+		arg = argv[2];
+		if (!kp_parse_non_negative_number(arg, &passes) ||
+				passes == 0) {
+			shell_error(
+				shell,
+				"Invalid number of passes "
+				"(a number greater than zero expected): %s",
+				arg
+			);
+			return 1;
+		}
+	}
+
+	/* Remember the start position, if any */
+	start = kp_act_locate();
+
+	/* For each enabled channel and direction */
+	for (ch = 0; ch < ARRAY_SIZE(kp_cap_conf.ch_list); ch++) {
+		for (ne_dirs = KP_CAP_NE_DIRS_UP;
+		     ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			dir = kp_cap_dirs_from_ne(ne_dirs);
+			if (!(kp_cap_conf.ch_list[ch].dirs & dir)) {
+				continue;
+			}
+			win = &kp_act_wins.ch_list[ch][ne_dirs];
+			win->top = KP_ACT_POS_INVALID;
+			win->bottom = KP_ACT_POS_INVALID;
+
+			/* Capture only this channel in this direction */
+			conf = kp_cap_conf;
+			memset(conf.ch_list, 0, sizeof(conf.ch_list));
+			conf.ch_list[ch] = kp_cap_conf.ch_list[ch];
+			conf.ch_list[ch].dirs = dir;
+
+			/* Tighten its window within the top and bottom */
+			top = kp_act_pos_top;
+			bottom = kp_act_pos_bottom;
+			switch (kp_tighten(&top, &bottom, &conf,
+					   (size_t)steps, (size_t)passes,
+					   kp_act_speed)) {
+				case KP_SAMPLE_RC_OK:
+					break;
+				case KP_SAMPLE_RC_ABORTED:
+					shell_error(shell, "Aborted");
+					return 1;
+				case KP_SAMPLE_RC_OFF:
+					shell_error(shell,
+						"Actuator is off, aborted");
+					return 1;
+				case KP_SAMPLE_RC_STALLED:
+					kp_print_stalled(shell);
+					return 1;
+				default:
+					shell_error(shell,
+						"Unexpected error, aborted");
+					return 1;
+			}
+
+			if (kp_act_pos_is_valid(top) &&
+			    kp_act_pos_is_valid(bottom)) {
+				win->top = top;
+				win->bottom = bottom;
+				shell_print(shell, "#%zu %s: %d - %d",
+					    ch, kp_cap_dirs_to_lcstr(dir),
+					    top, bottom);
+			} else {
+				shell_error(shell,
+					"#%zu %s: no reliable trigger "
+					"between the top and bottom positions",
+					ch, kp_cap_dirs_to_lcstr(dir));
+				result = 1;
+			}
+		}
+	}
+
+	/* Return to the start position */
+	switch (kp_act_move_to(start, kp_act_speed)) {
+		case KP_ACT_MOVE_RC_OK:
+			break;
+		case KP_ACT_MOVE_RC_ABORTED:
+			shell_warn(
+				shell,
+				"Move back to the start position "
+				"was aborted"
+			);
+			break;
+		case KP_ACT_MOVE_RC_OFF:
+			shell_warn(
+				shell,
+				"Couldn't move back to the start position - "
+				"actuator is off"
+			);
+			break;
+		default:
+			shell_warn(
+				shell,
+				"Unexpected error moving back to the start "
+				"position"
+			);
+			break;
+	}
+
+	return result;
+}
+
+SHELL_CMD_ARG_REGISTER(split, NULL,
+			"Tighten a separate window within the specified "
+			"number of steps (default 1) around the trigger "
+			"point of each enabled channel and direction, "
+			"between the top and bottom positions, to be "
+			"traversed by measurement passes instead. Verify "
+			"trigger with specified number of passes (default 2).",
+			kp_cmd_split, 1, 2);
+
+/** Execute the "map [clear]" command */
+static int
+kp_cmd_map(const struct shell *shell, size_t argc, char **argv)
+{
+	if (argc >= 2) {
+		if (kp_strcasecmp(argv[1], "clear") != 0) {
+			shell_error(shell,
+				    "Invalid action (clear expected): %s",
+				    argv[1]);
+			return 1;
+		}
+		kp_map_clear();
+		return 0;
+	}
+	kp_map_print(shell, &kp_cap_conf);
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(map, NULL,
+			"Output the trigger map: recently passed position "
+			"ranges with triggered/total passes for each enabled "
+			"channel and direction, or \"clear\" it",
+			kp_cmd_map, 1, 1);
+
+/** Last measurement */
+struct kp_meas kp_meas = KP_MEAS_INVALID;
+
+/** Execute an "acquire"/"print"/"measure" command */
+static int
+kp_cmd_meas(const struct shell *shell, size_t argc, char **argv)
+{
+	const char *arg;
+	/* True if a measurement has to be acquired */
+	bool acquire = false;
+	/* True if the last measurement has to be continued */
+	bool resume = false;
+	/* Number of measurement passes to make (or add, if resuming) */
+	long acquire_passes = 1;
+	/* Measurement start position */
+	int32_t acquire_start_pos = KP_ACT_POS_INVALID;
+	/* True if measurement's even passes are directed down, false if up */
+	bool acquire_even_down = UINT8_MAX;
+	/* True if the captures are triggered by an external stimulus */
+	bool trig_ext = (kp_cap_conf.trig == KP_CAP_TRIG_EXT);
+	/* True if the measurement has to be printed */
+	bool print = false;
+	/* True if the measurement must be printed in verbose format */
+	bool print_verbose = false;
+	/* True if a live dashboard must be output while acquiring */
+	bool print_live = false;
+	/* Predicted acquisition duration, us */
+	uint64_t predicted_us;
+	/* True if the prediction is the worst case */
+	bool predicted_worst = false;
+	/* Acquisition start uptime, ms */
+	int64_t start_ms;
+	/* Actual acquisition duration, us */
+	uint64_t actual_us;
+	/* Number of passes to acquire */
+	size_t passes;
+	char predicted_buf[KP_FMT_DURATION_LEN];
+	char actual_buf[KP_FMT_DURATION_LEN];
+
+	size_t i;
+	enum kp_sample_rc rc;
+
+	arg = argv[0];
+	if (strcmp(arg, "acquire") == 0) {
+		acquire = true;
+	} else if (strcmp(arg, "print") == 0) {
+		print = true;
+	} else if (strcmp(arg, "measure") == 0) {
+		acquire = true;
+		print = true;
+	} else if (strcmp(arg, "resume") == 0) {
+		acquire = true;
+		resume = true;
+		print = true;
+		acquire_passes = 0;
+	} else {
+		assert(!"Unknown command name");
+		return 1;
+	}
+	/* NOTE: Don't move to next argument yet, as argc is special here */
+
+	if (acquire) {
+		/* Check for power and remember the start position */
+		if (!trig_ext && !kp_act_pos_is_valid(
+			acquire_start_pos = kp_act_locate()
+		)) {
+			shell_error(shell, "Actuator is off, aborting");
+			return 1;
+		}
+		/* Check for parameters */
+		if (!trig_ext && !kp_act_pos_is_valid(kp_act_pos_top)) {
 			shell_error(shell, "Top position not set, aborting");
 			return 1;
 		}
-		if (!kp_act_pos_is_valid(kp_act_pos_bottom)) {
+		if (!trig_ext && !kp_act_pos_is_valid(kp_act_pos_bottom)) {
 			shell_error(shell,
 					"Bottom position not set, aborting");
 			return 1;
 		}
-		/* Decide on the initial direction */
-		acquire_even_down = abs(acquire_start_pos - kp_act_pos_top) <
-			abs(acquire_start_pos - kp_act_pos_bottom);
+		if (resume) {
+			/* Check we have a measurement to continue */
+			if (!kp_meas_is_valid(&kp_meas)) {
+				shell_error(shell,
+					"No measurement to resume. "
+					"Execute \"acquire\" or \"measure\" "
+					"command first."
+				);
+				return 1;
+			}
+			if (!kp_meas_matches(&kp_meas,
+					     kp_act_pos_top, kp_act_pos_bottom,
+					     &kp_act_wins, kp_act_speed,
+					     &kp_cap_conf, &kp_lanes)) {
+				shell_error(shell,
+					"Top/bottom positions, windows, "
+					"speed, channel configuration, or "
+					"lanes changed since the measurement, "
+					"aborting"
+				);
+				return 1;
+			}
+			/* Keep the direction of the measurement passes */
+			acquire_even_down = kp_meas.even_down;
+		} else if (trig_ext) {
+			/* Start with the next stimulus edge */
+			acquire_even_down =
+				gpio_pin_get(kp_ext_gpio, kp_ext_pin) == 0;
+		} else {
+			/* Decide on the initial direction */
+			acquire_even_down =
+				abs(acquire_start_pos - kp_act_pos_top) <
+				abs(acquire_start_pos - kp_act_pos_bottom);
+		}
 	} else if (print && !kp_meas_is_valid(&kp_meas)) {
 		shell_error(shell,
 			"No measurement to print. "
 			"Execute \"acquire\" or \"measure\" command first."
 		);
+		return 1;
 	}
 
 	/* Return to the shell and restart in an input-diverted thread */
@@ -1269,11 +2455,15 @@ kp_cmd_meas(const struct shell *shell, size_t argc, char **argv)
 			print_verbose = true;
 		} else if (kp_strcasecmp(arg, "brief") == 0) {
 			print_verbose = false;
+		} else if (acquire && kp_strcasecmp(arg, "live") == 0) {
+			print_live = true;
 		} else {
 			shell_error(
 				shell,
-				"Invalid verbosity argument "
-				"(brief/verbose expected): %s",
+				acquire ? "Invalid verbosity argument "
+					  "(brief/verbose/live expected): %s"
+					: "Invalid verbosity argument "
+					  "(brief/verbose expected): %s",
 				arg
 			);
 			return 1;
@@ -1291,9 +2481,21 @@ kp_cmd_meas(const struct shell *shell, size_t argc, char **argv)
 			return 1;
 		}
 
+		/* Check that the lanes can be interleaved */
+		if (!kp_meas_lanes_are_compatible(&kp_lanes, &kp_cap_conf)) {
+			shell_error(shell,
+				"Lanes have different channel directions, "
+				"or trigger, aborting");
+			shell_info(shell,
+				"Use \"lane clear\" command to remove lanes");
+			return 1;
+		}
+
 		/* Check that we have enough memory to record all passes */
 		i = kp_cap_conf_ch_res_idx(&kp_cap_conf, acquire_even_down,
-						acquire_passes, 0);
+					   (resume ? kp_meas.requested_passes
+						   : 0) + acquire_passes,
+					   0);
 		if (i > ARRAY_SIZE(kp_meas.ch_res_list)) {
 			shell_error(
 				shell,
@@ -1304,81 +2506,1732 @@ kp_cmd_meas(const struct shell *shell, size_t argc, char **argv)
 			return 1;
 		}
 
-		/* Initialize the measurement */
-		kp_meas_init(&kp_meas,
-			     kp_act_pos_top, kp_act_pos_bottom,
-			     kp_act_speed, acquire_passes,
-			     &kp_cap_conf, acquire_even_down);
-		/* Acquire (and possibly print) the measurement */
-		if (print) {
-			rc = kp_meas_make(shell, &kp_meas, print_verbose);
-		} else {
-			rc = kp_meas_acquire(&kp_meas, NULL, NULL);
-		}
-		/* Handle result code */
-		switch (rc) {
-			case KP_SAMPLE_RC_OK:
-				break;
-			case KP_SAMPLE_RC_ABORTED:
-				shell_error(shell, "Aborted");
-				return 1;
-			case KP_SAMPLE_RC_OFF:
-				shell_error(shell, "Actuator is off, aborted");
-				return 1;
-			default:
-				shell_error(shell, "Unexpected error, aborted");
-				return 1;
+		/* Check that the global timebase can be used */
+		if (kp_timebase_global && !kp_check_trig_act(shell)) {
+			shell_info(shell,
+				   "Or use \"set timebase pass\" command "
+				   "to capture external triggers");
+			return 1;
+		}
+
+		/* Predict the acquisition duration, if we're pacing it */
+		passes = (resume ? kp_meas.requested_passes - kp_meas.passes
+				 : 0) + acquire_passes;
+		predicted_us = trig_ext ? 0 : kp_plan_meas_us(
+			acquire_start_pos, kp_act_pos_top, kp_act_pos_bottom,
+			&kp_act_wins, kp_act_speed, &kp_cap_conf,
+			acquire_even_down, &kp_lanes,
+			resume ? kp_meas.passes : 0, passes,
+			&kp_meas, &predicted_worst
+		);
+
+		/*
+		 * Start the global timeline, if requested, checking the lanes
+		 * can share it before touching the previous measurement
+		 */
+		if (kp_timebase_global) {
+			kp_cap_tl_start(&kp_cap_conf);
+			for (i = 0; i < kp_lanes.alt_num; i++) {
+				if (kp_cap_tl_matches(
+					&kp_lanes.alt_list[i].conf)) {
+					continue;
+				}
+				kp_cap_tl_stop();
+				shell_error(shell,
+					"Lanes have different channel edges, "
+					"cannot share the global timebase, "
+					"aborting");
+				shell_info(shell,
+					"Use \"set timebase pass\" command "
+					"to restart the timebase every pass");
+				return 1;
+			}
+		}
+
+		if (resume) {
+			/* Request the additional passes, if any */
+			kp_meas_append(&kp_meas, acquire_passes);
+		} else {
+			/* Initialize the measurement */
+			kp_meas_init(&kp_meas,
+				     kp_act_pos_top, kp_act_pos_bottom,
+				     &kp_act_wins, kp_act_speed,
+				     acquire_passes, &kp_cap_conf,
+				     acquire_even_down, &kp_lanes);
+		}
+		/* Acquire (and possibly print) the measurement */
+		start_ms = k_uptime_get();
+		if (print_live) {
+			rc = kp_meas_make_live(shell, &kp_meas);
+		} else if (print) {
+			rc = kp_meas_make(shell, &kp_meas, print_verbose);
+		} else {
+			rc = kp_meas_acquire(&kp_meas, NULL, NULL);
+		}
+		if (kp_timebase_global) {
+			kp_cap_tl_stop();
+		}
+		/* Handle result code */
+		switch (rc) {
+			case KP_SAMPLE_RC_OK:
+				break;
+			case KP_SAMPLE_RC_ABORTED:
+				shell_error(shell, "Aborted");
+				return 1;
+			case KP_SAMPLE_RC_OFF:
+				shell_error(shell, "Actuator is off, aborted");
+				return 1;
+			case KP_SAMPLE_RC_STUCK:
+				shell_error(shell,
+					    "Channels stuck in %u consecutive "
+					    "passes, aborted",
+					    KP_MEAS_STUCK_PASSES_MAX);
+				shell_info(shell,
+					   "Check the channel connections, and "
+					   "use \"resume\" command "
+					   "to continue");
+				return 1;
+			case KP_SAMPLE_RC_STALLED:
+				kp_print_stalled(shell);
+				return 1;
+			default:
+				shell_error(shell, "Unexpected error, aborted");
+				return 1;
+		}
+
+		/* Report the actual (vs. predicted) duration */
+		actual_us = (uint64_t)(k_uptime_get() - start_ms) * 1000;
+		if (trig_ext) {
+			/* The stimulus paces the acquisition, not us */
+			shell_info(shell, "Took %s",
+				   kp_fmt_duration(actual_buf, actual_us));
+			return 0;
+		}
+		shell_info(shell, "Took %s, predicted %s%s",
+			   kp_fmt_duration(actual_buf, actual_us),
+			   predicted_worst ? "at most " : "",
+			   kp_fmt_duration(predicted_buf, predicted_us));
+		/* Calibrate, unless predicted blindly, or slowed by output */
+		if (!predicted_worst && !print_verbose) {
+			/* Account for the move to the start boundary */
+			kp_plan_calibrate(passes + 1, predicted_us, actual_us);
+		}
+
+		/* Try to return to the start position */
+		switch (kp_act_move_to(acquire_start_pos, kp_act_speed)) {
+			case KP_ACT_MOVE_RC_OK:
+				break;
+			case KP_ACT_MOVE_RC_ABORTED:
+				shell_warn(
+					shell,
+					"Moving back to the start position "
+					"was aborted"
+				);
+				break;
+			case KP_ACT_MOVE_RC_OFF:
+				shell_warn(
+					shell,
+					"Couldn't move back to the start "
+					"position - actuator is off"
+				);
+				break;
+			default:
+				shell_error(
+					shell,
+					"Unexpected error moving back to the "
+					"start position"
+				);
+				break;
+		}
+	} else if (print) {
+		kp_meas_print(shell, &kp_meas, print_verbose);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(measure, NULL,
+		       "Acquire a timing measurement on all enabled "
+		       "channels for specified number of passes "
+		       "(default 1), and output \"brief\" (default), "
+		       "or \"verbose\" results, or show a \"live\" "
+		       "dashboard while acquiring",
+		       kp_cmd_meas, 1, 2);
+
+SHELL_CMD_ARG_REGISTER(acquire, NULL,
+		       "Acquire a timing measurement on all enabled channels "
+		       "for specified number of passes (default 1)",
+		       kp_cmd_meas, 1, 1);
+
+SHELL_CMD_ARG_REGISTER(resume, NULL,
+		       "Continue acquiring the last (e.g. interrupted) "
+		       "measurement with unchanged positions, speed, and "
+		       "channel configuration, adding specified number of "
+		       "passes (default 0), and output \"brief\" (default), "
+		       "or \"verbose\" results, or show a \"live\" "
+		       "dashboard while acquiring",
+		       kp_cmd_meas, 1, 2);
+
+SHELL_CMD_ARG_REGISTER(print, NULL,
+		       "Print the last timing measurement in a \"brief\" "
+		       "(default) or \"verbose\" format",
+		       kp_cmd_meas, 1, 1);
+
+/** Default scope sampling period, us */
+#define KP_SCOPE_PERIOD_US_DEF	10
+
+/** Execute the "scope [<period_us>]" command */
+static int
+kp_cmd_scope(const struct shell *shell, size_t argc, char **argv)
+{
+	long period_us = KP_SCOPE_PERIOD_US_DEF;
+	bool trig_ext = (kp_cap_conf.trig == KP_CAP_TRIG_EXT);
+	int32_t start = KP_ACT_POS_INVALID;
+	bool down;
+	enum kp_cap_dirs dirs;
+	enum kp_sample_rc rc;
+	enum kp_input_msg msg;
+	struct kp_cap_ch_res ch_res_list[KP_CAP_CH_NUM];
+	struct kp_scope_sig sig_list[1 + KP_CAP_CH_NUM];
+	char name_list[KP_CAP_CH_NUM][KP_CAP_CH_NAME_MAX_LEN + 1];
+	size_t num;
+	size_t i;
+
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_scope, kp_input_bypass_cb);
+	kp_input_reset();
+
+	/* Parse the sampling period */
+	if (argc > 1 &&
+	    (!kp_parse_non_negative_number(argv[1], &period_us) ||
+	     !kp_scope_period_is_valid((uint32_t)period_us))) {
+		shell_error(shell,
+			    "Invalid sampling period (1-%u us expected): %s",
+			    KP_SCOPE_PERIOD_MAX_US, argv[1]);
+		return 1;
+	}
+
+	if (trig_ext) {
+		/* Wait for the next stimulus edge */
+		down = gpio_pin_get(kp_ext_gpio, kp_ext_pin) == 0;
+	} else {
+		/* Check for power and remember the start position */
+		if (!kp_act_pos_is_valid(start = kp_act_locate())) {
+			shell_error(shell, "Actuator is off, aborting");
+			return 1;
+		}
+		/* Check for parameters */
+		if (!kp_act_pos_is_valid(kp_act_pos_top)) {
+			shell_error(shell, "Top position not set, aborting");
+			return 1;
+		}
+		if (!kp_act_pos_is_valid(kp_act_pos_bottom)) {
+			shell_error(shell,
+				    "Bottom position not set, aborting");
+			return 1;
+		}
+		/* Move to the closest boundary without capturing */
+		down = abs(start - kp_act_pos_top) <
+			abs(start - kp_act_pos_bottom);
+		rc = kp_sample(down ? kp_act_pos_top : kp_act_pos_bottom,
+			       kp_act_speed, &kp_cap_conf, KP_CAP_DIRS_NONE,
+			       NULL, 0);
+		if (rc == KP_SAMPLE_RC_ABORTED) {
+			shell_error(shell, "Aborted");
+			return 1;
+		} else if (rc == KP_SAMPLE_RC_OFF) {
+			shell_error(shell, "Actuator is off, aborted");
+			return 1;
+		} else if (rc == KP_SAMPLE_RC_STALLED) {
+			kp_print_stalled(shell);
+			return 1;
+		}
+	}
+
+	/* Sample a pass, starting with its capture */
+	dirs = kp_cap_dirs_from_down(down);
+	kp_scope_arm((uint32_t)period_us);
+	if (trig_ext) {
+		rc = kp_sample_ext(&kp_cap_conf, dirs,
+				   ch_res_list, ARRAY_SIZE(ch_res_list));
+	} else {
+		rc = kp_sample(down ? kp_act_pos_bottom : kp_act_pos_top,
+			       kp_act_speed, &kp_cap_conf, dirs,
+			       ch_res_list, ARRAY_SIZE(ch_res_list));
+	}
+	/* Wait for the samples to fill up, unless aborted */
+	while (rc == KP_SAMPLE_RC_OK &&
+	       kp_scope_get_num() < KP_SCOPE_SAMPLE_NUM) {
+		if (kp_input_get(&msg, K_MSEC(1)) == 0 &&
+		    msg == KP_INPUT_MSG_ABORT) {
+			rc = KP_SAMPLE_RC_ABORTED;
+		}
+	}
+	num = kp_scope_disarm();
+	if (rc == KP_SAMPLE_RC_ABORTED) {
+		shell_error(shell, "Aborted");
+		return 1;
+	} else if (rc == KP_SAMPLE_RC_OFF) {
+		shell_error(shell, "Actuator is off, aborted");
+		return 1;
+	} else if (rc == KP_SAMPLE_RC_STALLED) {
+		kp_print_stalled(shell);
+		return 1;
+	}
+
+	/* Output the trigger and all the channels */
+	sig_list[0] = (struct kp_scope_sig){
+		.name = trig_ext ? "stimulus" : "actuator",
+		.pin = trig_ext ? kp_ext_pin : kp_cap_pin_trig,
+	};
+	for (i = 0; i < KP_CAP_CH_NUM; i++) {
+		if (kp_cap_conf.ch_list[i].name[0] == '\0') {
+			snprintf(name_list[i], sizeof(name_list[i]),
+				 "ch%zu", i);
+		} else {
+			strncpy(name_list[i], kp_cap_conf.ch_list[i].name,
+				sizeof(name_list[i]));
+		}
+		sig_list[1 + i] = (struct kp_scope_sig){
+			.name = name_list[i],
+			.pin = kp_cap_pin_ch_base + i,
+		};
+	}
+	kp_scope_print_vcd(shell, (uint32_t)period_us, num,
+			   sig_list, ARRAY_SIZE(sig_list));
+
+	/* Return to the start position, if we moved */
+	if (!trig_ext &&
+	    kp_act_move_to(start, kp_act_speed) != KP_ACT_MOVE_RC_OK) {
+		shell_warn(shell,
+			   "Couldn't move back to the start position");
+	}
+
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(scope, NULL,
+		       "Sample the trigger and channel inputs every "
+		       "specified number of microseconds (default 10) "
+		       "during a pass, and output them in VCD format",
+		       kp_cmd_scope, 1, 1);
+
+/** Period of "freq" command statistics output, ms */
+#define KP_FREQ_PERIOD_MS	1000
+
+/** Execute the "freq <ch> [<seconds>]" command */
+static int
+kp_cmd_freq(const struct shell *shell, size_t argc, char **argv)
+{
+	long ch;
+	long seconds = 0;
+	long elapsed;
+	int64_t deadline;
+	int64_t remaining;
+	enum kp_input_msg msg;
+	bool stopped = false;
+	bool aborted = false;
+	struct kp_cap_pwm pwm;
+	struct kp_table table;
+	uint32_t mean_us;
+
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_freq, kp_input_bypass_cb);
+	kp_input_reset();
+
+	/* Parse arguments */
+	if (!kp_parse_non_negative_number(argv[1], &ch) ||
+	    ch >= KP_CAP_CH_NUM) {
+		shell_error(shell,
+			    "Invalid channel index (0-%u expected): %s",
+			    KP_CAP_CH_NUM - 1, argv[1]);
+		return 1;
+	}
+	if (argc > 2 &&
+	    (!kp_parse_non_negative_number(argv[2], &seconds) ||
+	     seconds == 0)) {
+		shell_error(shell,
+			    "Invalid number of seconds "
+			    "(a number greater than zero expected): %s",
+			    argv[2]);
+		return 1;
+	}
+
+	/* Output the header */
+	kp_table_init(&table, shell, 7, 10, 8);
+	kp_table_col(&table, "Time, s");
+	kp_table_col(&table, "Periods");
+	kp_table_col(&table, "Missed");
+	kp_table_col(&table, "Min, us");
+	kp_table_col(&table, "Mean, us");
+	kp_table_col(&table, "Max, us");
+	kp_table_col(&table, "Jitter, us");
+	kp_table_col(&table, "Duty, %%");
+	kp_table_nl(&table);
+	kp_table_sep(&table);
+
+	/* Measure, outputting running statistics periodically */
+	kp_cap_pwm_start((size_t)ch);
+	deadline = k_uptime_get();
+	for (elapsed = 1; !stopped &&
+			  (seconds == 0 ||
+			   elapsed <= seconds * 1000 / KP_FREQ_PERIOD_MS);
+	     elapsed++) {
+		/* Wait for the next output, stopping on Enter or Ctrl-C */
+		deadline += KP_FREQ_PERIOD_MS;
+		while (!stopped &&
+		       (remaining = deadline - k_uptime_get()) > 0) {
+			if (kp_input_get(&msg, K_MSEC(remaining)) != 0) {
+				continue;
+			}
+			if (msg == KP_INPUT_MSG_ABORT) {
+				stopped = aborted = true;
+			} else if (msg == KP_INPUT_MSG_ENTER) {
+				stopped = true;
+			}
+		}
+		if (aborted) {
+			break;
+		}
+
+		/* Output the statistics so far */
+		kp_cap_pwm_get(&pwm);
+		kp_table_col(&table, "%ld",
+			     elapsed * KP_FREQ_PERIOD_MS / 1000);
+		kp_table_col(&table, "%zu", pwm.periods);
+		kp_table_col(&table, "%zu", pwm.missed);
+		if (pwm.periods == 0) {
+			kp_table_col(&table, "");
+			kp_table_col(&table, "");
+			kp_table_col(&table, "");
+			kp_table_col(&table, "");
+			kp_table_col(&table, "");
+		} else {
+			mean_us = (uint32_t)(pwm.period_sum_us / pwm.periods);
+			kp_table_col(&table, "%u", pwm.period_min_us);
+			kp_table_col(&table, "%u", mean_us);
+			kp_table_col(&table, "%u", pwm.period_max_us);
+			kp_table_col(&table, "%u",
+				     kp_cap_pwm_get_jitter_us(&pwm));
+			if (pwm.highs == 0 || mean_us == 0) {
+				kp_table_col(&table, "");
+			} else {
+				kp_table_col(&table, "%u",
+					     (uint32_t)(pwm.high_sum_us /
+							pwm.highs * 100 /
+							mean_us));
+			}
+		}
+		kp_table_nl(&table);
+	}
+	kp_cap_pwm_stop();
+
+	if (aborted) {
+		shell_error(shell, "Aborted");
+		return 1;
+	}
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(freq, NULL,
+		       "Measure period and duty cycle of a periodic signal "
+		       "on the specified channel, outputting running "
+		       "statistics every second, for specified number of "
+		       "seconds, or until interrupted",
+		       kp_cmd_freq, 2, 1);
+
+/**
+ * Move the X axis actuator to a position, aborting on Ctrl-C.
+ * Must be called from an input-diverted thread.
+ *
+ * @param pos	The position to move the X axis actuator to.
+ *
+ * @return The movement result.
+ */
+static enum kp_act_move_rc
+kp_xmove_to(int32_t pos)
+{
+	int32_t cur;
+	int64_t deadline;
+	int64_t remaining;
+	enum kp_input_msg msg;
+
+	assert(kp_act_pos_is_valid(pos));
+
+	/*
+	 * The channel windows and the triggers mapped for the current key
+	 * won't apply to another
+	 */
+	if (kp_xact_locate() != pos) {
+		kp_meas_wins_clear(&kp_act_wins);
+		kp_map_clear();
+	}
+
+	while ((cur = kp_xact_locate()) != pos) {
+		if (!kp_act_pos_is_valid(cur) || !kp_xact_step(pos > cur)) {
+			return KP_ACT_MOVE_RC_OFF;
+		}
+		/* Wait for the step to complete, handling input */
+		deadline = k_uptime_ticks() +
+			k_us_to_ticks_ceil64(KP_XACT_STEP_US);
+		while ((remaining = deadline - k_uptime_ticks()) > 0) {
+			if (kp_input_get(&msg, K_TICKS(remaining)) == 0 &&
+			    msg == KP_INPUT_MSG_ABORT) {
+				return KP_ACT_MOVE_RC_ABORTED;
+			}
+		}
+	}
+
+	return KP_ACT_MOVE_RC_OK;
+}
+
+/** Execute the "x on" command */
+static int
+kp_cmd_x_on(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	if (!kp_xact_on()) {
+		shell_info(shell, "X axis actuator is already on");
+	}
+	return 0;
+}
+
+/** Execute the "x off" command */
+static int
+kp_cmd_x_off(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	if (!kp_xact_off()) {
+		shell_info(shell, "X axis actuator is already off");
+	}
+	return 0;
+}
+
+/** Execute the "x left/right [steps]" commands */
+static int
+kp_cmd_x_move(const struct shell *shell, size_t argc, char **argv)
+{
+	long steps = 1;
+	int32_t pos;
+
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_x_move, kp_input_bypass_cb);
+	kp_input_reset();
+
+	if (argc >= 2 && !kp_parse_non_negative_number(argv[1], &steps)) {
+		shell_error(shell, "Invalid number of steps: %s", argv[1]);
+		return 1;
+	}
+
+	/* Check for power */
+	if (!kp_act_pos_is_valid(pos = kp_xact_locate())) {
+		shell_error(shell, "X axis actuator is off, aborting");
+		return 1;
+	}
+	pos += (strcmp(argv[0], "left") == 0) ? -steps : steps;
+	if (!kp_act_pos_is_valid(pos)) {
+		shell_error(shell, "Position out of range");
+		return 1;
+	}
+	switch (kp_xmove_to(pos)) {
+		case KP_ACT_MOVE_RC_OK:
+			return 0;
+		case KP_ACT_MOVE_RC_OFF:
+			shell_error(shell,
+				    "X axis actuator is off, stopping");
+			return 1;
+		case KP_ACT_MOVE_RC_ABORTED:
+			shell_error(shell, "Aborted");
+			return 1;
+		default:
+			shell_error(shell, "Unexpected error, aborted");
+			return 1;
+	}
+}
+
+/** Execute the "x get" command */
+static int
+kp_cmd_x_get(const struct shell *shell, size_t argc, char **argv)
+{
+	int32_t pos = kp_xact_locate();
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	if (!kp_act_pos_is_valid(pos)) {
+		shell_error(shell, "X axis actuator is off");
+		return 1;
+	}
+	shell_print(shell, "%d", pos);
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(x_subcmds,
+	SHELL_CMD(on, NULL,
+		  "Turn on X axis actuator, making its position zero",
+		  kp_cmd_x_on),
+	SHELL_CMD(off, NULL, "Turn off X axis actuator", kp_cmd_x_off),
+	SHELL_CMD_ARG(left, NULL, "Move X axis actuator left (n steps)",
+		      kp_cmd_x_move, 1, 1),
+	SHELL_CMD_ARG(right, NULL, "Move X axis actuator right (n steps)",
+		      kp_cmd_x_move, 1, 1),
+	SHELL_CMD(get, NULL, "Get X axis actuator position", kp_cmd_x_get),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(x, &x_subcmds,
+		   "Control the X axis (key indexing) actuator", NULL);
+
+/** Execute the "jitter on" command */
+static int
+kp_cmd_jitter_on(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	kp_act_jitter_enable(true);
+	return 0;
+}
+
+/** Execute the "jitter off" command */
+static int
+kp_cmd_jitter_off(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	kp_act_jitter_enable(false);
+	return 0;
+}
+
+/**
+ * Print step timing jitter statistics with a title.
+ *
+ * @param shell		The shell to print to.
+ * @param title		The title to print the statistics under.
+ * @param jitter	The statistics to print.
+ */
+static void
+kp_cmd_jitter_print_stats(const struct shell *shell, const char *title,
+			  const struct kp_act_jitter *jitter)
+{
+	size_t i;
+
+	assert(shell != NULL);
+	assert(title != NULL);
+	assert(jitter != NULL);
+
+	shell_print(shell, "%s:", title);
+	if (jitter->intervals == 0) {
+		shell_print(shell, "  No step intervals measured");
+		return;
+	}
+
+	if (jitter->moves > 1) {
+		shell_print(shell, "      Moves: %u", jitter->moves);
+	}
+	shell_print(shell, "  Intervals: %u", jitter->intervals);
+	shell_print(shell, "   Mean, us: %u",
+		    (uint32_t)(jitter->sum_us / jitter->intervals));
+	shell_print(shell, "    P99, us: %u",
+		    kp_act_jitter_get_percentile_us(jitter, 99));
+	if (jitter->moves > 1) {
+		shell_print(shell, "Max P99, us: %u",
+			    jitter->move_p99_max_us);
+	}
+	shell_print(shell, "    Max, us: %u", jitter->max_us);
+
+	/* Output non-empty histogram bins */
+	for (i = 0; i < ARRAY_SIZE(jitter->bins); i++) {
+		if (jitter->bins[i] == 0) {
+			continue;
+		}
+		if (i < ARRAY_SIZE(jitter->bins) - 1) {
+			shell_print(shell, "%6zu-%zu us: %u",
+				    i * KP_ACT_JITTER_BIN_US,
+				    (i + 1) * KP_ACT_JITTER_BIN_US - 1,
+				    jitter->bins[i]);
+		} else {
+			shell_print(shell, "%6zu+ us: %u",
+				    i * KP_ACT_JITTER_BIN_US,
+				    jitter->bins[i]);
+		}
+	}
+}
+
+/** Execute the "jitter print" command */
+static int
+kp_cmd_jitter_print(const struct shell *shell, size_t argc, char **argv)
+{
+	struct kp_act_jitter all;
+	struct kp_act_jitter move;
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (!kp_act_jitter_get(&all, &move)) {
+		shell_warn(shell, "Jitter monitoring is off");
+	}
+
+	kp_cmd_jitter_print_stats(shell, "Last move", &move);
+	kp_cmd_jitter_print_stats(shell, "All moves", &all);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(jitter_subcmds,
+	SHELL_CMD(on, NULL,
+		  "Reset statistics and start monitoring step timing jitter",
+		  kp_cmd_jitter_on),
+	SHELL_CMD(off, NULL, "Stop monitoring step timing jitter",
+		  kp_cmd_jitter_off),
+	SHELL_CMD(print, NULL,
+		  "Print deviations of step intervals from planned, "
+		  "for the last move and all moves monitored so far",
+		  kp_cmd_jitter_print),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(jitter, &jitter_subcmds,
+		   "Monitor actuator step timing jitter", NULL);
+
+/** Execute the "driver type <plain/tmc/sim>" command */
+static int
+kp_cmd_driver_type(const struct shell *shell, size_t argc, char **argv)
+{
+	enum kp_drv_type type;
+	struct kp_drv_conf conf;
+	enum kp_drv_rc rc;
+
+	assert(argc == 2);
+
+	if (!kp_drv_type_from_str(argv[1], &type)) {
+		shell_error(shell,
+			    "Invalid driver type (plain/tmc/sim expected): %s",
+			    argv[1]);
+		return 1;
+	}
+	kp_drv_get(NULL, &conf);
+	rc = kp_drv_set(type, &conf);
+	if (rc != KP_DRV_RC_OK) {
+		shell_error(shell, "Failed configuring the driver: %s",
+			    kp_drv_rc_to_str(rc));
+		return 1;
+	}
+	return 0;
+}
+
+/** Execute the "driver conf <microsteps> <run> <hold> <stall>" command */
+static int
+kp_cmd_driver_conf(const struct shell *shell, size_t argc, char **argv)
+{
+	enum kp_drv_type type;
+	struct kp_drv_conf conf;
+	struct kp_drv_conf prev_conf;
+	enum kp_drv_rc rc;
+	long microsteps;
+	long run_current;
+	long hold_current;
+	long stall_threshold;
+
+	assert(argc == 5);
+
+	if (!kp_parse_non_negative_number(argv[1], &microsteps) ||
+	    microsteps < 1 || microsteps > KP_DRV_MICROSTEPS_MAX ||
+	    (microsteps & (microsteps - 1)) != 0) {
+		shell_error(shell,
+			    "Invalid microsteps "
+			    "(a power of two, 1-%u expected): %s",
+			    KP_DRV_MICROSTEPS_MAX, argv[1]);
+		return 1;
+	}
+	if (!kp_parse_non_negative_number(argv[2], &run_current) ||
+	    run_current < 1 || run_current > KP_DRV_CURRENT_MAX) {
+		shell_error(shell,
+			    "Invalid run current (1-%u expected): %s",
+			    KP_DRV_CURRENT_MAX, argv[2]);
+		return 1;
+	}
+	if (!kp_parse_non_negative_number(argv[3], &hold_current) ||
+	    hold_current < 1 || hold_current > KP_DRV_CURRENT_MAX) {
+		shell_error(shell,
+			    "Invalid hold current (1-%u expected): %s",
+			    KP_DRV_CURRENT_MAX, argv[3]);
+		return 1;
+	}
+	if (!kp_parse_non_negative_number(argv[4], &stall_threshold) ||
+	    stall_threshold > KP_DRV_STALL_THRESHOLD_MAX) {
+		shell_error(shell,
+			    "Invalid stall threshold (0-%u expected): %s",
+			    KP_DRV_STALL_THRESHOLD_MAX, argv[4]);
+		return 1;
+	}
+
+	conf = (struct kp_drv_conf){
+		.microsteps = (uint32_t)microsteps,
+		.run_current = (uint32_t)run_current,
+		.hold_current = (uint32_t)hold_current,
+		.stall_threshold = (uint32_t)stall_threshold,
+	};
+	kp_drv_get(&type, &prev_conf);
+	rc = kp_drv_set(type, &conf);
+	if (rc != KP_DRV_RC_OK) {
+		shell_error(shell, "Failed configuring the driver: %s",
+			    kp_drv_rc_to_str(rc));
+		return 1;
+	}
+
+	/* Forget the positions, if the step size changed */
+	if (conf.microsteps != prev_conf.microsteps) {
+		kp_act_pos_top = KP_ACT_POS_INVALID;
+		kp_act_pos_bottom = KP_ACT_POS_INVALID;
+		kp_meas_wins_clear(&kp_act_wins);
+		kp_map_clear();
+		shell_warn(shell,
+			   "Microsteps changed, the top and bottom "
+			   "positions, channel windows, and the trigger map "
+			   "are forgotten");
+		shell_info(shell,
+			   "Execute \"home\" command, and set the positions "
+			   "again");
+	}
+	return 0;
+}
+
+/** Execute the "driver get" command */
+static int
+kp_cmd_driver_get(const struct shell *shell, size_t argc, char **argv)
+{
+	enum kp_drv_type type;
+	struct kp_drv_conf conf;
+	enum kp_drv_rc rc;
+	uint32_t load;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	kp_drv_get(&type, &conf);
+	shell_print(shell, "Type: %s", kp_drv_type_to_lcstr(type));
+	shell_print(shell, "Microsteps: %u", conf.microsteps);
+	shell_print(shell, "Run current: %u/%u",
+		    conf.run_current, KP_DRV_CURRENT_MAX);
+	shell_print(shell, "Hold current: %u/%u",
+		    conf.hold_current, KP_DRV_CURRENT_MAX);
+	if (conf.stall_threshold == 0) {
+		shell_print(shell, "Stall threshold: off");
+	} else {
+		shell_print(shell, "Stall threshold: %u",
+			    conf.stall_threshold);
+	}
+	if (type == KP_DRV_TYPE_PLAIN) {
+		return 0;
+	}
+	rc = kp_drv_read_load(&load);
+	if (rc != KP_DRV_RC_OK) {
+		shell_error(shell, "Failed reading the load: %s",
+			    kp_drv_rc_to_str(rc));
+		return 1;
+	}
+	shell_print(shell, "Load: %u", load);
+	return 0;
+}
+
+/** Execute the "driver stop <steps>" command */
+static int
+kp_cmd_driver_stop(const struct shell *shell, size_t argc, char **argv)
+{
+	enum kp_drv_type type;
+	long steps;
+
+	assert(argc == 2);
+
+	kp_drv_get(&type, NULL);
+	if (type != KP_DRV_TYPE_SIM) {
+		shell_error(shell,
+			    "Not a simulated driver, "
+			    "execute \"driver type sim\" first");
+		return 1;
+	}
+	if (!kp_parse_non_negative_number(argv[1], &steps)) {
+		shell_error(shell, "Invalid number of steps: %s", argv[1]);
+		return 1;
+	}
+	kp_drv_sim_set_stop((uint32_t)MIN(steps, INT32_MAX));
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(driver_subcmds,
+	SHELL_CMD_ARG(type, NULL,
+		  "Switch the actuator driver type, and configure it: "
+		  "plain/tmc/sim",
+		  kp_cmd_driver_type, 2, 0),
+	SHELL_CMD_ARG(conf, NULL,
+		  "Configure the actuator driver: <microsteps> "
+		  "<run current> <hold current> (1-32) "
+		  "<stall threshold> (0-255, 0 - off)",
+		  kp_cmd_driver_conf, 5, 0),
+	SHELL_CMD(get, NULL,
+		  "Print the actuator driver type, configuration, "
+		  "and the current load",
+		  kp_cmd_driver_get),
+	SHELL_CMD_ARG(stop, NULL,
+		  "Place the simulated hard stop n steps above "
+		  "the simulated motor",
+		  kp_cmd_driver_stop, 2, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(driver, &driver_subcmds,
+		   "Configure the actuator stepper driver", NULL);
+
+/** Maximum number of steps to move up looking for a stall, by default */
+#define KP_HOME_STEPS_DEF	10000
+
+/** Execute the "home [steps]" command */
+static int
+kp_cmd_home(const struct shell *shell, size_t argc, char **argv)
+{
+	long steps;
+
+	if (argc >= 2) {
+		if (!kp_parse_non_negative_number(argv[1], &steps) ||
+		    steps == 0 || steps > INT32_MAX) {
+			shell_error(shell, "Invalid number of steps: %s",
+				    argv[1]);
+			return 1;
+		}
+	} else {
+		steps = KP_HOME_STEPS_DEF;
+	}
+	if (!kp_drv_stall_is_enabled()) {
+		shell_error(shell,
+			    "Stall detection is off, "
+			    "configure a driver with a stall threshold first");
+		return 1;
+	}
+
+	/* Move up until the driver stalls against the stop */
+	switch (kp_act_move_by(-steps, kp_act_speed)) {
+		case KP_ACT_MOVE_RC_STALLED:
+			break;
+		case KP_ACT_MOVE_RC_OK:
+			shell_error(shell, "No stall within %ld steps", steps);
+			return 1;
+		case KP_ACT_MOVE_RC_OFF:
+			shell_error(shell, "Actuator is off, stopping");
+			return 1;
+		case KP_ACT_MOVE_RC_ABORTED:
+			shell_error(shell, "Aborted");
+			return 1;
+		default:
+			shell_error(shell, "Unexpected error, aborted");
+			return 1;
+	}
+
+	/* Make the stop the origin, losing everything relative to before */
+	if (!kp_act_zero()) {
+		shell_error(shell, "Actuator is off, stopping");
+		return 1;
+	}
+	kp_act_pos_top = KP_ACT_POS_INVALID;
+	kp_act_pos_bottom = KP_ACT_POS_INVALID;
+	kp_meas_wins_clear(&kp_act_wins);
+	kp_map_clear();
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(home, NULL,
+		       "Move the actuator up (at most n steps) until the "
+		       "driver detects a stall, and make that position zero",
+		       kp_cmd_home, 1, 1);
+
+/** The last (or current) endurance run */
+static struct kp_endure kp_endure;
+
+/** Endurance run progress output period, ms */
+#define KP_ENDURE_PROGRESS_PERIOD_MS	10000
+
+/** Endurance run state between passes */
+struct kp_endure_pass_state {
+	/** The shell to output progress to */
+	const struct shell *shell;
+	/** Uptime of the last checkpoint, ms */
+	int64_t ckpt_ms;
+	/** Uptime of the last progress output, ms */
+	int64_t progress_ms;
+};
+
+/**
+ * Checkpoint the endurance run, if enabled: its configuration together with
+ * the statistics, so they always match, even if checkpointing was enabled
+ * mid-run. The unchanged configuration is not written to flash again.
+ *
+ * @return True if the run was checkpointed, false otherwise.
+ */
+static bool
+kp_endure_ckpt(void)
+{
+	assert(kp_endure_is_valid(&kp_endure));
+	return kp_endure_ckpt_period_s != 0 &&
+	       kp_ckpt_is_initialized() &&
+	       kp_ckpt_save(KP_CKPT_ID_ENDURE_CONF,
+			    &kp_endure.conf, sizeof(kp_endure.conf)) &&
+	       kp_ckpt_save(KP_CKPT_ID_ENDURE_STATS,
+			    &kp_endure.stats, sizeof(kp_endure.stats));
+}
+
+/**
+ * Handle an endurance run pass: checkpoint the statistics and output
+ * progress, when it's time.
+ *
+ * @param endure	The endurance run so far.
+ * @param data		The endurance run pass state.
+ */
+static void
+kp_endure_pass(const struct kp_endure *endure, void *data)
+{
+	struct kp_endure_pass_state *state =
+		(struct kp_endure_pass_state *)data;
+	int64_t now_ms = k_uptime_get();
+
+	assert(endure == &kp_endure);
+	assert(state != NULL);
+
+	if (kp_endure_ckpt_period_s != 0 &&
+	    now_ms - state->ckpt_ms >=
+	    (int64_t)kp_endure_ckpt_period_s * 1000) {
+		kp_endure_ckpt();
+		state->ckpt_ms = now_ms;
+	}
+	if (now_ms - state->progress_ms >= KP_ENDURE_PROGRESS_PERIOD_MS) {
+		shell_print(state->shell, "%u passes", endure->stats.passes);
+		state->progress_ms = now_ms;
+	}
+}
+
+/**
+ * Continue the endurance run, and output its statistics.
+ * Must be called from an input-diverted thread.
+ *
+ * @param shell	The shell to output to.
+ *
+ * @return Zero if the run completed, or was interrupted, non-zero on error.
+ */
+static int
+kp_endure_continue(const struct shell *shell)
+{
+	struct kp_endure_pass_state state;
+	enum kp_sample_rc rc;
+	int32_t start;
+	int result = 1;
+
+	assert(kp_endure_is_valid(&kp_endure));
+
+	start = kp_act_locate();
+	state.shell = shell;
+	state.ckpt_ms = state.progress_ms = k_uptime_get();
+	rc = kp_endure_run(&kp_endure, kp_act_pos_top, kp_act_pos_bottom,
+			   kp_endure_pass, &state);
+	/* Checkpoint whatever we got */
+	kp_endure_ckpt();
+	switch (rc) {
+		case KP_SAMPLE_RC_OK:
+			result = 0;
+			break;
+		case KP_SAMPLE_RC_ABORTED:
+			shell_warn(shell, "Interrupted");
+			result = 0;
+			break;
+		case KP_SAMPLE_RC_OFF:
+			shell_error(shell, "Actuator is off, aborted");
+			break;
+		case KP_SAMPLE_RC_STALLED:
+			kp_print_stalled(shell);
+			break;
+		default:
+			shell_error(shell, "Unexpected error, aborted");
+			break;
+	}
+	kp_endure_print(shell, &kp_endure);
+
+	/* Return to the start position, unless it can't be trusted */
+	if (rc != KP_SAMPLE_RC_OFF && rc != KP_SAMPLE_RC_STALLED &&
+	    kp_act_move_to(start, kp_act_speed) != KP_ACT_MOVE_RC_OK) {
+		shell_warn(shell, "Couldn't move back to the start position");
+	}
+
+	return result;
+}
+
+/**
+ * Check that an endurance run can make passes, and output an error, if not.
+ *
+ * @param shell	The shell to output the error to.
+ *
+ * @return True if the endurance run can make passes, false otherwise.
+ */
+static bool
+kp_endure_check_ready(const struct shell *shell)
+{
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return false;
+	}
+	/* Check for power */
+	if (kp_act_is_off()) {
+		shell_error(shell, "Actuator is off, aborting");
+		return false;
+	}
+	/* Check for parameters */
+	if (!kp_act_pos_is_valid(kp_act_pos_top) ||
+	    !kp_act_pos_is_valid(kp_act_pos_bottom)) {
+		shell_error(shell, "Top/bottom positions not set, aborting");
+		shell_info(shell,
+			   "Use \"setup\" command to set them");
+		return false;
+	}
+	return true;
+}
+
+/** Execute the "endure start [<passes>]" command */
+static int
+kp_cmd_endure_start(const struct shell *shell, size_t argc, char **argv)
+{
+	long passes = 0;
+	int32_t pos;
+
+	if (!kp_endure_check_ready(shell)) {
+		return 1;
+	}
+	/* Check that at least one channel is enabled */
+	if (kp_cap_conf_ch_num(&kp_cap_conf, KP_CAP_DIRS_BOTH) == 0) {
+		shell_error(shell, "No enabled channels, aborting");
+		shell_info(shell,
+			   "Use \"set ch\" command to enable channels");
+		return 1;
+	}
+
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_endure_start, kp_input_bypass_cb);
+	kp_input_reset();
+
+	if (argc >= 2 && !kp_parse_non_negative_number(argv[1], &passes)) {
+		shell_error(shell, "Invalid number of passes: %s", argv[1]);
+		return 1;
+	}
+
+	/* Start from the closest boundary */
+	pos = kp_act_locate();
+	kp_endure_init(&kp_endure, &kp_cap_conf, kp_act_speed,
+		       (uint32_t)passes,
+		       abs(pos - kp_act_pos_top) <
+		       abs(pos - kp_act_pos_bottom));
+
+	/* Don't let an earlier run be restored after a reset */
+	if (kp_ckpt_is_initialized()) {
+		kp_ckpt_erase(KP_CKPT_ID_ENDURE_STATS);
+		kp_ckpt_erase(KP_CKPT_ID_ENDURE_CONF);
+	}
+	/* Checkpoint the configuration, and the empty statistics */
+	if (kp_endure_ckpt_period_s != 0 && !kp_endure_ckpt()) {
+		shell_warn(shell,
+			   "Cannot store checkpoints, "
+			   "the run won't survive a reset");
+	}
+
+	return kp_endure_continue(shell);
+}
+
+/** Execute the "endure resume" command */
+static int
+kp_cmd_endure_resume(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (!kp_endure_is_valid(&kp_endure)) {
+		shell_error(shell,
+			    "No endurance run to resume. "
+			    "Execute \"endure start\" command first.");
+		return 1;
+	}
+	if (kp_endure_is_complete(&kp_endure)) {
+		shell_error(shell, "Endurance run is complete");
+		return 1;
+	}
+	if (!kp_endure_check_ready(shell)) {
+		return 1;
+	}
+	if (!kp_cap_conf_is_equal(&kp_endure.conf.cap, &kp_cap_conf) ||
+	    kp_endure.conf.speed != kp_act_speed) {
+		shell_error(shell,
+			    "Speed or channel configuration changed since "
+			    "the endurance run started, aborting");
+		return 1;
+	}
+
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_endure_resume, kp_input_bypass_cb);
+	kp_input_reset();
+
+	return kp_endure_continue(shell);
+}
+
+/** Execute the "endure print" command */
+static int
+kp_cmd_endure_print(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (!kp_endure_is_valid(&kp_endure)) {
+		shell_error(shell, "No endurance run to print");
+		return 1;
+	}
+	kp_endure_print(shell, &kp_endure);
+	return 0;
+}
+
+/** Execute the "endure clear" command */
+static int
+kp_cmd_endure_clear(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(shell);
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	kp_endure = KP_ENDURE_INVALID;
+	if (kp_ckpt_is_initialized()) {
+		kp_ckpt_erase(KP_CKPT_ID_ENDURE_STATS);
+		kp_ckpt_erase(KP_CKPT_ID_ENDURE_CONF);
+	}
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(endure_subcmds,
+	SHELL_CMD_ARG(start, NULL,
+		      "Start an endurance run of specified number of passes "
+		      "(default 0, unlimited) between the top and bottom "
+		      "positions, checkpointing statistics to flash",
+		      kp_cmd_endure_start, 1, 1),
+	SHELL_CMD(resume, NULL,
+		  "Continue the last (e.g. interrupted, or checkpointed "
+		  "before a reset) endurance run",
+		  kp_cmd_endure_resume),
+	SHELL_CMD(print, NULL, "Print the endurance run statistics",
+		  kp_cmd_endure_print),
+	SHELL_CMD(clear, NULL,
+		  "Forget the endurance run and remove its checkpoints",
+		  kp_cmd_endure_clear),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(endure, &endure_subcmds,
+		   "Run and checkpoint long endurance measurements", NULL);
+
+/**
+ * Restore the endurance run, and its configuration, from checkpoints, if
+ * any.
+ *
+ * @return True if the endurance run was restored, false otherwise.
+ */
+static bool
+kp_endure_restore(void)
+{
+	struct kp_endure endure;
+
+	if (!kp_ckpt_load(KP_CKPT_ID_ENDURE_CONF,
+			  &endure.conf, sizeof(endure.conf)) ||
+	    !kp_ckpt_load(KP_CKPT_ID_ENDURE_STATS,
+			  &endure.stats, sizeof(endure.stats)) ||
+	    !kp_endure_is_valid(&endure)) {
+		return false;
+	}
+	kp_endure = endure;
+	kp_cap_conf = endure.conf.cap;
+	kp_act_speed = endure.conf.speed;
+	return true;
+}
+
+/** Execute the "bench" command */
+static int
+kp_cmd_bench(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct kp_bench_res res;
+	static struct kp_bench_res base;
+	bool save = false;
+	bool force = false;
+	bool have_base = false;
+	size_t i;
+
+	if (argc > 3) {
+		shell_error(shell, "Invalid number of arguments");
+		return 1;
+	}
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "save") == 0) {
+			save = true;
+		} else if (strcmp(argv[i], "force") == 0) {
+			force = true;
+		} else {
+			shell_error(shell, "Invalid argument: %s", argv[i]);
+			return 1;
+		}
+	}
+
+	/* Don't discard the last measurement, unless forced */
+	if (kp_meas_is_valid(&kp_meas) && !force) {
+		shell_error(shell,
+			    "Benchmarking would discard the last "
+			    "measurement, aborting");
+		shell_info(shell,
+			   "Export it first, if needed, and add \"force\" "
+			   "to discard it");
+		return 1;
+	}
+
+	shell_print(shell, "Benchmarking...");
+	kp_bench_run(&kp_meas, &res);
+
+	if (kp_ckpt_is_initialized()) {
+		have_base = kp_ckpt_load(KP_CKPT_ID_BENCH_BASE,
+					 &base, sizeof(base));
+	}
+	kp_bench_print(shell, &res, have_base ? &base : NULL);
+
+	if (save) {
+		if (!kp_ckpt_is_initialized() ||
+		    !kp_ckpt_save(KP_CKPT_ID_BENCH_BASE, &res, sizeof(res))) {
+			shell_error(shell, "Failed saving the baseline");
+			return 1;
+		}
+		shell_print(shell, "Saved as the baseline");
+	}
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(bench, NULL,
+		       "Benchmark statistics, rendering, indexing, and locking "
+		       "kernels, comparing to the saved baseline, if any. "
+		       "Accepts \"save\" to save the results as the baseline, "
+		       "and \"force\" to discard the last measurement, "
+		       "used as the data buffer.",
+		       kp_cmd_bench, 1, 2);
+
+/** Number of packed bytes to output per line when exporting */
+#define KP_EXPORT_LINE_BYTES	32
+
+/**
+ * Output packed data to a shell in hex, wrapping lines at
+ * KP_EXPORT_LINE_BYTES.
+ *
+ * @param shell	The shell to output to.
+ * @param buf	The buffer with the data to output.
+ * @param len	The length of the data.
+ * @param pcol	Location of the number of bytes output on the current line.
+ */
+static void
+kp_export_hex(const struct shell *shell, const uint8_t *buf, size_t len,
+	      size_t *pcol)
+{
+	size_t i;
+
+	assert(pcol != NULL);
+
+	for (i = 0; i < len; i++) {
+		shell_fprintf(shell, SHELL_NORMAL, "%02x", buf[i]);
+		if (++*pcol >= KP_EXPORT_LINE_BYTES) {
+			shell_fprintf(shell, SHELL_NORMAL, "\n");
+			*pcol = 0;
+		}
+	}
+}
+
+/** Execute the "export" command */
+static int
+kp_cmd_export(const struct shell *shell, size_t argc, char **argv)
+{
+	uint8_t buf[MAX(KP_PACK_HEAD_MAX_SIZE, KP_PACK_PASS_MAX_SIZE)];
+	struct kp_pack pack;
+	size_t len;
+	size_t packed_len;
+	size_t ch_res_num;
+	size_t col = 0;
+	size_t pass;
+
+	if (!kp_meas_is_valid(&kp_meas)) {
+		shell_error(shell,
+			"No measurement to export. "
+			"Execute \"acquire\" or \"measure\" command first."
+		);
+		return 1;
+	}
+	if (kp_meas.lanes.alt_num != 0) {
+		shell_error(shell,
+			    "Cannot export measurements with interleaved lanes");
+		return 1;
+	}
+
+	/* Output the header */
+	len = kp_pack_meas_head(&kp_meas, buf, sizeof(buf));
+	assert(len != 0);
+	kp_export_hex(shell, buf, len, &col);
+	packed_len = len;
+
+	/* Output the passes */
+	kp_pack_init(&pack);
+	for (pass = 0; pass < kp_meas.passes; pass++) {
+		len = kp_pack_meas_pass(&pack, &kp_meas, pass,
+					buf, sizeof(buf));
+		kp_export_hex(shell, buf, len, &col);
+		packed_len += len;
+	}
+
+	/* Finish the last line */
+	if (col != 0) {
+		shell_fprintf(shell, SHELL_NORMAL, "\n");
+	}
+
+	ch_res_num = kp_cap_conf_ch_res_idx(&kp_meas.conf, kp_meas.even_down,
+					    kp_meas.passes, 0);
+	shell_info(shell,
+		   "Packed %zu passes with %zu channel results "
+		   "(%zu bytes in memory) into %zu bytes",
+		   kp_meas.passes, ch_res_num,
+		   ch_res_num * sizeof(struct kp_cap_ch_res), packed_len);
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(export, NULL,
+		       "Output the last timing measurement packed, in hex",
+		       kp_cmd_export, 1, 0);
+
+/** The summary sketch of the added measurements */
+static struct kp_sketch kp_sketch;
+
+/**
+ * Checkpoint the summary sketch, a record per channel sketch, to fit flash
+ * sectors.
+ *
+ * @return True if the sketch was checkpointed, false otherwise.
+ */
+static bool
+kp_sketch_save(void)
+{
+	size_t ch, ne_dirs;
+
+	if (!kp_ckpt_is_initialized() ||
+	    !kp_ckpt_save(KP_CKPT_ID_SKETCH_HEAD,
+			  &kp_sketch.head, sizeof(kp_sketch.head))) {
+		return false;
+	}
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			if (!kp_ckpt_save(KP_CKPT_ID_SKETCH_CH +
+					  ch * KP_CAP_NE_DIRS_BOTH + ne_dirs,
+					  &kp_sketch.ch_list[ch][ne_dirs],
+					  sizeof(kp_sketch.ch_list[ch][ne_dirs]))) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Restore the summary sketch from checkpoints, if any.
+ *
+ * @return True if the summary sketch was restored, false otherwise.
+ */
+static bool
+kp_sketch_restore(void)
+{
+	size_t ch, ne_dirs;
+
+	if (!kp_ckpt_load(KP_CKPT_ID_SKETCH_HEAD,
+			  &kp_sketch.head, sizeof(kp_sketch.head))) {
+		goto fail;
+	}
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			if (!kp_ckpt_load(KP_CKPT_ID_SKETCH_CH +
+					  ch * KP_CAP_NE_DIRS_BOTH + ne_dirs,
+					  &kp_sketch.ch_list[ch][ne_dirs],
+					  sizeof(kp_sketch.ch_list[ch][ne_dirs]))) {
+				goto fail;
+			}
+		}
+	}
+	if (kp_sketch_is_valid(&kp_sketch)) {
+		return true;
+	}
+fail:
+	/* Don't leave a partially-loaded sketch behind */
+	kp_sketch_init(&kp_sketch);
+	return false;
+}
+
+/** Execute the "sketch add" command */
+static int
+kp_cmd_sketch_add(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (!kp_meas_is_valid(&kp_meas)) {
+		shell_error(shell,
+			"No measurement to add. "
+			"Execute \"acquire\" or \"measure\" command first."
+		);
+		return 1;
+	}
+	if (kp_meas.lanes.alt_num != 0) {
+		shell_error(shell,
+			    "Cannot add measurements with interleaved lanes");
+		return 1;
+	}
+	if (kp_meas.sketched) {
+		shell_error(shell,
+			"The measurement is already added to the sketch. "
+			"Execute \"acquire\" or \"measure\" command to "
+			"make a new one."
+		);
+		return 1;
+	}
+	if (!kp_sketch_is_compatible(&kp_sketch, kp_meas.conf.ch_list)) {
+		shell_error(shell,
+			    "Channel directions or edges differ from the "
+			    "sketch, execute \"sketch clear\" to start over");
+		return 1;
+	}
+
+	kp_sketch_add_meas(&kp_sketch, &kp_meas);
+	kp_meas.sketched = true;
+	if (!kp_sketch_save()) {
+		shell_warn(shell, "Failed checkpointing the sketch");
+	}
+	shell_print(shell, "Added, the sketch has %u runs",
+		    kp_sketch.head.runs);
+	return 0;
+}
+
+/** Execute the "sketch print" command */
+static int
+kp_cmd_sketch_print(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (kp_sketch.head.runs == 0) {
+		shell_error(shell,
+			    "The sketch is empty. "
+			    "Execute \"sketch add\" command first.");
+		return 1;
+	}
+	kp_sketch_print(shell, &kp_sketch);
+	return 0;
+}
+
+/** Execute the "sketch export" command */
+static int
+kp_cmd_sketch_export(const struct shell *shell, size_t argc, char **argv)
+{
+	uint8_t buf[MAX(KP_SKETCH_HEAD_MAX_SIZE,
+			MAX(KP_SKETCH_CH_HEAD_MAX_SIZE,
+			    KP_SKETCH_BUCKET_MAX_SIZE))];
+	size_t len;
+	size_t packed_len;
+	size_t col = 0;
+	size_t ch, ne_dirs, bucket;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	/* Output the header */
+	len = kp_sketch_pack_head(&kp_sketch, buf, sizeof(buf));
+	assert(len != 0);
+	kp_export_hex(shell, buf, len, &col);
+	packed_len = len;
+
+	/* Output the channel sketches */
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			len = kp_sketch_pack_ch_head(&kp_sketch, ch, ne_dirs,
+						     buf, sizeof(buf));
+			assert(len != 0);
+			kp_export_hex(shell, buf, len, &col);
+			packed_len += len;
+			/* Output the buckets a bufferful at a time */
+			bucket = 0;
+			while ((len = kp_sketch_pack_ch_buckets(
+					&kp_sketch, ch, ne_dirs, &bucket,
+					buf, sizeof(buf))) != 0) {
+				kp_export_hex(shell, buf, len, &col);
+				packed_len += len;
+			}
 		}
+	}
 
-		/* Try to return to the start position */
-		switch (kp_act_move_to(acquire_start_pos, kp_act_speed)) {
-			case KP_ACT_MOVE_RC_OK:
-				break;
-			case KP_ACT_MOVE_RC_ABORTED:
-				shell_warn(
-					shell,
-					"Moving back to the start position "
-					"was aborted"
-				);
-				break;
-			case KP_ACT_MOVE_RC_OFF:
-				shell_warn(
-					shell,
-					"Couldn't move back to the start "
-					"position - actuator is off"
-				);
-				break;
-			default:
-				shell_error(
-					shell,
-					"Unexpected error moving back to the "
-					"start position"
-				);
-				break;
-		}
-	} else if (print) {
-		kp_meas_print(shell, &kp_meas, print_verbose);
+	/* Finish the last line */
+	if (col != 0) {
+		shell_fprintf(shell, SHELL_NORMAL, "\n");
 	}
 
+	shell_info(shell,
+		   "Packed the sketch of %u runs "
+		   "(%zu bytes in memory) into %zu bytes",
+		   kp_sketch.head.runs, sizeof(kp_sketch), packed_len);
 	return 0;
 }
 
-SHELL_CMD_ARG_REGISTER(measure, NULL,
-		       "Acquire a timing measurement on all enabled "
-		       "channels for specified number of passes "
-		       "(default 1), and output \"brief\" (default), "
-		       "or \"verbose\" results",
-		       kp_cmd_meas, 1, 2);
+/** Execute the "sketch clear" command */
+static int
+kp_cmd_sketch_clear(const struct shell *shell, size_t argc, char **argv)
+{
+	size_t id;
 
-SHELL_CMD_ARG_REGISTER(acquire, NULL,
-		       "Acquire a timing measurement on all enabled channels "
-		       "for specified number of passes (default 1)",
-		       kp_cmd_meas, 1, 1);
+	ARG_UNUSED(shell);
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
 
-SHELL_CMD_ARG_REGISTER(print, NULL,
-		       "Print the last timing measurement in a \"brief\" "
-		       "(default) or \"verbose\" format",
-		       kp_cmd_meas, 1, 1);
+	kp_sketch_init(&kp_sketch);
+	if (kp_ckpt_is_initialized()) {
+		for (id = KP_CKPT_ID_SKETCH_HEAD;
+		     id < KP_CKPT_ID_SKETCH_CH +
+			  KP_CAP_CH_NUM * KP_CAP_NE_DIRS_BOTH; id++) {
+			kp_ckpt_erase(id);
+		}
+	}
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sketch_subcmds,
+	SHELL_CMD(add, NULL,
+		  "Add the last measurement to the summary sketch, "
+		  "and checkpoint it",
+		  kp_cmd_sketch_add),
+	SHELL_CMD(print, NULL,
+		  "Print the summary sketch statistics and percentiles",
+		  kp_cmd_sketch_print),
+	SHELL_CMD(export, NULL,
+		  "Output the summary sketch packed, in hex",
+		  kp_cmd_sketch_export),
+	SHELL_CMD(clear, NULL,
+		  "Empty the summary sketch and remove its checkpoints",
+		  kp_cmd_sketch_clear),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(sketch, &sketch_subcmds,
+		   "Accumulate mergeable summaries of measurements", NULL);
+
+/** Execute the "plan [passes]" command */
+static int
+kp_cmd_plan(const struct shell *shell, size_t argc, char **argv)
+{
+	long passes = 1;
+	int32_t start;
+	int32_t top, bottom;
+	struct kp_meas_wins wins;
+	bool even_down;
+	bool worst = false;
+	bool down;
+	uint32_t pass_us;
+	uint64_t total_us;
+	char buf[KP_FMT_DURATION_LEN];
+
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return 1;
+	}
+	/* Check for power and get the start position */
+	if (!kp_act_pos_is_valid(start = kp_act_locate())) {
+		shell_error(shell, "Actuator is off, aborting");
+		return 1;
+	}
+	/* Check for parameters */
+	if (!kp_act_pos_is_valid(kp_act_pos_top)) {
+		shell_error(shell, "Top position not set, aborting");
+		return 1;
+	}
+	if (!kp_act_pos_is_valid(kp_act_pos_bottom)) {
+		shell_error(shell, "Bottom position not set, aborting");
+		return 1;
+	}
+	/* Check that at least one channel is enabled */
+	if (kp_cap_conf_ch_num(&kp_cap_conf, KP_CAP_DIRS_BOTH) == 0) {
+		shell_error(shell, "No enabled channels, aborting");
+		shell_info(shell,
+			   "Use \"set ch\" command to enable channels");
+		return 1;
+	}
+	/* Check that the lanes can be interleaved */
+	if (!kp_meas_lanes_are_compatible(&kp_lanes, &kp_cap_conf)) {
+		shell_error(shell,
+			    "Lanes have different channel directions, "
+			    "or trigger, aborting");
+		shell_info(shell,
+			   "Use \"lane clear\" command to remove lanes");
+		return 1;
+	}
+
+	/* Parse the number of passes */
+	if (argc > 1 && !kp_parse_non_negative_number(argv[1], &passes)) {
+		shell_error(
+			shell,
+			"Invalid number of passes "
+			"(non-negative integer expected): %s",
+			argv[1]
+		);
+		return 1;
+	}
+
+	/* Decide on the initial direction, the same way "measure" does */
+	even_down = abs(start - kp_act_pos_top) <
+		abs(start - kp_act_pos_bottom);
+
+	/* Output the estimated pass durations, over the windows, if any */
+	kp_meas_wins_select(&wins, kp_act_pos_top, kp_act_pos_bottom,
+			    &kp_act_wins);
+	for (down = even_down; ; down = !down) {
+		kp_meas_wins_get_dir_range(kp_act_pos_top, kp_act_pos_bottom,
+					   &wins, &kp_cap_conf,
+					   kp_cap_dirs_from_down(down),
+					   &top, &bottom);
+		pass_us = kp_plan_sample_us(
+			bottom - top, kp_act_speed,
+			kp_plan_capture_us(&kp_cap_conf, down,
+					   &kp_meas, &worst)
+		);
+		shell_print(shell, "%s pass: %u.%03u ms",
+			    kp_cap_dirs_to_cpstr(kp_cap_dirs_from_down(down)),
+			    pass_us / 1000, pass_us % 1000);
+		if (down != even_down) {
+			break;
+		}
+	}
+	shell_print(shell, "Overhead: %u.%03u ms",
+		    kp_plan_get_overhead_us() / 1000,
+		    kp_plan_get_overhead_us() % 1000);
+
+	/* Output the total */
+	total_us = kp_plan_meas_us(start, kp_act_pos_top, kp_act_pos_bottom,
+				   &kp_act_wins, kp_act_speed, &kp_cap_conf,
+				   even_down, &kp_lanes, 0, (size_t)passes,
+				   &kp_meas, &worst);
+	shell_print(shell, "Total: %s%s", worst ? "at most " : "",
+		    kp_fmt_duration(buf, total_us));
+	if (worst) {
+		shell_info(shell,
+			   "No measurement with the same channel "
+			   "configuration to take capture times from, "
+			   "assuming all channels time out");
+	}
+
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(plan, NULL,
+		       "Estimate the time a measurement of specified "
+		       "number of passes (default 1) would take",
+		       kp_cmd_plan, 1, 1);
 
 /** Execute a "setup" command */
 static int
@@ -1393,6 +4246,10 @@ kp_cmd_setup(const struct shell *shell, size_t argc, char **argv)
 	int32_t tightened_top;
 	int32_t tightened_bottom;
 
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return 1;
+	}
 	/* Check that at least one channel is enabled */
 	if (kp_cap_conf_ch_num(&kp_cap_conf, KP_CAP_DIRS_BOTH) == 0) {
 		shell_error(shell, "No enabled channels, aborting");
@@ -1445,6 +4302,8 @@ kp_cmd_setup(const struct shell *shell, size_t argc, char **argv)
 	/* Clear top and bottom positions (control is lost now anyway) */
 	kp_act_pos_top = KP_ACT_POS_INVALID;
 	kp_act_pos_bottom = KP_ACT_POS_INVALID;
+	kp_meas_wins_clear(&kp_act_wins);
+	kp_map_clear();
 
 	/* Ask the user to move the actuator somewhere above trigger point */
 	shell_info(
@@ -1517,6 +4376,9 @@ kp_cmd_setup(const struct shell *shell, size_t argc, char **argv)
 		case KP_SAMPLE_RC_OFF:
 			shell_error(shell, "Actuator is off, aborted");
 			return 1;
+		case KP_SAMPLE_RC_STALLED:
+			kp_print_stalled(shell);
+			return 1;
 		default:
 			shell_error(shell, "Unexpected error, aborted");
 			return 1;
@@ -1580,6 +4442,249 @@ SHELL_CMD_ARG_REGISTER(setup, NULL,
 		       "(default 2).",
 		       kp_cmd_setup, 1, 2);
 
+/** Number of passes to verify the trigger with, for each campaign key */
+#define KP_CAMPAIGN_CHECK_PASSES	2
+
+/** Execute the "campaign <passes> <x>..." command */
+static int
+kp_cmd_campaign(const struct shell *shell, size_t argc, char **argv)
+{
+	long passes;
+	long x;
+	size_t i;
+	size_t ch;
+	size_t ch_num;
+	/* The Z position to travel between keys at */
+	int32_t travel_pos;
+	/* The trigger range width to tighten to */
+	int32_t width;
+	/* The steps to extend the trigger range by, when looking for it */
+	int32_t margin;
+	int32_t top;
+	int32_t bottom;
+	struct kp_table table;
+	struct kp_meas_ch_sum sum;
+	enum kp_sample_rc rc = KP_SAMPLE_RC_OK;
+	enum kp_act_move_rc move_rc = KP_ACT_MOVE_RC_OK;
+	/* The number of arguments, before or after yielding */
+	size_t arg_num = argc >= (size_t)SSIZE_MAX
+		? argc - (size_t)SSIZE_MAX : argc;
+
+	/* Check the trigger source */
+	if (!kp_check_trig_act(shell)) {
+		return 1;
+	}
+	/* Check for power and remember the travel position */
+	if (!kp_act_pos_is_valid(travel_pos = kp_act_locate())) {
+		shell_error(shell, "Actuator is off, aborting");
+		return 1;
+	}
+	if (!kp_act_pos_is_valid(kp_xact_locate())) {
+		shell_error(shell, "X axis actuator is off, aborting");
+		return 1;
+	}
+	/* Check for parameters */
+	if (!kp_act_pos_is_valid(kp_act_pos_top)) {
+		shell_error(shell, "Top position not set, aborting");
+		return 1;
+	}
+	if (!kp_act_pos_is_valid(kp_act_pos_bottom)) {
+		shell_error(shell, "Bottom position not set, aborting");
+		return 1;
+	}
+	/* Check that at least one channel is enabled */
+	if (kp_cap_conf_ch_num(&kp_cap_conf, KP_CAP_DIRS_BOTH) == 0) {
+		shell_error(shell, "No enabled channels, aborting");
+		shell_info(shell,
+			   "Use \"set ch\" command to enable channels");
+		return 1;
+	}
+
+	/* Parse the number of passes */
+	if (!kp_parse_non_negative_number(argv[1], &passes) || passes == 0) {
+		shell_error(
+			shell,
+			"Invalid number of passes "
+			"(a number greater than zero expected): %s",
+			argv[1]
+		);
+		return 1;
+	}
+	/* Check that we have enough memory to record all passes */
+	i = kp_cap_conf_ch_res_idx(&kp_cap_conf, true, passes, 0);
+	if (i > ARRAY_SIZE(kp_meas.ch_res_list)) {
+		shell_error(
+			shell,
+			"Not enough memory to capture measurement "
+			"results.\nAvailable: %zu, required: %zu.\n",
+			ARRAY_SIZE(kp_meas.ch_res_list), i
+		);
+		return 1;
+	}
+	/* Verify the key positions upfront, so we don't stop midway */
+	for (i = 2; i < arg_num; i++) {
+		if (!kp_parse_non_negative_number(argv[i], &x) ||
+		    !kp_act_pos_is_valid(x)) {
+			shell_error(shell, "Invalid X axis position: %s",
+				    argv[i]);
+			return 1;
+		}
+	}
+
+	/* Return to the shell and restart in an input-diverted thread */
+	KP_SHELL_YIELD(kp_cmd_campaign, kp_input_bypass_cb);
+	kp_input_reset();
+
+	/*
+	 * Travel at the current height, if above the top. Look for the
+	 * trigger of each key around where it was on the previous one,
+	 * extended by the travel clearance, or at least the range width.
+	 */
+	travel_pos = MIN(travel_pos, kp_act_pos_top);
+	width = kp_act_pos_bottom - kp_act_pos_top;
+	margin = MAX(kp_act_pos_top - travel_pos, width);
+
+	/* Output the summary header */
+	for (ch = 0, ch_num = 0; ch < ARRAY_SIZE(kp_cap_conf.ch_list); ch++) {
+		ch_num += (kp_cap_conf.ch_list[ch].dirs != KP_CAP_DIRS_NONE);
+	}
+	kp_table_init(&table, shell, 4, 8, 4 + ch_num * 2);
+	kp_table_col(&table, "");
+	kp_table_col(&table, "");
+	kp_table_col(&table, "");
+	kp_table_col(&table, "");
+	for (ch = 0; ch < ARRAY_SIZE(kp_cap_conf.ch_list); ch++) {
+		if (kp_cap_conf.ch_list[ch].dirs) {
+			kp_table_col(&table, "#%zu", ch);
+			kp_table_col(&table, "%s",
+				     kp_cap_conf.ch_list[ch].name);
+		}
+	}
+	kp_table_nl(&table);
+	kp_table_col(&table, "Key");
+	kp_table_col(&table, "X");
+	kp_table_col(&table, "Top");
+	kp_table_col(&table, "Bottom");
+	for (ch = 0; ch < ARRAY_SIZE(kp_cap_conf.ch_list); ch++) {
+		if (kp_cap_conf.ch_list[ch].dirs) {
+			kp_table_col(&table, "Trigs, %%");
+			kp_table_col(&table, "Mean, us");
+		}
+	}
+	kp_table_nl(&table);
+	kp_table_sep(&table);
+
+	/* For each key */
+	for (i = 2; i < argc; i++) {
+		x = strtol(argv[i], NULL, 10);
+
+		/* Lift the actuator, and move over to the key */
+		move_rc = kp_act_move_to(travel_pos, kp_act_speed);
+		if (move_rc != KP_ACT_MOVE_RC_OK) {
+			break;
+		}
+		move_rc = kp_xmove_to(x);
+		if (move_rc != KP_ACT_MOVE_RC_OK) {
+			break;
+		}
+
+		/* Find the trigger */
+		top = MAX(kp_act_pos_top - margin, KP_ACT_POS_MIN);
+		bottom = MIN(kp_act_pos_bottom + margin, KP_ACT_POS_MAX);
+		rc = kp_tighten(&top, &bottom, &kp_cap_conf,
+				width, KP_CAMPAIGN_CHECK_PASSES,
+				kp_act_speed);
+		if (rc != KP_SAMPLE_RC_OK) {
+			break;
+		}
+		if (!kp_act_pos_is_valid(top) ||
+		    !kp_act_pos_is_valid(bottom)) {
+			/* Output the missing trigger, and skip the key */
+			kp_table_col(&table, "%zu", i - 2);
+			kp_table_col(&table, "%ld", x);
+			kp_table_col(&table, "?");
+			kp_table_col(&table, "?");
+			for (ch = 0; ch < ch_num * 2; ch++) {
+				kp_table_col(&table, "");
+			}
+			kp_table_nl(&table);
+			continue;
+		}
+		/* Follow the trigger from key to key */
+		kp_act_pos_top = top;
+		kp_act_pos_bottom = bottom;
+
+		/* Measure */
+		kp_meas_init(&kp_meas, top, bottom, NULL, kp_act_speed,
+			     (size_t)passes, &kp_cap_conf, true, NULL);
+		rc = kp_meas_acquire(&kp_meas, NULL, NULL);
+		if (rc != KP_SAMPLE_RC_OK) {
+			break;
+		}
+
+		/* Output the key summary */
+		kp_table_col(&table, "%zu", i - 2);
+		kp_table_col(&table, "%ld", x);
+		kp_table_col(&table, "%d", top);
+		kp_table_col(&table, "%d", bottom);
+		for (ch = 0; ch < ARRAY_SIZE(kp_cap_conf.ch_list); ch++) {
+			if (!kp_cap_conf.ch_list[ch].dirs) {
+				continue;
+			}
+			kp_meas_get_ch_sum(&kp_meas, ch, KP_CAP_DIRS_BOTH,
+					   &sum);
+			if (sum.passes != 0) {
+				kp_table_col(&table, "%zu",
+					     sum.triggers * 100 / sum.passes);
+			} else {
+				kp_table_col(&table, "");
+			}
+			if (sum.triggers != 0) {
+				kp_table_col(&table, "%u", sum.mean_us);
+			} else {
+				kp_table_col(&table, "");
+			}
+		}
+		kp_table_nl(&table);
+	}
+
+	/* Handle the stopping reason */
+	if (rc == KP_SAMPLE_RC_ABORTED || move_rc == KP_ACT_MOVE_RC_ABORTED) {
+		shell_error(shell, "Aborted");
+		return 1;
+	} else if (rc == KP_SAMPLE_RC_OFF || move_rc == KP_ACT_MOVE_RC_OFF) {
+		shell_error(shell, "Actuator is off, aborted");
+		return 1;
+	} else if (rc == KP_SAMPLE_RC_STUCK) {
+		shell_error(shell, "Channels stuck, aborted");
+		return 1;
+	} else if (rc == KP_SAMPLE_RC_STALLED ||
+		   move_rc == KP_ACT_MOVE_RC_STALLED) {
+		kp_print_stalled(shell);
+		return 1;
+	} else if (rc != KP_SAMPLE_RC_OK || move_rc != KP_ACT_MOVE_RC_OK) {
+		shell_error(shell, "Unexpected error, aborted");
+		return 1;
+	}
+	kp_table_sep(&table);
+
+	/* Lift the actuator off the last key */
+	if (kp_act_move_to(travel_pos, kp_act_speed) != KP_ACT_MOVE_RC_OK) {
+		shell_warn(shell, "Couldn't move back to the travel position");
+	}
+
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(campaign, NULL,
+		       "Measure specified number of passes on each key at "
+		       "the specified X axis positions, starting with top "
+		       "and bottom positions set on the first key, "
+		       "finding the trigger point of every key next to "
+		       "where it was on the previous one, and output "
+		       "per-key trigger percentages and mean times",
+		       kp_cmd_campaign, 3, KP_SHELL_ARGC_MAX - 3);
+
 void
 main(void)
 {
@@ -1604,14 +4709,54 @@ main(void)
 	if (!device_is_ready(kp_dbg_gpio)) {
 		return;
 	}
+	if (!device_is_ready(kp_ext_gpio)) {
+		return;
+	}
+	if (!device_is_ready(kp_cap_gpio)) {
+		return;
+	}
+	gpio_pin_configure(kp_ext_gpio, kp_ext_pin, GPIO_INPUT);
 	gpio_pin_configure(kp_dbg_gpio, kp_dbg_pin_update,
 				GPIO_PUSH_PULL | GPIO_OUTPUT_LOW);
 
+	/*
+	 * Initialize the actuator driver backend
+	 */
+	kp_drv_init(device_is_ready(kp_drv_uart) ? kp_drv_uart : NULL,
+		    kp_act_gpio, kp_drv_pin_diag);
+
 	/*
 	 * Initialize the actuator
 	 */
 	kp_act_init(kp_act_gpio, /* disable */ 3, /* dir */ 8, /* step */ 9);
 
+	/*
+	 * Initialize the X axis actuator
+	 */
+	kp_xact_init(kp_act_gpio,
+		     /* disable */ 12, /* dir */ 13, /* step */ 14);
+
+	/*
+	 * Initialize the between-pass channel monitor
+	 */
+	gpio_pin_t cap_ch_pin_list[KP_CAP_CH_NUM];
+	for (i = 0; i < ARRAY_SIZE(cap_ch_pin_list); i++) {
+		cap_ch_pin_list[i] = kp_cap_pin_ch_base + i;
+		gpio_pin_configure(kp_cap_gpio, cap_ch_pin_list[i],
+				   GPIO_INPUT);
+	}
+	kp_mon_init(kp_cap_gpio, cap_ch_pin_list);
+
+	/*
+	 * Set no channel windows
+	 */
+	kp_meas_wins_clear(&kp_act_wins);
+
+	/*
+	 * Set no alternative lanes
+	 */
+	kp_meas_lanes_clear(&kp_lanes);
+
 	/*
 	 * Set default capture configuration
 	 */
@@ -1664,5 +4809,42 @@ main(void)
 		    DT_IRQ_BY_NAME(KP_TIMER_NODE, cc, priority),
 		    kp_cap_isr, NULL, 0);
 	irq_enable(DT_IRQ_BY_NAME(KP_TIMER_NODE, cc, irq));
-	kp_cap_init((TIM_TypeDef *)DT_REG_ADDR(KP_TIMER_NODE), &cap_dbg_conf);
+	kp_cap_init((TIM_TypeDef *)DT_REG_ADDR(KP_TIMER_NODE),
+		    kp_cap_gpio, cap_ch_pin_list, &cap_dbg_conf);
+
+	/*
+	 * Initialize the scope
+	 */
+	pclken = (struct stm32_pclken){
+		.bus = DT_CLOCKS_CELL(KP_SCOPE_TIMER_NODE, bus),
+		.enr = DT_CLOCKS_CELL(KP_SCOPE_TIMER_NODE, bits)
+	};
+	if (clock_control_on(clk, (clock_control_subsys_t *)&pclken) < 0) {
+		return;
+	}
+	kp_scope_init((TIM_TypeDef *)DT_REG_ADDR(KP_SCOPE_TIMER_NODE),
+		      (GPIO_TypeDef *)DT_REG_ADDR(KP_CAP_GPIO_NODE));
+
+	/*
+	 * Initialize the debounce emulator over the scope
+	 */
+	kp_dbnc_init(cap_ch_pin_list);
+
+	/*
+	 * Restore the checkpointed endurance run, if any
+	 */
+	if (kp_ckpt_init() && kp_endure_restore()) {
+		printk("Restored endurance run checkpoint at %u passes.\n"
+		       "Execute \"setup\" to re-home the actuator, "
+		       "and \"endure resume\" to continue.\n",
+		       kp_endure.stats.passes);
+	}
+
+	/*
+	 * Restore the checkpointed summary sketch, if any
+	 */
+	if (kp_ckpt_is_initialized() && kp_sketch_restore()) {
+		printk("Restored summary sketch of %u runs.\n",
+		       kp_sketch.head.runs);
+	}
 }
@@ -9,6 +9,9 @@
  */
 
 #include "kp_act.h"
+#include "kp_drv.h"
+#include "kp_seqlock.h"
+#include <string.h>
 
 /*
  * Only changed upon initialization.
@@ -49,14 +52,39 @@ static volatile bool kp_act_move_aborted;
  * Movement state accessed by move.../locate functions
  */
 
-/** The semaphore signaling a movement can be started */
-static K_SEM_DEFINE(kp_act_move_available, 1, 1);
+/** The semaphore signaling a movement can be queued */
+static K_SEM_DEFINE(kp_act_move_available,
+		    KP_ACT_QUEUE_LEN, KP_ACT_QUEUE_LEN);
 
-/** The semaphore signaling a movement should begin */
+/** The semaphore signaling the queued movements should begin */
 static K_SEM_DEFINE(kp_act_move_begin, 0, 1);
 
-/** The move target position, in steps */
-static int32_t kp_act_target;
+/** A queued move */
+struct kp_act_seg {
+	/** The move target position, in steps */
+	int32_t target;
+	/** The speed with which to move, 0-100% */
+	uint32_t speed;
+	/** The function to call before the first step, or NULL if none */
+	kp_act_move_start_fn start_fn;
+	/** The data to pass to the start function */
+	void *start_data;
+};
+
+/*
+ * The move queue, protected by the base state lock.
+ * The first move is the one in progress, if kp_act_moving is true.
+ */
+static struct kp_act_seg kp_act_queue[KP_ACT_QUEUE_LEN];
+
+/** Index of the first queued move */
+static size_t kp_act_queue_head;
+
+/** Number of queued moves */
+static size_t kp_act_queue_num;
+
+/** True if the move thread is running queued moves */
+static bool kp_act_moving;
 
 /** The timestamp of the last step in cycles */
 static uint32_t kp_act_move_last_cycles;
@@ -64,11 +92,52 @@ static uint32_t kp_act_move_last_cycles;
 /** True if the last step was in the positive direction, false otherwise */
 static bool kp_act_move_last_positive;
 
+/** The speed of the move in progress, 0-100% */
+static uint32_t kp_act_move_speed;
+
 /** The semaphore signaling a movement is done */
-static K_SEM_DEFINE(kp_act_move_done, 0, 1);
+static K_SEM_DEFINE(kp_act_move_done, 0, KP_ACT_QUEUE_LEN);
+
+/*
+ * Results of the finished moves, in order, protected by the base state lock.
+ * Each has kp_act_move_done given.
+ */
+static enum kp_act_move_rc kp_act_move_rc_list[KP_ACT_QUEUE_LEN];
+
+/** Index of the first finished move result */
+static size_t kp_act_move_rc_head;
+
+/** Number of finished move results */
+static size_t kp_act_move_rc_num;
+
+/** The planned duration of a step of the current move, us */
+static uint32_t kp_act_move_step_us;
+
+/*
+ * Step timing jitter monitoring state, protected by the base state lock
+ */
+
+/** True if step timing jitter is monitored */
+static bool kp_act_jitter_enabled;
+
+/** Step timing jitter statistics of all finished moves */
+static struct kp_act_jitter kp_act_jitter;
+
+/** Step timing jitter statistics of the current, or the last move */
+static struct kp_act_jitter kp_act_jitter_move;
+
+/** True if kp_act_jitter_move has the last move, already finished */
+static bool kp_act_jitter_move_done;
+
+/*
+ * State snapshot, written with the base state lock held, read without it
+ */
+
+/** The sequence lock protecting the state snapshot */
+static struct kp_seqlock kp_act_state_seqlock;
 
-/** The move result, only valid when kp_act_move_done is available */
-static volatile enum kp_act_move_rc kp_act_move_rc;
+/** The state snapshot */
+static struct kp_act_state kp_act_state;
 
 /*
  * End of state
@@ -96,13 +165,40 @@ kp_act_is_on_locked(void)
 	return !kp_act_is_off_locked();
 }
 
+/**
+ * Publish the state snapshot, assuming the base state lock is held.
+ */
+static void
+kp_act_state_publish_locked(void)
+{
+	kp_seqlock_write_begin(&kp_act_state_seqlock);
+	kp_act_state.off = kp_act_is_off_locked();
+	kp_act_state.moving = kp_act_moving;
+	kp_act_state.pos = kp_act_pos;
+	kp_act_state.target = kp_act_queue_num > 0
+		? kp_act_queue[kp_act_queue_head].target
+		: kp_act_pos;
+	kp_act_state.queued = kp_act_queue_num;
+	kp_seqlock_write_end(&kp_act_state_seqlock);
+}
+
+void
+kp_act_get_state(struct kp_act_state *state)
+{
+	assert(kp_act_is_initialized());
+	assert(state != NULL);
+	KP_SEQLOCK_READ(&kp_act_state_seqlock) {
+		*state = kp_act_state;
+	}
+}
+
 bool
 kp_act_is_off(void)
 {
 	bool is_off;
 	assert(kp_act_is_initialized());
-	KP_ACT_WITH_LOCK {
-		is_off = kp_act_is_off_locked();
+	KP_SEQLOCK_READ(&kp_act_state_seqlock) {
+		is_off = kp_act_state.off;
 	}
 	return is_off;
 }
@@ -115,6 +211,7 @@ kp_act_on(void)
 	KP_ACT_WITH_LOCK {
 		if (kp_act_is_off_locked()) {
 			gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_disable, 0);
+			kp_act_state_publish_locked();
 			turned_on = true;
 		}
 	}
@@ -131,6 +228,7 @@ kp_act_off(void)
 		if (kp_act_is_on_locked()) {
 			gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_disable, 1);
 			kp_act_pos = 0;
+			kp_act_state_publish_locked();
 			turned_off = true;
 		}
 	}
@@ -142,14 +240,28 @@ kp_act_locate(void)
 {
 	int32_t pos;
 	assert(kp_act_is_initialized());
-	KP_ACT_WITH_LOCK {
-		pos = kp_act_is_on_locked()
-			? kp_act_pos
-			: KP_ACT_POS_INVALID;
+	KP_SEQLOCK_READ(&kp_act_state_seqlock) {
+		pos = kp_act_state.off ? KP_ACT_POS_INVALID : kp_act_state.pos;
 	}
 	return pos;
 }
 
+bool
+kp_act_zero(void)
+{
+	bool zeroed = false;
+	assert(kp_act_is_initialized());
+	KP_ACT_WITH_LOCK {
+		assert(!kp_act_moving);
+		if (kp_act_is_on_locked()) {
+			kp_act_pos = 0;
+			kp_act_state_publish_locked();
+			zeroed = true;
+		}
+	}
+	return zeroed;
+}
+
 /** Move timer */
 static K_TIMER_DEFINE(kp_act_move_timer, NULL, NULL);
 
@@ -159,6 +271,49 @@ static K_TIMER_DEFINE(kp_act_move_timer, NULL, NULL);
 /** Maximum move timer period, us */
 #define KP_ACT_MOVE_TIMER_PERIOD_MAX_US	4000
 
+/** Number of move timer periods per step (control, raise, hold, fall) */
+#define KP_ACT_MOVE_TIMER_PERIODS_PER_STEP	4
+
+/**
+ * Get the move timer period for a speed.
+ * Shorter period for faster movement.
+ *
+ * @param speed	The speed of the movement, 0-100%.
+ *
+ * @return The move timer period, us.
+ */
+static inline uint32_t
+kp_act_get_period_us(uint32_t speed)
+{
+	assert(speed <= 100);
+	return KP_ACT_MOVE_TIMER_PERIOD_MAX_US -
+		((KP_ACT_MOVE_TIMER_PERIOD_MAX_US -
+		  KP_ACT_MOVE_TIMER_PERIOD_MIN_US) *
+		 speed) / 100;
+}
+
+uint32_t
+kp_act_get_step_us(uint32_t speed)
+{
+	assert(speed <= 100);
+	return kp_act_get_period_us(speed) *
+		KP_ACT_MOVE_TIMER_PERIODS_PER_STEP;
+}
+
+uint32_t
+kp_act_get_turn_delay_us(uint32_t speed)
+{
+	assert(speed <= 100);
+	/*
+	 * The faster we move, the more time we need to absorb
+	 * the momentum.
+	 */
+	return (KP_ACT_MOVE_TIMER_PERIOD_MIN_US +
+		((KP_ACT_MOVE_TIMER_PERIOD_MAX_US -
+		  KP_ACT_MOVE_TIMER_PERIOD_MIN_US) *
+		 speed) / 100) * 2;
+}
+
 /**
  * Wait for next timer tick, or go to a label if timer is stopped.
  *
@@ -172,59 +327,335 @@ static K_TIMER_DEFINE(kp_act_move_timer, NULL, NULL);
 		}                                               \
 	} while (0)
 
+/**
+ * Account for a step interval in the jitter statistics, assuming the base
+ * state lock is held and jitter monitoring is enabled.
+ *
+ * @param interval_cycles	The interval between the rises of two
+ *				consecutive step pulses, cycles.
+ */
+static void
+kp_act_jitter_add_locked(uint32_t interval_cycles)
+{
+	uint32_t interval_us = k_cyc_to_us_floor32(interval_cycles);
+	uint32_t deviation_us = interval_us > kp_act_move_step_us
+		? interval_us - kp_act_move_step_us
+		: kp_act_move_step_us - interval_us;
+
+	assert(kp_act_jitter_enabled);
+
+	/* Start the move's statistics over, if the last one's finished */
+	if (kp_act_jitter_move_done) {
+		memset(&kp_act_jitter_move, 0, sizeof(kp_act_jitter_move));
+		kp_act_jitter_move_done = false;
+	}
+	kp_act_jitter_move.intervals++;
+	kp_act_jitter_move.sum_us += deviation_us;
+	kp_act_jitter_move.max_us = MAX(kp_act_jitter_move.max_us,
+					deviation_us);
+	kp_act_jitter_move.bins[MIN(deviation_us / KP_ACT_JITTER_BIN_US,
+				    ARRAY_SIZE(kp_act_jitter_move.bins) - 1)]++;
+}
+
+/**
+ * Add the jitter statistics of the move in progress, if any, to those of
+ * all moves, assuming the base state lock is held.
+ */
+static void
+kp_act_jitter_finish_move_locked(void)
+{
+	size_t i;
+
+	if (kp_act_jitter_move_done || kp_act_jitter_move.intervals == 0) {
+		return;
+	}
+
+	kp_act_jitter_move.moves = 1;
+	kp_act_jitter_move.move_p99_max_us =
+		kp_act_jitter_get_percentile_us(&kp_act_jitter_move, 99);
+	kp_act_jitter_move_done = true;
+
+	kp_act_jitter.moves++;
+	kp_act_jitter.move_p99_max_us = MAX(kp_act_jitter.move_p99_max_us,
+					    kp_act_jitter_move.move_p99_max_us);
+	kp_act_jitter.intervals += kp_act_jitter_move.intervals;
+	kp_act_jitter.sum_us += kp_act_jitter_move.sum_us;
+	kp_act_jitter.max_us = MAX(kp_act_jitter.max_us,
+				   kp_act_jitter_move.max_us);
+	for (i = 0; i < ARRAY_SIZE(kp_act_jitter.bins); i++) {
+		kp_act_jitter.bins[i] += kp_act_jitter_move.bins[i];
+	}
+}
+
 void
-kp_act_move_thread_fn(void *arg1, void *arg2, void *arg3)
+kp_act_jitter_enable(bool enable)
 {
-	bool positive = false;
-	assert(kp_act_is_initialized());
+	KP_ACT_WITH_LOCK {
+		if (enable && !kp_act_jitter_enabled) {
+			memset(&kp_act_jitter, 0, sizeof(kp_act_jitter));
+			memset(&kp_act_jitter_move, 0,
+			       sizeof(kp_act_jitter_move));
+			kp_act_jitter_move_done = false;
+		}
+		kp_act_jitter_enabled = enable;
+	}
+}
 
-	/* While we can get the "begin" semaphore */
-	while (k_sem_take(&kp_act_move_begin, K_FOREVER) == 0) {
-		/* Run the timer */
-		while (true) {
-			/* Control */
-			KP_ACT_MOVE_TIMER_SYNC(stop);
-			KP_ACT_WITH_LOCK {
-				if (kp_act_is_off_locked()) {
-					kp_act_move_rc = KP_ACT_MOVE_RC_OFF;
-					k_timer_stop(&kp_act_move_timer);
-					continue;
+bool
+kp_act_jitter_get(struct kp_act_jitter *all, struct kp_act_jitter *move)
+{
+	bool enabled;
+	assert(all != NULL);
+	assert(move != NULL);
+	KP_ACT_WITH_LOCK {
+		*all = kp_act_jitter;
+		*move = kp_act_jitter_move;
+		enabled = kp_act_jitter_enabled;
+	}
+	return enabled;
+}
+
+/**
+ * Signal a move is finished, assuming the base state lock is held.
+ *
+ * @param rc	The result of the move.
+ */
+static void
+kp_act_move_finish_locked(enum kp_act_move_rc rc)
+{
+	assert(kp_act_move_rc_num < ARRAY_SIZE(kp_act_move_rc_list));
+	kp_act_jitter_finish_move_locked();
+	kp_act_move_rc_list[(kp_act_move_rc_head + kp_act_move_rc_num) %
+			    ARRAY_SIZE(kp_act_move_rc_list)] = rc;
+	kp_act_move_rc_num++;
+	k_sem_give(&kp_act_move_done);
+}
+
+/**
+ * Remove the first queued move and signal it's finished, assuming the base
+ * state lock is held.
+ *
+ * @param rc	The result of the move.
+ */
+static void
+kp_act_queue_pop_locked(enum kp_act_move_rc rc)
+{
+	assert(kp_act_queue_num > 0);
+	kp_act_queue_head = (kp_act_queue_head + 1) % ARRAY_SIZE(kp_act_queue);
+	kp_act_queue_num--;
+	kp_act_state_publish_locked();
+	kp_act_move_finish_locked(rc);
+}
+
+/**
+ * Remove all queued moves and signal they're finished, assuming the base
+ * state lock is held.
+ *
+ * @param rc	The result of the moves.
+ */
+static void
+kp_act_queue_flush_locked(enum kp_act_move_rc rc)
+{
+	while (kp_act_queue_num > 0) {
+		kp_act_queue_pop_locked(rc);
+	}
+}
+
+/**
+ * Finish the queued moves having nothing left to do, and (re)start the move
+ * timer for the first remaining one, if any, assuming the base state lock is
+ * held. Delay the start to absorb the momentum, if the move turns from the
+ * direction of the last step.
+ *
+ * @return True if the timer was started, false if no moves remain.
+ */
+static bool
+kp_act_move_timer_start_locked(void)
+{
+	const struct kp_act_seg *seg;
+	k_timeout_t delay = K_NO_WAIT;
+
+	/* Finish the moves already at their targets */
+	while (kp_act_queue_num > 0 &&
+	       kp_act_queue[kp_act_queue_head].target == kp_act_pos) {
+		kp_act_queue_pop_locked(KP_ACT_MOVE_RC_OK);
+	}
+	if (kp_act_queue_num == 0) {
+		return false;
+	}
+	seg = &kp_act_queue[kp_act_queue_head];
+
+	/* If our direction is different from the last step */
+	if ((seg->target > kp_act_pos) != kp_act_move_last_positive) {
+		/* Minimum turn delay, microseconds */
+		uint32_t turn_delay_us = kp_act_get_turn_delay_us(seg->speed);
+		/* Current time, cycles */
+		uint32_t now_cycles = k_cycle_get_32();
+		/* Microseconds from the last step */
+		uint32_t elapsed_us = k_cyc_to_us_floor32(
+			now_cycles > kp_act_move_last_cycles
+				? now_cycles - kp_act_move_last_cycles
+				/* Just always wait on overflow */
+				: 0
+		);
+		if (elapsed_us < turn_delay_us) {
+			/* Wait to absorb momentum before turning */
+			delay = K_USEC(turn_delay_us - elapsed_us);
+		}
+	}
+
+	kp_act_move_speed = seg->speed;
+	kp_act_move_step_us = kp_act_get_step_us(seg->speed);
+	k_timer_start(&kp_act_move_timer, delay,
+		      K_USEC(kp_act_get_period_us(seg->speed)));
+	return true;
+}
+
+/**
+ * Run the queued moves, until the queue is exhausted, or the moves are
+ * aborted, or the power is off.
+ */
+static void
+kp_act_move_run(void)
+{
+	bool positive = kp_act_move_last_positive;
+	/* True if the timer was restarted for the next move */
+	bool restarted;
+	/* The timestamp of the current step pulse rise, cycles */
+	uint32_t raise_cycles;
+	/* The timestamp of the previous step pulse rise in the move, cycles */
+	uint32_t prev_raise_cycles = 0;
+	/* True if prev_raise_cycles is valid */
+	bool got_prev_raise = false;
+	struct kp_act_seg *seg;
+
+	/* Run the timer */
+	while (true) {
+		/* Control */
+		KP_ACT_MOVE_TIMER_SYNC(stop);
+		restarted = false;
+		KP_ACT_WITH_LOCK {
+			if (kp_act_is_off_locked()) {
+				kp_act_queue_flush_locked(KP_ACT_MOVE_RC_OFF);
+				k_timer_stop(&kp_act_move_timer);
+				continue;
+			}
+			if (kp_act_move_aborted) {
+				kp_act_queue_flush_locked(
+					KP_ACT_MOVE_RC_ABORTED
+				);
+				k_timer_stop(&kp_act_move_timer);
+				continue;
+			}
+			assert(kp_act_queue_num > 0);
+			seg = &kp_act_queue[kp_act_queue_head];
+			/* If the move is done, chain the next one, if any */
+			if (seg->target == kp_act_pos) {
+				kp_act_queue_pop_locked(KP_ACT_MOVE_RC_OK);
+				seg = &kp_act_queue[kp_act_queue_head];
+				while (kp_act_queue_num > 0 &&
+				       seg->target == kp_act_pos) {
+					kp_act_queue_pop_locked(
+						KP_ACT_MOVE_RC_OK
+					);
+					seg = &kp_act_queue[kp_act_queue_head];
 				}
-				if (kp_act_move_aborted) {
-					kp_act_move_rc =
-						KP_ACT_MOVE_RC_ABORTED;
+				if (kp_act_queue_num == 0) {
 					k_timer_stop(&kp_act_move_timer);
 					continue;
 				}
-				if (kp_act_target == kp_act_pos) {
-					kp_act_move_rc = KP_ACT_MOVE_RC_OK;
-					k_timer_stop(&kp_act_move_timer);
+				/*
+				 * Keep stepping without a stop, if going the
+				 * same way with the same speed, otherwise
+				 * retime, and wait out the turn, if any.
+				 */
+				if ((seg->target > kp_act_pos) != positive ||
+				    seg->speed != kp_act_move_speed) {
+					kp_act_move_timer_start_locked();
+					got_prev_raise = false;
+					restarted = true;
 					continue;
 				}
-				positive = kp_act_target > kp_act_pos;
-				gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_dir,
-					     !positive);
 			}
-			/* Raise */
-			KP_ACT_MOVE_TIMER_SYNC(stop);
-			gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_step, 1);
-			kp_act_move_last_cycles = k_cycle_get_32();
-			kp_act_move_last_positive = positive;
-			/* Hold */
-			KP_ACT_MOVE_TIMER_SYNC(stop);
-			KP_ACT_WITH_LOCK {
-				if (positive) {
-					kp_act_pos++;
-				} else {
-					kp_act_pos--;
-				}
+			positive = seg->target > kp_act_pos;
+			/* Stop without stepping, if the driver stalled */
+			if (kp_drv_step(positive)) {
+				kp_act_queue_flush_locked(
+					KP_ACT_MOVE_RC_STALLED
+				);
+				k_timer_stop(&kp_act_move_timer);
+				continue;
+			}
+			gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_dir,
+				     !positive);
+			/* Call the start function before the first step */
+			if (seg->start_fn != NULL) {
+				seg->start_fn(seg->start_data);
+				seg->start_fn = NULL;
+			}
+		}
+		/* Wait for the retimed control, if restarted */
+		if (restarted) {
+			continue;
+		}
+		/* Raise */
+		KP_ACT_MOVE_TIMER_SYNC(stop);
+		gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_step, 1);
+		raise_cycles = k_cycle_get_32();
+		kp_act_move_last_cycles = raise_cycles;
+		kp_act_move_last_positive = positive;
+		/* Hold */
+		KP_ACT_MOVE_TIMER_SYNC(stop);
+		KP_ACT_WITH_LOCK {
+			if (positive) {
+				kp_act_pos++;
+			} else {
+				kp_act_pos--;
+			}
+			kp_act_state_publish_locked();
+			/* Account for the step interval, if any */
+			if (kp_act_jitter_enabled && got_prev_raise) {
+				kp_act_jitter_add_locked(
+					raise_cycles -
+					prev_raise_cycles
+				);
 			}
-			/* Fall */
-			KP_ACT_MOVE_TIMER_SYNC(stop);
-			gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_step, 0);
 		}
+		prev_raise_cycles = raise_cycles;
+		got_prev_raise = true;
+		/* Fall */
+		KP_ACT_MOVE_TIMER_SYNC(stop);
+		gpio_pin_set(kp_act_gpio, kp_act_gpio_pin_step, 0);
+	}
 stop:;
-		k_sem_give(&kp_act_move_done);
+}
+
+void
+kp_act_move_thread_fn(void *arg1, void *arg2, void *arg3)
+{
+	bool more;
+	assert(kp_act_is_initialized());
+
+	/* While we can get the "begin" semaphore */
+	while (k_sem_take(&kp_act_move_begin, K_FOREVER) == 0) {
+		do {
+			kp_act_move_run();
+			/* Continue with the moves queued while stopping */
+			KP_ACT_WITH_LOCK {
+				more = !kp_act_is_off_locked() &&
+				       !kp_act_move_aborted &&
+				       kp_act_move_timer_start_locked();
+				if (!more) {
+					kp_act_queue_flush_locked(
+						kp_act_is_off_locked()
+							? KP_ACT_MOVE_RC_OFF
+							: KP_ACT_MOVE_RC_ABORTED
+					);
+					kp_act_moving = false;
+					kp_act_state_publish_locked();
+				}
+			}
+		} while (more);
 	}
 }
 
@@ -236,83 +667,64 @@ K_THREAD_DEFINE(kp_act_move_thread, 512,
 		-1, 0, -1);
 
 void
-kp_act_start_move(bool relative, int32_t steps, uint32_t speed)
+kp_act_start_move_hook(bool relative, int32_t steps, uint32_t speed,
+		       kp_act_move_start_fn start_fn, void *start_data)
 {
 	bool started = false;
-	uint32_t period_us;
-	k_timeout_t delay = K_NO_WAIT;
+	struct kp_act_seg *seg;
 	assert(relative || kp_act_pos_is_valid(steps));
 	assert(speed <= 100);
 	assert(kp_act_is_initialized());
 
-	/* Wait for a move to be available */
+	/* Wait for a queue slot to be available */
 	k_sem_take(&kp_act_move_available, K_FOREVER);
 
-	/* Start the timer */
 	KP_ACT_WITH_LOCK {
 		/* If we have the power off */
 		if (kp_act_is_off_locked()) {
-			kp_act_move_rc = KP_ACT_MOVE_RC_OFF;
+			kp_act_move_finish_locked(KP_ACT_MOVE_RC_OFF);
 			continue;
 		}
-		/* Calculate target steps */
-		kp_act_target =
-			relative ? kp_act_pos + steps : steps;
-		/* If we don't have to move */
-		if (kp_act_target == kp_act_pos) {
-			kp_act_move_rc = KP_ACT_MOVE_RC_OK;
+		/* Queue the move, continuing from the last queued target */
+		seg = &kp_act_queue[(kp_act_queue_head + kp_act_queue_num) %
+				    ARRAY_SIZE(kp_act_queue)];
+		seg->target = relative
+			? (kp_act_queue_num > 0
+				? kp_act_queue[(kp_act_queue_head +
+						kp_act_queue_num - 1) %
+					       ARRAY_SIZE(kp_act_queue)].target
+				: kp_act_pos) + steps
+			: steps;
+		seg->speed = speed;
+		seg->start_fn = start_fn;
+		seg->start_data = start_data;
+		kp_act_queue_num++;
+		kp_act_state_publish_locked();
+		/* If the thread is running the queue, it will get to it */
+		if (kp_act_moving) {
 			continue;
 		}
-
 		kp_act_move_aborted = false;
-
-		/* If our direction is different from the last step */
-		if ((kp_act_target > kp_act_pos) !=
-				kp_act_move_last_positive) {
-			/*
-			 * Minimum turn delay, microseconds.
-			 * The faster we move, the more time we need to absorb
-			 * the momentum.
-			 */
-			uint32_t turn_delay_us =
-				(KP_ACT_MOVE_TIMER_PERIOD_MIN_US +
-				 ((KP_ACT_MOVE_TIMER_PERIOD_MAX_US -
-				   KP_ACT_MOVE_TIMER_PERIOD_MIN_US) *
-				  speed) / 100) * 2;
-			/* Current time, cycles */
-			uint32_t now_cycles = k_cycle_get_32();
-			/* Microseconds from the last step */
-			uint32_t elapsed_us = k_cyc_to_us_floor32(
-				now_cycles > kp_act_move_last_cycles
-					? now_cycles - kp_act_move_last_cycles
-					/* Just always wait on overflow */
-					: 0
-			);
-			if (elapsed_us < turn_delay_us) {
-				/* Wait to absorb momentum before turning */
-				delay = K_USEC(turn_delay_us - elapsed_us);
-			}
+		/* Start the timer, unless we don't have to move */
+		if (kp_act_move_timer_start_locked()) {
+			kp_act_moving = true;
+			kp_act_state_publish_locked();
+			started = true;
 		}
-
-		/* Shorter period for faster movement */
-		period_us = KP_ACT_MOVE_TIMER_PERIOD_MAX_US -
-			((KP_ACT_MOVE_TIMER_PERIOD_MAX_US -
-			  KP_ACT_MOVE_TIMER_PERIOD_MIN_US) *
-			 speed) / 100;
-
-		k_timer_start(&kp_act_move_timer, delay, K_USEC(period_us));
-		started = true;
 	}
 
 	if (started) {
-		/* Begin the move */
+		/* Begin the moves */
 		k_sem_give(&kp_act_move_begin);
-	} else {
-		/* Complete the move */
-		k_sem_give(&kp_act_move_done);
 	}
 }
 
+void
+kp_act_start_move(bool relative, int32_t steps, uint32_t speed)
+{
+	kp_act_start_move_hook(relative, steps, speed, NULL, NULL);
+}
+
 void
 kp_act_finish_move_event_init(struct k_poll_event *event)
 {
@@ -332,8 +744,14 @@ kp_act_finish_move(k_timeout_t timeout)
 		return KP_ACT_MOVE_TIMEOUT;
 	}
 
-	/* Remember the result */
-	rc = kp_act_move_rc;
+	/* Take the result */
+	KP_ACT_WITH_LOCK {
+		assert(kp_act_move_rc_num > 0);
+		rc = kp_act_move_rc_list[kp_act_move_rc_head];
+		kp_act_move_rc_head = (kp_act_move_rc_head + 1) %
+				      ARRAY_SIZE(kp_act_move_rc_list);
+		kp_act_move_rc_num--;
+	}
 
 	/* Mark next move as available */
 	k_sem_give(&kp_act_move_available);
@@ -374,7 +792,11 @@ kp_act_init(const struct device *gpio,
 	assert(!kp_act_is_initialized());
 
 	/* Move state */
-	kp_act_target = 0;
+	kp_act_queue_head = 0;
+	kp_act_queue_num = 0;
+	kp_act_moving = false;
+	kp_act_move_rc_head = 0;
+	kp_act_move_rc_num = 0;
 	kp_act_move_last_cycles = 0;
 	kp_act_move_last_positive = false;
 
@@ -396,6 +818,11 @@ kp_act_init(const struct device *gpio,
 	/* Mark actuator initialized */
 	kp_act_gpio = gpio;
 
+	/* Publish the initial state */
+	KP_ACT_WITH_LOCK {
+		kp_act_state_publish_locked();
+	}
+
 	/* Start the actuator-moving thread */
 	k_thread_start(kp_act_move_thread);
 
@@ -96,13 +96,44 @@ static inline bool kp_act_pos_is_valid(int32_t pos)
 }
 
 /**
- * Retrieve the absolute position of a powered actuator.
+ * Retrieve the absolute position of a powered actuator, without waiting for,
+ * or holding up the steps.
  *
  * @return The position, if successful, or KP_ACT_POS_INVALID, if the actuator
  * 	   is powered off.
  */
 extern int32_t kp_act_locate(void);
 
+/** A snapshot of the actuator state */
+struct kp_act_state {
+	/** True if the power is off */
+	bool off;
+	/** True if the queued moves are being run */
+	bool moving;
+	/** The current position, steps, meaningless if the power is off */
+	int32_t pos;
+	/** The target of the move in progress, or the position, if none */
+	int32_t target;
+	/** Number of moves queued, including the one in progress */
+	size_t queued;
+};
+
+/**
+ * Retrieve a consistent snapshot of the actuator state, without waiting for,
+ * or holding up the steps. Can be called from any thread.
+ *
+ * @param state	Location for the snapshot.
+ */
+extern void kp_act_get_state(struct kp_act_state *state);
+
+/**
+ * Make the current position of a powered, still actuator zero, e.g. after
+ * homing.
+ *
+ * @return True if the position was reset, false if the actuator is off.
+ */
+extern bool kp_act_zero(void);
+
 /** Result code of a movement attempt */
 enum kp_act_move_rc {
 	/** Move succeeded / finished */
@@ -111,15 +142,135 @@ enum kp_act_move_rc {
 	KP_ACT_MOVE_RC_ABORTED,
 	/** Actuator is off (power is invalid) */
 	KP_ACT_MOVE_RC_OFF,
+	/** The driver detected a stall, and the move stopped */
+	KP_ACT_MOVE_RC_STALLED,
 	/** Waiting for a move to finish timed out */
 	KP_ACT_MOVE_TIMEOUT,
 };
 
 /**
- * Start moving the actuator.
+ * Get the time a single step takes when moving with a particular speed.
+ *
+ * @param speed	The speed of the movement, 0-100%.
+ *
+ * @return The step duration, us.
+ */
+extern uint32_t kp_act_get_step_us(uint32_t speed);
+
+/**
+ * Get the minimum delay between the last step in one direction and the first
+ * step in the opposite direction, for a movement with a particular speed.
+ *
+ * @param speed	The speed of the movement after the turn, 0-100%.
+ *
+ * @return The turn delay, us.
+ */
+extern uint32_t kp_act_get_turn_delay_us(uint32_t speed);
+
+/** Width of a step timing jitter histogram bin, us */
+#define KP_ACT_JITTER_BIN_US	4
+
+/** Number of step timing jitter histogram bins */
+#define KP_ACT_JITTER_BIN_NUM	64
+
+/** Step timing jitter statistics of one move, or of a number of them */
+struct kp_act_jitter {
+	/** Number of finished moves with step intervals measured */
+	uint32_t moves;
+	/** The maximum 99th percentile deviation of a finished move, us */
+	uint32_t move_p99_max_us;
+	/** Number of step intervals measured */
+	uint32_t intervals;
+	/** Sum of absolute deviations from planned intervals, us */
+	uint64_t sum_us;
+	/** Maximum absolute deviation from a planned interval, us */
+	uint32_t max_us;
+	/**
+	 * Histogram of absolute deviations from planned intervals, with
+	 * KP_ACT_JITTER_BIN_US-wide bins, the last bin counting all
+	 * deviations beyond the others.
+	 */
+	uint32_t bins[KP_ACT_JITTER_BIN_NUM];
+};
+
+/**
+ * Enable or disable step timing jitter monitoring. Timestamp each step pulse
+ * rise while enabled, and account for the deviation of the interval between
+ * consecutive rises within a move from the planned step duration, in the
+ * statistics of the move, adding them to the statistics of all moves when
+ * the move finishes. Reset the statistics on enabling.
+ *
+ * @param enable	True to enable monitoring, false to disable.
+ */
+extern void kp_act_jitter_enable(bool enable);
+
+/**
+ * Retrieve the step timing jitter statistics collected so far.
+ *
+ * @param all	Location for the statistics of all finished moves.
+ * @param move	Location for the statistics of the move in progress, if
+ *		it had any step intervals measured yet, or of the last
+ *		finished move otherwise.
+ *
+ * @return True if monitoring is enabled, false otherwise.
+ */
+extern bool kp_act_jitter_get(struct kp_act_jitter *all,
+			      struct kp_act_jitter *move);
+
+/**
+ * Get an upper bound of a percentile of step timing deviations from jitter
+ * statistics, within histogram bin resolution.
+ *
+ * @param jitter	The statistics to get the percentile from.
+ * @param percent	The percentile to get, 0-100.
+ *
+ * @return The upper bound of the percentile, us,
+ *	   or zero if there were no intervals measured.
+ */
+static inline uint32_t
+kp_act_jitter_get_percentile_us(const struct kp_act_jitter *jitter,
+				uint32_t percent)
+{
+	uint64_t rank;
+	uint64_t count = 0;
+	size_t i;
+
+	assert(jitter != NULL);
+	assert(percent <= 100);
+
+	if (jitter->intervals == 0) {
+		return 0;
+	}
+
+	rank = ((uint64_t)jitter->intervals * percent + 99) / 100;
+	for (i = 0; i < ARRAY_SIZE(jitter->bins) - 1; i++) {
+		count += jitter->bins[i];
+		if (count >= rank) {
+			return MIN((i + 1) * KP_ACT_JITTER_BIN_US - 1,
+				   jitter->max_us);
+		}
+	}
+	return jitter->max_us;
+}
+
+/**
+ * Maximum number of moves started, but not finished with
+ * kp_act_finish_move() yet.
+ */
+#define KP_ACT_QUEUE_LEN	4
+
+/**
+ * Start moving the actuator, or queue the move after the moves started
+ * before, if they're not done yet. Queued moves are chained without stopping,
+ * if they continue in the same direction with the same speed, and are only
+ * delayed to absorb the momentum, if they turn. Each move is finished
+ * separately, in order. Waits for a previous move to be finished, if
+ * KP_ACT_QUEUE_LEN moves are already started.
  *
  * @param relative	True if the move is relative, false if absolute.
- * @param steps		The number of steps to move by, if "relative" is true.
+ * @param steps		The number of steps to move by, from the target of
+ *			the last queued move, if any, or from the current
+ *			position, if "relative" is true.
  * 			The absolute position, in steps, if "relative" is
  * 			false. Positive - lower, negative - higher.
  * @param speed		The speed with which to move, 0-100%.
@@ -127,7 +278,34 @@ enum kp_act_move_rc {
 extern void kp_act_start_move(bool relative, int32_t steps, uint32_t speed);
 
 /**
- * Finish moving the actuator.
+ * A function called right before the first step of a move.
+ * Called by the actuator thread with the actuator state locked, so it must
+ * be quick, and must not block, or call the actuator functions.
+ *
+ * @param data	The data supplied when starting the move.
+ */
+typedef void (*kp_act_move_start_fn)(void *data);
+
+/**
+ * Start a move, same as kp_act_start_move(), but call a function right
+ * before its first step. The function is not called, if the move finishes
+ * without stepping (e.g. it's already at the target, or aborted).
+ *
+ * @param relative	True if the move is relative, false if absolute.
+ * @param steps		The number of steps, or the absolute position,
+ *			see kp_act_start_move().
+ * @param speed		The speed with which to move, 0-100%.
+ * @param start_fn	The function to call before the first step,
+ *			or NULL for none.
+ * @param start_data	The data to pass to the start function.
+ */
+extern void kp_act_start_move_hook(bool relative, int32_t steps,
+				   uint32_t speed,
+				   kp_act_move_start_fn start_fn,
+				   void *start_data);
+
+/**
+ * Finish the earliest started actuator move.
  *
  * @param timeout	The time to wait for the move to finish, or one of
  * 			the special values K_NO_WAIT and K_FOREVER.
@@ -184,8 +362,8 @@ kp_act_move_to(int32_t pos, uint32_t speed)
 }
 
 /**
- * Start moving the actuator to an absolute position.
- * Waits for the previous move to be finished/aborted.
+ * Start moving the actuator to an absolute position, or queue the move.
+ * See kp_act_start_move().
  *
  * @param pos	The absolute position to move the actuator to (must be valid).
  * @param speed	The speed with which to move, 0-100%.
@@ -217,7 +395,8 @@ kp_act_move_by(int32_t steps, uint32_t speed)
 }
 
 /**
- * Start moving the actuator by a specified number of steps.
+ * Start moving the actuator by a specified number of steps, or queue the
+ * move. See kp_act_start_move().
  *
  * @param steps	The number of steps to move by: positive values
  * 		- lower, negative - higher.
@@ -234,7 +413,8 @@ kp_act_start_move_by(int32_t steps, uint32_t speed)
 }
 
 /**
- * Abort the actuator's movement in progress, if any.
+ * Abort the actuator's movement in progress, and all the queued moves,
+ * if any.
  *
  * @return True if there was no movement or it was aborted,
  * 	   false if the actuator was not powered.
@@ -0,0 +1,344 @@
+/** @file
+ *  @brief Keypecker micro-benchmarks
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_bench.h"
+#include "kp_table.h"
+#include "kp_seqlock.h"
+#include <zephyr/timing/timing.h>
+#include <string.h>
+
+/** Maximum number of passes to render table rows for */
+#define KP_BENCH_TABLE_PASSES_MAX	100000
+
+/** Kernel names */
+static const char *kp_bench_kernel_names[KP_BENCH_KERNEL_NUM] = {
+	[KP_BENCH_KERNEL_IDX] = "idx",
+	[KP_BENCH_KERNEL_SUM] = "sum",
+	[KP_BENCH_KERNEL_BRIEF] = "brief",
+	[KP_BENCH_KERNEL_VERBOSE] = "verbose",
+	[KP_BENCH_KERNEL_TABLE] = "table",
+	[KP_BENCH_KERNEL_SPIN_READ] = "spinrd",
+	[KP_BENCH_KERNEL_SEQ_READ] = "seqrd",
+	[KP_BENCH_KERNEL_SEQ_WRITE] = "seqwr",
+};
+
+/** A sink for kernel results, so they're not optimized out */
+static volatile uint32_t kp_bench_sink;
+
+/** The actuator state snapshot the lock kernels read and write */
+static struct kp_act_state kp_bench_state;
+
+/** The spinlock the spinlock read kernel reads the snapshot under */
+static struct k_spinlock kp_bench_state_lock;
+
+/** The sequence lock the sequence lock kernels use for the snapshot */
+static struct kp_seqlock kp_bench_state_seqlock;
+
+uint32_t
+kp_bench_size_passes(size_t size)
+{
+	uint32_t passes = 100;
+	assert(size < KP_BENCH_SIZE_NUM);
+	for (; size > 0; size--) {
+		passes *= 10;
+	}
+	return passes;
+}
+
+/**
+ * Fill a measurement with synthetic results of a number of passes: one
+ * channel captured down, another up, with a spread of times, occasional
+ * overcaptures, and rare timeouts.
+ *
+ * @param meas		The measurement to fill.
+ * @param passes	The number of passes to fill in.
+ *			Must fit into the measurement.
+ */
+static void
+kp_bench_fill(struct kp_meas *meas, uint32_t passes)
+{
+	struct kp_cap_conf conf;
+	struct kp_cap_ch_res *ch_res;
+	uint32_t random = 1;
+	size_t i;
+
+	assert(meas != NULL);
+
+	memset(&conf, 0, sizeof(conf));
+	conf.timeout_us = 1000000;
+	conf.bounce_us = 50000;
+	conf.trig = KP_CAP_TRIG_ACT;
+	conf.ch_list[0].dirs = KP_CAP_DIRS_DOWN;
+	conf.ch_list[0].rising = true;
+	strcpy(conf.ch_list[0].name, "DOWN");
+	conf.ch_list[1].dirs = KP_CAP_DIRS_UP;
+	conf.ch_list[1].rising = false;
+	strcpy(conf.ch_list[1].name, "UP");
+	assert(kp_cap_conf_ch_res_idx(&conf, true, passes, 0) <=
+	       ARRAY_SIZE(meas->ch_res_list));
+
+	kp_meas_init(meas, 0, 1, NULL, 100, passes, &conf, true, NULL);
+	for (i = 0; i < passes; i++) {
+		/* A linear congruential generator */
+		random = random * 1103515245 + 12345;
+		ch_res = &meas->ch_res_list[i];
+		if ((random >> 16) % 64 == 0) {
+			ch_res->status = KP_CAP_CH_STATUS_TIMEOUT;
+			ch_res->value_us = 0;
+		} else {
+			ch_res->status = ((random >> 16) % 8 == 0)
+				? KP_CAP_CH_STATUS_OVERCAPTURE
+				: KP_CAP_CH_STATUS_OK;
+			ch_res->value_us = 2000 + (random >> 16) % 1000;
+		}
+	}
+	meas->passes = passes;
+	meas->captured_passes = passes;
+	assert(kp_meas_is_valid(meas));
+}
+
+/**
+ * Run a kernel on a data set.
+ *
+ * @param kernel	The kernel to run.
+ * @param meas		The measurement to use as the data set.
+ *
+ * @return The number of cycles the kernel took.
+ */
+static uint32_t
+kp_bench_run_kernel(enum kp_bench_kernel kernel, struct kp_meas *meas)
+{
+	struct kp_table table;
+	struct kp_meas_ch_sum sum;
+	struct kp_act_state state;
+	k_spinlock_key_t key;
+	timing_t start, end;
+	uint64_t cycles;
+	uint32_t acc = 0;
+	size_t pass, ch;
+
+	assert(kernel < KP_BENCH_KERNEL_NUM);
+	assert(kp_meas_is_valid(meas));
+
+	start = timing_counter_get();
+	switch (kernel) {
+	case KP_BENCH_KERNEL_IDX:
+		for (pass = 0; pass < meas->requested_passes; pass++) {
+			acc += kp_cap_conf_ch_res_idx(&meas->conf,
+						      meas->even_down,
+						      pass, 0);
+		}
+		break;
+	case KP_BENCH_KERNEL_SUM:
+		for (ch = 0; ch < ARRAY_SIZE(meas->conf.ch_list); ch++) {
+			kp_meas_get_ch_sum(meas, ch, KP_CAP_DIRS_BOTH, &sum);
+			acc += sum.mean_us;
+		}
+		break;
+	case KP_BENCH_KERNEL_BRIEF:
+		kp_meas_print(NULL, meas, false);
+		break;
+	case KP_BENCH_KERNEL_VERBOSE:
+		kp_meas_print(NULL, meas, true);
+		break;
+	case KP_BENCH_KERNEL_TABLE:
+		kp_table_init(&table, NULL,
+			      KP_CAP_TIME_MAX_DIGITS + 1,
+			      KP_CAP_CH_NAME_MAX_LEN, 3);
+		for (pass = 0; pass < meas->requested_passes; pass++) {
+			kp_table_col(&table, "%s",
+				     (pass & 1) ? "Up" : "Down");
+			kp_table_col(&table, "%zu", pass);
+			kp_table_col(&table, "+%zu", pass * 3);
+			kp_table_nl(&table);
+		}
+		acc += table.line_num;
+		break;
+	case KP_BENCH_KERNEL_SPIN_READ:
+		for (pass = 0; pass < meas->requested_passes; pass++) {
+			key = k_spin_lock(&kp_bench_state_lock);
+			state = kp_bench_state;
+			k_spin_unlock(&kp_bench_state_lock, key);
+			acc += state.pos;
+		}
+		break;
+	case KP_BENCH_KERNEL_SEQ_READ:
+		for (pass = 0; pass < meas->requested_passes; pass++) {
+			KP_SEQLOCK_READ(&kp_bench_state_seqlock) {
+				state = kp_bench_state;
+			}
+			acc += state.pos;
+		}
+		break;
+	case KP_BENCH_KERNEL_SEQ_WRITE:
+		for (pass = 0; pass < meas->requested_passes; pass++) {
+			kp_seqlock_write_begin(&kp_bench_state_seqlock);
+			kp_bench_state.pos = (int32_t)pass;
+			kp_bench_state.target = (int32_t)pass + 1;
+			kp_bench_state.queued = pass & 3;
+			kp_seqlock_write_end(&kp_bench_state_seqlock);
+		}
+		acc += kp_bench_state.pos;
+		break;
+	default:
+		assert(!"Unknown kernel");
+		break;
+	}
+	end = timing_counter_get();
+	/* Let other threads run between the kernels */
+	k_yield();
+
+	kp_bench_sink = acc;
+	cycles = timing_cycles_get(&start, &end);
+	return (uint32_t)MIN(cycles, UINT32_MAX);
+}
+
+void
+kp_bench_run(struct kp_meas *meas, struct kp_bench_res *res)
+{
+	enum kp_bench_kernel kernel;
+	size_t size;
+	uint32_t passes;
+	/* The synthetic data capacity, one result per pass */
+	const uint32_t meas_passes_max = ARRAY_SIZE(meas->ch_res_list);
+
+	assert(meas != NULL);
+	assert(res != NULL);
+
+	memset(res, 0, sizeof(*res));
+	timing_init();
+	timing_start();
+
+	for (size = 0; size < KP_BENCH_SIZE_NUM; size++) {
+		passes = kp_bench_size_passes(size);
+		/* Fill as much of the data set as fits */
+		kp_bench_fill(meas, MIN(passes, meas_passes_max));
+		/* Indexing needs no data, only the configuration */
+		meas->requested_passes = passes;
+		res->cycles[KP_BENCH_KERNEL_IDX][size] =
+			kp_bench_run_kernel(KP_BENCH_KERNEL_IDX, meas);
+		/* Snapshot kernels need no data either */
+		for (kernel = KP_BENCH_KERNEL_SPIN_READ;
+		     kernel <= KP_BENCH_KERNEL_SEQ_WRITE; kernel++) {
+			res->cycles[kernel][size] =
+				kp_bench_run_kernel(kernel, meas);
+		}
+		if (passes <= KP_BENCH_TABLE_PASSES_MAX) {
+			res->cycles[KP_BENCH_KERNEL_TABLE][size] =
+				kp_bench_run_kernel(KP_BENCH_KERNEL_TABLE,
+						    meas);
+		}
+		meas->requested_passes = meas->passes;
+		/* Run the data kernels only on complete data sets */
+		if (passes > meas_passes_max) {
+			continue;
+		}
+		for (kernel = KP_BENCH_KERNEL_SUM;
+		     kernel <= KP_BENCH_KERNEL_VERBOSE; kernel++) {
+			res->cycles[kernel][size] =
+				kp_bench_run_kernel(kernel, meas);
+		}
+	}
+
+	timing_stop();
+
+	/* Leave no measurement behind */
+	*meas = KP_MEAS_INVALID;
+}
+
+/**
+ * Convert cycles taken by a number of passes, to hundredths of nanoseconds
+ * per pass.
+ *
+ * @param cycles	The cycles taken.
+ * @param passes	The number of passes.
+ *
+ * @return Hundredths of nanoseconds per pass.
+ */
+static uint64_t
+kp_bench_cycles_to_cns_per_pass(uint32_t cycles, uint32_t passes)
+{
+	return timing_cycles_to_ns((uint64_t)cycles * 100) / passes;
+}
+
+void
+kp_bench_print(const struct shell *shell,
+	       const struct kp_bench_res *res,
+	       const struct kp_bench_res *base)
+{
+	struct kp_table table;
+	enum kp_bench_kernel kernel;
+	size_t size;
+	uint32_t passes;
+	uint32_t cycles;
+	uint64_t cns;
+	uint64_t base_cns;
+
+	assert(shell != NULL);
+	assert(res != NULL);
+
+	kp_table_init(&table, shell, 7, 11, base != NULL ? 6 : 4);
+	kp_table_col(&table, "Kernel");
+	kp_table_col(&table, "Passes");
+	kp_table_col(&table, "Cycles/pass");
+	kp_table_col(&table, "ns/pass");
+	if (base != NULL) {
+		kp_table_col(&table, "Base ns");
+		kp_table_col(&table, "Change, %%");
+	}
+	kp_table_nl(&table);
+	kp_table_sep(&table);
+
+	for (kernel = 0; kernel < KP_BENCH_KERNEL_NUM; kernel++) {
+		for (size = 0; size < KP_BENCH_SIZE_NUM; size++) {
+			cycles = res->cycles[kernel][size];
+			if (cycles == 0) {
+				continue;
+			}
+			passes = kp_bench_size_passes(size);
+			cns = kp_bench_cycles_to_cns_per_pass(cycles, passes);
+			kp_table_col(&table, "%s",
+				     kp_bench_kernel_names[kernel]);
+			kp_table_col(&table, "%u", passes);
+			kp_table_col(&table, "%u.%02u",
+				     (uint32_t)((uint64_t)cycles * 100 /
+						passes / 100),
+				     (uint32_t)((uint64_t)cycles * 100 /
+						passes % 100));
+			kp_table_col(&table, "%u.%02u",
+				     (uint32_t)(cns / 100),
+				     (uint32_t)(cns % 100));
+			if (base == NULL) {
+				kp_table_nl(&table);
+				continue;
+			}
+			if (base->cycles[kernel][size] == 0) {
+				kp_table_col(&table, "");
+				kp_table_col(&table, "");
+				kp_table_nl(&table);
+				continue;
+			}
+			base_cns = kp_bench_cycles_to_cns_per_pass(
+				base->cycles[kernel][size], passes
+			);
+			kp_table_col(&table, "%u.%02u",
+				     (uint32_t)(base_cns / 100),
+				     (uint32_t)(base_cns % 100));
+			kp_table_col(&table, "%s%u",
+				     cns >= base_cns ? "+" : "-",
+				     (uint32_t)((cns >= base_cns
+						? cns - base_cns
+						: base_cns - cns) *
+						100 / MAX(base_cns, 1)));
+			kp_table_nl(&table);
+		}
+	}
+	kp_table_sep(&table);
+}
@@ -0,0 +1,108 @@
+/** @file
+ *  @brief Keypecker micro-benchmarks
+ *
+ *  The benchmarks run the measurement statistics, rendering, and indexing
+ *  kernels on synthetic data sets of growing numbers of passes, and count
+ *  the cycles they take with the Zephyr timing functions (the DWT cycle
+ *  counter on Cortex-M). Rendering is done without output, so only the
+ *  formatting is counted. The state snapshot kernels read or write the same
+ *  number of snapshots instead, to compare the interrupts-off time a
+ *  spinlock adds to the step path, against a sequence lock.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_BENCH_H_
+#define KP_BENCH_H_
+
+#include "kp_meas.h"
+#include <zephyr/shell/shell.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Benchmarked kernels */
+enum kp_bench_kernel {
+	/** Channel result indexing (kp_cap_conf_ch_res_idx()) */
+	KP_BENCH_KERNEL_IDX,
+	/** Channel summary statistics (kp_meas_get_ch_sum()) */
+	KP_BENCH_KERNEL_SUM,
+	/** Brief measurement rendering: statistics and histogram */
+	KP_BENCH_KERNEL_BRIEF,
+	/** Verbose measurement rendering: passes, statistics, histograms */
+	KP_BENCH_KERNEL_VERBOSE,
+	/** Table row rendering (kp_table_col() and kp_table_nl()) */
+	KP_BENCH_KERNEL_TABLE,
+	/**
+	 * Actuator state snapshot read under a spinlock, as before
+	 * kp_act_get_state(), a pass per read. Interrupts are off for most
+	 * of each read.
+	 */
+	KP_BENCH_KERNEL_SPIN_READ,
+	/**
+	 * Actuator state snapshot read under a sequence lock
+	 * (kp_act_get_state()), a pass per read. Interrupts stay on.
+	 */
+	KP_BENCH_KERNEL_SEQ_READ,
+	/**
+	 * Actuator state snapshot publishing under a sequence lock, as done
+	 * by every step, a pass per write.
+	 */
+	KP_BENCH_KERNEL_SEQ_WRITE,
+	/** Number of kernels (not a kernel itself) */
+	KP_BENCH_KERNEL_NUM
+};
+
+/** Number of data set sizes: 10^2 to 10^6 passes */
+#define KP_BENCH_SIZE_NUM	5
+
+/** Benchmark results */
+struct kp_bench_res {
+	/**
+	 * Cycles each kernel took for each data set size, or zero, if the
+	 * size exceeds what the kernel can handle.
+	 */
+	uint32_t cycles[KP_BENCH_KERNEL_NUM][KP_BENCH_SIZE_NUM];
+};
+
+/**
+ * Get the number of passes in a data set.
+ *
+ * @param size	The index of the data set size.
+ *
+ * @return The number of passes in the data set.
+ */
+extern uint32_t kp_bench_size_passes(size_t size);
+
+/**
+ * Run all benchmarks.
+ *
+ * @param meas	The measurement to use as the synthetic data set.
+ *		Its contents are destroyed.
+ * @param res	Location for the results.
+ */
+extern void kp_bench_run(struct kp_meas *meas, struct kp_bench_res *res);
+
+/**
+ * Output benchmark results, comparing them to baseline results, if any.
+ *
+ * @param shell	The shell to output to.
+ * @param res	The results to output.
+ * @param base	The baseline results to compare to, or NULL for none.
+ */
+extern void kp_bench_print(const struct shell *shell,
+			   const struct kp_bench_res *res,
+			   const struct kp_bench_res *base);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_BENCH_H_ */
@@ -46,9 +46,21 @@ struct kp_cap_dbg_conf kp_cap_dbg_conf;
 /** The semaphore signaling a capture can be started */
 static K_SEM_DEFINE(kp_cap_available, 1, 1);
 
+/** The GPIO port with the pins connected to the channel inputs */
+static const struct device *kp_cap_ch_gpio;
+
+/** The pins connected to each channel input */
+static gpio_pin_t kp_cap_ch_pin_list[KP_CAP_CH_NUM];
+
 /** The capture interrupt mask for all channels to be captured */
 static uint32_t kp_cap_ch_ccif_mask;
 
+/**
+ * The capture interrupt mask of the channels found stuck at their
+ * post-trigger level when arming, and so not captured
+ */
+static uint32_t kp_cap_ch_stuck_mask;
+
 /** The maximum number of ticks to await capture of all channels */
 static uint32_t kp_cap_timeout_ticks;
 
@@ -58,6 +70,9 @@ static uint32_t kp_cap_bounce_ticks;
 /** The capture abort flag */
 static volatile bool kp_cap_aborted;
 
+/** True if the capture is reserved, but not armed (or aborted) yet */
+static bool kp_cap_reserved;
+
 /** The semaphore signaling a capture is done */
 static K_SEM_DEFINE(kp_cap_done, 0, 1);
 
@@ -65,6 +80,303 @@ static K_SEM_DEFINE(kp_cap_done, 0, 1);
 /** Only needs to be held if kp_cap_available is taken */
 static struct k_spinlock kp_cap_lock = {};
 
+/** PWM input configuration of a capture channel */
+struct kp_cap_pwm_ch {
+	/** The timer channel capturing the rising edges (the period) */
+	uint32_t rise_mask;
+	/** The paired timer channel capturing the falling edges (high time) */
+	uint32_t fall_mask;
+	/** Capture interrupt-enabling/interrupt-flag mask of the rise */
+	uint32_t rise_ccif_mask;
+	/** Capture interrupt-enabling/interrupt-flag mask of the fall */
+	uint32_t fall_ccif_mask;
+	/** Overcapture flag mask of the rise */
+	uint32_t rise_ccof_mask;
+	/** Offset of the captured-value register of the rise, bytes */
+	size_t rise_ccr_offset;
+	/** Offset of the captured-value register of the fall, bytes */
+	size_t fall_ccr_offset;
+};
+
+/**
+ * PWM input configurations of each channel. The falls are captured by the
+ * paired timer channels, connected to the channel inputs indirectly.
+ */
+static const struct kp_cap_pwm_ch kp_cap_pwm_ch_list[KP_CAP_CH_NUM] = {
+	{
+		.rise_mask = LL_TIM_CHANNEL_CH2,
+		.fall_mask = LL_TIM_CHANNEL_CH1,
+		.rise_ccif_mask = TIM_SR_CC2IF,
+		.fall_ccif_mask = TIM_SR_CC1IF,
+		.rise_ccof_mask = TIM_SR_CC2OF,
+		.rise_ccr_offset = offsetof(TIM_TypeDef, CCR2),
+		.fall_ccr_offset = offsetof(TIM_TypeDef, CCR1),
+	},
+	{
+		.rise_mask = LL_TIM_CHANNEL_CH3,
+		.fall_mask = LL_TIM_CHANNEL_CH4,
+		.rise_ccif_mask = TIM_SR_CC3IF,
+		.fall_ccif_mask = TIM_SR_CC4IF,
+		.rise_ccof_mask = TIM_SR_CC3OF,
+		.rise_ccr_offset = offsetof(TIM_TypeDef, CCR3),
+		.fall_ccr_offset = offsetof(TIM_TypeDef, CCR4),
+	},
+};
+
+/** The index of the channel being PWM-measured, or SIZE_MAX if none */
+static size_t kp_cap_pwm_ch = SIZE_MAX;
+
+/** The statistics of the running PWM input measurement */
+static struct kp_cap_pwm kp_cap_pwm;
+
+/** The number of timer overflows since the PWM measurement start */
+static uint32_t kp_cap_pwm_wraps;
+
+/** True if a rise was captured since the PWM measurement start */
+static bool kp_cap_pwm_got_rise;
+
+/** The (extended) time of the last captured rise, ticks */
+static uint32_t kp_cap_pwm_rise;
+
+/** True if a fall was captured since the last rise */
+static bool kp_cap_pwm_got_fall;
+
+/** The (extended) time of the last captured fall, ticks */
+static uint32_t kp_cap_pwm_fall;
+
+/** Number of the latest events kept on the capture timeline */
+#define KP_CAP_TL_EVENT_NUM	64
+
+/** The source of a timeline event standing for the trigger input */
+#define KP_CAP_TL_SRC_TRIG	KP_CAP_CH_NUM
+
+/** A capture timeline event */
+struct kp_cap_tl_event {
+	/** The (extended) time of the event, ticks */
+	uint32_t time;
+	/** The source: a channel index, or KP_CAP_TL_SRC_TRIG */
+	uint8_t src;
+	/** True if more edges were captured than the event stands for */
+	bool over;
+};
+
+/** True if the capture timeline is running */
+static volatile bool kp_cap_tl_running;
+
+/** The capture configuration the timeline is running with */
+static struct kp_cap_conf kp_cap_tl_conf;
+
+/** The number of timer overflows since the timeline start */
+static uint32_t kp_cap_tl_wraps;
+
+/** The ring of the latest timeline events */
+static struct kp_cap_tl_event kp_cap_tl_event_list[KP_CAP_TL_EVENT_NUM];
+
+/** The sequence number of the next timeline event */
+static uint32_t kp_cap_tl_seq;
+
+/** The latest timeline event of a source dropped from the ring */
+struct kp_cap_tl_drop {
+	/** True if an event of the source was dropped */
+	bool valid;
+	/** The sequence number of the event */
+	uint32_t seq;
+	/** The (extended) time of the event, ticks */
+	uint32_t time;
+};
+
+/** The latest events dropped from the ring, indexed by source */
+static struct kp_cap_tl_drop kp_cap_tl_drop_list[KP_CAP_CH_NUM + 1];
+
+/** True if the trigger time of the last finished pass is known */
+static bool kp_cap_tl_trig_valid;
+
+/** The (extended) trigger time of the last finished pass, ticks */
+static uint32_t kp_cap_tl_trig;
+
+/**
+ * Register a rise captured in PWM input measurement.
+ * Must be called with kp_cap_lock held.
+ *
+ * @param time	The (extended) time of the rise, ticks.
+ * @param valid	True if the period ending with the rise can be counted,
+ *		false if any rises were missed.
+ */
+static void
+kp_cap_pwm_rise_locked(uint32_t time, bool valid)
+{
+	struct kp_cap_pwm *pwm = &kp_cap_pwm;
+	uint32_t period_us = (time - kp_cap_pwm_rise) * KP_CAP_PWM_RES_US;
+	uint32_t high_us = (kp_cap_pwm_fall - kp_cap_pwm_rise) *
+				KP_CAP_PWM_RES_US;
+	int64_t dev_us;
+
+	if (!kp_cap_pwm_got_rise) {
+		/* Nothing to measure yet */
+	} else if (!valid) {
+		pwm->missed++;
+	} else {
+		if (pwm->periods == 0) {
+			pwm->period_first_us = period_us;
+			pwm->period_min_us = period_us;
+			pwm->period_max_us = period_us;
+		}
+		pwm->periods++;
+		pwm->period_min_us = MIN(pwm->period_min_us, period_us);
+		pwm->period_max_us = MAX(pwm->period_max_us, period_us);
+		pwm->period_sum_us += period_us;
+		dev_us = (int64_t)period_us - pwm->period_first_us;
+		pwm->period_dev_sq_sum += (uint64_t)(dev_us * dev_us);
+		if (kp_cap_pwm_got_fall && high_us < period_us) {
+			if (pwm->highs == 0) {
+				pwm->high_min_us = high_us;
+				pwm->high_max_us = high_us;
+			}
+			pwm->highs++;
+			pwm->high_min_us = MIN(pwm->high_min_us, high_us);
+			pwm->high_max_us = MAX(pwm->high_max_us, high_us);
+			pwm->high_sum_us += high_us;
+		}
+	}
+
+	kp_cap_pwm_got_rise = true;
+	kp_cap_pwm_rise = time;
+	kp_cap_pwm_got_fall = false;
+}
+
+/**
+ * Handle the capture timer interrupt during PWM input measurement.
+ * Must be called with kp_cap_lock held.
+ */
+static void
+kp_cap_pwm_isr_locked(void)
+{
+	const struct kp_cap_pwm_ch *ch = &kp_cap_pwm_ch_list[kp_cap_pwm_ch];
+	uint32_t sr = kp_cap_timer->SR;
+	bool got_rise = sr & ch->rise_ccif_mask;
+	bool got_fall = sr & ch->fall_ccif_mask;
+	bool wrapped = sr & TIM_SR_UIF;
+	uint32_t rise = 0;
+	uint32_t fall = 0;
+
+	/*
+	 * Clear the overflow and overcapture flags we've seen (reads clear
+	 * the rest), keeping any which were set since, for the next time
+	 */
+	kp_cap_timer->SR = ~(sr & (TIM_SR_UIF | ch->rise_ccof_mask));
+
+	/*
+	 * Extend captured values with the overflow count, assuming values in
+	 * the upper half were captured before a pending overflow.
+	 */
+	if (got_rise) {
+		rise = *(volatile uint32_t *)((uint8_t *)kp_cap_timer +
+					      ch->rise_ccr_offset) & 0xffff;
+		rise |= (kp_cap_pwm_wraps +
+			 (wrapped && rise < 0x8000)) << 16;
+	}
+	if (got_fall) {
+		fall = *(volatile uint32_t *)((uint8_t *)kp_cap_timer +
+					      ch->fall_ccr_offset) & 0xffff;
+		fall |= (kp_cap_pwm_wraps +
+			 (wrapped && fall < 0x8000)) << 16;
+	}
+	kp_cap_pwm_wraps += wrapped;
+
+	/* Register a fall preceding the rise, if any */
+	if (got_fall && (!got_rise || (int32_t)(fall - rise) < 0)) {
+		kp_cap_pwm_got_fall = kp_cap_pwm_got_rise;
+		kp_cap_pwm_fall = fall;
+		got_fall = false;
+	}
+	/* Register the rise, if any */
+	if (got_rise) {
+		kp_cap_pwm_rise_locked(rise, !(sr & ch->rise_ccof_mask));
+	}
+	/* Register a fall following the rise, if any */
+	if (got_fall) {
+		kp_cap_pwm_got_fall = kp_cap_pwm_got_rise;
+		kp_cap_pwm_fall = fall;
+	}
+}
+
+/**
+ * Extend a 16-bit timer value with the timeline overflow count, assuming
+ * values in the upper half were captured before a pending overflow.
+ * Must be called with kp_cap_lock held.
+ *
+ * @param value		The timer value to extend.
+ * @param wrapped	True if an overflow is pending, false otherwise.
+ *
+ * @return The extended time, ticks.
+ */
+static uint32_t
+kp_cap_tl_extend_locked(uint32_t value, bool wrapped)
+{
+	value &= 0xffff;
+	return ((kp_cap_tl_wraps + (wrapped && value < 0x8000)) << 16) | value;
+}
+
+/**
+ * Handle the capture timer interrupt while running the timeline.
+ * Must be called with kp_cap_lock held.
+ */
+static void
+kp_cap_tl_isr_locked(void)
+{
+	uint32_t sr = kp_cap_timer->SR;
+	uint32_t masked_sr = sr & kp_cap_timer->DIER;
+	bool wrapped = sr & TIM_SR_UIF;
+	struct kp_cap_tl_event *event;
+	uint32_t value;
+	size_t i;
+
+	/*
+	 * Clear the overflow and overcapture flags we've seen (reads clear
+	 * the rest), keeping any which were set since, for the next time
+	 */
+	kp_cap_timer->SR = ~(sr & (TIM_SR_UIF | TIM_SR_CC1OF |
+				   kp_cap_ch_ccof_mask_list[0] |
+				   kp_cap_ch_ccof_mask_list[1]));
+
+	/* Record the armed trigger, and disarm it, or each channel edge */
+	for (i = 0; i <= KP_CAP_CH_NUM; i++) {
+		if (i == KP_CAP_TL_SRC_TRIG) {
+			if (!(masked_sr & TIM_SR_CC1IF)) {
+				continue;
+			}
+			value = kp_cap_timer->CCR1;
+			kp_cap_timer->DIER &= ~TIM_SR_CC1IF;
+		} else {
+			if (!(masked_sr & kp_cap_ch_ccif_mask_list[i])) {
+				continue;
+			}
+			value = *(volatile uint32_t *)(
+				(uint8_t *)kp_cap_timer +
+				kp_cap_ch_ccr_offset_list[i]
+			);
+		}
+		event = &kp_cap_tl_event_list[kp_cap_tl_seq %
+					      KP_CAP_TL_EVENT_NUM];
+		/* Remember the event we're dropping, if any */
+		if (kp_cap_tl_seq >= KP_CAP_TL_EVENT_NUM) {
+			kp_cap_tl_drop_list[event->src] =
+				(struct kp_cap_tl_drop){
+					.valid = true,
+					.seq = kp_cap_tl_seq -
+						KP_CAP_TL_EVENT_NUM,
+					.time = event->time,
+				};
+		}
+		event->time = kp_cap_tl_extend_locked(value, wrapped);
+		event->src = i;
+		event->over = i < KP_CAP_CH_NUM &&
+			      (sr & kp_cap_ch_ccof_mask_list[i]);
+		kp_cap_tl_seq++;
+	}
+	kp_cap_tl_wraps += wrapped;
+}
+
 void
 kp_cap_isr(void *arg)
 {
@@ -77,8 +389,14 @@ kp_cap_isr(void *arg)
 
 	key = k_spin_lock(&kp_cap_lock);
 
-	/* If the capture is not aborted */
-	if (!kp_cap_aborted) {
+	/* If running the timeline */
+	if (kp_cap_tl_running) {
+		kp_cap_tl_isr_locked();
+	/* Else, if measuring PWM input */
+	} else if (kp_cap_pwm_ch < KP_CAP_CH_NUM) {
+		kp_cap_pwm_isr_locked();
+	/* Else, if the capture is not aborted */
+	} else if (!kp_cap_aborted) {
 		uint32_t sr = kp_cap_timer->SR;
 		uint32_t masked_sr = sr & kp_cap_timer->DIER;
 		/* If the timer got triggered */
@@ -218,7 +536,24 @@ kp_cap_conf_ch_res_idx(const struct kp_cap_conf *conf, bool even_down,
 }
 
 void
-kp_cap_start(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs)
+kp_cap_reserve(void)
+{
+	k_spinlock_key_t key;
+
+	assert(kp_cap_is_initialized());
+
+	/* Wait for the capture to be available */
+	k_sem_take(&kp_cap_available, K_FOREVER);
+
+	key = k_spin_lock(&kp_cap_lock);
+	/* Reset abort flag */
+	kp_cap_aborted = false;
+	kp_cap_reserved = true;
+	k_spin_unlock(&kp_cap_lock, key);
+}
+
+void
+kp_cap_arm(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs)
 {
 	size_t i;
 	const struct kp_cap_ch_conf *ch_conf;
@@ -229,22 +564,35 @@ kp_cap_start(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs)
 	assert(kp_cap_conf_is_valid(conf));
 	assert(kp_cap_dirs_is_valid(dirs));
 
-	/* Wait for the capture to be available */
-	k_sem_take(&kp_cap_available, K_FOREVER);
-
 	/* Lock the interrupt state */
 	key = k_spin_lock(&kp_cap_lock);
 
+	/* Don't arm, if aborted while reserved */
+	if (!kp_cap_reserved) {
+		k_spin_unlock(&kp_cap_lock, key);
+		return;
+	}
+	kp_cap_reserved = false;
+
 	/* Initialize the capture configuration */
 	kp_cap_ch_ccif_mask = 0;
+	kp_cap_ch_stuck_mask = 0;
 
 	/* For each channel */
 	for (i = 0; i < KP_CAP_CH_NUM; i++) {
 		ch_mask = kp_cap_ch_mask_list[i];
 		/* NOTE: Must be considered invalid before the check below */
 		ch_conf = &conf->ch_list[i];
-		/* If the channel's capture is enabled */
-		if (ch_conf->dirs & dirs) {
+		/* If the channel is already at its post-trigger level */
+		if ((ch_conf->dirs & dirs) &&
+		    gpio_pin_get_raw(kp_cap_ch_gpio,
+				     kp_cap_ch_pin_list[i]) ==
+		    (int)ch_conf->rising) {
+			/* Report it stuck, instead of waiting for timeout */
+			kp_cap_ch_stuck_mask |= kp_cap_ch_ccif_mask_list[i];
+			LL_TIM_CC_DisableChannel(kp_cap_timer, ch_mask);
+		/* Else, if the channel's capture is enabled */
+		} else if (ch_conf->dirs & dirs) {
 			/* Configure and enable the capture */
 			kp_cap_ch_ccif_mask |= kp_cap_ch_ccif_mask_list[i];
 			LL_TIM_IC_Config(
@@ -263,15 +611,15 @@ kp_cap_start(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs)
 		}
 	}
 
-	/* Reset abort flag */
-	kp_cap_aborted = false;
-
 	/* Remember the number of ticks to wait for capture */
 	kp_cap_timeout_ticks = conf->timeout_us / KP_CAP_RES_US;
 
 	/* Remember the number of ticks to wait for a channel to bounce */
 	kp_cap_bounce_ticks = conf->bounce_us / KP_CAP_RES_US;
 
+	/* Count from zero, so edges before the trigger are captured as zero */
+	LL_TIM_SetCounter(kp_cap_timer, 0);
+
 	/* Clear all the overcapture/interrupt flags */
 	kp_cap_timer->SR = 0;
 
@@ -279,10 +627,28 @@ kp_cap_start(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs)
 	/* NOTE: Assuming SR bits match DIER bits */
 	kp_cap_timer->DIER = TIM_SR_TIF | kp_cap_ch_ccif_mask | TIM_SR_UIF;
 
+	/* Select the trigger, disabling it while switching */
+	LL_TIM_SetSlaveMode(kp_cap_timer, LL_TIM_SLAVEMODE_DISABLED);
+	if (conf->trig == KP_CAP_TRIG_EXT) {
+		/* Trigger on the stimulus edge matching the direction */
+		LL_TIM_ConfigETR(kp_cap_timer,
+				 (dirs == KP_CAP_DIRS_UP)
+					? LL_TIM_ETR_POLARITY_INVERTED
+					: LL_TIM_ETR_POLARITY_NONINVERTED,
+				 LL_TIM_ETR_PRESCALER_DIV1,
+				 LL_TIM_ETR_FILTER_FDIV1);
+		LL_TIM_SetTriggerInput(kp_cap_timer, LL_TIM_TS_ETRF);
+	} else {
+		LL_TIM_SetTriggerInput(kp_cap_timer, LL_TIM_TS_TI1FP1);
+	}
+
 	/* Set auto-reload register to the total timeout */
+	/* Or just to the bounce time, if there's nothing left to capture */
 	LL_TIM_SetAutoReload(kp_cap_timer,
-			     kp_cap_timeout_ticks +
-			     kp_cap_bounce_ticks);
+			     (kp_cap_ch_stuck_mask && !kp_cap_ch_ccif_mask)
+				? MAX(kp_cap_bounce_ticks, 1)
+				: kp_cap_timeout_ticks +
+				  kp_cap_bounce_ticks);
 
 	/* Setup the trigger to start (but not stop) counting */
 	LL_TIM_SetSlaveMode(kp_cap_timer, LL_TIM_SLAVEMODE_TRIGGER);
@@ -291,6 +657,13 @@ kp_cap_start(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs)
 	k_spin_unlock(&kp_cap_lock, key);
 }
 
+void
+kp_cap_start(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs)
+{
+	kp_cap_reserve();
+	kp_cap_arm(conf, dirs);
+}
+
 bool
 kp_cap_abort(void)
 {
@@ -314,6 +687,12 @@ kp_cap_abort(void)
 		kp_cap_aborted = true;
 		/* Report as aborted */
 		aborted = true;
+	/* Else, if the capture is reserved, but not armed yet */
+	} else if (kp_cap_reserved) {
+		/* Don't arm it, and mark it as aborted */
+		kp_cap_reserved = false;
+		kp_cap_aborted = true;
+		aborted = true;
 	} else {
 		/* Report as not aborted */
 		aborted = false;
@@ -368,14 +747,16 @@ kp_cap_finish(struct kp_cap_ch_res *ch_res_list,
 
 	/* For each channel */
 	for (ch_res = ch_res_list, i = 0; i < KP_CAP_CH_NUM; i++) {
-		/* Skip disabled channels */
-		if (!LL_TIM_CC_IsEnabledChannel(kp_cap_timer,
-						kp_cap_ch_mask_list[i])) {
+		/* If the channel was stuck when arming */
+		if (kp_cap_ch_stuck_mask & kp_cap_ch_ccif_mask_list[i]) {
+			status = KP_CAP_CH_STATUS_STUCK;
+			value_us = 0;
+		/* Else, skip disabled channels */
+		} else if (!LL_TIM_CC_IsEnabledChannel(
+				kp_cap_timer, kp_cap_ch_mask_list[i])) {
 			continue;
-		}
-
-		/* If the channel was captured */
-		if (kp_cap_timer->SR & kp_cap_ch_ccif_mask_list[i]) {
+		/* Else, if the channel was captured */
+		} else if (kp_cap_timer->SR & kp_cap_ch_ccif_mask_list[i]) {
 			/* Read the value (clears the capture flag) */
 			value_ticks = *(uint32_t *)(
 				(uint8_t *)kp_cap_timer +
@@ -383,7 +764,8 @@ kp_cap_finish(struct kp_cap_ch_res *ch_res_list,
 			);
 			value_us = value_ticks * KP_CAP_RES_US;
 			/* If the channel was over-captured */
-			if (kp_cap_timer->SR & kp_cap_ch_ccof_mask_list[i]) {
+			if (kp_cap_timer->SR &
+				   kp_cap_ch_ccof_mask_list[i]) {
 				status = KP_CAP_CH_STATUS_OVERCAPTURE;
 				/* Reset the overcapture flag */
 				kp_cap_timer->SR &=
@@ -472,6 +854,38 @@ kp_cap_dirs_to_cpstr(enum kp_cap_dirs dirs)
 	return str == NULL ? "unknown" : str;
 }
 
+bool
+kp_cap_trig_from_str(const char *str, enum kp_cap_trig *ptrig)
+{
+	enum kp_cap_trig trig;
+	assert(str != NULL);
+
+	if (kp_strcasecmp(str, "actuator") == 0) {
+		trig = KP_CAP_TRIG_ACT;
+	} else if (kp_strcasecmp(str, "external") == 0) {
+		trig = KP_CAP_TRIG_EXT;
+	} else {
+		return false;
+	}
+
+	if (ptrig != NULL) {
+		*ptrig = trig;
+	}
+
+	return true;
+}
+
+const char *
+kp_cap_trig_to_lcstr(enum kp_cap_trig trig)
+{
+	static const char *str_list[KP_CAP_TRIG_NUM] = {
+		[KP_CAP_TRIG_ACT] = "actuator",
+		[KP_CAP_TRIG_EXT] = "external",
+	};
+	const char *str = kp_cap_trig_is_valid(trig) ? str_list[trig] : NULL;
+	return str == NULL ? "unknown" : str;
+}
+
 const char *
 kp_cap_ch_status_to_str(enum kp_cap_ch_status status)
 {
@@ -480,6 +894,7 @@ kp_cap_ch_status_to_str(enum kp_cap_ch_status status)
 		STATUS_STR(TIMEOUT),
 		STATUS_STR(OK),
 		STATUS_STR(OVERCAPTURE),
+		STATUS_STR(STUCK),
 #undef STATUS_STR
 	};
 	const char *str = (status >= 0 && status < ARRAY_SIZE(str_list))
@@ -508,22 +923,13 @@ kp_cap_is_initialized(void)
 	return kp_cap_timer != NULL;
 }
 
-void
-kp_cap_init(TIM_TypeDef* timer, const struct kp_cap_dbg_conf *dbg_conf)
+/**
+ * Configure the capture timer for capturing, after initialization, or after
+ * it was used for something else.
+ */
+static void
+kp_cap_configure(void)
 {
-	assert(!kp_cap_is_initialized());
-	assert(timer != NULL);
-
-	/* Remember the timer we're using */
-	kp_cap_timer = timer;
-
-	/* Remember debug output configuration */
-	if (dbg_conf == NULL) {
-		kp_cap_dbg_conf.gpio = NULL;
-	} else {
-		memcpy(&kp_cap_dbg_conf, dbg_conf, sizeof(kp_cap_dbg_conf));
-	}
-
 	/* Set update interrupt generation for overflow/underflow only */
 	LL_TIM_SetUpdateSource(kp_cap_timer, LL_TIM_UPDATESOURCE_COUNTER);
 	/* Setup prescaling to get our resolution with the system clock */
@@ -549,6 +955,538 @@ kp_cap_init(TIM_TypeDef* timer, const struct kp_cap_dbg_conf *dbg_conf)
 	LL_TIM_SetTriggerInput(kp_cap_timer, LL_TIM_TS_TI1FP1);
 	/* Setup trigger to start (but not stop) counting */
 	LL_TIM_SetSlaveMode(kp_cap_timer, LL_TIM_SLAVEMODE_TRIGGER);
+	/* Output counting as trigger, for slave timers to start with us */
+	LL_TIM_SetTriggerOutput(kp_cap_timer, LL_TIM_TRGO_ENABLE);
+}
+
+void
+kp_cap_init(TIM_TypeDef* timer,
+	    const struct device *ch_gpio,
+	    const gpio_pin_t *ch_pin_list,
+	    const struct kp_cap_dbg_conf *dbg_conf)
+{
+	assert(!kp_cap_is_initialized());
+	assert(timer != NULL);
+	assert(ch_gpio != NULL);
+	assert(ch_pin_list != NULL);
+
+	/* Remember the timer we're using */
+	kp_cap_timer = timer;
+
+	/* Remember where to read the channel levels from */
+	kp_cap_ch_gpio = ch_gpio;
+	memcpy(kp_cap_ch_pin_list, ch_pin_list, sizeof(kp_cap_ch_pin_list));
+
+	/* Remember debug output configuration */
+	if (dbg_conf == NULL) {
+		kp_cap_dbg_conf.gpio = NULL;
+	} else {
+		memcpy(&kp_cap_dbg_conf, dbg_conf, sizeof(kp_cap_dbg_conf));
+	}
+
+	/* Configure the timer for capturing */
+	kp_cap_configure();
+
+	assert(kp_cap_is_initialized());
+}
+
+uint32_t
+kp_cap_pwm_get_jitter_us(const struct kp_cap_pwm *pwm)
+{
+	int64_t mean_dev_us;
+	uint64_t mean_dev_sq;
+
+	assert(pwm != NULL);
+
+	if (pwm->periods == 0) {
+		return 0;
+	}
+
+	/* Variance is the mean squared deviation minus the squared mean one */
+	mean_dev_us = ((int64_t)pwm->period_sum_us -
+		       (int64_t)pwm->period_first_us * (int64_t)pwm->periods) /
+		      (int64_t)pwm->periods;
+	mean_dev_sq = pwm->period_dev_sq_sum / pwm->periods;
+	if (mean_dev_sq < (uint64_t)(mean_dev_us * mean_dev_us)) {
+		return 0;
+	}
+	return kp_isqrt64(mean_dev_sq - (uint64_t)(mean_dev_us * mean_dev_us));
+}
+
+void
+kp_cap_pwm_start(size_t ch)
+{
+	const struct kp_cap_pwm_ch *pwm_ch;
+	k_spinlock_key_t key;
+
+	assert(kp_cap_is_initialized());
+	assert(ch < KP_CAP_CH_NUM);
+
+	pwm_ch = &kp_cap_pwm_ch_list[ch];
+
+	/* Wait for the capture to be available, and keep it */
+	k_sem_take(&kp_cap_available, K_FOREVER);
+
+	/* Lock the interrupt state */
+	key = k_spin_lock(&kp_cap_lock);
+
+	/* Reset the measurement state */
+	memset(&kp_cap_pwm, 0, sizeof(kp_cap_pwm));
+	kp_cap_pwm_wraps = 0;
+	kp_cap_pwm_got_rise = false;
+	kp_cap_pwm_got_fall = false;
+
+	/* Free-run at PWM resolution over the whole 16-bit range */
+	kp_cap_timer->DIER = 0;
+	LL_TIM_SetSlaveMode(kp_cap_timer, LL_TIM_SLAVEMODE_DISABLED);
+	LL_TIM_DisableCounter(kp_cap_timer);
+	LL_TIM_SetPrescaler(kp_cap_timer,
+			    k_us_to_cyc_floor32(KP_CAP_PWM_RES_US) - 1);
+	LL_TIM_GenerateEvent_UPDATE(kp_cap_timer);
+	LL_TIM_SetAutoReload(kp_cap_timer, UINT16_MAX);
+
+	/* Capture rises directly, and falls via the paired channel */
+	LL_TIM_IC_Config(kp_cap_timer, pwm_ch->rise_mask,
+			 LL_TIM_ACTIVEINPUT_DIRECTTI |
+			 LL_TIM_ICPSC_DIV1 |
+			 LL_TIM_IC_FILTER_FDIV1 |
+			 LL_TIM_IC_POLARITY_RISING);
+	LL_TIM_IC_Config(kp_cap_timer, pwm_ch->fall_mask,
+			 LL_TIM_ACTIVEINPUT_INDIRECTTI |
+			 LL_TIM_ICPSC_DIV1 |
+			 LL_TIM_IC_FILTER_FDIV1 |
+			 LL_TIM_IC_POLARITY_FALLING);
+	LL_TIM_CC_EnableChannel(kp_cap_timer, pwm_ch->rise_mask);
+	LL_TIM_CC_EnableChannel(kp_cap_timer, pwm_ch->fall_mask);
+
+	/* Start counting, and interrupting on overflows and captures */
+	kp_cap_pwm_ch = ch;
+	LL_TIM_SetCounter(kp_cap_timer, 0);
+	kp_cap_timer->SR = 0;
+	kp_cap_timer->DIER = TIM_SR_UIF |
+			     pwm_ch->rise_ccif_mask |
+			     pwm_ch->fall_ccif_mask;
+	LL_TIM_EnableCounter(kp_cap_timer);
+
+	/* Unlock the interrupt state */
+	k_spin_unlock(&kp_cap_lock, key);
+}
+
+void
+kp_cap_pwm_get(struct kp_cap_pwm *pwm)
+{
+	k_spinlock_key_t key;
+
+	assert(kp_cap_is_initialized());
+	assert(pwm != NULL);
+
+	key = k_spin_lock(&kp_cap_lock);
+	*pwm = kp_cap_pwm;
+	k_spin_unlock(&kp_cap_lock, key);
+}
+
+void
+kp_cap_pwm_stop(void)
+{
+	const struct kp_cap_pwm_ch *pwm_ch;
+	k_spinlock_key_t key;
 
 	assert(kp_cap_is_initialized());
+	assert(kp_cap_pwm_ch < KP_CAP_CH_NUM);
+
+	/* Lock the interrupt state */
+	key = k_spin_lock(&kp_cap_lock);
+
+	/* Stop counting and interrupting */
+	pwm_ch = &kp_cap_pwm_ch_list[kp_cap_pwm_ch];
+	kp_cap_pwm_ch = SIZE_MAX;
+	kp_cap_timer->DIER = 0;
+	LL_TIM_DisableCounter(kp_cap_timer);
+	LL_TIM_CC_DisableChannel(kp_cap_timer, pwm_ch->rise_mask);
+	LL_TIM_CC_DisableChannel(kp_cap_timer, pwm_ch->fall_mask);
+
+	/* Restore the capture configuration */
+	kp_cap_configure();
+	kp_cap_timer->SR = 0;
+
+	/* Unlock the interrupt state */
+	k_spin_unlock(&kp_cap_lock, key);
+
+	/* Make the capture available */
+	k_sem_give(&kp_cap_available);
+}
+
+void
+kp_cap_tl_start(const struct kp_cap_conf *conf)
+{
+	size_t i;
+	const struct kp_cap_ch_conf *ch_conf;
+	uint32_t ch_mask;
+	uint32_t ch_ccif_mask = 0;
+	k_spinlock_key_t key;
+
+	assert(kp_cap_is_initialized());
+	assert(kp_cap_conf_is_valid(conf));
+	assert(conf->trig == KP_CAP_TRIG_ACT);
+
+	/* Wait for the capture to be available, and keep it */
+	k_sem_take(&kp_cap_available, K_FOREVER);
+
+	/* Lock the interrupt state */
+	key = k_spin_lock(&kp_cap_lock);
+
+	/* Reset the timeline */
+	kp_cap_tl_conf = *conf;
+	kp_cap_tl_wraps = 0;
+	kp_cap_tl_seq = 0;
+	memset(kp_cap_tl_drop_list, 0, sizeof(kp_cap_tl_drop_list));
+	kp_cap_tl_trig_valid = false;
+
+	/* Free-run at capture resolution over the whole 16-bit range */
+	kp_cap_timer->DIER = 0;
+	LL_TIM_SetSlaveMode(kp_cap_timer, LL_TIM_SLAVEMODE_DISABLED);
+	LL_TIM_DisableCounter(kp_cap_timer);
+	LL_TIM_SetAutoReload(kp_cap_timer, UINT16_MAX);
+
+	/* Capture the trigger input, and the enabled channels */
+	LL_TIM_CC_EnableChannel(kp_cap_timer, LL_TIM_CHANNEL_CH1);
+	for (i = 0; i < KP_CAP_CH_NUM; i++) {
+		ch_mask = kp_cap_ch_mask_list[i];
+		ch_conf = &conf->ch_list[i];
+		if (ch_conf->dirs) {
+			ch_ccif_mask |= kp_cap_ch_ccif_mask_list[i];
+			LL_TIM_IC_Config(
+				kp_cap_timer, ch_mask,
+				LL_TIM_ACTIVEINPUT_DIRECTTI |
+				LL_TIM_ICPSC_DIV1 |
+				LL_TIM_IC_FILTER_FDIV1 |
+				(ch_conf->rising
+					? LL_TIM_IC_POLARITY_RISING
+					: LL_TIM_IC_POLARITY_FALLING)
+			);
+			LL_TIM_CC_EnableChannel(kp_cap_timer, ch_mask);
+		} else {
+			LL_TIM_CC_DisableChannel(kp_cap_timer, ch_mask);
+		}
+	}
+
+	/* Start counting, and interrupting on overflows and channel edges */
+	kp_cap_tl_running = true;
+	LL_TIM_SetCounter(kp_cap_timer, 0);
+	kp_cap_timer->SR = 0;
+	kp_cap_timer->DIER = TIM_SR_UIF | ch_ccif_mask;
+	LL_TIM_EnableCounter(kp_cap_timer);
+
+	/* Unlock the interrupt state */
+	k_spin_unlock(&kp_cap_lock, key);
+}
+
+bool
+kp_cap_tl_is_running(void)
+{
+	return kp_cap_tl_running;
+}
+
+bool
+kp_cap_tl_matches(const struct kp_cap_conf *conf)
+{
+	size_t i;
+	const struct kp_cap_ch_conf *ch_conf;
+	const struct kp_cap_ch_conf *tl_ch_conf;
+
+	assert(kp_cap_tl_is_running());
+	assert(kp_cap_conf_is_valid(conf));
+
+	for (i = 0; i < KP_CAP_CH_NUM; i++) {
+		ch_conf = &conf->ch_list[i];
+		tl_ch_conf = &kp_cap_tl_conf.ch_list[i];
+		if ((ch_conf->dirs != KP_CAP_DIRS_NONE) !=
+		    (tl_ch_conf->dirs != KP_CAP_DIRS_NONE) ||
+		    (ch_conf->dirs && ch_conf->rising != tl_ch_conf->rising)) {
+			return false;
+		}
+	}
+	return conf->trig == kp_cap_tl_conf.trig;
+}
+
+uint32_t
+kp_cap_tl_arm(void)
+{
+	uint32_t seq;
+	k_spinlock_key_t key;
+
+	assert(kp_cap_tl_is_running());
+
+	key = k_spin_lock(&kp_cap_lock);
+	/* Forget trigger edges captured while disarmed */
+	kp_cap_timer->SR = ~(TIM_SR_CC1IF | TIM_SR_CC1OF);
+	kp_cap_timer->DIER |= TIM_SR_CC1IF;
+	seq = kp_cap_tl_seq;
+	kp_cap_tl_trig_valid = false;
+	k_spin_unlock(&kp_cap_lock, key);
+
+	return seq;
+}
+
+/** Timeline channel edge summary of a pass */
+struct kp_cap_tl_ch {
+	/** Number of edges within the window */
+	uint32_t edges;
+	/**
+	 * True if edges were dropped from the ring, and so the earlier of
+	 * them, and their number, are unknown
+	 */
+	bool lost;
+	/** Time of the first edge after the trigger, ticks */
+	uint32_t first;
+	/** Time of the last edge after the trigger, ticks */
+	uint32_t last;
+};
+
+/**
+ * Check if a timeline event dropped from the ring came at, or after, a
+ * sequence number. Must be called with kp_cap_lock held.
+ *
+ * @param src	The source of the event.
+ * @param seq	The sequence number to check against.
+ *
+ * @return True if the source has a dropped event at, or after, the
+ *	   sequence number, false otherwise.
+ */
+static bool
+kp_cap_tl_dropped_since_locked(size_t src, uint32_t seq)
+{
+	const struct kp_cap_tl_drop *drop = &kp_cap_tl_drop_list[src];
+	return drop->valid && drop->seq - seq < (UINT32_MAX >> 1);
+}
+
+/**
+ * Summarize the timeline channel edges of a pass within a window after its
+ * trigger. Must be called with kp_cap_lock held. If the edges bounced so
+ * much, the ring dropped some of the pass events, take the trigger from
+ * the dropped events, and mark the channels with edges dropped within the
+ * window as lost, as the earlier of their edges, and their number, are
+ * unknown.
+ *
+ * @param seq		The sequence number of the first event of the pass.
+ * @param dirs		The directions of the pass.
+ * @param window	The window after the trigger to summarize, ticks.
+ * @param ptrig		Location for the (extended) trigger time, ticks.
+ *			Only set if the trigger was found.
+ * @param pnow		Location for the time since the trigger, ticks.
+ * @param ch_list	Location for the summaries of each channel.
+ *
+ * @return True if the pass trigger was found, false otherwise.
+ */
+static bool
+kp_cap_tl_scan_locked(uint32_t seq, enum kp_cap_dirs dirs, uint32_t window,
+		      uint32_t *ptrig, uint32_t *pnow,
+		      struct kp_cap_tl_ch *ch_list)
+{
+	const struct kp_cap_tl_event *event;
+	const struct kp_cap_tl_drop *drop;
+	bool got_trig = false;
+	uint32_t trig_seq = 0;
+	uint32_t trig = 0;
+	uint32_t time;
+	struct kp_cap_tl_ch *ch;
+	size_t i;
+
+	memset(ch_list, 0, sizeof(*ch_list) * KP_CAP_CH_NUM);
+
+	/* If the ring dropped some of the pass events */
+	if (kp_cap_tl_seq - seq > KP_CAP_TL_EVENT_NUM) {
+		/* Take the trigger from the dropped events, if it's there */
+		if (kp_cap_tl_dropped_since_locked(KP_CAP_TL_SRC_TRIG, seq)) {
+			drop = &kp_cap_tl_drop_list[KP_CAP_TL_SRC_TRIG];
+			got_trig = true;
+			trig_seq = drop->seq;
+			trig = drop->time;
+		}
+		/* Start the channels with edges dropped after the trigger */
+		for (i = 0; got_trig && i < KP_CAP_CH_NUM; i++) {
+			drop = &kp_cap_tl_drop_list[i];
+			if (!(kp_cap_tl_conf.ch_list[i].dirs & dirs) ||
+			    !kp_cap_tl_dropped_since_locked(i, trig_seq)) {
+				continue;
+			}
+			time = drop->time - trig;
+			if (time > window) {
+				continue;
+			}
+			ch = &ch_list[i];
+			ch->edges = 1;
+			ch->lost = true;
+			ch->first = time;
+			ch->last = time;
+		}
+		seq = kp_cap_tl_seq - KP_CAP_TL_EVENT_NUM;
+	}
+
+	for (; seq != kp_cap_tl_seq; seq++) {
+		event = &kp_cap_tl_event_list[seq % KP_CAP_TL_EVENT_NUM];
+		if (event->src == KP_CAP_TL_SRC_TRIG) {
+			got_trig = true;
+			trig = event->time;
+			continue;
+		}
+		if (!got_trig ||
+		    !(kp_cap_tl_conf.ch_list[event->src].dirs & dirs)) {
+			continue;
+		}
+		time = event->time - trig;
+		if (time > window) {
+			continue;
+		}
+		ch = &ch_list[event->src];
+		if (ch->edges == 0) {
+			ch->first = time;
+		}
+		ch->edges += 1 + event->over;
+		ch->last = time;
+	}
+
+	if (got_trig) {
+		*ptrig = trig;
+	}
+	*pnow = kp_cap_tl_extend_locked(kp_cap_timer->CNT,
+					kp_cap_timer->SR & TIM_SR_UIF) - trig;
+	return got_trig;
+}
+
+void
+kp_cap_tl_finish(const struct kp_cap_conf *conf,
+		 enum kp_cap_dirs dirs, uint32_t seq,
+		 struct kp_cap_ch_res *ch_res_list,
+		 size_t ch_res_num)
+{
+	struct kp_cap_tl_ch ch_list[KP_CAP_CH_NUM];
+	const uint32_t timeout_ticks = conf->timeout_us / KP_CAP_RES_US;
+	const uint32_t bounce_ticks = conf->bounce_us / KP_CAP_RES_US;
+	uint32_t window;
+	uint32_t captured;
+	uint32_t trig = 0;
+	uint32_t now;
+	bool got_trig;
+	bool all_captured;
+	enum kp_cap_ch_status status;
+	uint32_t value_us;
+	k_spinlock_key_t key;
+	size_t i;
+
+	assert(kp_cap_tl_is_running());
+	assert(kp_cap_tl_matches(conf));
+	assert(kp_cap_dirs_is_valid(dirs));
+	assert(ch_res_list != NULL || ch_res_num == 0);
+
+	/* Wait for the window to expire, shortening it like kp_cap_isr() */
+	while (true) {
+		window = timeout_ticks + bounce_ticks;
+		key = k_spin_lock(&kp_cap_lock);
+		got_trig = kp_cap_tl_scan_locked(seq, dirs, window,
+						 &trig, &now, ch_list);
+		/* Stop after the bounce time, once all channels are captured */
+		all_captured = true;
+		captured = 0;
+		for (i = 0; i < KP_CAP_CH_NUM; i++) {
+			if (!(conf->ch_list[i].dirs & dirs)) {
+				continue;
+			}
+			if (ch_list[i].edges == 0 ||
+			    ch_list[i].first >= timeout_ticks) {
+				all_captured = false;
+			}
+			captured = MAX(captured, ch_list[i].first);
+		}
+		if (all_captured) {
+			window = captured + bounce_ticks;
+			kp_cap_tl_scan_locked(seq, dirs, window,
+					      &trig, &now, ch_list);
+		}
+		k_spin_unlock(&kp_cap_lock, key);
+		if (!got_trig || now >= window) {
+			break;
+		}
+		k_sleep(K_USEC((window - now) * KP_CAP_RES_US));
+	}
+
+	/* Output the results of the channels enabled in the pass */
+	for (i = 0; i < KP_CAP_CH_NUM && ch_res_num > 0; i++) {
+		if (!(conf->ch_list[i].dirs & dirs)) {
+			continue;
+		}
+		if (!got_trig || ch_list[i].edges == 0) {
+			status = KP_CAP_CH_STATUS_TIMEOUT;
+			value_us = UINT32_MAX;
+		} else {
+			/* Like the capture register, keep the last edge */
+			value_us = ch_list[i].last * KP_CAP_RES_US;
+			status = ch_list[i].edges > 1 || ch_list[i].lost
+					? KP_CAP_CH_STATUS_OVERCAPTURE
+					: ch_list[i].last > timeout_ticks
+						? KP_CAP_CH_STATUS_TIMEOUT
+						: KP_CAP_CH_STATUS_OK;
+		}
+		ch_res_list->status = status;
+		ch_res_list->value_us = value_us;
+		ch_res_list++;
+		ch_res_num--;
+	}
+
+	/* Remember the pass trigger time */
+	key = k_spin_lock(&kp_cap_lock);
+	kp_cap_tl_trig_valid = got_trig;
+	kp_cap_tl_trig = trig;
+	k_spin_unlock(&kp_cap_lock, key);
+}
+
+bool
+kp_cap_tl_get_trig(uint64_t *ptime_us)
+{
+	bool valid;
+	k_spinlock_key_t key;
+
+	assert(kp_cap_tl_is_running());
+	assert(ptime_us != NULL);
+
+	key = k_spin_lock(&kp_cap_lock);
+	valid = kp_cap_tl_trig_valid;
+	if (valid) {
+		*ptime_us = (uint64_t)kp_cap_tl_trig * KP_CAP_RES_US;
+	}
+	/* Don't give it out again for a pass without one */
+	kp_cap_tl_trig_valid = false;
+	k_spin_unlock(&kp_cap_lock, key);
+	return valid;
+}
+
+void
+kp_cap_tl_stop(void)
+{
+	size_t i;
+	k_spinlock_key_t key;
+
+	assert(kp_cap_tl_is_running());
+
+	/* Lock the interrupt state */
+	key = k_spin_lock(&kp_cap_lock);
+
+	/* Stop counting and interrupting */
+	kp_cap_tl_running = false;
+	kp_cap_timer->DIER = 0;
+	LL_TIM_DisableCounter(kp_cap_timer);
+	for (i = 0; i < KP_CAP_CH_NUM; i++) {
+		LL_TIM_CC_DisableChannel(kp_cap_timer,
+					 kp_cap_ch_mask_list[i]);
+	}
+
+	/* Restore the capture configuration */
+	kp_cap_configure();
+	kp_cap_timer->SR = 0;
+
+	/* Unlock the interrupt state */
+	k_spin_unlock(&kp_cap_lock, key);
+
+	/* Make the capture available */
+	k_sem_give(&kp_cap_available);
 }
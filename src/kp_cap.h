@@ -252,6 +252,8 @@ enum kp_cap_ch_status {
 	KP_CAP_CH_STATUS_OK,
 	/** More than one capture event occurred */
 	KP_CAP_CH_STATUS_OVERCAPTURE,
+	/** The channel was at its post-trigger level already when armed */
+	KP_CAP_CH_STATUS_STUCK,
 	/** Number of statuses - not a valid status itself */
 	KP_CAP_CH_STATUS_NUM
 };
@@ -278,15 +280,31 @@ kp_cap_ch_status_is_valid(enum kp_cap_ch_status status)
  */
 extern const char *kp_cap_ch_status_to_str(enum kp_cap_ch_status status);
 
+/**
+ * Check if a channel status means the channel was captured, i.e. has a
+ * valid captured time value.
+ *
+ * @param status	The status to check.
+ *
+ * @return True if the channel was captured, false otherwise.
+ */
+static inline bool
+kp_cap_ch_status_is_captured(enum kp_cap_ch_status status)
+{
+	assert(kp_cap_ch_status_is_valid(status));
+	return status == KP_CAP_CH_STATUS_OK ||
+		status == KP_CAP_CH_STATUS_OVERCAPTURE;
+}
+
 /** Channel capture result */
 struct kp_cap_ch_res {
 	/** Capture status */
-	enum kp_cap_ch_status status:2;
+	enum kp_cap_ch_status status:3;
 	/**
 	 * Captured time value.
 	 * Only valid if status is OK or OVERCAPTURE.
 	 */
-	uint32_t value_us:30;
+	uint32_t value_us:29;
 };
 
 /**
@@ -325,13 +343,21 @@ struct kp_cap_dbg_conf {
  * Initialize the capturer.
  *
  * @param timer		The STM32 timer to use for capturing.
- * 			The timer's rising CH1 input will be used to start
- * 			counting, and the CH2-CH3 channels to capture events,
- * 			as configured when starting the capture.
+ * 			The timer's rising CH1 input, or its ETR input will be
+ * 			used to start counting, and the CH2-CH3 channels to
+ * 			capture events, as configured when starting the
+ * 			capture.
+ * @param ch_gpio	The GPIO port with the pins connected to the channel
+ *			inputs, to read their levels from when arming.
+ * @param ch_pin_list	The pins connected to each channel input, configured
+ *			as inputs. The array must have KP_CAP_CH_NUM
+ *			elements.
  * @param dbg_conf	Debug output configuration.
  *			NULL to have debugging output disabled.
  */
 extern void kp_cap_init(TIM_TypeDef* timer,
+			const struct device *ch_gpio,
+			const gpio_pin_t *ch_pin_list,
 			const struct kp_cap_dbg_conf *dbg_conf);
 
 /**
@@ -341,6 +367,55 @@ extern void kp_cap_init(TIM_TypeDef* timer,
  */
 extern bool kp_cap_is_initialized(void);
 
+/** Capture trigger sources */
+enum kp_cap_trig {
+	/** The actuator's movement (the timer's CH1 input) */
+	KP_CAP_TRIG_ACT = 0,
+	/**
+	 * An external stimulus (the timer's ETR input), without the
+	 * actuator. Captures "down" are triggered by its rising edges, and
+	 * captures "up" by its falling edges.
+	 */
+	KP_CAP_TRIG_EXT,
+	/** Number of trigger sources - not a valid source itself */
+	KP_CAP_TRIG_NUM
+};
+
+/**
+ * Check if a capture trigger source is valid.
+ *
+ * @param trig	The trigger source to check.
+ *
+ * @return True if the trigger source is valid, false otherwise.
+ */
+static inline bool
+kp_cap_trig_is_valid(enum kp_cap_trig trig)
+{
+	return trig >= 0 && trig < KP_CAP_TRIG_NUM;
+}
+
+/**
+ * Convert a string to a capture trigger source (regardless of case).
+ *
+ * @param str	The string to convert.
+ * @param ptrig	Location for the converted trigger source (if valid).
+ * 		Can be NULL to discard the converted trigger source.
+ *
+ * @return True if the string was valid and the trigger source was output,
+ *         False, if the string was invalid and the trigger source was not
+ *         output.
+ */
+extern bool kp_cap_trig_from_str(const char *str, enum kp_cap_trig *ptrig);
+
+/**
+ * Convert a capture trigger source to a lower-case string.
+ *
+ * @param trig	The trigger source to convert.
+ *
+ * @return The string representing the trigger source.
+ */
+extern const char *kp_cap_trig_to_lcstr(enum kp_cap_trig trig);
+
 /** Capture configuration */
 struct kp_cap_conf {
 	/** Channel configurations */
@@ -356,6 +431,8 @@ struct kp_cap_conf {
 	 * Must not be greater than KP_CAP_TIME_MAX_US - timeout_us.
 	 */
 	uint32_t bounce_us;
+	/** The source of the capture trigger */
+	enum kp_cap_trig trig;
 };
 
 /**
@@ -369,7 +446,36 @@ static inline bool
 kp_cap_conf_is_valid(const struct kp_cap_conf *conf)
 {
 	return conf != NULL &&
-	       (conf->timeout_us + conf->bounce_us) <= KP_CAP_TIME_MAX_US;
+	       (conf->timeout_us + conf->bounce_us) <= KP_CAP_TIME_MAX_US &&
+	       kp_cap_trig_is_valid(conf->trig);
+}
+
+/**
+ * Check if two capture configurations would capture the same way.
+ * Channel names are not compared.
+ *
+ * @param a	The first configuration to compare. Must be valid.
+ * @param b	The second configuration to compare. Must be valid.
+ *
+ * @return True if the configurations are equivalent, false otherwise.
+ */
+static inline bool
+kp_cap_conf_is_equal(const struct kp_cap_conf *a, const struct kp_cap_conf *b)
+{
+	size_t i;
+	assert(kp_cap_conf_is_valid(a));
+	assert(kp_cap_conf_is_valid(b));
+	if (a->timeout_us != b->timeout_us || a->bounce_us != b->bounce_us ||
+	    a->trig != b->trig) {
+		return false;
+	}
+	for (i = 0; i < ARRAY_SIZE(a->ch_list); i++) {
+		if (a->ch_list[i].dirs != b->ch_list[i].dirs ||
+		    a->ch_list[i].rising != b->ch_list[i].rising) {
+			return false;
+		}
+	}
+	return true;
 }
 
 /**
@@ -401,13 +507,34 @@ extern size_t kp_cap_conf_ch_res_idx(const struct kp_cap_conf *conf,
 				     size_t ch);
 
 /**
- * Start capture, waiting for the previous one to finish first.
+ * Start capture, waiting for the previous one to finish first. Channels
+ * found at their post-trigger level already are not armed, and are reported
+ * stuck right away. If all the channels are stuck, the capture finishes
+ * right after the trigger (and the bounce time).
  *
  * @param conf	Capture configuration to use.
  * @param dirs	The movement directions the capture is happening in.
  */
 extern void kp_cap_start(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs);
 
+/**
+ * Reserve the capture, waiting for the previous one to finish first, to arm
+ * it later with kp_cap_arm(). A reserved capture can be aborted with
+ * kp_cap_abort() and finished with kp_cap_finish() before it's armed.
+ */
+extern void kp_cap_reserve(void);
+
+/**
+ * Arm a capture reserved with kp_cap_reserve() for the trigger, the same as
+ * kp_cap_start() would, unless it was aborted in the meantime. Doesn't
+ * block, and so can be called with other spinlocks held, e.g. by the
+ * actuator right before the first step of a move.
+ *
+ * @param conf	Capture configuration to use.
+ * @param dirs	The movement directions the capture is happening in.
+ */
+extern void kp_cap_arm(const struct kp_cap_conf *conf, enum kp_cap_dirs dirs);
+
 /**
  * Initialize a poll event to wait for finished captures.
  *
@@ -474,6 +601,146 @@ extern bool kp_cap_abort(void);
 extern enum kp_cap_rc kp_cap_finish(struct kp_cap_ch_res *ch_res_list,
 				    size_t ch_res_num, k_timeout_t timeout);
 
+/** PWM input measurement resolution, microseconds */
+#define KP_CAP_PWM_RES_US	1
+
+/** PWM input (periodic signal) measurement statistics */
+struct kp_cap_pwm {
+	/** Number of periods measured */
+	size_t periods;
+	/** Number of periods missed, because they were too short to handle */
+	size_t missed;
+	/** The first measured period, us, the reference for jitter */
+	uint32_t period_first_us;
+	/** Minimum period, us */
+	uint32_t period_min_us;
+	/** Maximum period, us */
+	uint32_t period_max_us;
+	/** Sum of all periods, us */
+	uint64_t period_sum_us;
+	/** Sum of squared period deviations from the first one, us^2 */
+	uint64_t period_dev_sq_sum;
+	/** Number of high (rising-to-falling) times measured */
+	size_t highs;
+	/** Minimum high time, us */
+	uint32_t high_min_us;
+	/** Maximum high time, us */
+	uint32_t high_max_us;
+	/** Sum of all high times, us */
+	uint64_t high_sum_us;
+};
+
+/**
+ * Calculate the RMS jitter (standard deviation) of the measured periods.
+ *
+ * @param pwm	The PWM input measurement statistics.
+ *
+ * @return The period jitter, us.
+ */
+extern uint32_t kp_cap_pwm_get_jitter_us(const struct kp_cap_pwm *pwm);
+
+/**
+ * Start measuring the period and the high time of a periodic signal on a
+ * capture channel continuously, waiting for the current capture to finish
+ * first. Captures cannot be started until the measurement is stopped.
+ *
+ * @param ch	The index of the channel to measure.
+ */
+extern void kp_cap_pwm_start(size_t ch);
+
+/**
+ * Retrieve the statistics of the running PWM input measurement.
+ *
+ * @param pwm	Location for the statistics.
+ */
+extern void kp_cap_pwm_get(struct kp_cap_pwm *pwm);
+
+/**
+ * Stop the running PWM input measurement, and make captures available.
+ */
+extern void kp_cap_pwm_stop(void);
+
+/**
+ * Start running the capture timer freely, timestamping the trigger input
+ * edges (once armed, see kp_cap_tl_arm()), and the edges of the channels
+ * enabled in a configuration (in any direction) on one extended (32-bit)
+ * timeline, waiting for the current capture to finish first. Captures
+ * cannot be started until the timeline is stopped, use kp_cap_tl_arm() and
+ * kp_cap_tl_finish() instead. Only the actuator trigger is supported.
+ *
+ * @param conf	The capture configuration with the channels to timestamp,
+ *		and their edges. Must be valid and use the actuator trigger.
+ */
+extern void kp_cap_tl_start(const struct kp_cap_conf *conf);
+
+/**
+ * Check if the capture timeline is running.
+ *
+ * @return True if the timeline is running, false otherwise.
+ */
+extern bool kp_cap_tl_is_running(void);
+
+/**
+ * Check if the running capture timeline timestamps the same channels, and
+ * their edges, as enabled in a configuration.
+ *
+ * @param conf	The capture configuration to check. Must be valid.
+ *
+ * @return True if the timeline matches the configuration, false otherwise.
+ */
+extern bool kp_cap_tl_matches(const struct kp_cap_conf *conf);
+
+/**
+ * Arm the running capture timeline to timestamp the next trigger input edge,
+ * marking the start of a pass.
+ *
+ * @return The timeline sequence number of the next event, to pass to
+ *	   kp_cap_tl_finish().
+ */
+extern uint32_t kp_cap_tl_arm(void);
+
+/**
+ * Retrieve the results of a pass from the running capture timeline, the
+ * same as kp_cap_finish() would for a capture started with the same
+ * configuration and directions, waiting for the capture window after the
+ * pass trigger to expire first. Output timeouts for all channels, if the
+ * trigger didn't arrive. Output overcaptures for the channels which had
+ * their earlier edges dropped, because the pass produced more edges than
+ * the timeline can keep.
+ *
+ * @param conf		The capture configuration of the pass.
+ *			Must be valid and match the timeline.
+ * @param dirs		The directions of the pass.
+ * @param seq		The sequence number returned by kp_cap_tl_arm() at
+ *			the start of the pass.
+ * @param ch_res_list	List of structures for channel capture results. Can
+ * 			be NULL if ch_res_num is zero.
+ * @param ch_res_num	Maximum number of channels to retrieve results for.
+ */
+extern void kp_cap_tl_finish(const struct kp_cap_conf *conf,
+			     enum kp_cap_dirs dirs, uint32_t seq,
+			     struct kp_cap_ch_res *ch_res_list,
+			     size_t ch_res_num);
+
+/**
+ * Retrieve, and forget, the trigger time of the pass last finished on the
+ * running capture timeline, since the timeline start, to time the passes
+ * against each other.
+ *
+ * @param ptime_us	Location for the trigger time, us.
+ *			Not modified if the trigger time is unknown.
+ *
+ * @return True if the pass got its trigger, and its time was output,
+ *	   false if not, if the pass was armed, but not finished, or if the
+ *	   time was already retrieved.
+ */
+extern bool kp_cap_tl_get_trig(uint64_t *ptime_us);
+
+/**
+ * Stop the running capture timeline, and make captures available.
+ */
+extern void kp_cap_tl_stop(void);
+
 #ifdef __cplusplus
 }
 #endif
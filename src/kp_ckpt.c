@@ -0,0 +1,83 @@
+/** @file
+ *  @brief Keypecker checkpoint storage
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_ckpt.h"
+#include <zephyr/fs/nvs.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/drivers/flash.h>
+#include <assert.h>
+
+/** The flash partition storing the checkpoints */
+#define KP_CKPT_PARTITION	storage_partition
+
+/** The NVS file system storing the checkpoints */
+static struct nvs_fs kp_ckpt_fs;
+
+/** True if the checkpoint storage is initialized */
+static bool kp_ckpt_initialized;
+
+bool
+kp_ckpt_is_initialized(void)
+{
+	return kp_ckpt_initialized;
+}
+
+bool
+kp_ckpt_init(void)
+{
+	struct flash_pages_info info;
+
+	assert(!kp_ckpt_is_initialized());
+
+	kp_ckpt_fs.flash_device = FIXED_PARTITION_DEVICE(KP_CKPT_PARTITION);
+	if (!device_is_ready(kp_ckpt_fs.flash_device)) {
+		return false;
+	}
+	kp_ckpt_fs.offset = FIXED_PARTITION_OFFSET(KP_CKPT_PARTITION);
+	if (flash_get_page_info_by_offs(kp_ckpt_fs.flash_device,
+					kp_ckpt_fs.offset, &info) != 0) {
+		return false;
+	}
+	kp_ckpt_fs.sector_size = info.size;
+	kp_ckpt_fs.sector_count =
+		FIXED_PARTITION_SIZE(KP_CKPT_PARTITION) / info.size;
+	if (nvs_mount(&kp_ckpt_fs) != 0) {
+		return false;
+	}
+
+	kp_ckpt_initialized = true;
+	assert(kp_ckpt_is_initialized());
+	return true;
+}
+
+bool
+kp_ckpt_save(enum kp_ckpt_id id, const void *data, size_t len)
+{
+	assert(kp_ckpt_is_initialized());
+	assert(data != NULL || len == 0);
+	/* NOTE: Returns zero if identical data is already stored */
+	return nvs_write(&kp_ckpt_fs, id, data, len) >= 0;
+}
+
+bool
+kp_ckpt_load(enum kp_ckpt_id id, void *data, size_t len)
+{
+	assert(kp_ckpt_is_initialized());
+	assert(data != NULL || len == 0);
+	/* NOTE: Returns the stored length, even if reading less */
+	return nvs_read(&kp_ckpt_fs, id, data, len) == (ssize_t)len;
+}
+
+void
+kp_ckpt_erase(enum kp_ckpt_id id)
+{
+	assert(kp_ckpt_is_initialized());
+	nvs_delete(&kp_ckpt_fs, id);
+}
@@ -0,0 +1,95 @@
+/** @file
+ *  @brief Keypecker checkpoint storage
+ *
+ *  Checkpoints are records stored in the "storage" flash partition with the
+ *  Non-Volatile Storage (NVS) subsystem, which appends records and spreads
+ *  erases over the partition's sectors. Storing a record identical to the
+ *  one already stored doesn't write the flash.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_CKPT_H_
+#define KP_CKPT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Checkpoint record identifiers */
+enum kp_ckpt_id {
+	/** Endurance run configuration */
+	KP_CKPT_ID_ENDURE_CONF = 1,
+	/** Endurance run statistics */
+	KP_CKPT_ID_ENDURE_STATS,
+	/** Baseline micro-benchmark results */
+	KP_CKPT_ID_BENCH_BASE,
+	/** Summary sketch header */
+	KP_CKPT_ID_SKETCH_HEAD,
+	/**
+	 * Summary sketch of the first channel going up, followed by the
+	 * identifiers of the rest of the channel sketches, in memory order.
+	 * Must stay the last identifier.
+	 */
+	KP_CKPT_ID_SKETCH_CH,
+};
+
+/**
+ * Check if the checkpoint storage is initialized.
+ *
+ * @return True if the storage is initialized, false otherwise.
+ */
+extern bool kp_ckpt_is_initialized(void);
+
+/**
+ * Initialize the checkpoint storage, mounting the flash partition.
+ *
+ * @return True if the storage was initialized, false if the partition
+ *	   couldn't be mounted.
+ */
+extern bool kp_ckpt_init(void);
+
+/**
+ * Store a checkpoint record, replacing the previous one with the same
+ * identifier.
+ *
+ * @param id	The identifier of the record to store.
+ * @param data	The data of the record to store.
+ * @param len	The length of the data to store.
+ *
+ * @return True if the record was stored, false otherwise.
+ */
+extern bool kp_ckpt_save(enum kp_ckpt_id id, const void *data, size_t len);
+
+/**
+ * Retrieve a checkpoint record.
+ *
+ * @param id	The identifier of the record to retrieve.
+ * @param data	The location for the data of the record.
+ * @param len	The length of the data to retrieve. The record must have
+ *		exactly this length to be retrieved.
+ *
+ * @return True if the record was retrieved, false if it wasn't found, or
+ *	   had a different length.
+ */
+extern bool kp_ckpt_load(enum kp_ckpt_id id, void *data, size_t len);
+
+/**
+ * Remove a checkpoint record, if stored.
+ *
+ * @param id	The identifier of the record to remove.
+ */
+extern void kp_ckpt_erase(enum kp_ckpt_id id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_CKPT_H_ */
@@ -0,0 +1,290 @@
+/** @file
+ *  @brief Keypecker debounce algorithm emulator
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_dbnc.h"
+#include "kp_scope.h"
+#include "kp_misc.h"
+#include <zephyr/kernel.h>
+
+/** Algorithm names, indexed by algorithm */
+static const char *kp_dbnc_algo_names[KP_DBNC_ALGO_NUM] = {
+	[KP_DBNC_ALGO_EAGER] = "eager",
+	[KP_DBNC_ALGO_DEFER] = "defer",
+	[KP_DBNC_ALGO_INTEGRATE] = "integ",
+	[KP_DBNC_ALGO_ASYM] = "asym",
+};
+
+/** True if the emulator is initialized */
+static bool kp_dbnc_initialized;
+
+/** The pins the channel inputs are on */
+static gpio_pin_t kp_dbnc_pin_list[KP_CAP_CH_NUM];
+
+/** The current configuration */
+static struct kp_dbnc_conf kp_dbnc_conf = {
+	.period_us = KP_DBNC_PERIOD_US_DEF,
+};
+
+/** True if a pass is being emulated */
+static bool kp_dbnc_pass_started;
+
+const char *
+kp_dbnc_algo_to_lcstr(enum kp_dbnc_algo algo)
+{
+	assert(kp_dbnc_algo_is_valid(algo));
+	return kp_dbnc_algo_names[algo];
+}
+
+bool
+kp_dbnc_algo_from_str(const char *str, enum kp_dbnc_algo *palgo)
+{
+	enum kp_dbnc_algo algo;
+
+	assert(str != NULL);
+
+	for (algo = 0; algo < KP_DBNC_ALGO_NUM; algo++) {
+		if (kp_strcasecmp(str, kp_dbnc_algo_names[algo]) == 0) {
+			if (palgo != NULL) {
+				*palgo = algo;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+kp_dbnc_conf_is_valid(const struct kp_dbnc_conf *conf)
+{
+	size_t i;
+
+	if (conf == NULL ||
+	    !kp_scope_period_is_valid(conf->period_us) ||
+	    conf->model_num > ARRAY_SIZE(conf->model_list)) {
+		return false;
+	}
+	for (i = 0; i < conf->model_num; i++) {
+		if (!kp_dbnc_algo_is_valid(conf->model_list[i].algo)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+kp_dbnc_stats_init(struct kp_dbnc_stats *stats)
+{
+	assert(stats != NULL);
+	memset(stats, 0, sizeof(*stats));
+	stats->conf = kp_dbnc_conf;
+}
+
+bool
+kp_dbnc_is_initialized(void)
+{
+	return kp_dbnc_initialized;
+}
+
+void
+kp_dbnc_init(const gpio_pin_t *pin_list)
+{
+	assert(!kp_dbnc_is_initialized());
+	assert(kp_scope_is_initialized());
+	assert(pin_list != NULL);
+
+	memcpy(kp_dbnc_pin_list, pin_list, sizeof(kp_dbnc_pin_list));
+	kp_dbnc_initialized = true;
+
+	assert(kp_dbnc_is_initialized());
+}
+
+void
+kp_dbnc_set_conf(const struct kp_dbnc_conf *conf)
+{
+	assert(kp_dbnc_conf_is_valid(conf));
+	kp_dbnc_conf = *conf;
+}
+
+void
+kp_dbnc_get_conf(struct kp_dbnc_conf *conf)
+{
+	assert(conf != NULL);
+	*conf = kp_dbnc_conf;
+}
+
+void
+kp_dbnc_pass_start(const struct kp_dbnc_stats *stats)
+{
+	assert(kp_dbnc_is_initialized());
+	assert(stats != NULL);
+	assert(kp_dbnc_conf_is_valid(&stats->conf));
+
+	/* The scope starts with the timer, which never stops on a timeline */
+	if (stats->conf.model_num == 0 || kp_cap_tl_is_running()) {
+		return;
+	}
+
+	kp_scope_arm(stats->conf.period_us);
+	kp_dbnc_pass_started = true;
+}
+
+/**
+ * Run a debounce model over the samples of a channel taken in a pass.
+ *
+ * @param model		The model to run.
+ * @param period_us	The sampling period, us.
+ * @param sample_list	The list of samples to run over.
+ * @param sample_num	The number of samples in the list.
+ * @param pin		The pin the channel input is on.
+ * @param rising	True if the channel's post-trigger level is high,
+ *			false if low.
+ * @param pfirst_us	Location for the time of the first output event,
+ *			us. Not modified, if there were no events.
+ *
+ * @return The number of output events, i.e. changes of the model's output
+ *	   to the post-trigger level.
+ */
+static uint32_t
+kp_dbnc_model_run(const struct kp_dbnc_model *model, uint32_t period_us,
+		  const uint16_t *sample_list, size_t sample_num,
+		  gpio_pin_t pin, bool rising, uint32_t *pfirst_us)
+{
+	/* The debounce time in samples, at least one */
+	const uint32_t time = MAX(model->time_us / period_us, 1);
+	/* The model's output, true if at the post-trigger level */
+	bool output = false;
+	bool next;
+	bool input;
+	bool prev_input = false;
+	/* Number of samples the input stayed unchanged for */
+	uint32_t stable = 0;
+	/* The lockout, or the integrator counter */
+	uint32_t count = 0;
+	uint32_t events = 0;
+	size_t i;
+
+	assert(kp_dbnc_algo_is_valid(model->algo));
+	assert(sample_list != NULL || sample_num == 0);
+	assert(pfirst_us != NULL);
+
+	for (i = 0; i < sample_num; i++) {
+		input = ((sample_list[i] & BIT(pin)) != 0) == rising;
+		stable = (input == prev_input) ? stable + 1 : 1;
+		prev_input = input;
+		next = output;
+		switch (model->algo) {
+		case KP_DBNC_ALGO_EAGER:
+			if (count > 0) {
+				count--;
+			} else if (input != output) {
+				next = input;
+				count = time;
+			}
+			break;
+		case KP_DBNC_ALGO_DEFER:
+			if (input != output && stable >= time) {
+				next = input;
+			}
+			break;
+		case KP_DBNC_ALGO_INTEGRATE:
+			if (input) {
+				count = MIN(count + 1, time);
+			} else if (count > 0) {
+				count--;
+			}
+			if (count == time) {
+				next = true;
+			} else if (count == 0) {
+				next = false;
+			}
+			break;
+		default:
+			if (input && !output) {
+				next = true;
+			} else if (!input && output && stable >= time) {
+				next = false;
+			}
+			break;
+		}
+		/* Sample N is taken after N + 1 periods */
+		if (next && !output && events++ == 0) {
+			*pfirst_us = (uint32_t)(i + 1) * period_us;
+		}
+		output = next;
+	}
+
+	return events;
+}
+
+void
+kp_dbnc_pass_finish(struct kp_dbnc_stats *stats,
+		    const struct kp_cap_conf *conf,
+		    enum kp_cap_dirs dirs)
+{
+	const uint16_t *sample_list;
+	size_t sample_num;
+	size_t model, ch;
+	struct kp_dbnc_ch_stats *ch_stats;
+	uint32_t events;
+	uint32_t first_us;
+
+	assert(kp_dbnc_is_initialized());
+	assert(kp_cap_conf_is_valid(conf));
+	assert(kp_cap_dirs_is_valid(dirs));
+
+	if (!kp_dbnc_pass_started) {
+		return;
+	}
+	kp_dbnc_pass_started = false;
+	sample_num = kp_scope_disarm();
+	if (stats == NULL) {
+		return;
+	}
+	sample_list = kp_scope_get_sample_list();
+
+	/* Count the passes outlasting the samples, missing later events */
+	if (sample_num >= KP_SCOPE_SAMPLE_NUM) {
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (conf->ch_list[ch].dirs & dirs) {
+				stats->cut_list[ch]++;
+			}
+		}
+	}
+
+	for (model = 0; model < stats->conf.model_num; model++) {
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (!(conf->ch_list[ch].dirs & dirs)) {
+				continue;
+			}
+			ch_stats = &stats->ch_list[model][ch];
+			ch_stats->passes++;
+			events = kp_dbnc_model_run(
+				&stats->conf.model_list[model],
+				stats->conf.period_us,
+				sample_list, sample_num,
+				kp_dbnc_pin_list[ch],
+				conf->ch_list[ch].rising,
+				&first_us
+			);
+			if (events == 0) {
+				continue;
+			}
+			if (ch_stats->events == 0) {
+				ch_stats->min_us = first_us;
+				ch_stats->max_us = first_us;
+			}
+			ch_stats->events++;
+			ch_stats->spurious += events - 1;
+			ch_stats->min_us = MIN(ch_stats->min_us, first_us);
+			ch_stats->max_us = MAX(ch_stats->max_us, first_us);
+			ch_stats->sum_us += first_us;
+		}
+	}
+}
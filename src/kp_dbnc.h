@@ -0,0 +1,206 @@
+/** @file
+ *  @brief Keypecker debounce algorithm emulator
+ *
+ *  The emulator samples the channel inputs with the scope during
+ *  measurement passes, runs a set of debounce algorithm models over the
+ *  sampled bounce trains, and accumulates the latency of each model's first
+ *  output event (the post-trigger level), and the number of extra
+ *  (spurious) events it produced.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_DBNC_H_
+#define KP_DBNC_H_
+
+#include "kp_cap.h"
+#include <zephyr/drivers/gpio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Debounce algorithms */
+enum kp_dbnc_algo {
+	/** Follow the first change, then ignore input for the time */
+	KP_DBNC_ALGO_EAGER,
+	/** Follow the input once it stays unchanged for the time */
+	KP_DBNC_ALGO_DEFER,
+	/** Count samples up/down, follow when saturated at the time worth */
+	KP_DBNC_ALGO_INTEGRATE,
+	/** Follow the press (post-trigger level) eagerly, release deferred */
+	KP_DBNC_ALGO_ASYM,
+	/** Number of algorithms (not an algorithm itself) */
+	KP_DBNC_ALGO_NUM
+};
+
+/**
+ * Check if a debounce algorithm is valid.
+ *
+ * @param algo	The algorithm to check.
+ *
+ * @return True if the algorithm is valid, false otherwise.
+ */
+static inline bool
+kp_dbnc_algo_is_valid(enum kp_dbnc_algo algo)
+{
+	return algo >= 0 && algo < KP_DBNC_ALGO_NUM;
+}
+
+/**
+ * Convert a debounce algorithm to a lowercase string.
+ *
+ * @param algo	The algorithm to convert. Must be valid.
+ *
+ * @return The string representing the algorithm.
+ */
+extern const char *kp_dbnc_algo_to_lcstr(enum kp_dbnc_algo algo);
+
+/**
+ * Convert a string to a debounce algorithm, case-insensitively.
+ *
+ * @param str	The string to convert.
+ * @param palgo	Location for the converted algorithm.
+ *		Not modified in case of failure. Can be NULL.
+ *
+ * @return True if the string was converted successfully, false otherwise.
+ */
+extern bool kp_dbnc_algo_from_str(const char *str,
+				  enum kp_dbnc_algo *palgo);
+
+/** Maximum number of emulated debounce models */
+#define KP_DBNC_MODEL_MAX	4
+
+/** Default sampling period, us, covering about 100ms of a pass */
+#define KP_DBNC_PERIOD_US_DEF	100
+
+/** A debounce algorithm model */
+struct kp_dbnc_model {
+	/** The algorithm */
+	enum kp_dbnc_algo algo;
+	/** The debounce time, us */
+	uint32_t time_us;
+};
+
+/** Debounce emulator configuration */
+struct kp_dbnc_conf {
+	/** The sampling period, us */
+	uint32_t period_us;
+	/** Number of models to emulate, zero to disable the emulator */
+	size_t model_num;
+	/** The models to emulate */
+	struct kp_dbnc_model model_list[KP_DBNC_MODEL_MAX];
+};
+
+/**
+ * Check if a debounce emulator configuration is valid.
+ *
+ * @param conf	The configuration to check.
+ *
+ * @return True if the configuration is valid, false otherwise.
+ */
+extern bool kp_dbnc_conf_is_valid(const struct kp_dbnc_conf *conf);
+
+/** Debounce model statistics of a channel */
+struct kp_dbnc_ch_stats {
+	/** Number of passes the channel was emulated in */
+	uint32_t passes;
+	/** Number of passes the model produced an event in */
+	uint32_t events;
+	/** Number of events beyond the first in a pass */
+	uint32_t spurious;
+	/** Minimum first event latency, us, only valid if events != 0 */
+	uint32_t min_us;
+	/** Maximum first event latency, us, only valid if events != 0 */
+	uint32_t max_us;
+	/** Sum of first event latencies, us */
+	uint64_t sum_us;
+};
+
+/** Debounce emulator statistics */
+struct kp_dbnc_stats {
+	/** The configuration the statistics are accumulated with */
+	struct kp_dbnc_conf conf;
+	/** Statistics of each model for each channel */
+	struct kp_dbnc_ch_stats ch_list[KP_DBNC_MODEL_MAX][KP_CAP_CH_NUM];
+	/**
+	 * Number of passes each channel was emulated in, where the samples
+	 * ran out before the pass capture finished, and so any later events
+	 * were missed
+	 */
+	uint32_t cut_list[KP_CAP_CH_NUM];
+};
+
+/**
+ * Initialize debounce emulator statistics with the current configuration.
+ *
+ * @param stats	The statistics to initialize.
+ */
+extern void kp_dbnc_stats_init(struct kp_dbnc_stats *stats);
+
+/**
+ * Check if the debounce emulator is initialized.
+ *
+ * @return True if the emulator is initialized, false otherwise.
+ */
+extern bool kp_dbnc_is_initialized(void);
+
+/**
+ * Initialize the debounce emulator. The scope must be initialized, and
+ * sample the port the channel inputs are on.
+ *
+ * @param pin_list	The list of KP_CAP_CH_NUM pins the channel inputs
+ *			are on.
+ */
+extern void kp_dbnc_init(const gpio_pin_t *pin_list);
+
+/**
+ * Set the debounce emulator configuration for the measurements initialized
+ * afterwards.
+ *
+ * @param conf	The configuration to set. Must be valid.
+ */
+extern void kp_dbnc_set_conf(const struct kp_dbnc_conf *conf);
+
+/**
+ * Get the current debounce emulator configuration.
+ *
+ * @param conf	Location for the configuration.
+ */
+extern void kp_dbnc_get_conf(struct kp_dbnc_conf *conf);
+
+/**
+ * Start emulating a pass with statistics' configuration, if it has models.
+ * Must be called right before the pass is sampled, as the sampling starts
+ * with the next capture trigger.
+ *
+ * @param stats	The statistics to take the configuration from.
+ */
+extern void kp_dbnc_pass_start(const struct kp_dbnc_stats *stats);
+
+/**
+ * Finish emulating a pass, if started, and add the results of the channels
+ * enabled in the pass to statistics, counting the pass as cut short for
+ * them, if the samples ran out before the pass finished.
+ *
+ * @param stats	The statistics to add the pass to, or NULL to discard it.
+ * @param conf	The capture configuration of the pass. Must be valid.
+ * @param dirs	The direction of the pass.
+ */
+extern void kp_dbnc_pass_finish(struct kp_dbnc_stats *stats,
+				const struct kp_cap_conf *conf,
+				enum kp_cap_dirs dirs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_DBNC_H_ */
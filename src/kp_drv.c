@@ -0,0 +1,654 @@
+/** @file
+ *  @brief Keypecker actuator stepper driver backend
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_drv.h"
+#include "kp_misc.h"
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/kernel.h>
+#include <string.h>
+
+/** The UART datagram synchronization byte */
+#define KP_DRV_SYNC		0x05
+
+/** The node address of the driver (MS1 and MS2 pulled low) */
+#define KP_DRV_NODE_ADDR	0x00
+
+/** The node address of the master, used in read replies */
+#define KP_DRV_MASTER_ADDR	0xff
+
+/** The register address bit marking a write access */
+#define KP_DRV_REG_WRITE	0x80
+
+/** Size of a write datagram, and of a read reply, bytes */
+#define KP_DRV_WRITE_SIZE	8
+
+/** Size of a read request datagram, bytes */
+#define KP_DRV_READ_SIZE	4
+
+/** Maximum time to wait for a received byte, us */
+#define KP_DRV_UART_TIMEOUT_US	2000
+
+/*
+ * Driver registers
+ */
+/** Global configuration flags */
+#define KP_DRV_REG_GCONF	0x00
+/** Successful write counter */
+#define KP_DRV_REG_IFCNT	0x02
+/** Run and hold currents */
+#define KP_DRV_REG_IHOLD_IRUN	0x10
+/** Lower velocity threshold for StallGuard output (upper TSTEP) */
+#define KP_DRV_REG_TCOOLTHRS	0x14
+/** StallGuard threshold */
+#define KP_DRV_REG_SGTHRS	0x40
+/** StallGuard load measurement */
+#define KP_DRV_REG_SG_RESULT	0x41
+/** Chopper configuration, including microstep resolution */
+#define KP_DRV_REG_CHOPCONF	0x6c
+
+/*
+ * Register fields
+ */
+/** GCONF: use VREF for current scaling */
+#define KP_DRV_GCONF_I_SCALE_ANALOG	BIT(0)
+/** GCONF: PDN_UART is UART only, not power-down control */
+#define KP_DRV_GCONF_PDN_DISABLE	BIT(6)
+/** GCONF: microstep resolution comes from CHOPCONF, not MS1/MS2 */
+#define KP_DRV_GCONF_MSTEP_REG_SELECT	BIT(7)
+/** GCONF: filter STEP pulses */
+#define KP_DRV_GCONF_MULTISTEP_FILT	BIT(8)
+/** CHOPCONF: microstep resolution field shift */
+#define KP_DRV_CHOPCONF_MRES_SHIFT	24
+/** CHOPCONF: microstep resolution field mask */
+#define KP_DRV_CHOPCONF_MRES_MASK	(0xfUL << KP_DRV_CHOPCONF_MRES_SHIFT)
+/** CHOPCONF: reset default */
+#define KP_DRV_CHOPCONF_DEF		0x10000053
+/** IHOLD_IRUN: hold current field shift */
+#define KP_DRV_IHOLD_SHIFT		0
+/** IHOLD_IRUN: run current field shift */
+#define KP_DRV_IRUN_SHIFT		8
+/** IHOLD_IRUN: power-down delay field shift */
+#define KP_DRV_IHOLDDELAY_SHIFT		16
+/** IHOLD_IRUN: power-down delay, in 2^18 clocks */
+#define KP_DRV_IHOLDDELAY		8
+/** TCOOLTHRS: the value enabling StallGuard output at all velocities */
+#define KP_DRV_TCOOLTHRS_ALL		0xfffff
+
+/** Simulated motor load measurement when moving freely */
+#define KP_DRV_SIM_LOAD_FREE		300
+
+/** Default distance to the simulated hard stop above the start, steps */
+#define KP_DRV_SIM_STOP_DEF		1000
+
+/** Type names, indexed by type */
+static const char *kp_drv_type_names[KP_DRV_TYPE_NUM] = {
+	[KP_DRV_TYPE_PLAIN] = "plain",
+	[KP_DRV_TYPE_TMC] = "tmc",
+	[KP_DRV_TYPE_SIM] = "sim",
+};
+
+/** True if the driver backend is initialized */
+static bool kp_drv_initialized;
+
+/** The UART device connected to the driver, NULL if none */
+static const struct device *kp_drv_uart;
+
+/** The GPIO port device the DIAG output is connected to */
+static const struct device *kp_drv_diag_gpio;
+
+/** The DIAG pin */
+static gpio_pin_t kp_drv_diag_pin;
+
+/** The current driver type */
+static enum kp_drv_type kp_drv_type = KP_DRV_TYPE_PLAIN;
+
+/** The current driver configuration */
+static struct kp_drv_conf kp_drv_conf;
+
+/*
+ * Simulated driver state
+ */
+
+/** A simulated driver register */
+struct kp_drv_sim_reg {
+	/** The register address */
+	uint8_t addr;
+	/** The register value */
+	uint32_t value;
+};
+
+/** The simulated registers, the unlisted ones read as zero */
+static struct kp_drv_sim_reg kp_drv_sim_reg_list[] = {
+	{.addr = KP_DRV_REG_GCONF},
+	{.addr = KP_DRV_REG_IFCNT},
+	{.addr = KP_DRV_REG_IHOLD_IRUN},
+	{.addr = KP_DRV_REG_TCOOLTHRS},
+	{.addr = KP_DRV_REG_SGTHRS},
+	{.addr = KP_DRV_REG_SG_RESULT},
+	{.addr = KP_DRV_REG_CHOPCONF, .value = KP_DRV_CHOPCONF_DEF},
+};
+
+/** The simulated motor position, steps */
+static int32_t kp_drv_sim_pos;
+
+/** The simulated hard stop position, steps */
+static int32_t kp_drv_sim_stop = -KP_DRV_SIM_STOP_DEF;
+
+const char *
+kp_drv_type_to_lcstr(enum kp_drv_type type)
+{
+	assert(kp_drv_type_is_valid(type));
+	return kp_drv_type_names[type];
+}
+
+bool
+kp_drv_type_from_str(const char *str, enum kp_drv_type *ptype)
+{
+	enum kp_drv_type type;
+
+	assert(str != NULL);
+
+	for (type = 0; type < KP_DRV_TYPE_NUM; type++) {
+		if (kp_strcasecmp(str, kp_drv_type_names[type]) == 0) {
+			if (ptype != NULL) {
+				*ptype = type;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+kp_drv_conf_is_valid(const struct kp_drv_conf *conf)
+{
+	return conf != NULL &&
+		conf->microsteps >= 1 &&
+		conf->microsteps <= KP_DRV_MICROSTEPS_MAX &&
+		(conf->microsteps & (conf->microsteps - 1)) == 0 &&
+		conf->run_current >= 1 &&
+		conf->run_current <= KP_DRV_CURRENT_MAX &&
+		conf->hold_current >= 1 &&
+		conf->hold_current <= KP_DRV_CURRENT_MAX &&
+		conf->stall_threshold <= KP_DRV_STALL_THRESHOLD_MAX;
+}
+
+const char *
+kp_drv_rc_to_str(enum kp_drv_rc rc)
+{
+	switch (rc) {
+	case KP_DRV_RC_OK:
+		return "OK";
+	case KP_DRV_RC_NO_REPLY:
+		return "no reply from the driver";
+	case KP_DRV_RC_BAD_REPLY:
+		return "bad reply from the driver";
+	case KP_DRV_RC_LOST_WRITE:
+		return "the driver lost a write";
+	case KP_DRV_RC_NO_UART:
+		return "no driver UART available";
+	default:
+		return "unknown error";
+	}
+}
+
+/**
+ * Calculate the CRC8 of a datagram, the way the driver does.
+ *
+ * @param buf	The datagram bytes, not including the CRC.
+ * @param len	The number of bytes.
+ *
+ * @return The CRC.
+ */
+static uint8_t
+kp_drv_crc(const uint8_t *buf, size_t len)
+{
+	uint8_t crc = 0;
+	uint8_t byte;
+	size_t i, bit;
+
+	assert(buf != NULL || len == 0);
+
+	for (i = 0; i < len; i++) {
+		byte = buf[i];
+		for (bit = 0; bit < 8; bit++) {
+			crc = (((crc >> 7) ^ (byte & 1)) != 0)
+				? (uint8_t)((crc << 1) ^ 0x07)
+				: (uint8_t)(crc << 1);
+			byte >>= 1;
+		}
+	}
+	return crc;
+}
+
+/**
+ * Find a simulated register.
+ *
+ * @param addr	The address of the register to find.
+ *
+ * @return The register, or NULL if not simulated.
+ */
+static struct kp_drv_sim_reg *
+kp_drv_sim_reg_find(uint8_t addr)
+{
+	size_t i;
+	for (i = 0; i < ARRAY_SIZE(kp_drv_sim_reg_list); i++) {
+		if (kp_drv_sim_reg_list[i].addr == addr) {
+			return &kp_drv_sim_reg_list[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Get the value of a simulated register.
+ *
+ * @param addr	The address of the register.
+ *
+ * @return The register value, zero if not simulated.
+ */
+static uint32_t
+kp_drv_sim_reg_get(uint8_t addr)
+{
+	const struct kp_drv_sim_reg *reg = kp_drv_sim_reg_find(addr);
+	return reg == NULL ? 0 : reg->value;
+}
+
+/**
+ * Exchange datagrams with the simulated driver, ignoring the ones it
+ * wouldn't accept, just like the real one.
+ *
+ * @param tx		The datagram to send.
+ * @param tx_len	The length of the datagram to send.
+ * @param rx		Location for the reply.
+ * @param rx_len	The length of the expected reply, zero for none.
+ *
+ * @return True if the expected reply was received, false otherwise.
+ */
+static bool
+kp_drv_sim_xfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+	struct kp_drv_sim_reg *reg;
+	uint32_t value;
+
+	if (tx_len < KP_DRV_READ_SIZE || tx[0] != KP_DRV_SYNC ||
+	    tx[1] != KP_DRV_NODE_ADDR ||
+	    tx[tx_len - 1] != kp_drv_crc(tx, tx_len - 1)) {
+		return false;
+	}
+
+	/* Write */
+	if (tx_len == KP_DRV_WRITE_SIZE && (tx[2] & KP_DRV_REG_WRITE)) {
+		reg = kp_drv_sim_reg_find(tx[2] & ~KP_DRV_REG_WRITE);
+		if (reg != NULL && reg->addr != KP_DRV_REG_IFCNT &&
+		    reg->addr != KP_DRV_REG_SG_RESULT) {
+			reg->value = sys_get_be32(&tx[3]);
+		}
+		reg = kp_drv_sim_reg_find(KP_DRV_REG_IFCNT);
+		reg->value = (reg->value + 1) & 0xff;
+		return rx_len == 0;
+	}
+
+	/* Read */
+	if (tx_len != KP_DRV_READ_SIZE || rx_len != KP_DRV_WRITE_SIZE) {
+		return false;
+	}
+	value = kp_drv_sim_reg_get(tx[2]);
+	rx[0] = KP_DRV_SYNC;
+	rx[1] = KP_DRV_MASTER_ADDR;
+	rx[2] = tx[2];
+	sys_put_be32(value, &rx[3]);
+	rx[7] = kp_drv_crc(rx, 7);
+	return true;
+}
+
+/**
+ * Receive a byte from the driver UART, waiting for it a little.
+ *
+ * @param pbyte	Location for the received byte.
+ *
+ * @return True if a byte was received, false if timed out.
+ */
+static bool
+kp_drv_uart_get(uint8_t *pbyte)
+{
+	uint32_t waited_us;
+	for (waited_us = 0; uart_poll_in(kp_drv_uart, pbyte) != 0;
+	     waited_us += 10) {
+		if (waited_us >= KP_DRV_UART_TIMEOUT_US) {
+			return false;
+		}
+		k_busy_wait(10);
+	}
+	return true;
+}
+
+/**
+ * Exchange datagrams with the driver over the single-wire UART.
+ *
+ * The USART has a single-byte receive register, so every byte echoed by
+ * the joined RX is taken right after sending it, before the next one
+ * overruns it, and the scheduler is kept locked, so the reply bytes are
+ * taken as they arrive, too.
+ *
+ * @param tx		The datagram to send.
+ * @param tx_len	The length of the datagram to send.
+ * @param rx		Location for the reply.
+ * @param rx_len	The length of the expected reply, zero for none.
+ *
+ * @return True if the expected reply was received, false otherwise.
+ */
+static bool
+kp_drv_uart_xfer(const uint8_t *tx, size_t tx_len,
+		 uint8_t *rx, size_t rx_len)
+{
+	bool ok = true;
+	uint8_t byte;
+	size_t i;
+
+	assert(kp_drv_uart != NULL);
+
+	k_sched_lock();
+
+	/* Drop anything stale */
+	while (uart_poll_in(kp_drv_uart, &byte) == 0);
+
+	/* Send the datagram, taking each byte echoed back */
+	for (i = 0; ok && i < tx_len; i++) {
+		uart_poll_out(kp_drv_uart, tx[i]);
+		ok = kp_drv_uart_get(&byte) && byte == tx[i];
+	}
+
+	/* Receive the reply */
+	for (i = 0; ok && i < rx_len; i++) {
+		ok = kp_drv_uart_get(&rx[i]);
+	}
+
+	k_sched_unlock();
+	return ok;
+}
+
+/**
+ * Exchange datagrams with a driver of a particular type.
+ *
+ * @param type		The driver type to exchange with, not plain.
+ * @param tx		The datagram to send.
+ * @param tx_len	The length of the datagram to send.
+ * @param rx		Location for the reply.
+ * @param rx_len	The length of the expected reply, zero for none.
+ *
+ * @return True if the expected reply was received, false otherwise.
+ */
+static bool
+kp_drv_xfer(enum kp_drv_type type,
+	    const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+	assert(type == KP_DRV_TYPE_TMC || type == KP_DRV_TYPE_SIM);
+	return type == KP_DRV_TYPE_SIM
+		? kp_drv_sim_xfer(tx, tx_len, rx, rx_len)
+		: kp_drv_uart_xfer(tx, tx_len, rx, rx_len);
+}
+
+/**
+ * Write a driver register.
+ *
+ * @param type	The driver type to write to, not plain.
+ * @param addr	The register address.
+ * @param value	The value to write.
+ *
+ * @return The communication result code. Writes are not acknowledged,
+ *	   so KP_DRV_RC_OK only means the datagram went out.
+ */
+static enum kp_drv_rc
+kp_drv_write(enum kp_drv_type type, uint8_t addr, uint32_t value)
+{
+	uint8_t tx[KP_DRV_WRITE_SIZE];
+
+	tx[0] = KP_DRV_SYNC;
+	tx[1] = KP_DRV_NODE_ADDR;
+	tx[2] = addr | KP_DRV_REG_WRITE;
+	sys_put_be32(value, &tx[3]);
+	tx[7] = kp_drv_crc(tx, 7);
+
+	return kp_drv_xfer(type, tx, sizeof(tx), NULL, 0)
+		? KP_DRV_RC_OK : KP_DRV_RC_NO_REPLY;
+}
+
+/**
+ * Read a driver register.
+ *
+ * @param type		The driver type to read from, not plain.
+ * @param addr		The register address.
+ * @param pvalue	Location for the read value.
+ *			Not modified in case of failure.
+ *
+ * @return The communication result code.
+ */
+static enum kp_drv_rc
+kp_drv_read(enum kp_drv_type type, uint8_t addr, uint32_t *pvalue)
+{
+	uint8_t tx[KP_DRV_READ_SIZE];
+	uint8_t rx[KP_DRV_WRITE_SIZE];
+
+	assert(pvalue != NULL);
+
+	tx[0] = KP_DRV_SYNC;
+	tx[1] = KP_DRV_NODE_ADDR;
+	tx[2] = addr;
+	tx[3] = kp_drv_crc(tx, 3);
+
+	if (!kp_drv_xfer(type, tx, sizeof(tx), rx, sizeof(rx))) {
+		return KP_DRV_RC_NO_REPLY;
+	}
+	if (rx[0] != KP_DRV_SYNC || rx[1] != KP_DRV_MASTER_ADDR ||
+	    rx[2] != addr || rx[7] != kp_drv_crc(rx, 7)) {
+		return KP_DRV_RC_BAD_REPLY;
+	}
+	*pvalue = sys_get_be32(&rx[3]);
+	return KP_DRV_RC_OK;
+}
+
+/**
+ * Configure a driver over UART.
+ *
+ * @param type	The driver type to configure, not plain.
+ * @param conf	The configuration to apply. Must be valid.
+ *
+ * @return The communication result code.
+ */
+static enum kp_drv_rc
+kp_drv_configure(enum kp_drv_type type, const struct kp_drv_conf *conf)
+{
+	enum kp_drv_rc rc;
+	uint32_t ifcnt_before;
+	uint32_t ifcnt_after;
+	uint32_t chopconf;
+	uint32_t mres;
+	size_t i;
+	struct {
+		uint8_t addr;
+		uint32_t value;
+	} write_list[5];
+
+	assert(type == KP_DRV_TYPE_TMC || type == KP_DRV_TYPE_SIM);
+	assert(kp_drv_conf_is_valid(conf));
+
+	/* Remember the write counter to verify the writes with */
+	rc = kp_drv_read(type, KP_DRV_REG_IFCNT, &ifcnt_before);
+	if (rc != KP_DRV_RC_OK) {
+		return rc;
+	}
+	/* Keep the chopper settings, except the microstep resolution */
+	rc = kp_drv_read(type, KP_DRV_REG_CHOPCONF, &chopconf);
+	if (rc != KP_DRV_RC_OK) {
+		return rc;
+	}
+	/* MRES is 8 for a full step, and 0 for 256 microsteps */
+	for (mres = 8; (1U << (8 - mres)) < conf->microsteps; mres--);
+
+	write_list[0].addr = KP_DRV_REG_GCONF;
+	write_list[0].value = KP_DRV_GCONF_I_SCALE_ANALOG |
+			      KP_DRV_GCONF_PDN_DISABLE |
+			      KP_DRV_GCONF_MSTEP_REG_SELECT |
+			      KP_DRV_GCONF_MULTISTEP_FILT;
+	write_list[1].addr = KP_DRV_REG_CHOPCONF;
+	write_list[1].value = (chopconf & ~KP_DRV_CHOPCONF_MRES_MASK) |
+			      (mres << KP_DRV_CHOPCONF_MRES_SHIFT);
+	write_list[2].addr = KP_DRV_REG_IHOLD_IRUN;
+	write_list[2].value =
+		((conf->hold_current - 1) << KP_DRV_IHOLD_SHIFT) |
+		((conf->run_current - 1) << KP_DRV_IRUN_SHIFT) |
+		(KP_DRV_IHOLDDELAY << KP_DRV_IHOLDDELAY_SHIFT);
+	/* StallGuard only works in StealthChop, which GCONF keeps enabled */
+	write_list[3].addr = KP_DRV_REG_TCOOLTHRS;
+	write_list[3].value = conf->stall_threshold != 0
+		? KP_DRV_TCOOLTHRS_ALL : 0;
+	write_list[4].addr = KP_DRV_REG_SGTHRS;
+	write_list[4].value = conf->stall_threshold;
+
+	for (i = 0; i < ARRAY_SIZE(write_list); i++) {
+		rc = kp_drv_write(type, write_list[i].addr,
+				  write_list[i].value);
+		if (rc != KP_DRV_RC_OK) {
+			return rc;
+		}
+	}
+
+	/* Check the driver accepted every write */
+	rc = kp_drv_read(type, KP_DRV_REG_IFCNT, &ifcnt_after);
+	if (rc != KP_DRV_RC_OK) {
+		return rc;
+	}
+	if (((ifcnt_after - ifcnt_before) & 0xff) != ARRAY_SIZE(write_list)) {
+		return KP_DRV_RC_LOST_WRITE;
+	}
+	return KP_DRV_RC_OK;
+}
+
+bool
+kp_drv_is_initialized(void)
+{
+	return kp_drv_initialized;
+}
+
+void
+kp_drv_init(const struct device *uart,
+	    const struct device *diag_gpio,
+	    gpio_pin_t diag_pin)
+{
+	assert(!kp_drv_is_initialized());
+	assert(diag_gpio != NULL);
+
+	kp_drv_diag_gpio = diag_gpio;
+	kp_drv_diag_pin = diag_pin;
+	gpio_pin_configure(kp_drv_diag_gpio, kp_drv_diag_pin,
+			   GPIO_INPUT | GPIO_PULL_DOWN);
+	kp_drv_type = KP_DRV_TYPE_PLAIN;
+	kp_drv_conf = KP_DRV_CONF_DEF;
+	kp_drv_uart = uart;
+	kp_drv_initialized = true;
+
+	assert(kp_drv_is_initialized());
+}
+
+enum kp_drv_rc
+kp_drv_set(enum kp_drv_type type, const struct kp_drv_conf *conf)
+{
+	enum kp_drv_rc rc = KP_DRV_RC_OK;
+
+	assert(kp_drv_is_initialized());
+	assert(kp_drv_type_is_valid(type));
+	assert(kp_drv_conf_is_valid(conf));
+
+	if (type == KP_DRV_TYPE_TMC && kp_drv_uart == NULL) {
+		rc = KP_DRV_RC_NO_UART;
+	} else if (type != KP_DRV_TYPE_PLAIN) {
+		rc = kp_drv_configure(type, conf);
+	}
+	if (rc == KP_DRV_RC_OK) {
+		kp_drv_type = type;
+		kp_drv_conf = *conf;
+	}
+	return rc;
+}
+
+void
+kp_drv_get(enum kp_drv_type *ptype, struct kp_drv_conf *conf)
+{
+	assert(kp_drv_is_initialized());
+	if (ptype != NULL) {
+		*ptype = kp_drv_type;
+	}
+	if (conf != NULL) {
+		*conf = kp_drv_conf;
+	}
+}
+
+bool
+kp_drv_stall_is_enabled(void)
+{
+	assert(kp_drv_is_initialized());
+	return kp_drv_type != KP_DRV_TYPE_PLAIN &&
+		kp_drv_conf.stall_threshold != 0;
+}
+
+enum kp_drv_rc
+kp_drv_read_load(uint32_t *pload)
+{
+	assert(kp_drv_is_initialized());
+	assert(pload != NULL);
+	if (kp_drv_type == KP_DRV_TYPE_PLAIN) {
+		*pload = 0;
+		return KP_DRV_RC_OK;
+	}
+	return kp_drv_read(kp_drv_type, KP_DRV_REG_SG_RESULT, pload);
+}
+
+bool
+kp_drv_step(bool positive)
+{
+	struct kp_drv_sim_reg *sg_result;
+	uint32_t sgthrs;
+	bool blocked;
+
+	assert(kp_drv_is_initialized());
+
+	switch (kp_drv_type) {
+	case KP_DRV_TYPE_TMC:
+		return kp_drv_conf.stall_threshold != 0 &&
+			gpio_pin_get(kp_drv_diag_gpio, kp_drv_diag_pin) > 0;
+	case KP_DRV_TYPE_SIM:
+		/* Pushing against the stop loads the motor fully */
+		blocked = !positive && kp_drv_sim_pos <= kp_drv_sim_stop;
+		sg_result = kp_drv_sim_reg_find(KP_DRV_REG_SG_RESULT);
+		sg_result->value = blocked ? 0 : KP_DRV_SIM_LOAD_FREE;
+		/* Signal DIAG the way the driver does, from its registers */
+		sgthrs = kp_drv_sim_reg_get(KP_DRV_REG_SGTHRS);
+		if (kp_drv_sim_reg_get(KP_DRV_REG_TCOOLTHRS) != 0 &&
+		    sgthrs != 0 && sg_result->value <= sgthrs * 2) {
+			return true;
+		}
+		/* Otherwise lose the step silently, if blocked */
+		if (!blocked) {
+			kp_drv_sim_pos += positive ? 1 : -1;
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
+void
+kp_drv_sim_set_stop(uint32_t steps)
+{
+	assert(kp_drv_is_initialized());
+	kp_drv_sim_stop = kp_drv_sim_pos - (int32_t)MIN(steps, INT32_MAX);
+}
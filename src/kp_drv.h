@@ -0,0 +1,234 @@
+/** @file
+ *  @brief Keypecker actuator stepper driver backend
+ *
+ *  The actuator steps a STEP/DIR/DISABLE driver. A "plain" driver needs
+ *  nothing else, while a "tmc" (TMC2209-class) driver is also configured
+ *  over its single-wire UART with the microstepping, the run and hold
+ *  currents, and the StallGuard threshold, and signals stalls on its DIAG
+ *  output. The actuator checks for a stall before each step, and stops the
+ *  move, if there was one, which makes sensorless homing against a hard stop
+ *  possible, and lost steps detectable.
+ *
+ *  A "sim" (simulated) driver answers the same UART datagrams and tracks the
+ *  position of a simulated motor, which stops at a simulated hard stop, and
+ *  reports a stall there, if stall detection is enabled, so everything
+ *  above the step pins can be exercised without the hardware.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_DRV_H_
+#define KP_DRV_H_
+
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/device.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Driver types */
+enum kp_drv_type {
+	/** A plain STEP/DIR/DISABLE driver, no configuration or stalls */
+	KP_DRV_TYPE_PLAIN,
+	/** A TMC2209-class driver, configured over UART, stalls on DIAG */
+	KP_DRV_TYPE_TMC,
+	/** A simulated TMC2209-class driver and motor */
+	KP_DRV_TYPE_SIM,
+	/** Number of types (not a type itself) */
+	KP_DRV_TYPE_NUM
+};
+
+/**
+ * Check if a driver type is valid.
+ *
+ * @param type	The type to check.
+ *
+ * @return True if the type is valid, false otherwise.
+ */
+static inline bool
+kp_drv_type_is_valid(enum kp_drv_type type)
+{
+	return type >= 0 && type < KP_DRV_TYPE_NUM;
+}
+
+/**
+ * Convert a driver type to a lowercase string.
+ *
+ * @param type	The type to convert. Must be valid.
+ *
+ * @return The string representing the type.
+ */
+extern const char *kp_drv_type_to_lcstr(enum kp_drv_type type);
+
+/**
+ * Convert a string to a driver type, case-insensitively.
+ *
+ * @param str	The string to convert.
+ * @param ptype	Location for the converted type.
+ *		Not modified in case of failure. Can be NULL.
+ *
+ * @return True if the string was converted successfully, false otherwise.
+ */
+extern bool kp_drv_type_from_str(const char *str, enum kp_drv_type *ptype);
+
+/** Maximum number of microsteps per full step */
+#define KP_DRV_MICROSTEPS_MAX	256
+
+/** Maximum current, in 1/32 of the full scale */
+#define KP_DRV_CURRENT_MAX	32
+
+/** Maximum stall threshold */
+#define KP_DRV_STALL_THRESHOLD_MAX	255
+
+/** Driver configuration */
+struct kp_drv_conf {
+	/** Microsteps per full step, a power of two, one per actuator step */
+	uint32_t microsteps;
+	/** Current while moving, 1/32 of the full scale, 1-32 */
+	uint32_t run_current;
+	/** Current while standing still, 1/32 of the full scale, 1-32 */
+	uint32_t hold_current;
+	/**
+	 * StallGuard threshold, 0-255, higher values detect stalls at lower
+	 * loads, zero disables stall detection.
+	 */
+	uint32_t stall_threshold;
+};
+
+/** Default driver configuration */
+#define KP_DRV_CONF_DEF (struct kp_drv_conf){ \
+	.microsteps = 8,                        \
+	.run_current = 16,                      \
+	.hold_current = 8,                      \
+	.stall_threshold = 0,                   \
+}
+
+/**
+ * Check if a driver configuration is valid.
+ *
+ * @param conf	The configuration to check.
+ *
+ * @return True if the configuration is valid, false otherwise.
+ */
+extern bool kp_drv_conf_is_valid(const struct kp_drv_conf *conf);
+
+/** Driver communication result code */
+enum kp_drv_rc {
+	/** Success */
+	KP_DRV_RC_OK,
+	/** The driver didn't reply in time */
+	KP_DRV_RC_NO_REPLY,
+	/** The driver reply was malformed, or had a bad CRC */
+	KP_DRV_RC_BAD_REPLY,
+	/** The driver didn't acknowledge a write */
+	KP_DRV_RC_LOST_WRITE,
+	/** No UART is available to talk to a real driver */
+	KP_DRV_RC_NO_UART,
+};
+
+/**
+ * Convert a driver communication result code to a string describing it.
+ *
+ * @param rc	The result code to convert.
+ *
+ * @return The string describing the result code.
+ */
+extern const char *kp_drv_rc_to_str(enum kp_drv_rc rc);
+
+/**
+ * Initialize the driver backend with a plain driver and the default
+ * configuration.
+ *
+ * @param uart		The UART device connected to the driver's
+ *			single-wire interface (with RX and TX joined),
+ *			or NULL, if none is available, and only plain and
+ *			simulated drivers can be used.
+ * @param diag_gpio	The device for the GPIO port the driver's DIAG
+ *			output is connected to.
+ * @param diag_pin	The DIAG pin number on the GPIO port.
+ */
+extern void kp_drv_init(const struct device *uart,
+			const struct device *diag_gpio,
+			gpio_pin_t diag_pin);
+
+/**
+ * Check if the driver backend is initialized.
+ *
+ * @return True if the backend is initialized, false if not.
+ */
+extern bool kp_drv_is_initialized(void);
+
+/**
+ * Switch to a driver type and configure the driver. Keep the previous type
+ * and configuration, if configuring fails. Must not be called while the
+ * actuator is moving.
+ *
+ * @param type	The driver type to switch to. Must be valid.
+ * @param conf	The configuration to apply. Must be valid.
+ *
+ * @return The communication result code.
+ */
+extern enum kp_drv_rc kp_drv_set(enum kp_drv_type type,
+				 const struct kp_drv_conf *conf);
+
+/**
+ * Retrieve the current driver type and configuration.
+ *
+ * @param ptype	Location for the driver type. Can be NULL.
+ * @param conf	Location for the configuration. Can be NULL.
+ */
+extern void kp_drv_get(enum kp_drv_type *ptype, struct kp_drv_conf *conf);
+
+/**
+ * Check if stall detection is enabled, i.e. the driver is not plain and
+ * has a non-zero stall threshold.
+ *
+ * @return True if stalls are detected, false otherwise.
+ */
+extern bool kp_drv_stall_is_enabled(void);
+
+/**
+ * Read the StallGuard load measurement (SG_RESULT) from the driver.
+ *
+ * @param pload	Location for the measurement, 0-510, lower values
+ *		meaning higher load. Not modified in case of failure.
+ *
+ * @return The communication result code, KP_DRV_RC_OK for a plain driver,
+ *	   with zero load.
+ */
+extern enum kp_drv_rc kp_drv_read_load(uint32_t *pload);
+
+/**
+ * Check for a stall before making a step, and make the step with the
+ * simulated motor, if not stalled. Called by the actuator with its state
+ * lock held, so has to be quick.
+ *
+ * @param positive	True if the step is in the positive (down) direction,
+ *			false otherwise.
+ *
+ * @return True if the driver reports a stall, and the step must not be
+ *	   made, false otherwise.
+ */
+extern bool kp_drv_step(bool positive);
+
+/**
+ * Place the hard stop of the simulated motor a number of steps above its
+ * current position.
+ *
+ * @param steps	The number of steps above the current position.
+ */
+extern void kp_drv_sim_set_stop(uint32_t steps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_DRV_H_ */
@@ -0,0 +1,202 @@
+/** @file
+ *  @brief Keypecker endurance run
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_endure.h"
+#include "kp_table.h"
+#include <string.h>
+
+void
+kp_endure_init(struct kp_endure *endure,
+	       const struct kp_cap_conf *cap_conf,
+	       uint32_t speed, uint32_t passes,
+	       bool next_down)
+{
+	assert(endure != NULL);
+	assert(kp_cap_conf_is_valid(cap_conf));
+	assert(cap_conf->trig == KP_CAP_TRIG_ACT);
+	assert(kp_cap_conf_ch_num(cap_conf, KP_CAP_DIRS_BOTH) > 0);
+	assert(speed <= 100);
+	assert((next_down & 1) == next_down);
+
+	/* Zero the padding too, to have identical checkpoints compare equal */
+	memset(endure, 0, sizeof(*endure));
+	endure->conf.version = KP_ENDURE_VERSION;
+	endure->stats.version = KP_ENDURE_VERSION;
+	endure->conf.cap = *cap_conf;
+	endure->conf.speed = speed;
+	endure->conf.requested_passes = passes;
+	endure->stats.next_down = next_down;
+
+	assert(kp_endure_is_valid(endure));
+}
+
+/**
+ * Add the channel results of a pass to endurance run statistics.
+ *
+ * @param endure	The endurance run to add the results to.
+ * @param dir		The (unit) direction of the pass.
+ * @param ch_res_list	The results of channels enabled in the direction.
+ */
+static void
+kp_endure_add(struct kp_endure *endure, enum kp_cap_dirs dir,
+	      const struct kp_cap_ch_res *ch_res_list)
+{
+	size_t ch;
+	struct kp_endure_ch_stats *ch_stats;
+
+	assert(kp_endure_is_valid(endure));
+	assert(kp_cap_dirs_is_unit(dir));
+	assert(ch_res_list != NULL);
+
+	for (ch = 0; ch < ARRAY_SIZE(endure->conf.cap.ch_list); ch++) {
+		if (!(endure->conf.cap.ch_list[ch].dirs & dir)) {
+			continue;
+		}
+		ch_stats = &endure->stats.ch_list[ch][kp_cap_dirs_to_ne(dir)];
+		ch_stats->passes++;
+		if (kp_cap_ch_status_is_captured(ch_res_list->status)) {
+			if (ch_stats->triggers == 0) {
+				ch_stats->min_us = ch_res_list->value_us;
+				ch_stats->max_us = ch_res_list->value_us;
+			}
+			ch_stats->triggers++;
+			ch_stats->min_us = MIN(ch_stats->min_us,
+					       ch_res_list->value_us);
+			ch_stats->max_us = MAX(ch_stats->max_us,
+					       ch_res_list->value_us);
+			ch_stats->sum_us += ch_res_list->value_us;
+		}
+		ch_res_list++;
+	}
+}
+
+enum kp_sample_rc
+kp_endure_run(struct kp_endure *endure,
+	      int32_t top, int32_t bottom,
+	      kp_endure_pass_fn pass_fn,
+	      void *pass_data)
+{
+	enum kp_sample_rc rc;
+	struct kp_cap_ch_res ch_res_list[KP_CAP_CH_NUM];
+	enum kp_cap_dirs dir;
+	bool down;
+
+	assert(kp_endure_is_valid(endure));
+	assert(kp_act_pos_is_valid(top));
+	assert(kp_act_pos_is_valid(bottom));
+	assert(top < bottom);
+
+	/* Nothing to do, if all passes are done */
+	if (kp_endure_is_complete(endure)) {
+		return KP_SAMPLE_RC_OK;
+	}
+
+	/* Move to the next pass start boundary without capturing */
+	rc = kp_sample(endure->stats.next_down ? top : bottom,
+		       endure->conf.speed, &endure->conf.cap,
+		       KP_CAP_DIRS_NONE, NULL, 0);
+	if (rc != KP_SAMPLE_RC_OK) {
+		return rc;
+	}
+
+	/* Pass until done, or aborted */
+	while (!kp_endure_is_complete(endure)) {
+		down = endure->stats.next_down;
+		dir = kp_cap_dirs_from_down(down);
+		/* Capture moving to the opposite boundary */
+		rc = kp_sample(down ? bottom : top,
+			       endure->conf.speed, &endure->conf.cap, dir,
+			       ch_res_list, ARRAY_SIZE(ch_res_list));
+		if (rc != KP_SAMPLE_RC_OK) {
+			return rc;
+		}
+		/* Register the pass */
+		kp_endure_add(endure, dir, ch_res_list);
+		endure->stats.passes++;
+		endure->stats.next_down = !down;
+		/* Notify about the pass, if requested */
+		if (pass_fn != NULL) {
+			pass_fn(endure, pass_data);
+		}
+	}
+
+	return KP_SAMPLE_RC_OK;
+}
+
+void
+kp_endure_print(const struct shell *shell, const struct kp_endure *endure)
+{
+	static const char *metric_names[] = {
+		"Trigs, %",
+		"Min, us",
+		"Mean, us",
+		"Max, us",
+	};
+	struct kp_table table;
+	const struct kp_cap_conf *conf;
+	const struct kp_endure_ch_stats *ch_stats;
+	enum kp_cap_ne_dirs ne_dirs;
+	size_t ch, metric;
+	uint32_t value;
+
+	assert(shell != NULL);
+	assert(kp_endure_is_valid(endure));
+
+	conf = &endure->conf.cap;
+
+	shell_print(shell, "Passes: %u", endure->stats.passes);
+
+	kp_table_ch_init(&table, shell, conf->ch_list);
+
+	/* For each unit direction with enabled channels */
+	for (ne_dirs = KP_CAP_NE_DIRS_UP; ne_dirs < KP_CAP_NE_DIRS_BOTH;
+	     ne_dirs++) {
+		if (!kp_table_ch_dir_head(&table, conf->ch_list, ne_dirs)) {
+			continue;
+		}
+		for (metric = 0; metric < ARRAY_SIZE(metric_names);
+		     metric++) {
+			kp_table_col(&table, "%s", metric_names[metric]);
+			for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+				if (!conf->ch_list[ch].dirs) {
+					continue;
+				}
+				ch_stats = &endure->stats.ch_list[ch][ne_dirs];
+				/* Skip metrics unknown in this direction */
+				if (ch_stats->passes == 0 ||
+				    (metric > 0 && ch_stats->triggers == 0)) {
+					kp_table_col(&table, "");
+					continue;
+				}
+				switch (metric) {
+					case 0:
+						value = (uint64_t)
+							ch_stats->triggers *
+							100 /
+							ch_stats->passes;
+						break;
+					case 1:
+						value = ch_stats->min_us;
+						break;
+					case 2:
+						value = ch_stats->sum_us /
+							ch_stats->triggers;
+						break;
+					default:
+						value = ch_stats->max_us;
+						break;
+				}
+				kp_table_col(&table, "%u", value);
+			}
+			kp_table_nl(&table);
+		}
+	}
+	kp_table_sep(&table);
+}
@@ -0,0 +1,180 @@
+/** @file
+ *  @brief Keypecker endurance run
+ *
+ *  An endurance run makes (possibly) unlimited passes over a range of
+ *  actuator positions, and accumulates streaming statistics of each channel
+ *  in each direction, instead of storing every result like a measurement.
+ *  Its configuration and statistics are kept in plain structures, so they
+ *  can be checkpointed as they are.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_ENDURE_H_
+#define KP_ENDURE_H_
+
+#include "kp_sample.h"
+#include "kp_cap.h"
+#include <zephyr/shell/shell.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Endurance run checkpoint layout version, stored in both the configuration
+ * and the statistics, to be bumped on any change to their layout
+ */
+#define KP_ENDURE_VERSION	1
+
+/** Endurance run configuration */
+struct kp_endure_conf {
+	/* Layout version, KP_ENDURE_VERSION */
+	uint32_t version;
+	/* Capture configuration */
+	struct kp_cap_conf cap;
+	/* The speed with which to move, 0-100% */
+	uint32_t speed;
+	/* Number of passes that should be done, zero for unlimited */
+	uint32_t requested_passes;
+};
+
+/** Endurance run statistics of a channel in one direction */
+struct kp_endure_ch_stats {
+	/* Number of passes the channel was captured in */
+	uint32_t passes;
+	/* Number of passes the channel triggered in */
+	uint32_t triggers;
+	/* Minimum captured time, us, only valid if triggers != 0 */
+	uint32_t min_us;
+	/* Maximum captured time, us, only valid if triggers != 0 */
+	uint32_t max_us;
+	/* Sum of captured times, us */
+	uint64_t sum_us;
+};
+
+/** Endurance run statistics */
+struct kp_endure_stats {
+	/* Layout version, KP_ENDURE_VERSION */
+	uint32_t version;
+	/* Number of passes done so far */
+	uint32_t passes;
+	/* True if the next pass is going down, false if up */
+	bool next_down;
+	/* Statistics of each channel, in each unit direction */
+	struct kp_endure_ch_stats ch_list[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+};
+
+/** An endurance run */
+struct kp_endure {
+	/* Configuration */
+	struct kp_endure_conf conf;
+	/* Statistics */
+	struct kp_endure_stats stats;
+};
+
+/** An invalid endurance run initializer */
+#define KP_ENDURE_INVALID	(struct kp_endure){0,}
+
+/**
+ * Check if an endurance run is valid.
+ *
+ * @param endure	The endurance run to check.
+ *
+ * @return True if the endurance run is valid, false otherwise.
+ */
+static inline bool
+kp_endure_is_valid(const struct kp_endure *endure)
+{
+	return endure != NULL &&
+	       endure->conf.version == KP_ENDURE_VERSION &&
+	       endure->stats.version == KP_ENDURE_VERSION &&
+	       kp_cap_conf_is_valid(&endure->conf.cap) &&
+	       endure->conf.cap.trig == KP_CAP_TRIG_ACT &&
+	       kp_cap_conf_ch_num(&endure->conf.cap, KP_CAP_DIRS_BOTH) > 0 &&
+	       endure->conf.speed <= 100 &&
+	       (endure->conf.requested_passes == 0 ||
+		endure->stats.passes <= endure->conf.requested_passes) &&
+	       (endure->stats.next_down & 1) == endure->stats.next_down;
+}
+
+/**
+ * Check if an endurance run is complete, i.e. has all requested passes done.
+ *
+ * @param endure	The endurance run to check. Must be valid.
+ *
+ * @return True if the endurance run is complete, false otherwise.
+ */
+static inline bool
+kp_endure_is_complete(const struct kp_endure *endure)
+{
+	assert(kp_endure_is_valid(endure));
+	return endure->conf.requested_passes != 0 &&
+	       endure->stats.passes == endure->conf.requested_passes;
+}
+
+/**
+ * Initialize an endurance run without passes done.
+ *
+ * @param endure	The endurance run to initialize.
+ * @param cap_conf	The capture configuration to use. Must be valid, use
+ *			the actuator trigger, and have at least one channel
+ *			enabled in at least one direction.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param passes	Number of passes to do, zero for unlimited.
+ * @param next_down	True if the first pass must be going down,
+ *			false if up.
+ */
+extern void kp_endure_init(struct kp_endure *endure,
+			   const struct kp_cap_conf *cap_conf,
+			   uint32_t speed, uint32_t passes,
+			   bool next_down);
+
+/**
+ * Prototype for a function notifying about an endurance run pass.
+ *
+ * @param endure	The endurance run so far.
+ * @param data		Opaque data.
+ */
+typedef void (*kp_endure_pass_fn)(const struct kp_endure *endure,
+				  void *data);
+
+/**
+ * Continue an endurance run until all the requested passes are done, or
+ * until aborted, if unlimited.
+ *
+ * @param endure	The endurance run to continue. Must be valid.
+ * @param top		The top position of the movement range.
+ * @param bottom	The bottom position of the movement range.
+ *			Must be greater than the top.
+ * @param pass_fn	The function to call after every pass.
+ * 			Can be NULL to have nothing called.
+ * @param pass_data	The data to pass to pass_fn with each call.
+ *
+ * @return Sampling result code.
+ */
+extern enum kp_sample_rc kp_endure_run(struct kp_endure *endure,
+				       int32_t top, int32_t bottom,
+				       kp_endure_pass_fn pass_fn,
+				       void *pass_data);
+
+/**
+ * Output endurance run statistics to a shell.
+ *
+ * @param shell		The shell to output to.
+ * @param endure	The endurance run to output. Must be valid.
+ */
+extern void kp_endure_print(const struct shell *shell,
+			    const struct kp_endure *endure);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_ENDURE_H_ */
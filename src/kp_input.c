@@ -17,6 +17,10 @@ static K_MUTEX_DEFINE(kp_input_mutex);
 K_MSGQ_DEFINE(kp_input_msgq, sizeof(enum kp_input_msg),
 		16, sizeof(enum kp_input_msg));
 
+/** Input query queue, overflowing queries are dropped */
+K_MSGQ_DEFINE(kp_input_query_msgq, sizeof(enum kp_input_query),
+		4, sizeof(enum kp_input_query));
+
 /** Input state */
 enum kp_input_st {
 	/** Base state, no special characters encountered */
@@ -38,6 +42,7 @@ kp_input_reset(void)
 	k_mutex_lock(&kp_input_mutex, K_FOREVER);
 	kp_input_st = KP_INPUT_ST_NONE;
 	k_msgq_purge(&kp_input_msgq);
+	k_msgq_purge(&kp_input_query_msgq);
 	k_mutex_unlock(&kp_input_mutex);
 }
 
@@ -45,6 +50,7 @@ void
 kp_input_recv(uint8_t *data, size_t len)
 {
 	enum kp_input_msg msg;
+	enum kp_input_query query;
 	k_mutex_lock(&kp_input_mutex, K_FOREVER);
 	for (; len > 0; data++, len--) {
 		switch (kp_input_st) {
@@ -63,6 +69,21 @@ kp_input_recv(uint8_t *data, size_t len)
 			case 0x1b: /* ESC  */
 				kp_input_st = KP_INPUT_ST_ESC;
 				break;
+			case 's':
+				query = KP_INPUT_QUERY_STATUS;
+				k_msgq_put(&kp_input_query_msgq, &query,
+					   K_NO_WAIT);
+				break;
+			case 't':
+				query = KP_INPUT_QUERY_STATS;
+				k_msgq_put(&kp_input_query_msgq, &query,
+					   K_NO_WAIT);
+				break;
+			case 'p':
+				query = KP_INPUT_QUERY_POS;
+				k_msgq_put(&kp_input_query_msgq, &query,
+					   K_NO_WAIT);
+				break;
 			}
 			break;
 		/* Esc received */
@@ -129,3 +150,9 @@ kp_input_get(enum kp_input_msg *msg, k_timeout_t timeout)
 {
 	return k_msgq_get(&kp_input_msgq, msg, timeout);
 }
+
+int
+kp_input_get_query(enum kp_input_query *query)
+{
+	return k_msgq_get(&kp_input_query_msgq, query, K_NO_WAIT);
+}
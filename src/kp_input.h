@@ -29,6 +29,19 @@ enum kp_input_msg {
 	KP_INPUT_MSG_ENTER,
 };
 
+/**
+ * Input queries, answered right away by the thread receiving the input,
+ * without involving the command running.
+ */
+enum kp_input_query {
+	/** Status ('s') */
+	KP_INPUT_QUERY_STATUS,
+	/** Statistics so far ('t') */
+	KP_INPUT_QUERY_STATS,
+	/** Positions ('p') */
+	KP_INPUT_QUERY_POS,
+};
+
 /**
  * Reset tracked input state to start processing another session.
  */
@@ -62,6 +75,16 @@ extern void kp_input_get_event_init(struct k_poll_event *event);
  */
 extern int kp_input_get(enum kp_input_msg *msg, k_timeout_t timeout);
 
+/**
+ * Get the next input query, without waiting.
+ *
+ * @param query	Location for the retrieved query.
+ *
+ * @retval 0 Query received.
+ * @retval -ENOMSG No queries pending.
+ */
+extern int kp_input_get_query(enum kp_input_query *query);
+
 #ifdef __cplusplus
 }
 #endif
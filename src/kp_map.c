@@ -0,0 +1,288 @@
+/** @file
+ *  @brief Keypecker trigger map
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_map.h"
+#include "kp_table.h"
+#include <string.h>
+#include <assert.h>
+
+/** Number of the most recent passes over a range to judge misses by */
+#define KP_MAP_RECENT_NUM	8
+
+/** Channel triggers within a range, in one direction */
+struct kp_map_trigs {
+	/** Number of passes */
+	uint32_t passes:24;
+	/**
+	 * Misses in the most recent passes (up to KP_MAP_RECENT_NUM), a bit
+	 * per pass, the latest in the lowest bit
+	 */
+	uint32_t recent_misses:KP_MAP_RECENT_NUM;
+	/** Number of passes the channel triggered in */
+	uint32_t triggers;
+};
+
+/**
+ * Check if channel triggers within a range show it mostly missing
+ * recently, i.e. in the majority of (at least two of) its most recent
+ * passes, so that a single miss (e.g. a glitch) doesn't condemn the range.
+ *
+ * @param trigs	The channel triggers to check.
+ *
+ * @return True if the channel mostly misses, false otherwise.
+ */
+static bool
+kp_map_trigs_mostly_miss(const struct kp_map_trigs *trigs)
+{
+	uint32_t recent = MIN(trigs->passes, KP_MAP_RECENT_NUM);
+	uint32_t misses = __builtin_popcount(trigs->recent_misses);
+	return recent >= 2 && misses * 2 > recent;
+}
+
+/** A range of positions in the map */
+struct kp_map_range {
+	/** The top position of the range */
+	int32_t top;
+	/** The bottom position, equal to the top if the range is unused */
+	int32_t bottom;
+	/** Triggers of each channel, in each unit direction */
+	struct kp_map_trigs ch_list[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+};
+
+/** The map ranges, a ring buffer */
+static struct kp_map_range kp_map_range_list[KP_MAP_RANGE_NUM];
+
+/** The index of the range to replace next */
+static size_t kp_map_range_next;
+
+/**
+ * Check if a map range is used.
+ *
+ * @param range	The range to check.
+ *
+ * @return True if the range is used, false otherwise.
+ */
+static inline bool
+kp_map_range_is_used(const struct kp_map_range *range)
+{
+	assert(range != NULL);
+	return range->top < range->bottom;
+}
+
+void
+kp_map_clear(void)
+{
+	memset(kp_map_range_list, 0, sizeof(kp_map_range_list));
+	kp_map_range_next = 0;
+}
+
+void
+kp_map_add(int32_t top, int32_t bottom,
+	   const struct kp_cap_conf *conf,
+	   enum kp_cap_dirs dirs,
+	   const struct kp_cap_ch_res *ch_res_list,
+	   size_t ch_res_num)
+{
+	struct kp_map_range *range = NULL;
+	struct kp_map_trigs *trigs;
+	enum kp_cap_ne_dirs ne_dirs;
+	size_t i;
+	size_t ch;
+
+	assert(top < bottom);
+	assert(kp_cap_conf_is_valid(conf));
+	assert(kp_cap_dirs_is_unit(dirs));
+	assert(ch_res_list != NULL || ch_res_num == 0);
+
+	/* Look for the range in the map */
+	for (i = 0; i < ARRAY_SIZE(kp_map_range_list); i++) {
+		if (kp_map_range_list[i].top == top &&
+		    kp_map_range_list[i].bottom == bottom) {
+			range = &kp_map_range_list[i];
+			break;
+		}
+	}
+
+	/* If not found, replace the oldest range */
+	if (range == NULL) {
+		range = &kp_map_range_list[kp_map_range_next];
+		kp_map_range_next = (kp_map_range_next + 1) %
+			ARRAY_SIZE(kp_map_range_list);
+		memset(range, 0, sizeof(*range));
+		range->top = top;
+		range->bottom = bottom;
+	}
+
+	/* Add the results of channels enabled in the pass direction */
+	ne_dirs = kp_cap_dirs_to_ne(dirs);
+	for (ch = 0, i = 0; ch < ARRAY_SIZE(conf->ch_list) && i < ch_res_num;
+	     ch++) {
+		if (!(conf->ch_list[ch].dirs & dirs)) {
+			continue;
+		}
+		/* Stuck channels tell nothing about the range */
+		if (ch_res_list[i].status == KP_CAP_CH_STATUS_STUCK) {
+			i++;
+			continue;
+		}
+		trigs = &range->ch_list[ch][ne_dirs];
+		trigs->passes++;
+		trigs->recent_misses <<= 1;
+		if (kp_cap_ch_status_is_captured(ch_res_list[i].status)) {
+			trigs->triggers++;
+		} else {
+			trigs->recent_misses |= 1;
+		}
+		i++;
+	}
+}
+
+enum kp_map_verdict
+kp_map_check(int32_t top, int32_t bottom,
+	     const struct kp_cap_conf *conf,
+	     size_t passes)
+{
+	enum kp_map_verdict verdict = KP_MAP_VERDICT_TRIGGERS;
+	enum kp_cap_ne_dirs ne_dirs;
+	const struct kp_map_range *range;
+	const struct kp_map_trigs *trigs;
+	size_t required;
+	size_t known;
+	size_t i;
+	size_t ch;
+
+	assert(top < bottom);
+	assert(kp_cap_conf_is_valid(conf));
+	assert(kp_cap_conf_ch_num(conf, KP_CAP_DIRS_BOTH) > 0);
+	assert(passes > 0);
+
+	/*
+	 * kp_sample_check() alternates directions, so if channels are
+	 * enabled in both, each direction gets at least half of the passes
+	 */
+	if (kp_cap_conf_ch_num(conf, KP_CAP_DIRS_UP) > 0 &&
+	    kp_cap_conf_ch_num(conf, KP_CAP_DIRS_DOWN) > 0) {
+		required = MAX(passes / 2, 1);
+	} else {
+		required = passes;
+	}
+
+	/* For each channel and each of its enabled directions */
+	for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+		for (ne_dirs = KP_CAP_NE_DIRS_UP;
+		     ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			if (!(conf->ch_list[ch].dirs &
+			      kp_cap_dirs_from_ne(ne_dirs))) {
+				continue;
+			}
+			known = 0;
+			for (i = 0; i < ARRAY_SIZE(kp_map_range_list); i++) {
+				range = &kp_map_range_list[i];
+				if (!kp_map_range_is_used(range)) {
+					continue;
+				}
+				trigs = &range->ch_list[ch][ne_dirs];
+				/* Recent misses within a containing range */
+				if (range->top <= top &&
+				    range->bottom >= bottom &&
+				    kp_map_trigs_mostly_miss(trigs)) {
+					return KP_MAP_VERDICT_MISSES;
+				}
+				/* Triggers within a contained range */
+				if (range->top >= top &&
+				    range->bottom <= bottom &&
+				    trigs->triggers == trigs->passes) {
+					known = MAX(known, trigs->passes);
+				}
+			}
+			if (known < required) {
+				verdict = KP_MAP_VERDICT_UNKNOWN;
+			}
+		}
+	}
+
+	return verdict;
+}
+
+void
+kp_map_print(const struct shell *shell, const struct kp_cap_conf *conf)
+{
+	struct kp_table table;
+	enum kp_cap_ne_dirs ne_dirs;
+	const struct kp_map_range *range;
+	const struct kp_map_trigs *trigs;
+	size_t col_num;
+	size_t i;
+	size_t ch;
+
+	assert(shell != NULL);
+	assert(kp_cap_conf_is_valid(conf));
+
+	/* Count the columns */
+	col_num = 2;
+	for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+		for (ne_dirs = KP_CAP_NE_DIRS_UP;
+		     ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			col_num += (conf->ch_list[ch].dirs &
+				    kp_cap_dirs_from_ne(ne_dirs)) != 0;
+		}
+	}
+
+	/* Output the header */
+	kp_table_init(&table, shell, 6, 10, col_num);
+	kp_table_col(&table, "");
+	kp_table_col(&table, "");
+	for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+		for (ne_dirs = KP_CAP_NE_DIRS_UP;
+		     ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			if (conf->ch_list[ch].dirs &
+			    kp_cap_dirs_from_ne(ne_dirs)) {
+				kp_table_col(&table, "#%zu %s", ch,
+					     ne_dirs == KP_CAP_NE_DIRS_DOWN
+						? "Down" : "Up");
+			}
+		}
+	}
+	kp_table_nl(&table);
+	kp_table_col(&table, "Top");
+	kp_table_col(&table, "Bottom");
+	for (i = 2; i < col_num; i++) {
+		kp_table_col(&table, "Trigs");
+	}
+	kp_table_nl(&table);
+	kp_table_sep(&table);
+
+	/* Output the ranges, oldest first */
+	for (i = 0; i < ARRAY_SIZE(kp_map_range_list); i++) {
+		range = &kp_map_range_list[
+			(kp_map_range_next + i) % ARRAY_SIZE(kp_map_range_list)
+		];
+		if (!kp_map_range_is_used(range)) {
+			continue;
+		}
+		kp_table_col(&table, "%d", range->top);
+		kp_table_col(&table, "%d", range->bottom);
+		for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+			for (ne_dirs = KP_CAP_NE_DIRS_UP;
+			     ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+				if (!(conf->ch_list[ch].dirs &
+				      kp_cap_dirs_from_ne(ne_dirs))) {
+					continue;
+				}
+				trigs = &range->ch_list[ch][ne_dirs];
+				kp_table_col(&table, "%u/%u",
+					     trigs->triggers,
+					     (uint32_t)trigs->passes);
+			}
+		}
+		kp_table_nl(&table);
+	}
+	kp_table_sep(&table);
+}
@@ -0,0 +1,102 @@
+/** @file
+ *  @brief Keypecker trigger map
+ *
+ *  The trigger map remembers how each channel triggered in each direction,
+ *  for the most recently sampled ranges of actuator positions. It is updated
+ *  by every capturing pass, and lets the trigger reliability of a range be
+ *  inferred without sampling it again: a pass over a range also passes over
+ *  every range inside it, so triggering within a range means triggering
+ *  within every range containing it, and missing within a range means
+ *  missing within every range inside it.
+ *
+ *  The map is only valid for the current actuator position reference,
+ *  channel configuration, and switch, and must be cleared when those change.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_MAP_H_
+#define KP_MAP_H_
+
+#include "kp_cap.h"
+#include <zephyr/shell/shell.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of ranges the map remembers */
+#define KP_MAP_RANGE_NUM	32
+
+/** A trigger reliability verdict for a range */
+enum kp_map_verdict {
+	/** Not enough information, the range has to be sampled */
+	KP_MAP_VERDICT_UNKNOWN,
+	/** All enabled channels triggered reliably */
+	KP_MAP_VERDICT_TRIGGERS,
+	/** At least one enabled channel mostly missed recently */
+	KP_MAP_VERDICT_MISSES,
+};
+
+/**
+ * Forget all ranges in the map.
+ */
+extern void kp_map_clear(void);
+
+/**
+ * Add the results of a capturing pass to the map.
+ *
+ * @param top		The top position of the passed range.
+ * @param bottom	The bottom position of the passed range.
+ *			Must be greater than the top position.
+ * @param conf		The capture configuration used for the pass.
+ * @param dirs		The (unit) direction of the pass.
+ * @param ch_res_list	The list of results for channels enabled in the
+ *			pass direction, as output by kp_cap_finish().
+ * @param ch_res_num	Number of results in the list.
+ */
+extern void kp_map_add(int32_t top, int32_t bottom,
+		       const struct kp_cap_conf *conf,
+		       enum kp_cap_dirs dirs,
+		       const struct kp_cap_ch_res *ch_res_list,
+		       size_t ch_res_num);
+
+/**
+ * Infer from the map, if all enabled channels would trigger reliably in a
+ * kp_sample_check() over a range of positions.
+ *
+ * @param top		The top position of the range.
+ * @param bottom	The bottom position of the range.
+ *			Must be greater than the top position.
+ * @param conf		The capture configuration to check with.
+ *			Must have at least one channel enabled.
+ * @param passes	The number of passes the check would execute.
+ *			Must be greater than zero.
+ *
+ * @return The inferred verdict.
+ */
+extern enum kp_map_verdict kp_map_check(int32_t top, int32_t bottom,
+					const struct kp_cap_conf *conf,
+					size_t passes);
+
+/**
+ * Output the map to a shell, as a table of ranges, with triggered and total
+ * passes for each channel enabled in a capture configuration.
+ *
+ * @param shell	The shell to output to.
+ * @param conf	The capture configuration to output the channels of.
+ */
+extern void kp_map_print(const struct shell *shell,
+			 const struct kp_cap_conf *conf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_MAP_H_ */
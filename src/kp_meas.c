@@ -10,34 +10,192 @@
 
 #include "kp_meas.h"
 #include "kp_table.h"
+#include "kp_misc.h"
+#include "kp_seqlock.h"
+#include "kp_scope.h"
+#include <zephyr/kernel.h>
 #include <sys/types.h>
 
-enum kp_sample_rc
-kp_meas_acquire(struct kp_meas *meas,
-		kp_meas_acquire_pass_fn pass_fn,
-		void *pass_data)
+/** The sequence lock protecting the published progress */
+static struct kp_seqlock kp_meas_progress_seqlock;
+
+/** The progress of the measurement being (or last) acquired */
+static struct kp_meas_progress kp_meas_progress;
+
+void
+kp_meas_get_progress(struct kp_meas_progress *progress)
+{
+	assert(progress != NULL);
+	KP_SEQLOCK_READ(&kp_meas_progress_seqlock) {
+		*progress = kp_meas_progress;
+	}
+}
+
+/**
+ * Publish a measurement's progress for kp_meas_get_progress().
+ *
+ * @param progress	The progress to publish.
+ */
+static void
+kp_meas_progress_publish(const struct kp_meas_progress *progress)
+{
+	assert(progress != NULL);
+
+	/* Don't let the readers preempt us, and spin, while we update */
+	k_sched_lock();
+	kp_seqlock_write_begin(&kp_meas_progress_seqlock);
+	kp_meas_progress = *progress;
+	kp_seqlock_write_end(&kp_meas_progress_seqlock);
+	k_sched_unlock();
+}
+
+bool
+kp_meas_ch_acc_add(struct kp_meas_ch_acc *acc,
+		   const struct kp_cap_ch_res *ch_res)
+{
+	assert(acc != NULL);
+	assert(ch_res != NULL);
+
+	acc->passes++;
+	if (!kp_cap_ch_status_is_captured(ch_res->status)) {
+		return false;
+	}
+	if (acc->triggers++ == 0) {
+		acc->min_us = ch_res->value_us;
+		acc->max_us = ch_res->value_us;
+	}
+	acc->min_us = MIN(acc->min_us, ch_res->value_us);
+	acc->max_us = MAX(acc->max_us, ch_res->value_us);
+	acc->sum_us += ch_res->value_us;
+	acc->sum_sq_us += (uint64_t)ch_res->value_us * ch_res->value_us;
+	return true;
+}
+
+/**
+ * Account for the channel results of a measurement's pass in its progress.
+ *
+ * @param progress	The progress to account the pass in.
+ * @param meas		The measurement containing the pass.
+ * @param pass		The index of the pass to account for.
+ */
+static void
+kp_meas_progress_add_pass(struct kp_meas_progress *progress,
+			  const struct kp_meas *meas, size_t pass)
+{
+	enum kp_cap_dirs dir = kp_meas_get_pass_dir(meas, pass);
+	enum kp_cap_ne_dirs ne_dirs = kp_cap_dirs_to_ne(dir);
+	const struct kp_cap_ch_res *ch_res;
+	size_t ch;
+
+	assert(progress != NULL);
+	assert(kp_meas_is_valid(meas));
+	assert(pass < meas->passes);
+
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (!(meas->conf.ch_list[ch].dirs & dir)) {
+			continue;
+		}
+		ch_res = kp_meas_get_ch_res_const(meas, pass, ch);
+		kp_meas_ch_acc_add(&progress->ch_list[ch][ne_dirs], ch_res);
+	}
+	progress->passes = meas->passes;
+	progress->captured_passes = meas->captured_passes;
+}
+
+/**
+ * Time the cycle ending with a pass on the global capture timeline, if the
+ * timeline is running, and the pass got its trigger.
+ *
+ * @param tl	The pass cycle statistics to update.
+ * @param dir	The (unit) direction of the pass.
+ */
+static void
+kp_meas_tl_add(struct kp_meas_tl *tl, enum kp_cap_dirs dir)
+{
+	uint64_t *ptrig_us;
+	uint64_t trig_us;
+	uint32_t cycle_us;
+
+	assert(tl != NULL);
+	assert(dir == KP_CAP_DIRS_UP || dir == KP_CAP_DIRS_DOWN);
+
+	if (!kp_cap_tl_is_running()) {
+		return;
+	}
+	ptrig_us = &tl->trig_us_list[kp_cap_dirs_to_ne(dir)];
+	if (!kp_cap_tl_get_trig(&trig_us)) {
+		/* Don't time a cycle across a pass without a trigger */
+		*ptrig_us = UINT64_MAX;
+		return;
+	}
+	if (*ptrig_us != UINT64_MAX) {
+		cycle_us = (uint32_t)MIN(trig_us - *ptrig_us, UINT32_MAX);
+		if (tl->cycles == 0) {
+			tl->first_us = tl->min_us = tl->max_us = cycle_us;
+		}
+		tl->cycles++;
+		tl->last_us = cycle_us;
+		tl->min_us = MIN(tl->min_us, cycle_us);
+		tl->max_us = MAX(tl->max_us, cycle_us);
+		tl->sum_us += cycle_us;
+	}
+	*ptrig_us = trig_us;
+}
+
+/**
+ * Acquire an initalized measurement, see kp_meas_acquire(), accounting
+ * the acquired passes in its progress and publishing it.
+ *
+ * @param meas		The measurement to acquire.
+ *			Must be initialized.
+ * @param pass_fn	The function to call for every pass-worth of samples.
+ * 			Can be NULL to have nothing called.
+ * @param pass_data	The data to pass to pass_fn with each call.
+ * @param progress	The progress to account the passes in.
+ *
+ * @return Sampling result code.
+ */
+static enum kp_sample_rc
+kp_meas_acquire_passes(struct kp_meas *meas,
+		       kp_meas_acquire_pass_fn pass_fn,
+		       void *pass_data,
+		       struct kp_meas_progress *progress)
 {
 	enum kp_sample_rc rc;
 	static struct kp_cap_ch_res *ch_res;
 	size_t ch_res_rem;
 	size_t ch_res_num;
+	size_t ch_res_idx;
+	int32_t top;
+	int32_t bottom;
+	size_t lane;
+	const struct kp_cap_conf *conf;
+	uint32_t speed;
+	/* Number of consecutive passes with stuck channels */
+	size_t stuck_passes = 0;
+	size_t i;
 
 	assert(kp_meas_is_valid(meas));
-	assert(kp_meas_is_empty(meas));
 
-	/* Move to the start boundary without capturing */
-	rc = kp_sample(meas->even_down ? meas->top : meas->bottom,
-		       meas->speed, &meas->conf, KP_CAP_DIRS_NONE, NULL, 0);
-	if (rc != KP_SAMPLE_RC_OK) {
-		return rc;
+	/* Nothing to do, if all passes are done */
+	if (kp_meas_is_complete(meas)) {
+		return KP_SAMPLE_RC_OK;
 	}
 
-	/* Capture the requested number of passes */
-	for (ch_res_rem = ARRAY_SIZE(meas->ch_res_list),
-	     ch_res = meas->ch_res_list;
+	/* Find where the results of the next pass go */
+	ch_res_idx = kp_cap_conf_ch_res_idx(&meas->conf, meas->even_down,
+					    meas->passes, 0);
+
+	/* Capture the remaining requested number of passes */
+	for (ch_res_rem = ARRAY_SIZE(meas->ch_res_list) - ch_res_idx,
+	     ch_res = meas->ch_res_list + ch_res_idx;
 	     meas->passes < meas->requested_passes;) {
 		bool down = (meas->passes ^ meas->even_down) & 1;
 		enum kp_cap_dirs dir = kp_cap_dirs_from_down(down);
+		/* Take the configuration of the pass lane */
+		lane = kp_meas_get_pass_lane(meas, meas->passes);
+		conf = kp_meas_get_lane_conf(meas, lane);
+		speed = kp_meas_get_lane_speed(meas, lane);
 		/* Count next number of channel results */
 		ch_res_num = kp_cap_conf_ch_num(&meas->conf, dir);
 		if (ch_res_num > ch_res_rem) {
@@ -45,29 +203,345 @@ kp_meas_acquire(struct kp_meas *meas,
 			/* The caller must make sure we have enough memory */
 			return KP_SAMPLE_RC_OK;
 		}
-		/* Capture moving to the opposite boundary */
-		rc = kp_sample(
-			down ? meas->bottom : meas->top,
-			meas->speed, &meas->conf, dir, ch_res, ch_res_rem
-		);
+		/* Sample the bounce trains for debounce emulation, if any */
+		kp_dbnc_pass_start(&meas->dbnc);
+		if (meas->conf.trig == KP_CAP_TRIG_EXT) {
+			/* Capture after the next stimulus edge */
+			rc = kp_sample_ext(conf, dir, ch_res, ch_res_rem);
+		} else {
+			/*
+			 * Move to the pass start boundary, and capture moving
+			 * to the opposite one, queueing both moves together.
+			 * Only map the main lane, as the alternative lanes
+			 * capture with different polarities and timeouts.
+			 */
+			kp_meas_get_dir_range(meas, dir, &top, &bottom);
+			rc = kp_sample_from(
+				down ? top : bottom,
+				down ? bottom : top,
+				speed, conf, dir,
+				ch_res, ch_res_rem, lane == 0
+			);
+		}
+		kp_dbnc_pass_finish(rc == KP_SAMPLE_RC_OK ? &meas->dbnc : NULL,
+				    conf, dir);
 		if (rc != KP_SAMPLE_RC_OK) {
 			return rc;
 		}
+		/* Time the pass cycle, if on the global timeline */
+		if (meas->conf.trig == KP_CAP_TRIG_ACT) {
+			kp_meas_tl_add(&meas->tl, dir);
+		}
+		/* Count consecutive passes with stuck channels */
+		for (i = 0; i < ch_res_num &&
+			    ch_res[i].status != KP_CAP_CH_STATUS_STUCK; i++);
+		stuck_passes = (i < ch_res_num) ? stuck_passes + 1 : 0;
 		/* Advance past captured results */
 		ch_res_rem -= ch_res_num;
 		ch_res += ch_res_num;
 		/* Register the pass */
 		meas->captured_passes += (ch_res_num != 0);
 	       	meas->passes++;
+		/* Publish the progress, without waiting for the readers */
+		kp_meas_progress_add_pass(progress, meas, meas->passes - 1);
+		kp_meas_progress_publish(progress);
 		/* Notify about the pass, if requested */
 		if (pass_fn != NULL) {
 			pass_fn(meas, pass_data);
 		}
+		/* Give up, if channels stay stuck */
+		if (stuck_passes >= KP_MEAS_STUCK_PASSES_MAX) {
+			return KP_SAMPLE_RC_STUCK;
+		}
 	}
 
 	return KP_SAMPLE_RC_OK;
 }
 
+enum kp_sample_rc
+kp_meas_acquire(struct kp_meas *meas,
+		kp_meas_acquire_pass_fn pass_fn,
+		void *pass_data)
+{
+	struct kp_meas_progress progress;
+	enum kp_sample_rc rc;
+	size_t pass;
+
+	assert(kp_meas_is_valid(meas));
+
+	/* Don't time cycles across timeline restarts, if continuing */
+	memset(meas->tl.trig_us_list, 0xff, sizeof(meas->tl.trig_us_list));
+
+	/* Account for the passes done before, if continuing */
+	memset(&progress, 0, sizeof(progress));
+	progress.acquiring = true;
+	progress.start_ms = k_uptime_get();
+	progress.start_passes = meas->passes;
+	progress.requested_passes = meas->requested_passes;
+	for (pass = 0; pass < meas->passes; pass++) {
+		kp_meas_progress_add_pass(&progress, meas, pass);
+	}
+	kp_meas_progress_publish(&progress);
+
+	/* Collect the edges between the pass captures, if monitored */
+	kp_mon_attach(&meas->mon);
+	rc = kp_meas_acquire_passes(meas, pass_fn, pass_data, &progress);
+	kp_mon_detach();
+
+	progress.acquiring = false;
+	kp_meas_progress_publish(&progress);
+	return rc;
+}
+
+void
+kp_meas_get_ch_sum(const struct kp_meas *meas, size_t ch,
+		   enum kp_cap_dirs dirs, struct kp_meas_ch_sum *sum)
+{
+	kp_meas_get_ch_lane_sum(meas, ch, dirs, KP_MEAS_LANE_ALL, sum);
+}
+
+void
+kp_meas_get_ch_lane_sum(const struct kp_meas *meas, size_t ch,
+			enum kp_cap_dirs dirs, size_t lane,
+			struct kp_meas_ch_sum *sum)
+{
+	size_t pass;
+	uint64_t total_us = 0;
+	const struct kp_cap_ch_res *ch_res;
+
+	assert(kp_meas_is_valid(meas));
+	assert(ch < ARRAY_SIZE(meas->conf.ch_list));
+	assert(kp_cap_dirs_is_valid(dirs));
+	assert(lane == KP_MEAS_LANE_ALL || lane < kp_meas_get_lane_num(meas));
+	assert(sum != NULL);
+
+	memset(sum, 0, sizeof(*sum));
+	sum->min_us = UINT32_MAX;
+
+	for (pass = 0; pass < meas->passes; pass++) {
+		if (!(meas->conf.ch_list[ch].dirs & dirs &
+		      kp_meas_get_pass_dir(meas, pass))) {
+			continue;
+		}
+		if (lane != KP_MEAS_LANE_ALL &&
+		    kp_meas_get_pass_lane(meas, pass) != lane) {
+			continue;
+		}
+		sum->passes++;
+		ch_res = kp_meas_get_ch_res_const(meas, pass, ch);
+		if (kp_cap_ch_status_is_captured(ch_res->status)) {
+			sum->triggers++;
+			total_us += ch_res->value_us;
+			sum->min_us = MIN(sum->min_us, ch_res->value_us);
+			sum->max_us = MAX(sum->max_us, ch_res->value_us);
+		}
+	}
+
+	if (sum->triggers != 0) {
+		sum->mean_us = total_us / sum->triggers;
+	}
+}
+
+/**
+ * Number of median absolute deviations a channel value has to be away from
+ * the median to be an outlier, zero to disable outlier detection
+ */
+static uint32_t kp_meas_outlier_mads = KP_MEAS_OUTLIER_MADS_DEF;
+
+void
+kp_meas_set_outlier_mads(uint32_t mads)
+{
+	assert(mads <= KP_MEAS_OUTLIER_MADS_MAX);
+	kp_meas_outlier_mads = mads;
+}
+
+uint32_t
+kp_meas_get_outlier_mads(void)
+{
+	return kp_meas_outlier_mads;
+}
+
+/**
+ * Count values captured for a channel of a measurement in directions,
+ * within a range.
+ *
+ * @param meas		The measurement to count the values in.
+ * @param ch		The index of the channel to count the values for.
+ * @param dirs		The directions to count the values for.
+ * @param min_us	The minimum value to count, us.
+ * @param max_us	The maximum value to count, us.
+ *
+ * @return The number of channel values within the range.
+ */
+static size_t
+kp_meas_count_ch_range(const struct kp_meas *meas, size_t ch,
+		       enum kp_cap_dirs dirs,
+		       uint32_t min_us, uint32_t max_us)
+{
+	size_t pass;
+	size_t count = 0;
+	const struct kp_cap_ch_res *ch_res;
+
+	assert(kp_meas_is_valid(meas));
+	assert(ch < ARRAY_SIZE(meas->conf.ch_list));
+	assert(kp_cap_dirs_is_valid(dirs));
+
+	for (pass = 0; pass < meas->passes; pass++) {
+		if (!(meas->conf.ch_list[ch].dirs & dirs &
+		      kp_meas_get_pass_dir(meas, pass))) {
+			continue;
+		}
+		ch_res = kp_meas_get_ch_res_const(meas, pass, ch);
+		if (kp_cap_ch_status_is_captured(ch_res->status) &&
+		    ch_res->value_us >= min_us && ch_res->value_us <= max_us) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Find the smallest deviation from a center value, within which a number
+ * of a channel's values in directions fall, by bisecting the deviation, to
+ * avoid storing sorted copies.
+ *
+ * @param meas		The measurement to look at the values in.
+ * @param ch		The index of the channel to look at the values for.
+ * @param dirs		The directions to look at the values for.
+ * @param center_us	The center value, us.
+ * @param rank		The number of values to find the deviation for.
+ *			Must not exceed the number of channel values.
+ *
+ * @return The deviation, us.
+ */
+static uint32_t
+kp_meas_select_ch_dev(const struct kp_meas *meas, size_t ch,
+		      enum kp_cap_dirs dirs, uint32_t center_us, size_t rank)
+{
+	uint32_t lo, hi, mid;
+
+	for (lo = 0, hi = KP_CAP_TIME_MAX_US; lo < hi;) {
+		mid = lo + (hi - lo) / 2;
+		if (kp_meas_count_ch_range(meas, ch, dirs,
+					   center_us > mid
+						? center_us - mid : 0,
+					   center_us + mid) >= rank) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	return lo;
+}
+
+/**
+ * Find the median and the median absolute deviation of a channel's values
+ * in directions.
+ *
+ * @param meas		The measurement to look at the values in.
+ * @param ch		The index of the channel to look at the values for.
+ * @param dirs		The directions to look at the values for.
+ * @param pmed_us	Location for the median, us.
+ * @param pmad_us	Location for the median absolute deviation, us.
+ *
+ * @return True if the channel has values in the directions, and the
+ *	   locations were written, false otherwise.
+ */
+static bool
+kp_meas_get_ch_med_mad(const struct kp_meas *meas, size_t ch,
+		       enum kp_cap_dirs dirs,
+		       uint32_t *pmed_us, uint32_t *pmad_us)
+{
+	size_t rank;
+
+	assert(pmed_us != NULL);
+	assert(pmad_us != NULL);
+
+	/* The rank of the (lower) median */
+	rank = (kp_meas_count_ch_range(meas, ch, dirs,
+				       0, UINT32_MAX) + 1) / 2;
+	if (rank == 0) {
+		return false;
+	}
+	*pmed_us = kp_meas_select_ch_dev(meas, ch, dirs, 0, rank);
+	*pmad_us = kp_meas_select_ch_dev(meas, ch, dirs, *pmed_us, rank);
+	return true;
+}
+
+/** Ranges of non-outlier values of a measurement's channels */
+struct kp_meas_inliers {
+	/** Minimum non-outlier value per channel per unit direction, us */
+	uint32_t min_us[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+	/** Maximum non-outlier value per channel per unit direction, us */
+	uint32_t max_us[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+};
+
+/**
+ * Find the ranges of non-outlier values of a measurement's channels, in each
+ * unit direction, so the bimodal up/down values don't hide each other's
+ * outliers.
+ *
+ * @param meas		The measurement to find the ranges for.
+ * @param inliers	Location for the ranges.
+ */
+static void
+kp_meas_get_inliers(const struct kp_meas *meas,
+		    struct kp_meas_inliers *inliers)
+{
+	enum kp_cap_ne_dirs ne_dirs;
+	uint32_t med_us, mad_us, dev_us;
+	size_t ch;
+
+	assert(kp_meas_is_valid(meas));
+	assert(inliers != NULL);
+
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			inliers->min_us[ch][ne_dirs] = 0;
+			inliers->max_us[ch][ne_dirs] = UINT32_MAX;
+			if (kp_meas_outlier_mads == 0 ||
+			    !kp_meas_get_ch_med_mad(
+					meas, ch, kp_cap_dirs_from_ne(ne_dirs),
+					&med_us, &mad_us)) {
+				continue;
+			}
+			/*
+			 * Don't let a deviation of half the values below
+			 * the capture resolution flag everything else
+			 */
+			dev_us = kp_meas_outlier_mads *
+				 MAX(mad_us, KP_CAP_RES_US);
+			inliers->min_us[ch][ne_dirs] =
+				med_us > dev_us ? med_us - dev_us : 0;
+			inliers->max_us[ch][ne_dirs] = med_us + dev_us;
+		}
+	}
+}
+
+/**
+ * Check if a channel result is a captured value outlier.
+ *
+ * @param inliers	The ranges of non-outlier values.
+ * @param ch		The index of the channel the result belongs to.
+ * @param ne_dirs	The unit direction the result was captured in.
+ * @param ch_res	The channel result to check.
+ *
+ * @return True if the result is an outlier, false otherwise.
+ */
+static bool
+kp_meas_is_outlier(const struct kp_meas_inliers *inliers, size_t ch,
+		   enum kp_cap_ne_dirs ne_dirs,
+		   const struct kp_cap_ch_res *ch_res)
+{
+	assert(inliers != NULL);
+	assert(ch < KP_CAP_CH_NUM);
+	assert(ne_dirs < KP_CAP_NE_DIRS_BOTH);
+	assert(ch_res != NULL);
+	return kp_cap_ch_status_is_captured(ch_res->status) &&
+	       (ch_res->value_us < inliers->min_us[ch][ne_dirs] ||
+		ch_res->value_us > inliers->max_us[ch][ne_dirs]);
+}
 
 /**
  * Output a channel index (and name) header for a measurement result.
@@ -186,8 +660,7 @@ kp_meas_print_data_pass(struct kp_table *table, const struct kp_meas *meas,
 	kp_table_col(table, "%s", kp_cap_dirs_to_cpstr(pass_dir));
 
 	for (ch = 0,
-	     /* We promise we won't change the measurement */
-	     ch_res = kp_meas_get_ch_res((struct kp_meas *)meas, pass, ch);
+	     ch_res = kp_meas_get_ch_res_const(meas, pass, ch);
 	     ch < ARRAY_SIZE(meas->conf.ch_list); ch++) {
 		/* Skip channels disabled for this measurement */
 		if (!(meas->conf.ch_list[ch].dirs & dirs)) {
@@ -205,6 +678,9 @@ kp_meas_print_data_pass(struct kp_table *table, const struct kp_meas *meas,
 		case KP_CAP_CH_STATUS_TIMEOUT:
 			kp_table_col(table, "!");
 			break;
+		case KP_CAP_CH_STATUS_STUCK:
+			kp_table_col(table, "=");
+			break;
 		case KP_CAP_CH_STATUS_OVERCAPTURE:
 			kp_table_col(table, "+%u",
 				     ch_res->value_us);
@@ -268,6 +744,7 @@ kp_meas_print_stats(struct kp_table *table,
 		    bool verbose)
 {
 	bool timeout[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM] = {{0, }};
+	bool stuck[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM] = {{0, }};
 	bool overcapture[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM] = {{0, }};
 	bool unknown[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM] = {{0, }};
 	static const char *metric_names[] = {
@@ -323,6 +800,12 @@ kp_meas_print_stats(struct kp_table *table,
 				/* Got timeout for either direction */
 				timeout[ch][KP_CAP_NE_DIRS_BOTH] = true;
 				break;
+			case KP_CAP_CH_STATUS_STUCK:
+				/* Got stuck channel for this direction */
+				stuck[ch][ne_dirs] = true;
+				/* Got stuck channel for either direction */
+				stuck[ch][KP_CAP_NE_DIRS_BOTH] = true;
+				break;
 			case KP_CAP_CH_STATUS_OVERCAPTURE:
 				/* Got overcapture for this direction */
 				overcapture[ch][ne_dirs] = true;
@@ -442,9 +925,10 @@ kp_meas_print_stats(struct kp_table *table,
 				     * or we have measured values
 				     */
 				    (!metric || got_value[ch][ne_dirs])
-					    ? "%s%s%s%u" : "%s%s%s",
+					    ? "%s%s%s%s%u" : "%s%s%s%s",
 				    overcapture[ch][ne_dirs] ? "+" : "",
 				    unknown[ch][ne_dirs] ? "?" : "",
+				    stuck[ch][ne_dirs] ? "=" : "",
 				    timeout[ch][ne_dirs] ? "!" : "",
 				    metric_data[metric][ch][ne_dirs]);
 			}
@@ -454,92 +938,690 @@ kp_meas_print_stats(struct kp_table *table,
 }
 
 /**
- * Output histograms for a measurement result.
+ * Output robust statistics for a measurement result, per unit direction, as
+ * the outliers are: the median and the median absolute deviation of the
+ * captured values, the number of outliers, and the statistics of the values
+ * which aren't outliers.
  *
  * @param table		The table to output to.
  * @param meas		The measurement result to output.
- * @param verbose	True if the output should be verbose,
- * 			false otherwise.
+ * @param inliers	The ranges of non-outlier values.
  */
 static void
-kp_meas_print_histogram(struct kp_table *table,
-			const struct kp_meas *meas,
-			bool verbose)
+kp_meas_print_robust(struct kp_table *table,
+		     const struct kp_meas *meas,
+		     const struct kp_meas_inliers *inliers)
 {
-#define STEP_NUM 16
-	uint32_t min, max;
-	uint32_t step_size;
-	size_t step_passes[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM]
-				[STEP_NUM] = {{{0, }}};
-	size_t max_step_passes[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM] = {{0, }};
-	size_t ch, pass;
-	enum kp_cap_dirs dirs;
+	static const char *metric_names[] = {
+		"Med, us",
+		"MAD, us",
+		"Outliers",
+		"Min, us",
+		"Mean, us",
+		"Max, us",
+	};
+	const size_t metric_num = ARRAY_SIZE(metric_names);
+	uint32_t metric_data[metric_num][KP_CAP_CH_NUM];
+	bool got_value[KP_CAP_CH_NUM];
+	size_t values[KP_CAP_CH_NUM];
+	uint64_t sum[KP_CAP_CH_NUM];
 	enum kp_cap_ne_dirs ne_dirs;
+	enum kp_cap_ne_dirs pass_ne_dirs;
+	enum kp_cap_dirs dirs;
+	size_t pass, ch, metric;
 	const struct kp_cap_ch_res *ch_res;
-	ssize_t step_idx;
-	uint32_t step_min;
-	char char_buf[sizeof(table->col_buf)];
-	size_t width;
-	size_t char_idx;
-	size_t chars, next_chars;
-	char c;
 
 	assert(kp_table_is_valid(table));
 	assert(table->col_idx == 0);
 	assert(kp_meas_is_valid(meas));
+	assert(inliers != NULL);
 
-	/* Get the directions we captured in */
-	dirs = kp_meas_get_requested_dirs(meas);
-
-	/* Set histogram width to one character less than column width */
-	snprintf(char_buf, sizeof(char_buf), table->coln_fmt, "");
-	width = strlen(char_buf);
-	assert(width > 0);
-	width--;
+	/*
+	 * For each unit direction with enabled channels, as the outliers are
+	 * judged against the median of their direction, and mixing the
+	 * directions would make the median and MAD disagree with them
+	 */
+	for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+		dirs = kp_cap_dirs_from_ne(ne_dirs);
+		if (kp_cap_conf_ch_num(&meas->conf, dirs) == 0) {
+			continue;
+		}
 
-	/* Find minimum and maximum time for all channels */
-	min = UINT32_MAX;
-	max = 0;
-	for (ch_res = meas->ch_res_list, pass = 0;
-	     pass < meas->passes; pass++) {
+		/* Calculate the metrics */
 		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
-			if (meas->conf.ch_list[ch].dirs &
-			    kp_cap_dirs_from_down((pass & 1) ^
-						  meas->even_down)) {
-				if (ch_res->status == KP_CAP_CH_STATUS_OK ||
-				    ch_res->status ==
-					KP_CAP_CH_STATUS_OVERCAPTURE) {
-					min = MIN(min, ch_res->value_us);
-					max = MAX(max, ch_res->value_us);
+			got_value[ch] = kp_meas_get_ch_med_mad(
+				meas, ch, dirs,
+				&metric_data[0][ch], &metric_data[1][ch]
+			);
+			metric_data[2][ch] = 0;
+			metric_data[3][ch] = UINT32_MAX;
+			metric_data[5][ch] = 0;
+			values[ch] = 0;
+			sum[ch] = 0;
+		}
+		for (ch_res = meas->ch_res_list, pass = 0;
+		     pass < meas->passes; pass++) {
+			pass_ne_dirs = kp_cap_ne_dirs_from_down(
+				meas->even_down ^ (pass & 1)
+			);
+			for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+				/* Skip channels disabled in this direction */
+				if (!(meas->conf.ch_list[ch].dirs &
+				      kp_cap_dirs_from_ne(pass_ne_dirs))) {
+					continue;
+				}
+				/* Move onto the next result, if not counted */
+				if (!(dirs &
+				      kp_cap_dirs_from_ne(pass_ne_dirs)) ||
+				    !kp_cap_ch_status_is_captured(
+					ch_res->status)) {
+					ch_res++;
+					continue;
+				}
+				if (kp_meas_is_outlier(inliers, ch,
+						       pass_ne_dirs, ch_res)) {
+					metric_data[2][ch]++;
+				} else {
+					values[ch]++;
+					sum[ch] += ch_res->value_us;
+					metric_data[3][ch] = MIN(
+						metric_data[3][ch],
+						ch_res->value_us
+					);
+					metric_data[5][ch] = MAX(
+						metric_data[5][ch],
+						ch_res->value_us
+					);
 				}
 				ch_res++;
 			}
 		}
-	}
-	/* If minimum and maximum are not found (we had no data) */
-	if (min > max) {
-		min = 0;
-		max = meas->conf.timeout_us + meas->conf.bounce_us;
-	}
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			metric_data[4][ch] = values[ch] != 0
+				? sum[ch] / values[ch] : 0;
+		}
 
-	/* Calculate histogram step values per channel */
-	step_size = (max - min) / STEP_NUM;
-	if (step_size == 0) {
-		step_size = KP_CAP_RES_US;
-	}
-	for (ch_res = meas->ch_res_list, pass = 0;
-	     pass < meas->passes; pass++) {
-		ne_dirs = kp_cap_ne_dirs_from_down(
-			meas->even_down ^ (pass & 1)
-		);
+		/* Output direction header */
+		kp_table_sep(table);
+		kp_table_col(table, "%s", kp_cap_dirs_to_cpstr(dirs));
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (meas->conf.ch_list[ch].dirs) {
+				kp_table_col(table, "Robust");
+			}
+		}
+		kp_table_nl(table);
+		kp_table_sep(table);
+		/* For each metric */
+		for (metric = 0; metric < metric_num; metric++) {
+			kp_table_col(table, "%s", metric_names[metric]);
+			for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+				if (!meas->conf.ch_list[ch].dirs) {
+					continue;
+				}
+				/* If disabled in direction, or got no values */
+				if (!(meas->conf.ch_list[ch].dirs & dirs) ||
+				    !got_value[ch]) {
+					kp_table_col(table, "");
+				} else {
+					kp_table_col(table, "%u",
+						     metric_data[metric][ch]);
+				}
+			}
+			kp_table_nl(table);
+		}
+	}
+}
+
+/**
+ * Output the outliers of a measurement result, a pass per line, if any.
+ *
+ * @param table		The table to output to.
+ * @param meas		The measurement result to output.
+ * @param inliers	The ranges of non-outlier values.
+ */
+static void
+kp_meas_print_outliers(struct kp_table *table,
+		       const struct kp_meas *meas,
+		       const struct kp_meas_inliers *inliers)
+{
+	bool header = false;
+	bool outlier;
+	enum kp_cap_ne_dirs ne_dirs;
+	size_t pass, ch;
+	const struct kp_cap_ch_res *ch_res;
+	const struct kp_cap_ch_res *pass_ch_res;
+
+	assert(kp_table_is_valid(table));
+	assert(table->col_idx == 0);
+	assert(kp_meas_is_valid(meas));
+	assert(inliers != NULL);
+
+	for (ch_res = meas->ch_res_list, pass = 0;
+	     pass < meas->passes; pass++) {
+		ne_dirs = kp_cap_ne_dirs_from_down(
+			meas->even_down ^ (pass & 1)
+		);
+		/* Check if the pass has outliers */
+		pass_ch_res = ch_res;
+		outlier = false;
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (meas->conf.ch_list[ch].dirs &
+			    kp_cap_dirs_from_ne(ne_dirs)) {
+				outlier = outlier ||
+					kp_meas_is_outlier(inliers, ch,
+							   ne_dirs, ch_res);
+				ch_res++;
+			}
+		}
+		if (!outlier) {
+			continue;
+		}
+		/* Output the header before the first outlier */
+		if (!header) {
+			kp_table_sep(table);
+			kp_table_col(table, "Outlier");
+			for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+				if (meas->conf.ch_list[ch].dirs) {
+					kp_table_col(table, "Time, us");
+				}
+			}
+			kp_table_nl(table);
+			kp_table_sep(table);
+			header = true;
+		}
+		/* Output the pass number, and its outliers */
+		kp_table_col(table, "#%zu", pass);
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (!meas->conf.ch_list[ch].dirs) {
+				continue;
+			}
+			if (!(meas->conf.ch_list[ch].dirs &
+			      kp_cap_dirs_from_ne(ne_dirs))) {
+				kp_table_col(table, "");
+				continue;
+			}
+			if (kp_meas_is_outlier(inliers, ch, ne_dirs,
+					       pass_ch_res)) {
+				kp_table_col(table, "%u",
+					     pass_ch_res->value_us);
+			} else {
+				kp_table_col(table, "");
+			}
+			pass_ch_res++;
+		}
+		kp_table_nl(table);
+	}
+}
+
+/**
+ * Output statistics of each configuration lane of a measurement result, and
+ * their differences from the main lane, if there are alternative lanes.
+ *
+ * @param table		The table to output to.
+ * @param meas		The measurement result to output.
+ */
+static void
+kp_meas_print_lanes(struct kp_table *table, const struct kp_meas *meas)
+{
+	static const char *metric_names[] = {
+		"Passes",
+		"Trigs, %",
+		"Mean, us",
+		"Diff, us",
+	};
+	struct kp_meas_ch_sum sum_list[KP_MEAS_LANE_MAX][KP_CAP_CH_NUM];
+	const struct kp_meas_ch_sum *sum;
+	const struct kp_meas_ch_sum *main_sum;
+	size_t lane, ch, metric;
+
+	assert(kp_table_is_valid(table));
+	assert(table->col_idx == 0);
+	assert(kp_meas_is_valid(meas));
+
+	if (meas->lanes.alt_num == 0) {
+		return;
+	}
+
+	/* Summarize each enabled channel in each lane */
+	for (lane = 0; lane < kp_meas_get_lane_num(meas); lane++) {
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (meas->conf.ch_list[ch].dirs) {
+				kp_meas_get_ch_lane_sum(meas, ch,
+							KP_CAP_DIRS_BOTH, lane,
+							&sum_list[lane][ch]);
+			}
+		}
+	}
+
+	/* For each lane */
+	for (lane = 0; lane < kp_meas_get_lane_num(meas); lane++) {
+		/* Output the lane header */
+		kp_table_sep(table);
+		kp_table_col(table, "Lane #%zu", lane);
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (meas->conf.ch_list[ch].dirs) {
+				kp_table_col(table, "Value");
+			}
+		}
+		kp_table_nl(table);
+		kp_table_sep(table);
+		/* For each metric (no difference for the main lane) */
+		for (metric = 0;
+		     metric < ARRAY_SIZE(metric_names) - (lane == 0);
+		     metric++) {
+			kp_table_col(table, "%s", metric_names[metric]);
+			for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+				if (!meas->conf.ch_list[ch].dirs) {
+					continue;
+				}
+				sum = &sum_list[lane][ch];
+				main_sum = &sum_list[0][ch];
+				switch (metric) {
+				case 0:
+					kp_table_col(table, "%zu",
+						     sum->passes);
+					break;
+				case 1:
+					if (sum->passes == 0) {
+						kp_table_col(table, "");
+						break;
+					}
+					kp_table_col(table, "%zu",
+						     sum->triggers * 100 /
+						     sum->passes);
+					break;
+				case 2:
+					if (sum->triggers == 0) {
+						kp_table_col(table, "");
+						break;
+					}
+					kp_table_col(table, "%u", sum->mean_us);
+					break;
+				default:
+					if (sum->triggers == 0 ||
+					    main_sum->triggers == 0) {
+						kp_table_col(table, "");
+						break;
+					}
+					kp_table_col(
+						table, "%s%u",
+						sum->mean_us < main_sum->mean_us
+							? "-" : "+",
+						sum->mean_us < main_sum->mean_us
+							? main_sum->mean_us -
+							  sum->mean_us
+							: sum->mean_us -
+							  main_sum->mean_us
+					);
+					break;
+				}
+			}
+			kp_table_nl(table);
+		}
+	}
+}
+
+/**
+ * Output statistics of unexpected edges between passes of a measurement
+ * result, if any gaps were monitored.
+ *
+ * @param table		The table to output to.
+ * @param meas		The measurement result to output.
+ */
+static void
+kp_meas_print_mon(struct kp_table *table, const struct kp_meas *meas)
+{
+	static const char *metric_names[] = {
+		"Edges",
+		"Gaps, %",
+		"Max/gap",
+		"Min, us",
+		"Max, us",
+	};
+	size_t ch, metric;
+	const struct kp_mon_ch_stats *ch_stats;
+	uint32_t value;
+
+	assert(kp_table_is_valid(table));
+	assert(table->col_idx == 0);
+	assert(kp_meas_is_valid(meas));
+
+	if (meas->mon.gaps == 0) {
+		return;
+	}
+
+	/* Output the header */
+	kp_table_sep(table);
+	kp_table_col(table, "Spurious");
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (meas->conf.ch_list[ch].dirs) {
+			kp_table_col(table, "Value");
+		}
+	}
+	kp_table_nl(table);
+	kp_table_sep(table);
+
+	/* For each metric */
+	for (metric = 0; metric < ARRAY_SIZE(metric_names); metric++) {
+		kp_table_col(table, "%s", metric_names[metric]);
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (!meas->conf.ch_list[ch].dirs) {
+				continue;
+			}
+			ch_stats = &meas->mon.ch_list[ch];
+			/* Times are only known if there were edges */
+			if (metric >= 3 && ch_stats->edges == 0) {
+				kp_table_col(table, "");
+				continue;
+			}
+			switch (metric) {
+			case 0:
+				value = ch_stats->edges;
+				break;
+			case 1:
+				value = ch_stats->gaps * 100 / meas->mon.gaps;
+				break;
+			case 2:
+				value = ch_stats->gap_edges_max;
+				break;
+			case 3:
+				value = ch_stats->min_us;
+				break;
+			default:
+				value = ch_stats->max_us;
+				break;
+			}
+			kp_table_col(table, "%u", value);
+		}
+		kp_table_nl(table);
+	}
+}
+
+/**
+ * Output the statistics of the pass cycles timed on the global capture
+ * timeline, if any.
+ *
+ * @param table		The table to output to.
+ * @param meas		The measurement result to output.
+ */
+static void
+kp_meas_print_tl(struct kp_table *table, const struct kp_meas *meas)
+{
+	static const char *metric_names[] = {
+		"Cycles",
+		"Min, us",
+		"Mean, us",
+		"Max, us",
+		"Drift, us",
+	};
+	size_t ch, metric;
+	bool first;
+
+	assert(kp_table_is_valid(table));
+	assert(table->col_idx == 0);
+	assert(kp_meas_is_valid(meas));
+
+	if (meas->tl.cycles == 0) {
+		return;
+	}
+
+	/* Output the header, and the metrics in the first channel column */
+	for (metric = 0; metric <= ARRAY_SIZE(metric_names); metric++) {
+		if (metric == 0) {
+			kp_table_sep(table);
+			kp_table_col(table, "Timeline");
+		} else {
+			kp_table_col(table, "%s", metric_names[metric - 1]);
+		}
+		for (ch = 0, first = true; ch < KP_CAP_CH_NUM; ch++) {
+			if (!meas->conf.ch_list[ch].dirs) {
+				continue;
+			}
+			if (!first) {
+				kp_table_col(table, "");
+				continue;
+			}
+			first = false;
+			switch (metric) {
+			case 0:
+				kp_table_col(table, "Value");
+				break;
+			case 1:
+				kp_table_col(table, "%u", meas->tl.cycles);
+				break;
+			case 2:
+				kp_table_col(table, "%u", meas->tl.min_us);
+				break;
+			case 3:
+				kp_table_col(table, "%u", (uint32_t)(
+					meas->tl.sum_us / meas->tl.cycles));
+				break;
+			case 4:
+				kp_table_col(table, "%u", meas->tl.max_us);
+				break;
+			default:
+				/* The change from the first to the last */
+				kp_table_col(table, "%d", (int32_t)(
+					meas->tl.last_us - meas->tl.first_us));
+				break;
+			}
+		}
+		kp_table_nl(table);
+		if (metric == 0) {
+			kp_table_sep(table);
+		}
+	}
+}
+
+/**
+ * Output the results of debounce algorithm models emulated over a
+ * measurement result, if any, followed by the percentage of passes the
+ * samples ran out in.
+ *
+ * @param table		The table to output to.
+ * @param meas		The measurement result to output.
+ */
+static void
+kp_meas_print_dbnc(struct kp_table *table, const struct kp_meas *meas)
+{
+	static const char *metric_names[] = {
+		"Fired, %",
+		"Min, us",
+		"Mean, us",
+		"Max, us",
+		"Spurious",
+	};
+	size_t model, ch, metric;
+	const struct kp_dbnc_model *dbnc_model;
+	const struct kp_dbnc_ch_stats *ch_stats;
+	uint32_t value;
+
+	assert(kp_table_is_valid(table));
+	assert(table->col_idx == 0);
+	assert(kp_meas_is_valid(meas));
+
+	/* For each emulated model */
+	for (model = 0; model < meas->dbnc.conf.model_num; model++) {
+		dbnc_model = &meas->dbnc.conf.model_list[model];
+		/* Output the header: the algorithm and its time */
+		kp_table_sep(table);
+		kp_table_col(table, "%s",
+			     kp_dbnc_algo_to_lcstr(dbnc_model->algo));
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (meas->conf.ch_list[ch].dirs) {
+				kp_table_col(table, "%uus",
+					     dbnc_model->time_us);
+			}
+		}
+		kp_table_nl(table);
+		kp_table_sep(table);
+		/* For each metric */
+		for (metric = 0; metric < ARRAY_SIZE(metric_names);
+		     metric++) {
+			kp_table_col(table, "%s", metric_names[metric]);
+			for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+				if (!meas->conf.ch_list[ch].dirs) {
+					continue;
+				}
+				ch_stats = &meas->dbnc.ch_list[model][ch];
+				/* Latencies are only known if got events */
+				if (ch_stats->passes == 0 ||
+				    (metric >= 1 && metric <= 3 &&
+				     ch_stats->events == 0)) {
+					kp_table_col(table, "");
+					continue;
+				}
+				switch (metric) {
+				case 0:
+					value = (uint64_t)ch_stats->events *
+						100 / ch_stats->passes;
+					break;
+				case 1:
+					value = ch_stats->min_us;
+					break;
+				case 2:
+					value = ch_stats->sum_us /
+						ch_stats->events;
+					break;
+				case 3:
+					value = ch_stats->max_us;
+					break;
+				default:
+					value = ch_stats->spurious;
+					break;
+				}
+				kp_table_col(table, "%u", value);
+			}
+			kp_table_nl(table);
+		}
+	}
+
+	/* Output the passes the samples ran out in, if any models */
+	if (meas->dbnc.conf.model_num == 0) {
+		return;
+	}
+	kp_table_sep(table);
+	kp_table_col(table, "samples");
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (meas->conf.ch_list[ch].dirs) {
+			kp_table_col(table, "%ux%uus",
+				     (uint32_t)KP_SCOPE_SAMPLE_NUM,
+				     meas->dbnc.conf.period_us);
+		}
+	}
+	kp_table_nl(table);
+	kp_table_sep(table);
+	kp_table_col(table, "Cut, %%");
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (!meas->conf.ch_list[ch].dirs) {
+			continue;
+		}
+		/* All models are emulated in the same passes */
+		ch_stats = &meas->dbnc.ch_list[0][ch];
+		if (ch_stats->passes == 0) {
+			kp_table_col(table, "");
+		} else {
+			kp_table_col(table, "%u",
+				     (uint32_t)((uint64_t)
+						meas->dbnc.cut_list[ch] * 100 /
+						ch_stats->passes));
+		}
+	}
+	kp_table_nl(table);
+}
+
+/**
+ * Output histograms for a measurement result. The outliers are put into the
+ * edge steps, instead of stretching the range.
+ *
+ * @param table		The table to output to.
+ * @param meas		The measurement result to output.
+ * @param inliers	The ranges of non-outlier values.
+ * @param verbose	True if the output should be verbose,
+ * 			false otherwise.
+ */
+static void
+kp_meas_print_histogram(struct kp_table *table,
+			const struct kp_meas *meas,
+			const struct kp_meas_inliers *inliers,
+			bool verbose)
+{
+#define STEP_NUM 16
+	uint32_t min, max;
+	uint32_t step_size;
+	size_t step_passes[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM]
+				[STEP_NUM] = {{{0, }}};
+	size_t max_step_passes[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_NUM] = {{0, }};
+	size_t ch, pass;
+	enum kp_cap_dirs dirs;
+	enum kp_cap_ne_dirs ne_dirs;
+	const struct kp_cap_ch_res *ch_res;
+	ssize_t step_idx;
+	uint32_t step_min;
+	char char_buf[sizeof(table->col_buf)];
+	size_t width;
+	size_t char_idx;
+	size_t chars, next_chars;
+	char c;
+
+	assert(kp_table_is_valid(table));
+	assert(table->col_idx == 0);
+	assert(kp_meas_is_valid(meas));
+
+	/* Get the directions we captured in */
+	dirs = kp_meas_get_requested_dirs(meas);
+
+	/* Set histogram width to one character less than column width */
+	snprintf(char_buf, sizeof(char_buf), table->coln_fmt, "");
+	width = strlen(char_buf);
+	assert(width > 0);
+	width--;
+
+	/* Find minimum and maximum non-outlier time for all channels */
+	min = UINT32_MAX;
+	max = 0;
+	for (ch_res = meas->ch_res_list, pass = 0;
+	     pass < meas->passes; pass++) {
+		ne_dirs = kp_cap_ne_dirs_from_down(
+			meas->even_down ^ (pass & 1)
+		);
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (meas->conf.ch_list[ch].dirs &
+			    kp_cap_dirs_from_ne(ne_dirs)) {
+				if (kp_cap_ch_status_is_captured(
+					ch_res->status) &&
+				    !kp_meas_is_outlier(inliers, ch, ne_dirs,
+							ch_res)) {
+					min = MIN(min, ch_res->value_us);
+					max = MAX(max, ch_res->value_us);
+				}
+				ch_res++;
+			}
+		}
+	}
+	/* If minimum and maximum are not found (we had no data) */
+	if (min > max) {
+		min = 0;
+		max = meas->conf.timeout_us + meas->conf.bounce_us;
+	}
+
+	/* Calculate histogram step values per channel */
+	step_size = (max - min) / STEP_NUM;
+	if (step_size == 0) {
+		step_size = KP_CAP_RES_US;
+	}
+	for (ch_res = meas->ch_res_list, pass = 0;
+	     pass < meas->passes; pass++) {
+		ne_dirs = kp_cap_ne_dirs_from_down(
+			meas->even_down ^ (pass & 1)
+		);
 		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
 			if (!(meas->conf.ch_list[ch].dirs &
 			      kp_cap_dirs_from_ne(ne_dirs))) {
 			     continue;
 			}
-			if (ch_res->status == KP_CAP_CH_STATUS_OK ||
-			    ch_res->status == KP_CAP_CH_STATUS_OVERCAPTURE) {
-				step_idx = MIN(
+			if (kp_cap_ch_status_is_captured(ch_res->status)) {
+				step_idx = ch_res->value_us < min ? 0 : MIN(
 					(ch_res->value_us - min) / step_size,
 					STEP_NUM - 1
 				);
@@ -681,7 +1763,8 @@ kp_meas_print_histogram(struct kp_table *table,
 /**
  * Output a measurement result to a shell.
  *
- * @param shell		The shell to output to.
+ * @param shell		The shell to output to, or NULL to only format the
+ *			output (e.g. for benchmarking).
  * @param meas		The measurement result to output.
  * @param verbose	True if the output should be verbose,
  * 			false otherwise.
@@ -691,8 +1774,8 @@ kp_meas_print(const struct shell *shell, const struct kp_meas *meas,
 	      bool verbose)
 {
 	struct kp_table table;
+	struct kp_meas_inliers inliers;
 
-	assert(shell != NULL);
 	assert(kp_meas_is_valid(meas));
 
 	/* Initialize the table output */
@@ -708,6 +1791,9 @@ kp_meas_print(const struct shell *shell, const struct kp_meas *meas,
 	/* Output the index/name header */
 	kp_meas_print_head(&table, meas);
 
+	/* Find the outliers, if detected */
+	kp_meas_get_inliers(meas, &inliers);
+
 	/* Output raw data, if verbose, or got only one captured pass */
 	if (verbose || meas->captured_passes == 1) {
 		kp_meas_print_data(&table, meas);
@@ -717,10 +1803,28 @@ kp_meas_print(const struct shell *shell, const struct kp_meas *meas,
 	if (meas->captured_passes > 1) {
 		/* Output stats */
 		kp_meas_print_stats(&table, meas, verbose);
+		/* Output robust stats and outliers, if detected */
+		if (kp_meas_outlier_mads != 0) {
+			kp_meas_print_robust(&table, meas, &inliers);
+			if (verbose) {
+				kp_meas_print_outliers(&table, meas, &inliers);
+			}
+		}
+		/* Output per-lane stats, if interleaved */
+		kp_meas_print_lanes(&table, meas);
 	}
 
+	/* Output unexpected edges between passes, if monitored */
+	kp_meas_print_mon(&table, meas);
+
+	/* Output pass cycles, if timed on the global timeline */
+	kp_meas_print_tl(&table, meas);
+
+	/* Output debounce model results, if emulated */
+	kp_meas_print_dbnc(&table, meas);
+
 	/* Output histogram */
-	kp_meas_print_histogram(&table, meas, verbose);
+	kp_meas_print_histogram(&table, meas, &inliers, verbose);
 
 	/* Add final separator */
 	kp_table_sep(&table);
@@ -741,8 +1845,7 @@ kp_meas_make_pass(const struct kp_meas *meas, void *data)
 	assert(meas->passes > 0);
 
 	/* If this is the first captured pass */
-	/* NOTE: We promise we won't change it */
-	if (kp_meas_get_ch_res((struct kp_meas *)meas, pass, 0) ==
+	if (kp_meas_get_ch_res_const(meas, pass, 0) ==
 		meas->ch_res_list &&
 	    kp_meas_get_pass_ch_num(meas, pass) != 0) {
 		/* Output the channel index/name header */
@@ -759,11 +1862,11 @@ enum kp_sample_rc
 kp_meas_make(const struct shell *shell, struct kp_meas *meas, bool verbose)
 {
 	struct kp_table table;
+	struct kp_meas_inliers inliers;
 	enum kp_sample_rc rc;
 
 	assert(shell != NULL);
 	assert(kp_meas_is_valid(meas));
-	assert(kp_meas_is_empty(meas));
 
 	/* Initialize the output table */
 	kp_table_init(&table, shell,
@@ -771,6 +1874,13 @@ kp_meas_make(const struct shell *shell, struct kp_meas *meas, bool verbose)
 		      KP_CAP_CH_NAME_MAX_LEN,
 		      1 + kp_meas_get_requested_ch_num(meas));
 
+	/* If verbose, and continuing a measurement with data */
+	if (verbose && meas->captured_passes != 0) {
+		/* Output the headers the pass function won't */
+		kp_meas_print_head(&table, meas);
+		kp_meas_print_data_head(&table, meas);
+	}
+
 	/* Acquire the measurement, printing raw data if verbose */
 	rc = kp_meas_acquire(meas,
 			     (verbose ? kp_meas_make_pass : NULL),
@@ -794,20 +1904,303 @@ kp_meas_make(const struct shell *shell, struct kp_meas *meas, bool verbose)
 		kp_meas_print_head(&table, meas);
 	}
 
+	/* Find the outliers, if detected */
+	kp_meas_get_inliers(meas, &inliers);
+
 	/* If got more than one captured pass */
 	if (meas->captured_passes > 1) {
 		/* Output stats */
 		kp_meas_print_stats(&table, meas, verbose);
+		/* Output robust stats and outliers, if detected */
+		if (kp_meas_outlier_mads != 0) {
+			kp_meas_print_robust(&table, meas, &inliers);
+			if (verbose) {
+				kp_meas_print_outliers(&table, meas, &inliers);
+			}
+		}
+		/* Output per-lane stats, if interleaved */
+		kp_meas_print_lanes(&table, meas);
 	/* Output raw data with header, if hadn't before */
 	} else if (!verbose) {
 		kp_meas_print_data(&table, meas);
 	}
 
+	/* Output unexpected edges between passes, if monitored */
+	kp_meas_print_mon(&table, meas);
+
+	/* Output pass cycles, if timed on the global timeline */
+	kp_meas_print_tl(&table, meas);
+
+	/* Output debounce model results, if emulated */
+	kp_meas_print_dbnc(&table, meas);
+
 	/* Output histogram */
-	kp_meas_print_histogram(&table, meas, verbose);
+	kp_meas_print_histogram(&table, meas, &inliers, verbose);
 
 	/* Add final separator */
 	kp_table_sep(&table);
 
 	return KP_SAMPLE_RC_OK;
 }
+
+/** Maximum number of passes between live dashboard redraws */
+#define KP_MEAS_LIVE_PERIOD_PASSES	64
+
+/** Maximum time between live dashboard redraws, ms */
+#define KP_MEAS_LIVE_PERIOD_MS		250
+
+/**
+ * Number of times other output was interleaved with the live dashboard.
+ * Only incremented by the shell thread, and read whole by the dashboard.
+ */
+static volatile uint32_t kp_meas_live_interrupts;
+
+void
+kp_meas_live_interrupt(void)
+{
+	kp_meas_live_interrupts++;
+}
+
+/** Live measurement dashboard state */
+struct kp_meas_live {
+	/** The table to output the dashboard with */
+	struct kp_table table;
+	/** Uptime at the start of the acquisition, ms */
+	int64_t start_ms;
+	/** Number of measurement passes done at the start of acquisition */
+	size_t start_passes;
+	/** Uptime at the last redraw, ms */
+	int64_t drawn_ms;
+	/** Number of measurement passes done at the last redraw */
+	size_t drawn_passes;
+	/** Number of lines output by the last redraw, zero if none */
+	size_t drawn_lines;
+	/** The value of kp_meas_live_interrupts at the last redraw */
+	uint32_t drawn_interrupts;
+};
+
+/**
+ * Output the statistics rows of a live measurement dashboard: trigger
+ * percentage, and running minimum, mean, and 99th percentile per channel,
+ * for both directions.
+ *
+ * @param table	The table to output to.
+ * @param meas	The measurement to output the statistics for.
+ */
+static void
+kp_meas_live_print_stats(struct kp_table *table, const struct kp_meas *meas)
+{
+	static const char *metric_names[] = {
+		"Trigs, %",
+		"Min, us",
+		"Mean, us",
+		"P99, us",
+	};
+	enum kp_cap_dirs dirs;
+	uint32_t metric_data[ARRAY_SIZE(metric_names)][KP_CAP_CH_NUM];
+	size_t values[KP_CAP_CH_NUM] = {0, };
+	size_t passes[KP_CAP_CH_NUM] = {0, };
+	uint32_t max[KP_CAP_CH_NUM];
+	uint64_t sum[KP_CAP_CH_NUM] = {0, };
+	size_t pass, ch, metric, rank;
+	uint32_t lo, hi, mid;
+	const struct kp_cap_ch_res *ch_res;
+
+	assert(kp_table_is_valid(table));
+	assert(table->col_idx == 0);
+	assert(kp_meas_is_valid(meas));
+
+	dirs = kp_meas_get_requested_dirs(meas);
+
+	/* Aggregate the values captured so far */
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		metric_data[1][ch] = UINT32_MAX;
+		max[ch] = 0;
+	}
+	for (ch_res = meas->ch_res_list, pass = 0;
+	     pass < meas->passes; pass++) {
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (!(meas->conf.ch_list[ch].dirs &
+			      kp_meas_get_pass_dir(meas, pass))) {
+				continue;
+			}
+			passes[ch]++;
+			if (kp_cap_ch_status_is_captured(ch_res->status)) {
+				values[ch]++;
+				sum[ch] += ch_res->value_us;
+				metric_data[1][ch] = MIN(metric_data[1][ch],
+							 ch_res->value_us);
+				max[ch] = MAX(max[ch], ch_res->value_us);
+			}
+			ch_res++;
+		}
+	}
+
+	/* Calculate the metrics */
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		metric_data[0][ch] = passes[ch] ? values[ch] * 100 / passes[ch]
+						: 0;
+		if (values[ch] == 0) {
+			continue;
+		}
+		metric_data[2][ch] = sum[ch] / values[ch];
+		/*
+		 * Binary-search the smallest value with at least 99% of
+		 * values not exceeding it, to avoid storing sorted copies
+		 */
+		rank = (values[ch] * 99 + 99) / 100;
+		for (lo = metric_data[1][ch], hi = max[ch]; lo < hi;) {
+			mid = lo + (hi - lo) / 2;
+			if (kp_meas_count_ch_range(meas, ch, KP_CAP_DIRS_BOTH,
+						   0, mid) >= rank) {
+				hi = mid;
+			} else {
+				lo = mid + 1;
+			}
+		}
+		metric_data[3][ch] = lo;
+	}
+
+	/* Output the metrics */
+	for (metric = 0; metric < ARRAY_SIZE(metric_names); metric++) {
+		kp_table_col(table, "%s", metric_names[metric]);
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (!(meas->conf.ch_list[ch].dirs & dirs)) {
+				continue;
+			}
+			if (passes[ch] == 0 || (metric && values[ch] == 0)) {
+				kp_table_col(table, "");
+			} else {
+				kp_table_col(table, "%u",
+					     metric_data[metric][ch]);
+			}
+		}
+		kp_table_nl(table);
+	}
+}
+
+/**
+ * Erase a previously-drawn live measurement dashboard, if any, and leave the
+ * cursor where it started.
+ *
+ * @param live	The dashboard state.
+ */
+static void
+kp_meas_live_erase(struct kp_meas_live *live)
+{
+	uint32_t interrupts = kp_meas_live_interrupts;
+
+	assert(live != NULL);
+	/*
+	 * If other output came since the last redraw, we don't know where
+	 * our lines are anymore, so leave them, and draw below the output
+	 */
+	if (live->drawn_lines != 0 && interrupts == live->drawn_interrupts) {
+		/* Move up to the first line, and erase to the screen end */
+		shell_fprintf(live->table.shell, SHELL_NORMAL,
+			      "\x1b[%zuA\r\x1b[J", live->drawn_lines);
+	}
+	live->drawn_lines = 0;
+	live->drawn_interrupts = interrupts;
+}
+
+/**
+ * (Re)draw a live measurement dashboard.
+ *
+ * @param live	The dashboard state.
+ * @param meas	The measurement so far.
+ */
+static void
+kp_meas_live_draw(struct kp_meas_live *live, const struct kp_meas *meas)
+{
+	int64_t now_ms = k_uptime_get();
+	uint32_t elapsed_ms = (uint32_t)(now_ms - live->start_ms);
+	size_t passes = meas->passes - live->start_passes;
+	/* Pass rate, hundredths of a pass per second */
+	uint32_t rate = elapsed_ms ? passes * 100000 / elapsed_ms : 0;
+	char eta_buf[KP_FMT_DURATION_LEN];
+
+	assert(live != NULL);
+	assert(kp_meas_is_valid(meas));
+
+	kp_meas_live_erase(live);
+	/* Start a new table for the frame, counting its lines from zero */
+	kp_table_init(&live->table, live->table.shell,
+		      KP_CAP_TIME_MAX_DIGITS + 1,
+		      KP_CAP_CH_NAME_MAX_LEN,
+		      1 + kp_meas_get_requested_ch_num(meas));
+
+	/* Output the progress */
+	shell_fprintf(live->table.shell, SHELL_NORMAL,
+		      "Passes: %zu/%zu, rate: %u.%02u/s, ETA: %s\n",
+		      meas->passes, meas->requested_passes,
+		      rate / 100, rate % 100,
+		      passes == 0 ? "?" : kp_fmt_duration(
+			eta_buf,
+			(uint64_t)elapsed_ms * 1000 *
+			(meas->requested_passes - meas->passes) / passes
+		      ));
+
+	/* Output the running statistics, if there's any data */
+	if (meas->captured_passes != 0) {
+		kp_meas_print_head(&live->table, meas);
+		kp_meas_live_print_stats(&live->table, meas);
+	}
+
+	live->drawn_ms = now_ms;
+	live->drawn_passes = meas->passes;
+	live->drawn_lines = 1 + live->table.line_num;
+}
+
+/**
+ * Register a pass for making a measurement with a live dashboard.
+ *
+ * @param meas	The measurement so far.
+ * @param data	The dashboard state.
+ */
+static void
+kp_meas_make_live_pass(const struct kp_meas *meas, void *data)
+{
+	struct kp_meas_live *live = (struct kp_meas_live *)data;
+
+	assert(meas->passes > 0);
+
+	/* Redraw if enough passes or time went by, or if done */
+	if (meas->passes - live->drawn_passes >= KP_MEAS_LIVE_PERIOD_PASSES ||
+	    k_uptime_get() - live->drawn_ms >= KP_MEAS_LIVE_PERIOD_MS ||
+	    kp_meas_is_complete(meas)) {
+		kp_meas_live_draw(live, meas);
+	}
+}
+
+enum kp_sample_rc
+kp_meas_make_live(const struct shell *shell, struct kp_meas *meas)
+{
+	struct kp_meas_live live;
+	enum kp_sample_rc rc;
+
+	assert(shell != NULL);
+	assert(kp_meas_is_valid(meas));
+
+	/* Initialize the dashboard and draw it for the first time */
+	memset(&live, 0, sizeof(live));
+	kp_table_init(&live.table, shell,
+		      KP_CAP_TIME_MAX_DIGITS + 1,
+		      KP_CAP_CH_NAME_MAX_LEN,
+		      1 + kp_meas_get_requested_ch_num(meas));
+	live.start_ms = k_uptime_get();
+	live.start_passes = meas->passes;
+	kp_meas_live_draw(&live, meas);
+
+	/* Acquire the measurement, redrawing the dashboard, keep it on error */
+	rc = kp_meas_acquire(meas, kp_meas_make_live_pass, &live);
+	if (rc != KP_SAMPLE_RC_OK) {
+		return rc;
+	}
+
+	/* Replace the dashboard with the brief results */
+	kp_meas_live_erase(&live);
+	kp_meas_print(shell, meas, false);
+
+	return KP_SAMPLE_RC_OK;
+}
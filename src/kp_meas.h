@@ -13,22 +13,276 @@
 
 #include "kp_sample.h"
 #include "kp_cap.h"
+#include "kp_mon.h"
+#include "kp_dbnc.h"
 #include <zephyr/shell/shell.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** A window of actuator positions */
+struct kp_meas_win {
+	/* Top position (< bottom), or invalid, if the window is not set */
+	int32_t top;
+	/* Bottom position (> top), or invalid, if the window is not set */
+	int32_t bottom;
+};
+
+/** Windows of actuator positions for each channel and direction */
+struct kp_meas_wins {
+	/* Windows of each channel, in each unit direction */
+	struct kp_meas_win ch_list[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+};
+
+/**
+ * Check if a window is set.
+ *
+ * @param win	The window to check.
+ *
+ * @return True if the window is set, false otherwise.
+ */
+static inline bool
+kp_meas_win_is_set(const struct kp_meas_win *win)
+{
+	assert(win != NULL);
+	return kp_act_pos_is_valid(win->top) &&
+	       kp_act_pos_is_valid(win->bottom) &&
+	       win->top < win->bottom;
+}
+
+/**
+ * Unset all windows.
+ *
+ * @param wins	The windows to unset.
+ */
+static inline void
+kp_meas_wins_clear(struct kp_meas_wins *wins)
+{
+	size_t ch;
+	enum kp_cap_ne_dirs ne_dirs;
+
+	assert(wins != NULL);
+
+	for (ch = 0; ch < ARRAY_SIZE(wins->ch_list); ch++) {
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			wins->ch_list[ch][ne_dirs].top = KP_ACT_POS_INVALID;
+			wins->ch_list[ch][ne_dirs].bottom =
+				KP_ACT_POS_INVALID;
+		}
+	}
+}
+
+/**
+ * Check if two sets of windows are equal.
+ *
+ * @param a	The first set of windows to compare.
+ * @param b	The second set of windows to compare.
+ *
+ * @return True if the windows are equal, false otherwise.
+ */
+static inline bool
+kp_meas_wins_is_equal(const struct kp_meas_wins *a,
+		      const struct kp_meas_wins *b)
+{
+	assert(a != NULL);
+	assert(b != NULL);
+	return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/** Maximum number of configuration lanes interleaved in a measurement */
+#define KP_MEAS_LANE_MAX	4
+
+/** An alternative configuration lane of a measurement */
+struct kp_meas_lane {
+	/* Capture configuration */
+	struct kp_cap_conf conf;
+	/* The speed with which to move, 0-100%. Not used with external trigger */
+	uint32_t speed;
+};
+
+/**
+ * Alternative configuration lanes interleaved with the main configuration
+ * of a measurement (lane zero), each lane doing a turn of passes in order.
+ */
+struct kp_meas_lanes {
+	/* Alternative lanes, i.e. lanes one and up */
+	struct kp_meas_lane alt_list[KP_MEAS_LANE_MAX - 1];
+	/* Number of alternative lanes */
+	size_t alt_num;
+	/* Number of down/up pass pairs in a turn, at least one */
+	size_t cycles;
+};
+
+/**
+ * Remove all alternative lanes, and reset the turn to one pass pair.
+ *
+ * @param lanes	The lanes to clear.
+ */
+static inline void
+kp_meas_lanes_clear(struct kp_meas_lanes *lanes)
+{
+	assert(lanes != NULL);
+	memset(lanes, 0, sizeof(*lanes));
+	lanes->cycles = 1;
+}
+
+/**
+ * Check if an alternative lane can be interleaved with a main configuration,
+ * i.e. it has the same trigger and channels enabled in the same directions,
+ * so their results are laid out identically.
+ *
+ * @param lane	The alternative lane to check.
+ * @param conf	The main capture configuration. Must be valid.
+ *
+ * @return True if the lane is compatible, false otherwise.
+ */
+static inline bool
+kp_meas_lane_is_compatible(const struct kp_meas_lane *lane,
+			   const struct kp_cap_conf *conf)
+{
+	size_t ch;
+
+	assert(lane != NULL);
+	assert(kp_cap_conf_is_valid(conf));
+
+	if (!kp_cap_conf_is_valid(&lane->conf) ||
+	    lane->conf.trig != conf->trig || lane->speed > 100) {
+		return false;
+	}
+	for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+		if (lane->conf.ch_list[ch].dirs != conf->ch_list[ch].dirs) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Check if all alternative lanes are valid and can be interleaved with a
+ * main configuration.
+ *
+ * @param lanes	The lanes to check.
+ * @param conf	The main capture configuration. Must be valid.
+ *
+ * @return True if the lanes are compatible, false otherwise.
+ */
+static inline bool
+kp_meas_lanes_are_compatible(const struct kp_meas_lanes *lanes,
+			     const struct kp_cap_conf *conf)
+{
+	size_t i;
+
+	assert(lanes != NULL);
+
+	if (lanes->alt_num > ARRAY_SIZE(lanes->alt_list) ||
+	    lanes->cycles == 0) {
+		return false;
+	}
+	for (i = 0; i < lanes->alt_num; i++) {
+		if (!kp_meas_lane_is_compatible(&lanes->alt_list[i], conf)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Check if two sets of lanes are equal.
+ *
+ * @param a	The first set of lanes to compare. Must be valid.
+ * @param b	The second set of lanes to compare. Must be valid.
+ *
+ * @return True if the lanes are equal, false otherwise.
+ */
+static inline bool
+kp_meas_lanes_is_equal(const struct kp_meas_lanes *a,
+		       const struct kp_meas_lanes *b)
+{
+	size_t i;
+
+	assert(a != NULL);
+	assert(b != NULL);
+
+	if (a->alt_num != b->alt_num || a->cycles != b->cycles) {
+		return false;
+	}
+	for (i = 0; i < a->alt_num; i++) {
+		if (a->alt_list[i].speed != b->alt_list[i].speed ||
+		    !kp_cap_conf_is_equal(&a->alt_list[i].conf,
+					  &b->alt_list[i].conf)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Statistics of the pass cycles timed on the global capture timeline, i.e.
+ * the intervals between the triggers of consecutive passes in the same
+ * direction.
+ */
+struct kp_meas_tl {
+	/* Number of cycles timed */
+	uint32_t cycles;
+	/* The first cycle, us, only valid if cycles != 0 */
+	uint32_t first_us;
+	/* The last cycle, us, only valid if cycles != 0 */
+	uint32_t last_us;
+	/* Minimum cycle, us, only valid if cycles != 0 */
+	uint32_t min_us;
+	/* Maximum cycle, us, only valid if cycles != 0 */
+	uint32_t max_us;
+	/* Sum of cycles, us */
+	uint64_t sum_us;
+	/*
+	 * Timeline trigger time of the last pass in each unit direction, us,
+	 * or UINT64_MAX, if unknown, e.g. after restarting the timeline.
+	 */
+	uint64_t trig_us_list[KP_CAP_NE_DIRS_BOTH];
+};
+
+/**
+ * Initialize global timeline pass cycle statistics.
+ *
+ * @param tl	The statistics to initialize.
+ */
+static inline void
+kp_meas_tl_init(struct kp_meas_tl *tl)
+{
+	assert(tl != NULL);
+	memset(tl, 0, sizeof(*tl));
+	memset(tl->trig_us_list, 0xff, sizeof(tl->trig_us_list));
+}
+
 /** A measurement in progress */
 struct kp_meas {
 	/* Capture configuration */
 	struct kp_cap_conf conf;
-	/* Top position of the movement range (< bottom) */
+	/*
+	 * Top position of the movement range (< bottom).
+	 * Not used with external trigger.
+	 */
 	int32_t	top;
-	/* Bottom position of the movement range (> top) */
+	/*
+	 * Bottom position of the movement range (> top).
+	 * Not used with external trigger.
+	 */
 	int32_t	bottom;
-	/* The speed with which to move, 0-100% */
+	/*
+	 * Windows of channels within the movement range, traversed instead of
+	 * the whole range by passes in each direction, if set for all channels
+	 * enabled in it. Not used with external trigger.
+	 */
+	struct kp_meas_wins wins;
+	/* The speed with which to move, 0-100%. Not used with external trigger */
 	uint32_t speed;
+	/*
+	 * Alternative configuration lanes, interleaved with the above
+	 * configuration and speed, turn by turn
+	 */
+	struct kp_meas_lanes lanes;
 	/* Number of passes that should be done */
 	size_t requested_passes;
 	/* True if even passes are going down, false if up */
@@ -37,6 +291,14 @@ struct kp_meas {
 	size_t captured_passes;
 	/* Number of all passes done so far */
 	size_t passes;
+	/* Unexpected edges between passes, if monitored */
+	struct kp_mon_stats mon;
+	/* Debounce algorithm model results, if emulated */
+	struct kp_dbnc_stats dbnc;
+	/* Pass cycles timed on the global capture timeline, if running */
+	struct kp_meas_tl tl;
+	/* True if added to the sketch, and so mustn't be added again */
+	bool sketched;
 	/* List of channel capture results for passes so far */
 	struct kp_cap_ch_res ch_res_list[1024];
 };
@@ -56,13 +318,16 @@ kp_meas_is_valid(const struct kp_meas *meas)
 {
 	return meas != NULL &&
 	       kp_cap_conf_is_valid(&meas->conf) &&
-	       kp_act_pos_is_valid(meas->top) &&
-	       kp_act_pos_is_valid(meas->bottom) &&
-	       meas->top < meas->bottom &&
-	       meas->speed <= 100 &&
+	       (meas->conf.trig == KP_CAP_TRIG_EXT || (
+		       kp_act_pos_is_valid(meas->top) &&
+		       kp_act_pos_is_valid(meas->bottom) &&
+		       meas->top < meas->bottom &&
+		       meas->speed <= 100
+	       )) &&
 	       (meas->even_down & 1) == meas->even_down &&
 	       meas->passes <= meas->requested_passes &&
 	       kp_cap_conf_ch_num(&meas->conf, KP_CAP_DIRS_BOTH) > 0 &&
+	       kp_meas_lanes_are_compatible(&meas->lanes, &meas->conf) &&
 	       kp_cap_conf_ch_res_idx(&meas->conf, meas->even_down,
 				      meas->passes, 0) <=
 		       ARRAY_SIZE(meas->ch_res_list);
@@ -97,6 +362,172 @@ kp_meas_is_empty(const struct kp_meas *meas)
 	return meas->passes == 0;
 }
 
+/**
+ * Check if a measurement is complete, i.e. has all requested passes done.
+ *
+ * @param meas	The measurement to check. Must be valid.
+ *
+ * @return True if the measurement is complete, false otherwise.
+ */
+static inline bool
+kp_meas_is_complete(const struct kp_meas *meas)
+{
+	assert(kp_meas_is_valid(meas));
+	return meas->passes == meas->requested_passes;
+}
+
+/**
+ * Select the windows within a movement range, leaving the rest unset.
+ *
+ * @param wins		Location for the selected windows.
+ * @param top		The top position of the movement range.
+ * @param bottom	The bottom position of the movement range.
+ * @param src_wins	The windows to select from, or NULL for none.
+ */
+static inline void
+kp_meas_wins_select(struct kp_meas_wins *wins,
+		    int32_t top, int32_t bottom,
+		    const struct kp_meas_wins *src_wins)
+{
+	size_t ch;
+	enum kp_cap_ne_dirs ne_dirs;
+	const struct kp_meas_win *win;
+
+	assert(wins != NULL);
+
+	kp_meas_wins_clear(wins);
+	if (src_wins == NULL) {
+		return;
+	}
+	for (ch = 0; ch < ARRAY_SIZE(wins->ch_list); ch++) {
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			win = &src_wins->ch_list[ch][ne_dirs];
+			if (kp_meas_win_is_set(win) &&
+			    win->top >= top && win->bottom <= bottom) {
+				wins->ch_list[ch][ne_dirs] = *win;
+			}
+		}
+	}
+}
+
+/**
+ * Get the range of positions traversed by passes in a direction, given the
+ * movement range and the channel windows: the union of the windows of
+ * channels enabled in it, if all of them have windows set, and the whole
+ * movement range otherwise.
+ *
+ * @param top		The top position of the movement range.
+ * @param bottom	The bottom position of the movement range.
+ * @param wins		The channel windows within the movement range
+ *			(see kp_meas_wins_select()).
+ * @param conf		The capture configuration. Must be valid.
+ * @param dir		The (unit) direction to get the range for.
+ * @param ptop		Location for the top position of the range.
+ * @param pbottom	Location for the bottom position of the range.
+ */
+static inline void
+kp_meas_wins_get_dir_range(int32_t top, int32_t bottom,
+			   const struct kp_meas_wins *wins,
+			   const struct kp_cap_conf *conf,
+			   enum kp_cap_dirs dir,
+			   int32_t *ptop, int32_t *pbottom)
+{
+	size_t ch;
+	const struct kp_meas_win *win;
+	int32_t wins_top = KP_ACT_POS_MAX;
+	int32_t wins_bottom = KP_ACT_POS_MIN;
+
+	assert(wins != NULL);
+	assert(kp_cap_conf_is_valid(conf));
+	assert(kp_cap_dirs_is_unit(dir));
+	assert(ptop != NULL);
+	assert(pbottom != NULL);
+
+	for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+		if (!(conf->ch_list[ch].dirs & dir)) {
+			continue;
+		}
+		win = &wins->ch_list[ch][kp_cap_dirs_to_ne(dir)];
+		if (!kp_meas_win_is_set(win)) {
+			wins_top = KP_ACT_POS_MAX;
+			break;
+		}
+		wins_top = MIN(wins_top, win->top);
+		wins_bottom = MAX(wins_bottom, win->bottom);
+	}
+
+	/* If not all (or none) of the channels have windows */
+	if (wins_top >= wins_bottom) {
+		wins_top = top;
+		wins_bottom = bottom;
+	}
+
+	*ptop = wins_top;
+	*pbottom = wins_bottom;
+}
+
+/**
+ * Check if a measurement was (or would be) made with the specified
+ * parameters, and so can be continued with them. The positions, windows, and
+ * the speed are not compared for external-trigger measurements.
+ *
+ * @param meas		The measurement to check. Must be valid.
+ * @param top		The top position of the movement range.
+ * @param bottom	The bottom position of the movement range.
+ * @param wins		The channel windows, or NULL for none.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param conf		The capture configuration. Must be valid.
+ * @param lanes		The alternative lanes, or NULL for none.
+ *
+ * @return True if the measurement parameters match, false otherwise.
+ */
+static inline bool
+kp_meas_matches(const struct kp_meas *meas,
+		int32_t top, int32_t bottom,
+		const struct kp_meas_wins *wins,
+		uint32_t speed,
+		const struct kp_cap_conf *conf,
+		const struct kp_meas_lanes *lanes)
+{
+	struct kp_meas_wins selected_wins;
+	struct kp_meas_lanes no_lanes;
+
+	assert(kp_meas_is_valid(meas));
+	assert(kp_cap_conf_is_valid(conf));
+
+	if (lanes == NULL) {
+		kp_meas_lanes_clear(&no_lanes);
+		lanes = &no_lanes;
+	}
+	kp_meas_wins_select(&selected_wins, top, bottom, wins);
+	return (conf->trig == KP_CAP_TRIG_EXT || (
+			meas->top == top &&
+			meas->bottom == bottom &&
+			kp_meas_wins_is_equal(&meas->wins, &selected_wins) &&
+			meas->speed == speed
+		)) &&
+	       kp_cap_conf_is_equal(&meas->conf, conf) &&
+	       kp_meas_lanes_is_equal(&meas->lanes, lanes);
+}
+
+/**
+ * Request more passes to be done for a measurement. The caller must ensure
+ * all requested capture results can be accommodated.
+ *
+ * @param meas		The measurement to extend. Must be valid.
+ * @param passes	The number of passes to add.
+ */
+static inline void
+kp_meas_append(struct kp_meas *meas, size_t passes)
+{
+	assert(kp_meas_is_valid(meas));
+	assert(kp_cap_conf_ch_res_idx(&meas->conf, meas->even_down,
+				      meas->requested_passes + passes, 0) <=
+	       ARRAY_SIZE(meas->ch_res_list));
+	meas->requested_passes += passes;
+	assert(kp_meas_is_valid(meas));
+}
+
 /**
  * Initialize an empty measurement for a number of passes over a range of
  * actuator positions. The caller must ensure all requested capture results
@@ -105,41 +536,63 @@ kp_meas_is_empty(const struct kp_meas *meas)
  * @param meas		The measurement to initialize.
  * @param top		The top position of the movement range.
  * 			Must be less than the bottom.
+ * 			Ignored with external trigger.
  * @param bottom	The bottom position of the movement range.
  * 			Must be greater than the top.
+ * 			Ignored with external trigger.
+ * @param wins		The channel windows to use, or NULL for none.
+ *			Only the windows within the movement range are used.
+ * 			Ignored with external trigger.
  * @param speed		The speed with which to move, 0-100%.
+ * 			Ignored with external trigger.
  * @param passes	Number of actuator passes to execute.
  * @param conf		The capture configuration to use.
  * 			Must be valid, and have at least one channel enabled
  * 			in at least one direction.
  * @param even_down	True if even passes must be going down, false if up.
+ * @param lanes		The alternative configuration lanes to interleave
+ *			with the above configuration and speed, or NULL for
+ *			none. Must be compatible with the configuration.
  */
 static inline void
 kp_meas_init(struct kp_meas *meas,
 	     int32_t top, int32_t bottom,
+	     const struct kp_meas_wins *wins,
 	     uint32_t speed, size_t passes,
 	     const struct kp_cap_conf *conf,
-	     bool even_down)
+	     bool even_down,
+	     const struct kp_meas_lanes *lanes)
 {
 	assert(meas != NULL);
-	assert(kp_act_pos_is_valid(top));
-	assert(kp_act_pos_is_valid(bottom));
-	assert(top < bottom);
-	assert(speed <= 100);
 	assert(kp_cap_conf_is_valid(conf));
+	assert(conf->trig == KP_CAP_TRIG_EXT || kp_act_pos_is_valid(top));
+	assert(conf->trig == KP_CAP_TRIG_EXT || kp_act_pos_is_valid(bottom));
+	assert(conf->trig == KP_CAP_TRIG_EXT || top < bottom);
+	assert(conf->trig == KP_CAP_TRIG_EXT || speed <= 100);
 	assert((even_down & 1) == even_down);
 	assert(kp_cap_conf_ch_num(conf, KP_CAP_DIRS_BOTH) > 0);
 	assert(kp_cap_conf_ch_res_idx(conf, even_down, passes, 0) <=
 	       ARRAY_SIZE(meas->ch_res_list));
+	assert(lanes == NULL || kp_meas_lanes_are_compatible(lanes, conf));
 
 	meas->conf = *conf;
 	meas->top = top;
 	meas->bottom = bottom;
+	kp_meas_wins_select(&meas->wins, top, bottom, wins);
 	meas->speed = speed;
+	if (lanes == NULL) {
+		kp_meas_lanes_clear(&meas->lanes);
+	} else {
+		meas->lanes = *lanes;
+	}
 	meas->requested_passes = passes;
 	meas->even_down = even_down;
 	meas->captured_passes = 0;
 	meas->passes = 0;
+	kp_mon_stats_init(&meas->mon);
+	kp_dbnc_stats_init(&meas->dbnc);
+	kp_meas_tl_init(&meas->tl);
+	meas->sketched = false;
 
 	assert(kp_meas_is_valid(meas));
 	assert(kp_meas_is_empty(meas));
@@ -195,6 +648,91 @@ kp_meas_get_pass_dir(const struct kp_meas *meas, size_t pass)
 	return kp_cap_dirs_from_down((pass ^ meas->even_down) & 1);
 }
 
+/**
+ * Get the number of configuration lanes of a measurement, including the
+ * main one.
+ *
+ * @param meas	The measurement to get the number of lanes for.
+ *
+ * @return The number of lanes, at least one.
+ */
+static inline size_t
+kp_meas_get_lane_num(const struct kp_meas *meas)
+{
+	assert(kp_meas_is_valid(meas));
+	return 1 + meas->lanes.alt_num;
+}
+
+/**
+ * Get the configuration lane a measurement pass belongs to.
+ *
+ * @param meas	The measurement to get the pass lane for.
+ * @param pass	The pass to get the lane for.
+ *		Must be less than the number of requested passes.
+ *
+ * @return The index of the pass lane, zero for the main configuration.
+ */
+static inline size_t
+kp_meas_get_pass_lane(const struct kp_meas *meas, size_t pass)
+{
+	assert(kp_meas_is_valid(meas));
+	assert(pass < meas->requested_passes);
+	return (pass / (meas->lanes.cycles * 2)) % kp_meas_get_lane_num(meas);
+}
+
+/**
+ * Get the capture configuration of a measurement lane.
+ *
+ * @param meas	The measurement to get the lane configuration for.
+ * @param lane	The index of the lane to get the configuration for.
+ *
+ * @return The capture configuration of the lane.
+ */
+static inline const struct kp_cap_conf *
+kp_meas_get_lane_conf(const struct kp_meas *meas, size_t lane)
+{
+	assert(kp_meas_is_valid(meas));
+	assert(lane < kp_meas_get_lane_num(meas));
+	return lane == 0 ? &meas->conf : &meas->lanes.alt_list[lane - 1].conf;
+}
+
+/**
+ * Get the speed of a measurement lane.
+ *
+ * @param meas	The measurement to get the lane speed for.
+ * @param lane	The index of the lane to get the speed for.
+ *
+ * @return The speed of the lane, 0-100%.
+ */
+static inline uint32_t
+kp_meas_get_lane_speed(const struct kp_meas *meas, size_t lane)
+{
+	assert(kp_meas_is_valid(meas));
+	assert(lane < kp_meas_get_lane_num(meas));
+	return lane == 0 ? meas->speed : meas->lanes.alt_list[lane - 1].speed;
+}
+
+/**
+ * Get the range of positions traversed by measurement passes in a direction:
+ * the union of the windows of channels enabled in it, if all of them have
+ * windows set, and the whole movement range otherwise.
+ *
+ * @param meas		The measurement to get the range for.
+ *			Must be valid and use the actuator trigger.
+ * @param dir		The (unit) direction to get the range for.
+ * @param ptop		Location for the top position of the range.
+ * @param pbottom	Location for the bottom position of the range.
+ */
+static inline void
+kp_meas_get_dir_range(const struct kp_meas *meas, enum kp_cap_dirs dir,
+		      int32_t *ptop, int32_t *pbottom)
+{
+	assert(kp_meas_is_valid(meas));
+	assert(meas->conf.trig == KP_CAP_TRIG_ACT);
+	kp_meas_wins_get_dir_range(meas->top, meas->bottom, &meas->wins,
+				   &meas->conf, dir, ptop, pbottom);
+}
+
 /**
  * Get the number of captured channels for a specific measurement pass.
  *
@@ -239,6 +777,98 @@ kp_meas_get_ch_res(struct kp_meas *meas, size_t pass, size_t ch)
 		kp_cap_conf_ch_res_idx(&meas->conf, meas->even_down, pass, ch);
 }
 
+/**
+ * Get the pointer to a channel result in the channel result list of the
+ * specified constant measurement, for the specified pass and channel indices.
+ * See kp_meas_get_ch_res().
+ *
+ * @param meas	The measurement to get the channel result from.
+ * @param pass	The index of the pass to get the channel result for.
+ *		Must be less than the number of passes in the measurement.
+ * @param ch	The index of the channel to get the result for.
+ *		Must be less than the number of capture channels.
+ *
+ * @return The pointer to the result of the channel in the measurement's pass.
+ */
+static inline const struct kp_cap_ch_res *
+kp_meas_get_ch_res_const(const struct kp_meas *meas, size_t pass, size_t ch)
+{
+	assert(kp_meas_is_valid(meas));
+	assert(pass < meas->passes);
+	assert(ch < ARRAY_SIZE(meas->conf.ch_list));
+	return meas->ch_res_list +
+		kp_cap_conf_ch_res_idx(&meas->conf, meas->even_down, pass, ch);
+}
+
+/** Summary of a measurement's channel results */
+struct kp_meas_ch_sum {
+	/** Number of passes the channel was captured in */
+	size_t passes;
+	/** Number of passes the channel triggered in */
+	size_t triggers;
+	/** Minimum captured time, us, only valid if triggers != 0 */
+	uint32_t min_us;
+	/** Mean captured time, us, only valid if triggers != 0 */
+	uint32_t mean_us;
+	/** Maximum captured time, us, only valid if triggers != 0 */
+	uint32_t max_us;
+};
+
+/**
+ * Summarize the results of a measurement's channel.
+ *
+ * @param meas	The measurement to summarize the channel results of.
+ * @param ch	The index of the channel to summarize.
+ * @param dirs	The directions to summarize the channel results for.
+ * @param sum	Location for the summary.
+ */
+extern void kp_meas_get_ch_sum(const struct kp_meas *meas, size_t ch,
+			       enum kp_cap_dirs dirs,
+			       struct kp_meas_ch_sum *sum);
+
+/** The lane index standing for all lanes of a measurement */
+#define KP_MEAS_LANE_ALL	SIZE_MAX
+
+/**
+ * Summarize the results of a measurement's channel in a lane.
+ *
+ * @param meas	The measurement to summarize the channel results of.
+ * @param ch	The index of the channel to summarize.
+ * @param dirs	The directions to summarize the channel results for.
+ * @param lane	The index of the lane to summarize the channel results for,
+ *		or KP_MEAS_LANE_ALL for all lanes.
+ * @param sum	Location for the summary.
+ */
+extern void kp_meas_get_ch_lane_sum(const struct kp_meas *meas, size_t ch,
+				    enum kp_cap_dirs dirs, size_t lane,
+				    struct kp_meas_ch_sum *sum);
+
+/** Default number of MADs away from the median marking an outlier */
+#define KP_MEAS_OUTLIER_MADS_DEF	5
+
+/** Maximum number of MADs away from the median marking an outlier */
+#define KP_MEAS_OUTLIER_MADS_MAX	100
+
+/**
+ * Set the number of median absolute deviations (MADs) a channel value has to
+ * be away from the median of its channel and direction to be flagged as an
+ * outlier in measurement output. Outliers are counted and listed separately,
+ * and excluded from the robust statistics and the histogram range. The
+ * measurement data is not changed.
+ *
+ * @param mads	The number of MADs, zero to disable outlier detection.
+ *		Must not exceed KP_MEAS_OUTLIER_MADS_MAX.
+ */
+extern void kp_meas_set_outlier_mads(uint32_t mads);
+
+/**
+ * Get the number of median absolute deviations (MADs) a channel value has to
+ * be away from the median to be flagged as an outlier.
+ *
+ * @return The number of MADs, zero if outlier detection is disabled.
+ */
+extern uint32_t kp_meas_get_outlier_mads(void);
+
 /**
  * Prototype for a function notifying about an acquired pass.
  *
@@ -249,10 +879,78 @@ typedef void (*kp_meas_acquire_pass_fn)(const struct kp_meas *meas,
 					void *data);
 
 /**
- * Acquire an initalized measurement.
+ * Number of consecutive passes with stuck channels, after which a
+ * measurement acquisition is given up.
+ */
+#define KP_MEAS_STUCK_PASSES_MAX	8
+
+/** Results of a channel in one direction, accumulated over passes */
+struct kp_meas_ch_acc {
+	/** Number of passes the channel was captured in */
+	uint32_t passes;
+	/** Number of passes the channel triggered in */
+	uint32_t triggers;
+	/** Minimum captured time, us, only valid if triggers != 0 */
+	uint32_t min_us;
+	/** Maximum captured time, us, only valid if triggers != 0 */
+	uint32_t max_us;
+	/** Sum of captured times, us */
+	uint64_t sum_us;
+	/** Sum of squares of captured times, us^2 */
+	uint64_t sum_sq_us;
+};
+
+/**
+ * Add a channel's result of a pass to its accumulated results.
+ *
+ * @param acc		The accumulated results to add to. Must be zeroed
+ *			before adding the first result.
+ * @param ch_res	The channel result to add.
+ *
+ * @return True if the channel triggered, and so its value was added,
+ *	   false otherwise.
+ */
+extern bool kp_meas_ch_acc_add(struct kp_meas_ch_acc *acc,
+			       const struct kp_cap_ch_res *ch_res);
+
+/**
+ * A snapshot of the progress of the measurement being acquired, published
+ * after every pass.
+ */
+struct kp_meas_progress {
+	/** True if a measurement is being acquired */
+	bool acquiring;
+	/** Uptime the acquisition started at, ms */
+	int64_t start_ms;
+	/** Number of passes done when the acquisition started */
+	uint32_t start_passes;
+	/** Number of all passes done so far */
+	uint32_t passes;
+	/** Number of passes that should be done */
+	uint32_t requested_passes;
+	/** Number of passes with captured channel results so far */
+	uint32_t captured_passes;
+	/** The results of each channel in each unit direction, so far */
+	struct kp_meas_ch_acc ch_list[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+};
+
+/**
+ * Retrieve a consistent snapshot of the progress of the measurement being
+ * acquired, or of the last one acquired, without waiting for the pass in
+ * progress. Can be called from any thread.
+ *
+ * @param progress	Location for the snapshot.
+ */
+extern void kp_meas_get_progress(struct kp_meas_progress *progress);
+
+/**
+ * Acquire an initalized measurement, continuing from the last pass done, if
+ * any, and until all the requested passes are done, or until channels were
+ * stuck in KP_MEAS_STUCK_PASSES_MAX consecutive passes. Publish the progress
+ * for kp_meas_get_progress() after every pass.
  *
  * @param meas		The measurement to acquire.
- *			Must be initialized and empty.
+ *			Must be initialized.
  * @param pass_fn	The function to call for every pass-worth of samples.
  * 			Can be NULL to have nothing called.
  * @param pass_data	The data to pass to pass_fn with each call.
@@ -266,7 +964,8 @@ extern enum kp_sample_rc kp_meas_acquire(struct kp_meas *meas,
 /**
  * Output a measurement result to a shell.
  *
- * @param shell		The shell to output to.
+ * @param shell		The shell to output to, or NULL to only format the
+ *			output (e.g. for benchmarking).
  * @param meas		The measurement result to output.
  * @param verbose	True if the output should be verbose,
  * 			false otherwise.
@@ -276,11 +975,12 @@ extern void kp_meas_print(const struct shell *shell,
 			  bool verbose);
 
 /**
- * Make (acquire and print) an initialized measurement.
+ * Make (acquire and print) an initialized measurement, continuing from the
+ * last pass done, if any.
  *
  * @param shell		The shell to output the measurement to.
  * @param meas		The measurement to acquire and print.
- *			Must be initialized and empty.
+ *			Must be initialized.
  * @param verbose	True if the output should be verbose,
  * 			false otherwise.
  */
@@ -288,6 +988,28 @@ extern enum kp_sample_rc kp_meas_make(const struct shell *shell,
 				      struct kp_meas *meas,
 				      bool verbose);
 
+/**
+ * Note that other output was interleaved with the live measurement dashboard,
+ * if one is being shown, so it draws its next frame anew below that output,
+ * instead of erasing the previous frame, which it can no longer locate.
+ * Must be called from the shell thread only, after the output.
+ */
+extern void kp_meas_live_interrupt(void);
+
+/**
+ * Make (acquire and print) an initialized measurement, continuing from the
+ * last pass done, if any. Show a live dashboard with the progress and running
+ * statistics while acquiring, redrawing it in place periodically, so the
+ * output doesn't grow with the number of passes. Replace it with brief
+ * results when done.
+ *
+ * @param shell		The shell to output the measurement to.
+ * @param meas		The measurement to acquire and print.
+ *			Must be initialized.
+ */
+extern enum kp_sample_rc kp_meas_make_live(const struct shell *shell,
+					   struct kp_meas *meas);
+
 #ifdef __cplusplus
 }
 #endif
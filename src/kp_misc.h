@@ -14,6 +14,8 @@
 #include <zephyr/sys/util.h>
 #include <strings.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +27,57 @@ kp_strcasecmp(const char *a, const char *b)
 	return strncasecmp(a, b, MAX(strlen(a), strlen(b)));
 }
 
+/** Length of a buffer for a duration formatted by kp_fmt_duration() */
+#define KP_FMT_DURATION_LEN	sizeof("4294967295:59:59.999")
+
+/**
+ * Format a duration as hours, minutes, seconds, and milliseconds.
+ *
+ * @param buf	The buffer to format the duration into.
+ *		Must be at least KP_FMT_DURATION_LEN bytes long.
+ * @param us	The duration to format, us.
+ *
+ * @return The buffer with the formatted duration.
+ */
+static inline const char *
+kp_fmt_duration(char *buf, uint64_t us)
+{
+	uint64_t ms = us / 1000;
+	snprintf(buf, KP_FMT_DURATION_LEN, "%u:%02u:%02u.%03u",
+		 (uint32_t)(ms / 3600000),
+		 (uint32_t)(ms / 60000 % 60),
+		 (uint32_t)(ms / 1000 % 60),
+		 (uint32_t)(ms % 1000));
+	return buf;
+}
+
+/**
+ * Calculate the integer square root of a number, rounded down.
+ *
+ * @param n	The number to calculate the square root of.
+ *
+ * @return The square root.
+ */
+static inline uint32_t
+kp_isqrt64(uint64_t n)
+{
+	uint64_t root = 0;
+	uint64_t bit = (uint64_t)1 << 62;
+
+	while (bit > n) {
+		bit >>= 2;
+	}
+	for (; bit != 0; bit >>= 2) {
+		if (n >= root + bit) {
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+	}
+	return (uint32_t)root;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,240 @@
+/** @file
+ *  @brief Keypecker between-pass channel monitor
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_mon.h"
+#include <zephyr/kernel.h>
+
+/** The GPIO port the channel inputs are on, NULL if not initialized */
+static const struct device *kp_mon_gpio = NULL;
+
+/** The pins the channel inputs are on */
+static gpio_pin_t kp_mon_pin_list[KP_CAP_CH_NUM];
+
+/** The GPIO callback counting the edges */
+static struct gpio_callback kp_mon_callback;
+
+/** True if the monitor is enabled */
+static bool kp_mon_enabled;
+
+/** The statistics to add the monitored gaps to, NULL if detached */
+static struct kp_mon_stats *kp_mon_stats;
+
+/** True if a gap is being monitored */
+static bool kp_mon_gap_started;
+
+/** True if the edges of the monitored gap are being counted */
+static bool kp_mon_gap_counting;
+
+/** The cycle counter at the start of the monitored gap */
+static uint32_t kp_mon_gap_start_cycles;
+
+/** The unexpected edge statistics of the monitored gap */
+static struct kp_mon_stats kp_mon_gap;
+
+/** The gap state spinlock */
+static struct k_spinlock kp_mon_lock;
+
+/**
+ * Count channel edges.
+ *
+ * @param port	The GPIO port the edges arrived on.
+ * @param cb	The GPIO callback.
+ * @param pins	The mask of pins the edges arrived on.
+ */
+static void
+kp_mon_callback_handler(const struct device *port,
+			struct gpio_callback *cb,
+			gpio_port_pins_t pins)
+{
+	k_spinlock_key_t key;
+	uint32_t us;
+	size_t ch;
+	struct kp_mon_ch_stats *ch_stats;
+
+	ARG_UNUSED(port);
+	ARG_UNUSED(cb);
+
+	key = k_spin_lock(&kp_mon_lock);
+	if (kp_mon_gap_counting) {
+		us = k_cyc_to_us_floor32(k_cycle_get_32() -
+					 kp_mon_gap_start_cycles);
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (!(pins & BIT(kp_mon_pin_list[ch]))) {
+				continue;
+			}
+			ch_stats = &kp_mon_gap.ch_list[ch];
+			if (ch_stats->edges == 0) {
+				ch_stats->min_us = us;
+			}
+			ch_stats->edges++;
+			ch_stats->max_us = us;
+		}
+	}
+	k_spin_unlock(&kp_mon_lock, key);
+}
+
+bool
+kp_mon_is_initialized(void)
+{
+	return kp_mon_gpio != NULL;
+}
+
+void
+kp_mon_init(const struct device *gpio, const gpio_pin_t *pin_list)
+{
+	size_t ch;
+	gpio_port_pins_t pin_mask = 0;
+
+	assert(!kp_mon_is_initialized());
+	assert(gpio != NULL);
+	assert(pin_list != NULL);
+
+	kp_mon_gpio = gpio;
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		kp_mon_pin_list[ch] = pin_list[ch];
+		pin_mask |= BIT(pin_list[ch]);
+	}
+	gpio_init_callback(&kp_mon_callback, kp_mon_callback_handler,
+			   pin_mask);
+	gpio_add_callback(kp_mon_gpio, &kp_mon_callback);
+
+	assert(kp_mon_is_initialized());
+}
+
+void
+kp_mon_set_enabled(bool enabled)
+{
+	assert(kp_mon_is_initialized());
+	kp_mon_enabled = enabled;
+}
+
+bool
+kp_mon_is_enabled(void)
+{
+	assert(kp_mon_is_initialized());
+	return kp_mon_enabled;
+}
+
+/**
+ * Enable or disable edge interrupts on all channel pins.
+ *
+ * @param enabled	True to enable the interrupts, false to disable.
+ */
+static void
+kp_mon_set_interrupts(bool enabled)
+{
+	size_t ch;
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		gpio_pin_interrupt_configure(kp_mon_gpio, kp_mon_pin_list[ch],
+					     enabled ? GPIO_INT_EDGE_BOTH
+						     : GPIO_INT_DISABLE);
+	}
+}
+
+void
+kp_mon_attach(struct kp_mon_stats *stats)
+{
+	assert(kp_mon_is_initialized());
+	assert(stats != NULL);
+	assert(kp_mon_stats == NULL);
+	kp_mon_stats = stats;
+}
+
+void
+kp_mon_detach(void)
+{
+	assert(kp_mon_is_initialized());
+	kp_mon_gap_finish();
+	kp_mon_stats = NULL;
+}
+
+void
+kp_mon_gap_start(void)
+{
+	k_spinlock_key_t key;
+
+	assert(kp_mon_is_initialized());
+
+	if (!kp_mon_enabled || kp_mon_stats == NULL || kp_mon_gap_started) {
+		return;
+	}
+
+	key = k_spin_lock(&kp_mon_lock);
+	kp_mon_stats_init(&kp_mon_gap);
+	kp_mon_gap_start_cycles = k_cycle_get_32();
+	kp_mon_gap_started = true;
+	kp_mon_gap_counting = true;
+	k_spin_unlock(&kp_mon_lock, key);
+
+	kp_mon_set_interrupts(true);
+}
+
+void
+kp_mon_gap_stop(void)
+{
+	k_spinlock_key_t key;
+
+	assert(kp_mon_is_initialized());
+
+	key = k_spin_lock(&kp_mon_lock);
+	kp_mon_gap_counting = false;
+	k_spin_unlock(&kp_mon_lock, key);
+
+	/* Don't take edge interrupts during the capture, they're ignored */
+	if (kp_mon_gap_started) {
+		kp_mon_set_interrupts(false);
+	}
+}
+
+void
+kp_mon_gap_finish(void)
+{
+	k_spinlock_key_t key;
+	size_t ch;
+	struct kp_mon_ch_stats *gap_ch_stats;
+	struct kp_mon_ch_stats *ch_stats;
+	struct kp_mon_stats *stats = kp_mon_stats;
+
+	assert(kp_mon_is_initialized());
+
+	if (!kp_mon_gap_started) {
+		return;
+	}
+	assert(stats != NULL);
+
+	kp_mon_set_interrupts(false);
+
+	key = k_spin_lock(&kp_mon_lock);
+	kp_mon_gap_started = false;
+	kp_mon_gap_counting = false;
+	k_spin_unlock(&kp_mon_lock, key);
+
+	/* Add the gap to the statistics */
+	stats->gaps++;
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		gap_ch_stats = &kp_mon_gap.ch_list[ch];
+		ch_stats = &stats->ch_list[ch];
+		if (gap_ch_stats->edges == 0) {
+			continue;
+		}
+		if (ch_stats->edges == 0) {
+			ch_stats->min_us = gap_ch_stats->min_us;
+			ch_stats->max_us = gap_ch_stats->max_us;
+		}
+		ch_stats->edges += gap_ch_stats->edges;
+		ch_stats->gaps++;
+		ch_stats->gap_edges_max = MAX(ch_stats->gap_edges_max,
+					      gap_ch_stats->edges);
+		ch_stats->min_us = MIN(ch_stats->min_us,
+				       gap_ch_stats->min_us);
+		ch_stats->max_us = MAX(ch_stats->max_us,
+				       gap_ch_stats->max_us);
+	}
+}
@@ -0,0 +1,139 @@
+/** @file
+ *  @brief Keypecker between-pass channel monitor
+ *
+ *  The monitor counts channel edges arriving in the gaps between pass
+ *  captures, when no edges are expected, e.g. chatter after settling, or
+ *  ghost events induced by other keys. A gap lasts from the end of a pass
+ *  capture, through the rest of its stroke, any idle time, and the move to
+ *  the start of the next pass, until the next capture starts. Edges are
+ *  timestamped relative to the gap start. Gaps are only monitored while
+ *  statistics are attached to collect them, e.g. during a measurement.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_MON_H_
+#define KP_MON_H_
+
+#include "kp_cap.h"
+#include <zephyr/drivers/gpio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Unexpected edge statistics of a channel */
+struct kp_mon_ch_stats {
+	/** Number of unexpected edges */
+	uint32_t edges;
+	/** Number of gaps with unexpected edges */
+	uint32_t gaps;
+	/** Maximum number of unexpected edges in a gap */
+	uint32_t gap_edges_max;
+	/** Earliest edge since its gap start, us, only valid if edges != 0 */
+	uint32_t min_us;
+	/** Latest edge since its gap start, us, only valid if edges != 0 */
+	uint32_t max_us;
+};
+
+/** Unexpected edge statistics */
+struct kp_mon_stats {
+	/** Number of monitored gaps */
+	uint32_t gaps;
+	/** Statistics for each channel */
+	struct kp_mon_ch_stats ch_list[KP_CAP_CH_NUM];
+};
+
+/**
+ * Initialize unexpected edge statistics.
+ *
+ * @param stats	The statistics to initialize.
+ */
+static inline void
+kp_mon_stats_init(struct kp_mon_stats *stats)
+{
+	assert(stats != NULL);
+	memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * Check if the monitor is initialized.
+ *
+ * @return True if the monitor is initialized, false otherwise.
+ */
+extern bool kp_mon_is_initialized(void);
+
+/**
+ * Initialize the monitor.
+ *
+ * @param gpio		The GPIO port the channel inputs are on.
+ * @param pin_list	The list of KP_CAP_CH_NUM pins the channel inputs
+ *			are on.
+ */
+extern void kp_mon_init(const struct device *gpio,
+			const gpio_pin_t *pin_list);
+
+/**
+ * Enable or disable the monitor. Gaps started while the monitor is disabled
+ * are not monitored.
+ *
+ * @param enabled	True to enable the monitor, false to disable.
+ */
+extern void kp_mon_set_enabled(bool enabled);
+
+/**
+ * Check if the monitor is enabled.
+ *
+ * @return True if the monitor is enabled, false otherwise.
+ */
+extern bool kp_mon_is_enabled(void);
+
+/**
+ * Attach statistics to add the monitored gaps to, until detached.
+ * No statistics must be attached already.
+ *
+ * @param stats	The statistics to attach.
+ */
+extern void kp_mon_attach(struct kp_mon_stats *stats);
+
+/**
+ * Finish the gap being monitored, if any, and detach the statistics, if
+ * attached.
+ */
+extern void kp_mon_detach(void);
+
+/**
+ * Start monitoring a gap between passes, if the monitor is enabled,
+ * statistics are attached, and a gap is not being monitored already.
+ */
+extern void kp_mon_gap_start(void);
+
+/**
+ * Stop counting the edges of the gap being monitored, if any, and disable
+ * the edge interrupts, without finishing it. Doesn't block, and so can be
+ * called with other spinlocks held, e.g. by the actuator right before the
+ * first step of a capture move. The gap still needs to be finished with
+ * kp_mon_gap_finish() later, and the next one started with
+ * kp_mon_gap_start() re-enables the interrupts.
+ */
+extern void kp_mon_gap_stop(void);
+
+/**
+ * Finish monitoring a gap between passes, if started, and add its unexpected
+ * edges to the attached statistics.
+ */
+extern void kp_mon_gap_finish(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_MON_H_ */
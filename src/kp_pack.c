@@ -0,0 +1,121 @@
+/** @file
+ *  @brief Keypecker packed measurement encoding
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_pack.h"
+
+size_t
+kp_pack_varint(uint8_t *buf, size_t size, uint32_t value)
+{
+	size_t len = 0;
+
+	assert(buf != NULL || size == 0);
+
+	do {
+		if (len >= size) {
+			return 0;
+		}
+		buf[len++] = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+		value >>= 7;
+	} while (value != 0);
+
+	return len;
+}
+
+size_t
+kp_pack_ch_res(struct kp_pack *pack, size_t ch, bool down,
+	       const struct kp_cap_ch_res *res,
+	       uint8_t *buf, size_t size)
+{
+	uint32_t value;
+	uint32_t code = 0;
+
+	assert(pack != NULL);
+	assert(ch < KP_CAP_CH_NUM);
+	assert((down & 1) == down);
+	assert(res != NULL);
+	assert(kp_cap_ch_status_is_valid(res->status));
+
+	/* Encode the difference from the last value, if we have a value */
+	if (kp_cap_ch_status_is_captured(res->status)) {
+		value = res->value_us / KP_CAP_RES_US;
+		code = kp_pack_zigzag((int32_t)(value -
+						pack->last[ch][down]));
+		pack->last[ch][down] = value;
+	}
+
+	return kp_pack_varint(buf, size, (code << 2) | res->status);
+}
+
+size_t
+kp_pack_meas_head(const struct kp_meas *meas, uint8_t *buf, size_t size)
+{
+	size_t len = 0;
+	size_t ch, name_len;
+	const struct kp_cap_ch_conf *ch_conf;
+
+	assert(kp_meas_is_valid(meas));
+
+	KP_PACK_FIELD(KP_PACK_VERSION);
+	KP_PACK_FIELD(meas->conf.timeout_us);
+	KP_PACK_FIELD(meas->conf.bounce_us);
+	KP_PACK_FIELD(meas->conf.trig);
+	for (ch = 0; ch < ARRAY_SIZE(meas->conf.ch_list); ch++) {
+		ch_conf = &meas->conf.ch_list[ch];
+		KP_PACK_FIELD(ch_conf->dirs | (ch_conf->rising << 2));
+		name_len = strnlen(ch_conf->name, sizeof(ch_conf->name) - 1);
+		KP_PACK_FIELD(name_len);
+		if (size - len < name_len) {
+			return 0;
+		}
+		memcpy(buf + len, ch_conf->name, name_len);
+		len += name_len;
+	}
+	KP_PACK_FIELD(kp_pack_zigzag(meas->top));
+	KP_PACK_FIELD(kp_pack_zigzag(meas->bottom));
+	KP_PACK_FIELD(meas->speed);
+	KP_PACK_FIELD(meas->even_down);
+	KP_PACK_FIELD(meas->passes);
+
+	return len;
+}
+
+size_t
+kp_pack_meas_pass(struct kp_pack *pack, const struct kp_meas *meas,
+		  size_t pass, uint8_t *buf, size_t size)
+{
+	size_t len = 0;
+	size_t res_len;
+	size_t ch;
+	bool down;
+	const struct kp_cap_ch_res *ch_res;
+
+	assert(pack != NULL);
+	assert(kp_meas_is_valid(meas));
+	assert(pass < meas->passes);
+
+	down = (pass ^ meas->even_down) & 1;
+	ch_res = kp_meas_get_ch_res_const(meas, pass, 0);
+	for (ch = 0; ch < ARRAY_SIZE(meas->conf.ch_list); ch++) {
+		/* Skip channels not captured in this pass */
+		if (!(meas->conf.ch_list[ch].dirs &
+		      kp_cap_dirs_from_down(down))) {
+			continue;
+		}
+		res_len = kp_pack_ch_res(pack, ch, down, ch_res,
+					 buf + len, size - len);
+		if (res_len == 0) {
+			return 0;
+		}
+		len += res_len;
+		ch_res++;
+	}
+
+	return len;
+}
@@ -0,0 +1,164 @@
+/** @file
+ *  @brief Keypecker packed measurement encoding
+ *
+ *  A measurement is packed as a header followed by a stream of packed
+ *  channel results, in the order they're stored in the measurement.
+ *  Everything is encoded with unsigned LEB128 varints.
+ *
+ *  The header contains (in order): the format version, the capture timeout,
+ *  bounce, and trigger source, each channel's directions and edge, and
+ *  length-prefixed name, the top and bottom positions (zig-zag-encoded), the
+ *  speed, the "even down" flag, and the number of passes.
+ *
+ *  Each channel result is packed as the zig-zag-encoded difference between
+ *  its value and the last value captured on the same channel in the same
+ *  direction, in KP_CAP_RES_US units, shifted left by two bits and combined
+ *  with the capture status. Timeouts carry no value, and don't update the
+ *  last value. Values sitting in a narrow band take a single byte.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_PACK_H_
+#define KP_PACK_H_
+
+#include "kp_meas.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Packed measurement format version */
+#define KP_PACK_VERSION	3
+
+/** Maximum size of a packed 32-bit varint, bytes */
+#define KP_PACK_VARINT_MAX_SIZE	5
+
+/** Maximum size of a packed channel result, bytes */
+#define KP_PACK_CH_RES_MAX_SIZE	3
+
+/** Maximum size of a packed pass, bytes */
+#define KP_PACK_PASS_MAX_SIZE	(KP_PACK_CH_RES_MAX_SIZE * KP_CAP_CH_NUM)
+
+/** Maximum size of a packed measurement header, bytes */
+#define KP_PACK_HEAD_MAX_SIZE \
+	(KP_PACK_VARINT_MAX_SIZE * 9 + \
+	 (2 + KP_CAP_CH_NAME_MAX_LEN) * KP_CAP_CH_NUM)
+
+/** Channel result packing state */
+struct kp_pack {
+	/** Last captured value per channel per direction, KP_CAP_RES_US */
+	uint32_t last[KP_CAP_CH_NUM][2];
+};
+
+/**
+ * Zig-zag-encode a signed integer, so small magnitudes get small codes.
+ *
+ * @param value	The value to encode.
+ *
+ * @return The encoded value.
+ */
+static inline uint32_t
+kp_pack_zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * Pack an unsigned integer into a varint.
+ *
+ * @param buf	The buffer to pack into.
+ * @param size	The size of the buffer.
+ * @param value	The value to pack.
+ *
+ * @return The number of bytes packed, or zero if the buffer is too small.
+ */
+extern size_t kp_pack_varint(uint8_t *buf, size_t size, uint32_t value);
+
+/**
+ * Pack an unsigned integer field into a varint at the "len" offset into
+ * the "buf" buffer of "size" bytes, advancing "len", or return zero from the
+ * calling function, if the buffer is too small.
+ *
+ * @param _value	The value to pack.
+ */
+#define KP_PACK_FIELD(_value) \
+	do {                                                            \
+		size_t _field_len = kp_pack_varint(buf + len, size - len, \
+						   (_value));           \
+		if (_field_len == 0) {                                  \
+			return 0;                                       \
+		}                                                       \
+		len += _field_len;                                      \
+	} while (0)
+
+/**
+ * Initialize a channel result packing state.
+ *
+ * @param pack	The state to initialize.
+ */
+static inline void
+kp_pack_init(struct kp_pack *pack)
+{
+	assert(pack != NULL);
+	memset(pack, 0, sizeof(*pack));
+}
+
+/**
+ * Pack a channel result.
+ *
+ * @param pack	The packing state.
+ * @param ch	The index of the channel the result belongs to.
+ * @param down	True if the result was captured moving down, false if up.
+ * @param res	The channel result to pack.
+ * @param buf	The buffer to pack into.
+ * @param size	The size of the buffer.
+ *
+ * @return The number of bytes packed, or zero if the buffer is too small.
+ */
+extern size_t kp_pack_ch_res(struct kp_pack *pack, size_t ch, bool down,
+			     const struct kp_cap_ch_res *res,
+			     uint8_t *buf, size_t size);
+
+/**
+ * Pack the header of a measurement.
+ *
+ * @param meas	The measurement to pack the header of. Must be valid.
+ * @param buf	The buffer to pack into.
+ * @param size	The size of the buffer.
+ *
+ * @return The number of bytes packed, or zero if the buffer is too small.
+ */
+extern size_t kp_pack_meas_head(const struct kp_meas *meas,
+				uint8_t *buf, size_t size);
+
+/**
+ * Pack the channel results of a measurement pass.
+ *
+ * @param pack	The packing state. Must be initialized before the first
+ *		pass, and then passed unchanged for each following pass.
+ * @param meas	The measurement to pack a pass of. Must be valid.
+ * @param pass	The index of the pass to pack. Must be less than the
+ *		number of passes in the measurement.
+ * @param buf	The buffer to pack into.
+ * @param size	The size of the buffer.
+ *
+ * @return The number of bytes packed, or zero if the pass has no results, or
+ *	   the buffer is too small.
+ */
+extern size_t kp_pack_meas_pass(struct kp_pack *pack,
+				const struct kp_meas *meas, size_t pass,
+				uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_PACK_H_ */
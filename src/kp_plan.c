@@ -0,0 +1,225 @@
+/** @file
+ *  @brief Keypecker run duration planning
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_plan.h"
+#include <stdlib.h>
+
+/** The initial estimate of the overhead per sample, us */
+#define KP_PLAN_OVERHEAD_US_INIT	1000
+
+/** The calibrated overhead per sample, us */
+static uint32_t kp_plan_overhead_us = KP_PLAN_OVERHEAD_US_INIT;
+
+uint32_t
+kp_plan_get_overhead_us(void)
+{
+	return kp_plan_overhead_us;
+}
+
+uint32_t
+kp_plan_capture_us(const struct kp_cap_conf *conf, bool down,
+		   const struct kp_meas *ref, bool *pworst)
+{
+	enum kp_cap_dirs dir = kp_cap_dirs_from_down(down);
+	/* The duration of a capture where any channel times out */
+	uint32_t timeout_capture_us = conf->timeout_us + conf->bounce_us;
+	uint64_t total_us = 0;
+	size_t total_passes = 0;
+	size_t pass, ch, ch_num;
+	uint32_t pass_us;
+	const struct kp_cap_ch_res *ch_res;
+
+	assert(kp_cap_conf_is_valid(conf));
+	assert((down & 1) == down);
+
+	/* Captures without channels only finish when they time out */
+	ch_num = kp_cap_conf_ch_num(conf, dir);
+	if (ch_num == 0) {
+		return timeout_capture_us;
+	}
+
+	/* If the reference measurement is usable */
+	if (ref != NULL && kp_meas_is_valid(ref) &&
+	    kp_cap_conf_is_equal(&ref->conf, conf)) {
+		/* Average the capture durations of passes in our direction */
+		for (pass = 0; pass < ref->passes; pass++) {
+			if (kp_meas_get_pass_dir(ref, pass) != dir) {
+				continue;
+			}
+			ch_res = kp_meas_get_ch_res_const(ref, pass, 0);
+			/*
+			 * The capture lasts until the last channel + bounce.
+			 * Assume the channels which weren't captured (timed
+			 * out, or were stuck) will time out.
+			 */
+			for (pass_us = 0, ch = 0; ch < ch_num; ch++, ch_res++) {
+				if (!kp_cap_ch_status_is_captured(
+						ch_res->status)) {
+					pass_us = conf->timeout_us;
+					break;
+				}
+				pass_us = MAX(pass_us, ch_res->value_us);
+			}
+			total_us += pass_us + conf->bounce_us;
+			total_passes++;
+		}
+	}
+
+	/* If we had no reference passes */
+	if (total_passes == 0) {
+		/* Assume the worst */
+		if (pworst != NULL) {
+			*pworst = true;
+		}
+		return timeout_capture_us;
+	}
+
+	return (uint32_t)(total_us / total_passes);
+}
+
+uint32_t
+kp_plan_sample_us(uint32_t steps, uint32_t speed, uint32_t capture_us)
+{
+	uint32_t move_us;
+	uint32_t turn_delay_us;
+	uint32_t idle_us;
+
+	assert(speed <= 100);
+
+	/* A sample without movement doesn't capture or wait for anything */
+	if (steps == 0) {
+		return 0;
+	}
+
+	move_us = steps * kp_act_get_step_us(speed);
+	turn_delay_us = kp_act_get_turn_delay_us(speed);
+
+	/*
+	 * Assume the movement turns at each sample, and the capture starts
+	 * with the movement. The turn delay is counted from the last step of
+	 * the previous sample, so it's absorbed by the time the actuator
+	 * idles waiting for the previous capture to finish.
+	 */
+	idle_us = (capture_us > move_us) ? capture_us - move_us : 0;
+	return (turn_delay_us > idle_us ? turn_delay_us - idle_us : 0) +
+		MAX(move_us, capture_us) + kp_plan_overhead_us;
+}
+
+uint64_t
+kp_plan_meas_us(int32_t start, int32_t top, int32_t bottom,
+		const struct kp_meas_wins *wins, uint32_t speed,
+		const struct kp_cap_conf *conf, bool even_down,
+		const struct kp_meas_lanes *lanes,
+		size_t pass, size_t passes,
+		const struct kp_meas *ref, bool *pworst)
+{
+	struct kp_meas_wins selected_wins;
+	struct kp_meas_lanes no_lanes;
+	/* Position ranges traversed by passes, indexed by "down" */
+	int32_t range_top[2];
+	int32_t range_bottom[2];
+	/* Estimated pass durations, indexed by lane and "down" */
+	uint32_t pass_us[KP_MEAS_LANE_MAX][2];
+	/* Lane speeds */
+	uint32_t lane_speed[KP_MEAS_LANE_MAX];
+	const struct kp_cap_conf *lane_conf;
+	size_t lane_num, lane;
+	int32_t pos, pass_start;
+	bool down;
+	uint64_t total_us;
+	size_t i;
+
+	assert(kp_act_pos_is_valid(start));
+	assert(kp_act_pos_is_valid(top));
+	assert(kp_act_pos_is_valid(bottom));
+	assert(top < bottom);
+	assert(speed <= 100);
+	assert(kp_cap_conf_is_valid(conf));
+	assert((even_down & 1) == even_down);
+	assert(lanes == NULL || kp_meas_lanes_are_compatible(lanes, conf));
+
+	if (passes == 0) {
+		return 0;
+	}
+
+	if (lanes == NULL) {
+		kp_meas_lanes_clear(&no_lanes);
+		lanes = &no_lanes;
+	}
+	lane_num = 1 + lanes->alt_num;
+
+	/* Get the ranges the passes traverse, limited by the windows */
+	kp_meas_wins_select(&selected_wins, top, bottom, wins);
+	for (i = 0; i < ARRAY_SIZE(range_top); i++) {
+		kp_meas_wins_get_dir_range(top, bottom, &selected_wins, conf,
+					   kp_cap_dirs_from_down((bool)i),
+					   &range_top[i], &range_bottom[i]);
+	}
+
+	/* Estimate the pass durations of each lane */
+	for (lane = 0; lane < lane_num; lane++) {
+		lane_conf = lane == 0 ? conf : &lanes->alt_list[lane - 1].conf;
+		lane_speed[lane] = lane == 0 ? speed
+					     : lanes->alt_list[lane - 1].speed;
+		for (i = 0; i < ARRAY_SIZE(pass_us[lane]); i++) {
+			pass_us[lane][i] = kp_plan_sample_us(
+				range_bottom[i] - range_top[i],
+				lane_speed[lane],
+				kp_plan_capture_us(lane_conf, (bool)i,
+						   ref, pworst)
+			);
+		}
+	}
+
+	total_us = 0;
+	for (pos = start, i = pass; i < pass + passes; i++) {
+		down = (i ^ even_down) & 1;
+		lane = (i / (lanes->cycles * 2)) % lane_num;
+		pass_start = down ? range_top[down] : range_bottom[down];
+		if (i == pass) {
+			/* Move to the start boundary, without capturing */
+			total_us += kp_plan_sample_us(
+				abs(pass_start - pos), lane_speed[lane],
+				conf->timeout_us + conf->bounce_us
+			);
+		} else if (pos != pass_start) {
+			/*
+			 * Move between the direction ranges, queued with the
+			 * pass, so any turn is already accounted for
+			 */
+			total_us += (uint64_t)abs(pass_start - pos) *
+				kp_act_get_step_us(lane_speed[lane]);
+		}
+		total_us += pass_us[lane][down];
+		pos = down ? range_bottom[down] : range_top[down];
+	}
+
+	return total_us;
+}
+
+void
+kp_plan_calibrate(size_t samples, uint64_t predicted_us, uint64_t actual_us)
+{
+	int64_t overhead_us;
+
+	if (samples == 0) {
+		return;
+	}
+
+	/* Correct the overhead by the per-sample prediction error */
+	overhead_us = (int64_t)kp_plan_overhead_us +
+		((int64_t)actual_us - (int64_t)predicted_us) /
+		(int64_t)samples;
+	overhead_us = CLAMP(overhead_us, 0, (int64_t)UINT32_MAX);
+
+	/* Move halfway to the correction to smooth out outliers */
+	kp_plan_overhead_us = (uint32_t)(((uint64_t)kp_plan_overhead_us +
+					  (uint64_t)overhead_us) / 2);
+}
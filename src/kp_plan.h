@@ -0,0 +1,114 @@
+/** @file
+ *  @brief Keypecker run duration planning
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_PLAN_H_
+#define KP_PLAN_H_
+
+#include "kp_meas.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Get the current (calibrated) estimate of the time spent on each sample
+ * (movement), beyond the modeled movement and capture time.
+ *
+ * @return The overhead per sample, us.
+ */
+extern uint32_t kp_plan_get_overhead_us(void);
+
+/**
+ * Estimate the capture duration of a pass in the specified direction,
+ * counting from the movement start. Use the data of a reference measurement,
+ * if it was made with an equivalent capture configuration, and has passes in
+ * that direction. Otherwise assume all channels time out.
+ *
+ * @param conf		The capture configuration to use. Must be valid.
+ * @param down		True if the pass is going down, false if up.
+ * @param ref		The reference measurement to take capture times from,
+ *			or NULL, if none.
+ * @param pworst	Location for the flag set to true, if the worst case
+ *			(all channels timing out) had to be assumed, because
+ *			no reference data was available. Not modified
+ *			otherwise. Can be NULL.
+ *
+ * @return The estimated capture duration, us.
+ */
+extern uint32_t kp_plan_capture_us(const struct kp_cap_conf *conf,
+				   bool down,
+				   const struct kp_meas *ref,
+				   bool *pworst);
+
+/**
+ * Estimate the duration of a single sample (movement plus capture).
+ *
+ * @param steps		The number of steps to move over.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param capture_us	The expected capture duration, us.
+ *
+ * @return The estimated sample duration, us, including overhead.
+ */
+extern uint32_t kp_plan_sample_us(uint32_t steps, uint32_t speed,
+				  uint32_t capture_us);
+
+/**
+ * Estimate the duration of acquiring (a part of) a measurement, including
+ * moving to the start boundary. Each pass is assumed to traverse only the
+ * range of its direction (see kp_meas_wins_get_dir_range()), with the speed
+ * and the capture configuration of its lane.
+ *
+ * @param start		The actuator position the acquisition starts at.
+ * @param top		The top position of the movement range.
+ * @param bottom	The bottom position of the movement range.
+ * @param wins		The channel windows, or NULL for none.
+ *			Only the windows within the movement range are used.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param conf		The capture configuration to use. Must be valid.
+ * @param even_down	True if even passes are going down, false if up.
+ * @param lanes		The alternative configuration lanes interleaved
+ *			with the above configuration and speed, or NULL for
+ *			none.
+ * @param pass		The index of the first pass to estimate.
+ * @param passes	The number of passes to estimate.
+ * @param ref		The reference measurement to take capture times from,
+ *			or NULL, if none. See kp_plan_capture_us().
+ * @param pworst	Location for the flag set to true, if the worst case
+ *			capture durations had to be assumed. See
+ *			kp_plan_capture_us(). Can be NULL.
+ *
+ * @return The estimated acquisition duration, us.
+ */
+extern uint64_t kp_plan_meas_us(int32_t start, int32_t top, int32_t bottom,
+				const struct kp_meas_wins *wins,
+				uint32_t speed,
+				const struct kp_cap_conf *conf,
+				bool even_down,
+				const struct kp_meas_lanes *lanes,
+				size_t pass, size_t passes,
+				const struct kp_meas *ref,
+				bool *pworst);
+
+/**
+ * Calibrate the planning model with the actual duration of a run.
+ *
+ * @param samples	The number of samples (movements) the run took.
+ * @param predicted_us	The predicted run duration, us, including overhead.
+ * @param actual_us	The actual run duration, us.
+ */
+extern void kp_plan_calibrate(size_t samples,
+			      uint64_t predicted_us, uint64_t actual_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_PLAN_H_ */
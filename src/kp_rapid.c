@@ -0,0 +1,253 @@
+/** @file
+ *  @brief Keypecker rapid-trigger (re-actuation distance) search
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_rapid.h"
+#include "kp_table.h"
+#include <string.h>
+
+/** Bisection state of a channel in one direction */
+struct kp_rapid_ch_bound {
+	/** The largest amplitude known not to re-trigger in all passes */
+	uint32_t lo;
+	/** The smallest amplitude known to re-trigger in all passes */
+	uint32_t hi;
+};
+
+/** Probe results of a channel in one direction */
+struct kp_rapid_ch_probe {
+	/** Number of passes triggered */
+	uint32_t triggers;
+	/** Sum of the trigger times, us */
+	uint64_t sum_us;
+};
+
+/**
+ * Make reversal cycles of an amplitude from the bottom position, and count
+ * the triggers of each channel in each direction.
+ *
+ * @param bottom	The bottom position to reverse from.
+ * @param amplitude	The amplitude of the strokes, steps.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param conf		The capture configuration to use.
+ * @param passes	The number of reversal cycles to make.
+ * @param probe_list	Location for the results of each channel in each
+ *			unit direction.
+ *
+ * @return Sampling result code.
+ */
+static enum kp_sample_rc
+kp_rapid_probe(int32_t bottom, uint32_t amplitude, uint32_t speed,
+	       const struct kp_cap_conf *conf, size_t passes,
+	       struct kp_rapid_ch_probe
+			probe_list[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH])
+{
+	struct kp_cap_ch_res ch_res_list[KP_CAP_CH_NUM];
+	enum kp_sample_rc rc;
+	enum kp_cap_ne_dirs ne_dirs;
+	enum kp_cap_dirs dir;
+	struct kp_rapid_ch_probe *probe;
+	size_t pass, ch, i;
+
+	memset(probe_list, 0, sizeof(*probe_list) * KP_CAP_CH_NUM);
+
+	for (pass = 0; pass < passes; pass++) {
+		/* Release up from the bottom, then re-actuate down to it */
+		for (ne_dirs = KP_CAP_NE_DIRS_UP; ne_dirs < KP_CAP_NE_DIRS_BOTH;
+		     ne_dirs++) {
+			dir = kp_cap_dirs_from_ne(ne_dirs);
+			rc = kp_sample(
+				dir == KP_CAP_DIRS_UP
+					? bottom - (int32_t)amplitude
+					: bottom,
+				speed, conf, dir,
+				ch_res_list, ARRAY_SIZE(ch_res_list)
+			);
+			if (rc != KP_SAMPLE_RC_OK) {
+				return rc;
+			}
+			for (ch = 0, i = 0; ch < KP_CAP_CH_NUM; ch++) {
+				if (!(conf->ch_list[ch].dirs & dir)) {
+					continue;
+				}
+				probe = &probe_list[ch][ne_dirs];
+				if (kp_cap_ch_status_is_captured(
+						ch_res_list[i].status)) {
+					probe->triggers++;
+					probe->sum_us +=
+						ch_res_list[i].value_us;
+				}
+				i++;
+			}
+		}
+	}
+
+	return KP_SAMPLE_RC_OK;
+}
+
+enum kp_sample_rc
+kp_rapid_run(struct kp_rapid *rapid,
+	     int32_t top, int32_t bottom,
+	     uint32_t speed,
+	     const struct kp_cap_conf *conf,
+	     size_t passes)
+{
+	struct kp_rapid_ch_bound bound_list[KP_CAP_CH_NUM]
+					   [KP_CAP_NE_DIRS_BOTH];
+	struct kp_rapid_ch_probe probe_list[KP_CAP_CH_NUM]
+					   [KP_CAP_NE_DIRS_BOTH];
+	struct kp_rapid_ch_bound *bound;
+	struct kp_rapid_ch_probe *probe;
+	enum kp_cap_ne_dirs ne_dirs;
+	enum kp_sample_rc rc;
+	uint32_t amplitude;
+	size_t ch;
+
+	assert(rapid != NULL);
+	assert(kp_act_pos_is_valid(top));
+	assert(kp_act_pos_is_valid(bottom));
+	assert(top < bottom);
+	assert(speed <= 100);
+	assert(kp_cap_conf_is_valid(conf));
+	assert(conf->trig == KP_CAP_TRIG_ACT);
+	assert(kp_cap_conf_ch_num(conf, KP_CAP_DIRS_BOTH) > 0);
+	assert(passes > 0);
+
+	memset(rapid, 0, sizeof(*rapid));
+	rapid->range = (uint32_t)(bottom - top);
+
+	/* Move to the bottom without capturing */
+	rc = kp_sample(bottom, speed, conf, KP_CAP_DIRS_NONE, NULL, 0);
+	if (rc != KP_SAMPLE_RC_OK) {
+		return rc;
+	}
+
+	/* Nothing is known yet, but the full range is tried first */
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			bound_list[ch][ne_dirs] = (struct kp_rapid_ch_bound){
+				.lo = 0,
+				/* Disabled channels are settled right away */
+				.hi = (conf->ch_list[ch].dirs &
+				       kp_cap_dirs_from_ne(ne_dirs))
+					? rapid->range + 1 : 1,
+			};
+		}
+	}
+
+	/* Bisect the amplitude, until every bound is settled */
+	for (amplitude = rapid->range; amplitude > 0;) {
+		rc = kp_rapid_probe(bottom, amplitude, speed, conf, passes,
+				    probe_list);
+		if (rc != KP_SAMPLE_RC_OK) {
+			return rc;
+		}
+		rapid->probes++;
+		rapid->strokes += passes * 2;
+
+		/* Narrow every bound containing the amplitude */
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH;
+			     ne_dirs++) {
+				bound = &bound_list[ch][ne_dirs];
+				probe = &probe_list[ch][ne_dirs];
+				if (amplitude <= bound->lo ||
+				    amplitude >= bound->hi) {
+					continue;
+				}
+				if (probe->triggers < passes) {
+					bound->lo = amplitude;
+					continue;
+				}
+				bound->hi = amplitude;
+				rapid->ch_list[ch][ne_dirs] =
+					(struct kp_rapid_ch_res){
+						.distance = amplitude,
+						.latency_us = probe->sum_us /
+							      passes,
+					};
+			}
+		}
+
+		/* Probe the middle of the first unsettled bound, if any */
+		amplitude = 0;
+		for (ch = 0; ch < KP_CAP_CH_NUM && amplitude == 0; ch++) {
+			for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH;
+			     ne_dirs++) {
+				bound = &bound_list[ch][ne_dirs];
+				/* Never triggering at the full range */
+				if (bound->lo >= rapid->range) {
+					continue;
+				}
+				if (bound->hi - bound->lo > 1) {
+					amplitude = (bound->lo + bound->hi) / 2;
+					break;
+				}
+			}
+		}
+	}
+
+	return KP_SAMPLE_RC_OK;
+}
+
+void
+kp_rapid_print(const struct shell *shell,
+	       const struct kp_cap_conf *conf,
+	       const struct kp_rapid *rapid)
+{
+	static const char *metric_names[] = {
+		"Dist, st",
+		"Lat, us",
+	};
+	struct kp_table table;
+	const struct kp_rapid_ch_res *ch_res;
+	enum kp_cap_ne_dirs ne_dirs;
+	size_t ch, metric;
+
+	assert(shell != NULL);
+	assert(kp_cap_conf_is_valid(conf));
+	assert(rapid != NULL);
+
+	shell_print(shell, "Range: %u steps, probes: %u, strokes: %u",
+		    rapid->range, rapid->probes, rapid->strokes);
+
+	kp_table_ch_init(&table, shell, conf->ch_list);
+
+	/* For each unit direction with enabled channels */
+	for (ne_dirs = KP_CAP_NE_DIRS_UP; ne_dirs < KP_CAP_NE_DIRS_BOTH;
+	     ne_dirs++) {
+		if (!kp_table_ch_dir_head(&table, conf->ch_list, ne_dirs)) {
+			continue;
+		}
+		for (metric = 0; metric < ARRAY_SIZE(metric_names);
+		     metric++) {
+			kp_table_col(&table, "%s", metric_names[metric]);
+			for (ch = 0; ch < ARRAY_SIZE(conf->ch_list); ch++) {
+				if (!conf->ch_list[ch].dirs) {
+					continue;
+				}
+				ch_res = &rapid->ch_list[ch][ne_dirs];
+				/* Mark the channels never re-triggering */
+				if (!(conf->ch_list[ch].dirs &
+				      kp_cap_dirs_from_ne(ne_dirs))) {
+					kp_table_col(&table, "");
+				} else if (ch_res->distance == 0) {
+					kp_table_col(&table, "!");
+				} else {
+					kp_table_col(&table, "%u",
+						     metric == 0
+							? ch_res->distance
+							: ch_res->latency_us);
+				}
+			}
+			kp_table_nl(&table);
+		}
+	}
+	kp_table_sep(&table);
+}
@@ -0,0 +1,91 @@
+/** @file
+ *  @brief Keypecker rapid-trigger (re-actuation distance) search
+ *
+ *  The search makes reversal strokes up from the bottom position and back,
+ *  capturing the channels enabled in each stroke's direction, and bisects
+ *  the stroke amplitude (up to the distance to the top position) to find the
+ *  minimum one, at which each channel re-triggers in every one of a number
+ *  of passes, in each direction. It also reports the mean
+ *  reversal-to-event latency at that amplitude.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_RAPID_H_
+#define KP_RAPID_H_
+
+#include "kp_sample.h"
+#include "kp_cap.h"
+#include <zephyr/shell/shell.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Rapid-trigger search result of a channel in one direction */
+struct kp_rapid_ch_res {
+	/**
+	 * The minimum amplitude re-triggering in all passes, steps,
+	 * or zero, if none did (or the channel is disabled)
+	 */
+	uint32_t distance;
+	/** Mean reversal-to-event latency at the distance, us */
+	uint32_t latency_us;
+};
+
+/** Rapid-trigger search results */
+struct kp_rapid {
+	/** The maximum amplitude searched, steps */
+	uint32_t range;
+	/** Number of amplitudes probed */
+	uint32_t probes;
+	/** Number of reversal strokes made */
+	uint32_t strokes;
+	/** Results of each channel in each unit direction */
+	struct kp_rapid_ch_res ch_list[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+};
+
+/**
+ * Search for the minimum re-actuation distances of the enabled channels.
+ *
+ * @param rapid		Location for the search results.
+ * @param top		The top position, limiting the stroke amplitude.
+ * @param bottom	The bottom (actuated) position to reverse from.
+ *			Must be greater than the top.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param conf		The capture configuration to use. Must be valid,
+ *			use the actuator trigger, and have at least one
+ *			channel enabled.
+ * @param passes	The number of reversal cycles to make at each probed
+ *			amplitude. Must be greater than zero.
+ *
+ * @return Sampling result code.
+ */
+extern enum kp_sample_rc kp_rapid_run(struct kp_rapid *rapid,
+				      int32_t top, int32_t bottom,
+				      uint32_t speed,
+				      const struct kp_cap_conf *conf,
+				      size_t passes);
+
+/**
+ * Output rapid-trigger search results to a shell.
+ *
+ * @param shell	The shell to output to.
+ * @param conf	The capture configuration the search was done with.
+ * @param rapid	The results to output.
+ */
+extern void kp_rapid_print(const struct shell *shell,
+			   const struct kp_cap_conf *conf,
+			   const struct kp_rapid *rapid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_RAPID_H_ */
@@ -9,16 +9,74 @@
  */
 
 #include "kp_sample.h"
+#include "kp_map.h"
+#include "kp_mon.h"
 #include <string.h>
 #include <stdlib.h>
 
-enum kp_sample_rc
-kp_sample(int32_t target,
-	  uint32_t speed,
-	  const struct kp_cap_conf *conf,
-	  enum kp_cap_dirs dirs,
-	  struct kp_cap_ch_res *ch_res_list,
-	  size_t ch_res_num)
+/** The state of arming for a capture move */
+struct kp_sample_arm {
+	/** The capture configuration to use */
+	const struct kp_cap_conf *conf;
+	/** The capture movement directions */
+	enum kp_cap_dirs dirs;
+	/** True if arming the running capture timeline */
+	bool timeline;
+	/** The timeline sequence number at arming, if timeline is true */
+	uint32_t seq;
+};
+
+/**
+ * Arm the capture (or the timeline) right before the first step of the
+ * capture move, and stop counting the monitored gap, if capturing.
+ *
+ * @param data	The arming state (struct kp_sample_arm).
+ */
+static void
+kp_sample_arm_fn(void *data)
+{
+	struct kp_sample_arm *arm = data;
+
+	if (arm->dirs != KP_CAP_DIRS_NONE) {
+		kp_mon_gap_stop();
+	}
+	if (arm->timeline) {
+		arm->seq = kp_cap_tl_arm();
+	} else {
+		kp_cap_arm(arm->conf, arm->dirs);
+	}
+}
+
+/**
+ * Sample captured channels for a movement, optionally queueing a
+ * positioning move before it, so they run without a pause in between.
+ *
+ * @param position	True if positioning to "start" first, false if
+ *			starting from the current position.
+ * @param start		The absolute actuator position to capture from,
+ *			if "position" is true.
+ * @param target	The absolute actuator position to capture to.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param conf		The capture configuration to use.
+ * @param dirs		The capture movement directions.
+ * @param ch_res_list	Location for channel capture results.
+ * @param ch_res_num	Maximum number of channel results to output into
+ *			"ch_res_list".
+ * @param map		True if the results should be added to the trigger
+ *			map, false if not.
+ *
+ * @return Result code.
+ */
+static enum kp_sample_rc
+kp_sample_run(bool position,
+	      int32_t start,
+	      int32_t target,
+	      uint32_t speed,
+	      const struct kp_cap_conf *conf,
+	      enum kp_cap_dirs dirs,
+	      struct kp_cap_ch_res *ch_res_list,
+	      size_t ch_res_num,
+	      bool map)
 {
 	/* Poll event indices */
 	enum {
@@ -29,59 +87,103 @@ kp_sample(int32_t target,
 	};
 	struct k_poll_event events[EVENT_NUM];
 	enum kp_act_move_rc move_rc = KP_ACT_MOVE_RC_OK;
+	enum kp_act_move_rc rc;
 	enum kp_cap_rc cap_rc = KP_CAP_RC_OK;
-	int32_t start;
-	bool moved = false;
-	bool captured = false;
+	int32_t pos;
+	/* True if timestamping on the running capture timeline */
+	const bool timeline = kp_cap_tl_is_running();
+	/* Number of events to poll, without capture's, if timestamping */
+	const size_t event_num = timeline ? EVENT_NUM - 1 : EVENT_NUM;
+	struct kp_sample_arm arm = {
+		.conf = conf,
+		.dirs = dirs,
+		.timeline = timeline,
+	};
+	/* Number of started moves not finished yet */
+	size_t moves = 0;
+	/* True if we're going to move to the target, and so capture */
+	bool capture;
+	bool captured = timeline;
 	enum kp_input_msg msg;
 	size_t i;
 
+	assert(!position || kp_act_pos_is_valid(start));
 	assert(kp_act_pos_is_valid(target));
 	assert(kp_cap_conf_is_valid(conf));
+	assert(conf->trig == KP_CAP_TRIG_ACT);
 	assert(ch_res_list != NULL || ch_res_num == 0);
 
-	/* Get the start actuator position */
-	start = kp_act_locate();
+	/* Get the current actuator position */
+	pos = kp_act_locate();
 	/* If the actuator is off */
-	if (!kp_act_pos_is_valid(start)) {
+	if (!kp_act_pos_is_valid(pos)) {
 		return KP_SAMPLE_RC_OFF;
 	}
-
-	/* If we are not going to move, and so won't trigger a capture */
-	if (target == start) {
-		/* Output timeouts for all channels */
-		memset(ch_res_list, 0, sizeof(*ch_res_list) * ch_res_num);
-		return KP_SAMPLE_RC_OK;
+	if (!position) {
+		start = pos;
 	}
+	capture = target != start;
+	assert(!timeline || kp_cap_tl_matches(conf));
 
 	/* Initialize events */
 	kp_input_get_event_init(&events[EVENT_IDX_INPUT]);
 	kp_act_finish_move_event_init(&events[EVENT_IDX_ACT_FINISH_MOVE]);
 	kp_cap_finish_event_init(&events[EVENT_IDX_CAP_FINISH]);
 
-	/* Start the capture */
-	kp_cap_start(conf, dirs);
+	/* Monitor the gap between the captures through the positioning */
+	kp_mon_gap_start();
+
+	/* Start positioning, if needed */
+	if (start != pos) {
+		kp_act_start_move_to(start, speed);
+		moves++;
+	}
 
-	/* Start moving towards the target */
-	kp_act_start_move_to(target, speed);
+	/* If we are going to move to the target, and so trigger a capture */
+	if (capture) {
+		/* Reserve the capture to arm before the first step */
+		if (!timeline) {
+			kp_cap_reserve();
+		}
+		/* Queue the capture move after the positioning */
+		kp_act_start_move_hook(false, target, speed,
+				       kp_sample_arm_fn, &arm);
+		moves++;
+	} else {
+		/* Output timeouts for all channels */
+		memset(ch_res_list, 0, sizeof(*ch_res_list) * ch_res_num);
+		captured = true;
+	}
 
 	/* Move and capture */
-	for (; !moved || !captured;) {
-		while (k_poll(events, ARRAY_SIZE(events), K_FOREVER) != 0);
+	while (moves > 0 || !captured) {
+		while (k_poll(events, event_num, K_FOREVER) != 0);
 
 		/* Handle input */
 		if (events[EVENT_IDX_INPUT].state) {
 			while (kp_input_get(&msg, K_FOREVER) != 0);
 			if (msg == KP_INPUT_MSG_ABORT) {
 				kp_act_abort();
-				kp_cap_abort();
+				if (!captured) {
+					kp_cap_abort();
+				}
 			}
 		}
 
 		/* Handle movement completion */
 		if (events[EVENT_IDX_ACT_FINISH_MOVE].state) {
-			move_rc = kp_act_finish_move(K_FOREVER);
-			moved = true;
+			rc = kp_act_finish_move(K_FOREVER);
+			moves--;
+			if (move_rc == KP_ACT_MOVE_RC_OK) {
+				move_rc = rc;
+			}
+			/*
+			 * Don't wait for a failed move to trigger anything,
+			 * or for the capture to be armed.
+			 */
+			if (rc != KP_ACT_MOVE_RC_OK && !captured) {
+				kp_cap_abort();
+			}
 		}
 
 		/* Handle capture completion */
@@ -89,6 +191,11 @@ kp_sample(int32_t target,
 			cap_rc = kp_cap_finish(ch_res_list, ch_res_num,
 					       K_FOREVER);
 			captured = true;
+			/* Monitor the rest of the move for unexpected edges */
+			if (dirs != KP_CAP_DIRS_NONE) {
+				kp_mon_gap_finish();
+				kp_mon_gap_start();
+			}
 		}
 
 		/* Reset event state */
@@ -97,6 +204,19 @@ kp_sample(int32_t target,
 		}
 	}
 
+	/* Collect the pass edges from the timeline, once the move is done */
+	if (timeline && capture && dirs != KP_CAP_DIRS_NONE) {
+		if (move_rc == KP_ACT_MOVE_RC_OK) {
+			kp_cap_tl_finish(conf, dirs, arm.seq,
+					 ch_res_list, ch_res_num);
+		}
+		kp_mon_gap_finish();
+		kp_mon_gap_start();
+	}
+
+	if (move_rc == KP_ACT_MOVE_RC_STALLED) {
+		return KP_SAMPLE_RC_STALLED;
+	}
 	if (move_rc == KP_ACT_MOVE_RC_ABORTED ||
 			cap_rc == KP_CAP_RC_ABORTED) {
 		return KP_SAMPLE_RC_ABORTED;
@@ -107,6 +227,106 @@ kp_sample(int32_t target,
 	assert(move_rc == KP_ACT_MOVE_RC_OK);
 	assert(cap_rc == KP_CAP_RC_OK);
 
+	/* Remember how the channels triggered over the passed range */
+	if (map && capture && dirs != KP_CAP_DIRS_NONE) {
+		kp_map_add(MIN(start, target), MAX(start, target),
+			   conf, dirs, ch_res_list, ch_res_num);
+	}
+
+	return KP_SAMPLE_RC_OK;
+}
+
+enum kp_sample_rc
+kp_sample(int32_t target,
+	  uint32_t speed,
+	  const struct kp_cap_conf *conf,
+	  enum kp_cap_dirs dirs,
+	  struct kp_cap_ch_res *ch_res_list,
+	  size_t ch_res_num)
+{
+	return kp_sample_run(false, 0, target, speed, conf, dirs,
+			     ch_res_list, ch_res_num, true);
+}
+
+enum kp_sample_rc
+kp_sample_from(int32_t start,
+	       int32_t target,
+	       uint32_t speed,
+	       const struct kp_cap_conf *conf,
+	       enum kp_cap_dirs dirs,
+	       struct kp_cap_ch_res *ch_res_list,
+	       size_t ch_res_num,
+	       bool map)
+{
+	return kp_sample_run(true, start, target, speed, conf, dirs,
+			     ch_res_list, ch_res_num, map);
+}
+
+enum kp_sample_rc
+kp_sample_ext(const struct kp_cap_conf *conf,
+	      enum kp_cap_dirs dirs,
+	      struct kp_cap_ch_res *ch_res_list,
+	      size_t ch_res_num)
+{
+	/* Poll event indices */
+	enum {
+		EVENT_IDX_INPUT = 0,
+		EVENT_IDX_CAP_FINISH,
+		EVENT_NUM
+	};
+	struct k_poll_event events[EVENT_NUM];
+	enum kp_cap_rc cap_rc = KP_CAP_RC_OK;
+	bool captured = false;
+	enum kp_input_msg msg;
+	size_t i;
+
+	assert(kp_cap_conf_is_valid(conf));
+	assert(conf->trig == KP_CAP_TRIG_EXT);
+	assert(dirs == KP_CAP_DIRS_UP || dirs == KP_CAP_DIRS_DOWN);
+	assert(ch_res_list != NULL || ch_res_num == 0);
+
+	/* Initialize events */
+	kp_input_get_event_init(&events[EVENT_IDX_INPUT]);
+	kp_cap_finish_event_init(&events[EVENT_IDX_CAP_FINISH]);
+
+	/* Stop monitoring the gap since the previous capture, if any */
+	kp_mon_gap_finish();
+
+	/* Start the capture, armed for the stimulus edge */
+	kp_cap_start(conf, dirs);
+
+	/* Wait for the stimulus and capture */
+	while (!captured) {
+		while (k_poll(events, ARRAY_SIZE(events), K_FOREVER) != 0);
+
+		/* Handle input */
+		if (events[EVENT_IDX_INPUT].state) {
+			while (kp_input_get(&msg, K_FOREVER) != 0);
+			if (msg == KP_INPUT_MSG_ABORT) {
+				kp_cap_abort();
+			}
+		}
+
+		/* Handle capture completion */
+		if (events[EVENT_IDX_CAP_FINISH].state) {
+			cap_rc = kp_cap_finish(ch_res_list, ch_res_num,
+					       K_FOREVER);
+			captured = true;
+			/* Monitor until the next capture */
+			kp_mon_gap_start();
+		}
+
+		/* Reset event state */
+		for (i = 0; i < ARRAY_SIZE(events); i++) {
+			events[i].state = K_POLL_STATE_NOT_READY;
+		}
+	}
+
+	if (cap_rc == KP_CAP_RC_ABORTED) {
+		return KP_SAMPLE_RC_ABORTED;
+	}
+	assert(cap_rc == KP_CAP_RC_OK);
+
 	return KP_SAMPLE_RC_OK;
 }
 
@@ -130,6 +350,7 @@ kp_sample_check(int32_t top, int32_t bottom,
 	assert(kp_act_pos_is_valid(top));
 	assert(kp_act_pos_is_valid(bottom));
 	assert(kp_cap_conf_is_valid(conf));
+	assert(conf->trig == KP_CAP_TRIG_ACT);
 	assert(kp_cap_conf_ch_num(conf, KP_CAP_DIRS_BOTH) > 0);
 
 	if (passes == 0) {
@@ -165,8 +386,9 @@ kp_sample_check(int32_t top, int32_t bottom,
 		     i < ARRAY_SIZE(conf->ch_list); i++) {
 			/* If the channel is enabled in this direction */
 			if (conf->ch_list[i].dirs & dirs) {
-				if (ch_res_list[captured_channels].status !=
-						KP_CAP_CH_STATUS_TIMEOUT) {
+				if (kp_cap_ch_status_is_captured(
+					ch_res_list[captured_channels].status
+				)) {
 					triggered_channels++;
 				}
 				captured_channels++;
@@ -27,6 +27,10 @@ enum kp_sample_rc {
 	KP_SAMPLE_RC_ABORTED,
 	/* Actuator is off */
 	KP_SAMPLE_RC_OFF,
+	/* A channel was stuck for too many consecutive passes */
+	KP_SAMPLE_RC_STUCK,
+	/* The actuator driver detected a stall (lost steps) */
+	KP_SAMPLE_RC_STALLED,
 };
 
 /**
@@ -53,6 +57,62 @@ extern enum kp_sample_rc kp_sample(int32_t target,
 				   struct kp_cap_ch_res *ch_res_list,
 				   size_t ch_res_num);
 
+/**
+ * Sample captured channels for a movement from a specified position,
+ * queueing the move to that position (without capturing) and the capture
+ * move together, so the actuator doesn't stop in between, unless it turns.
+ * The capture is armed right before the first step of the capture move.
+ *
+ * @param start		The absolute actuator position to capture from.
+ * @param target	The absolute actuator position to capture to.
+ * @param speed		The speed with which to move, 0-100%.
+ * @param conf		The capture configuration to use.
+ * @param dirs		The capture movement directions.
+ * @param ch_res_list	Location for channel capture results.
+ * 			Only results for channels enabled in the
+ * 			capture configuration for the specified directions (as
+ * 			counted by kp_cap_conf_ch_num()) will be output.
+ * 			Can be NULL, if ch_res_num is zero.
+ * @param ch_res_num	Maximum number of channel results to output into
+ *			"ch_res_list".
+ * @param map		True if the results should be added to the trigger
+ *			map, false if not, e.g. if captured with a
+ *			configuration different from the one being mapped.
+ *
+ * @return Result code.
+ */
+extern enum kp_sample_rc kp_sample_from(int32_t start,
+					int32_t target,
+					uint32_t speed,
+					const struct kp_cap_conf *conf,
+					enum kp_cap_dirs dirs,
+					struct kp_cap_ch_res *ch_res_list,
+					size_t ch_res_num,
+					bool map);
+
+/**
+ * Sample captured channels for the next external stimulus edge, without
+ * moving the actuator.
+ *
+ * @param conf		The capture configuration to use.
+ *			Must have the external trigger selected.
+ * @param dirs		The capture directions, selecting the stimulus edge:
+ *			rising for "down", and falling for "up".
+ * @param ch_res_list	Location for channel capture results.
+ * 			Only results for channels enabled in the
+ * 			capture configuration for the specified directions (as
+ * 			counted by kp_cap_conf_ch_num()) will be output.
+ * 			Can be NULL, if ch_res_num is zero.
+ * @param ch_res_num	Maximum number of channel results to output into
+ *			"ch_res_list".
+ *
+ * @return Result code.
+ */
+extern enum kp_sample_rc kp_sample_ext(const struct kp_cap_conf *conf,
+				       enum kp_cap_dirs dirs,
+				       struct kp_cap_ch_res *ch_res_list,
+				       size_t ch_res_num);
+
 /**
  * Count the number of all-enabled-channel triggers for a number of passes
  * over a range of actuator positions.
@@ -0,0 +1,193 @@
+/** @file
+ *  @brief Keypecker logic analyzer ("scope")
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_scope.h"
+#include <stm32_ll_dma.h>
+#include <stm32_ll_bus.h>
+
+/** The DMA controller serving the sampling timer's update requests */
+#define KP_SCOPE_DMA		DMA1
+/** The DMA channel serving the sampling timer's update requests */
+#define KP_SCOPE_DMA_CH		LL_DMA_CHANNEL_3
+
+/** The timer requesting sampling, NULL if not initialized */
+static TIM_TypeDef *kp_scope_timer = NULL;
+
+/** The GPIO port being sampled */
+static GPIO_TypeDef *kp_scope_gpio = NULL;
+
+/** The samples of the GPIO port's input data register */
+static uint16_t kp_scope_sample_list[KP_SCOPE_SAMPLE_NUM];
+
+bool
+kp_scope_is_initialized(void)
+{
+	return kp_scope_timer != NULL;
+}
+
+void
+kp_scope_init(TIM_TypeDef *timer, GPIO_TypeDef *gpio)
+{
+	assert(!kp_scope_is_initialized());
+	assert(timer != NULL);
+	assert(gpio != NULL);
+
+	kp_scope_timer = timer;
+	kp_scope_gpio = gpio;
+
+	/* Enable the DMA controller */
+	LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+
+	/* Tick at the system clock, counting up */
+	LL_TIM_SetPrescaler(kp_scope_timer, 0);
+	LL_TIM_SetCounterMode(kp_scope_timer, LL_TIM_COUNTERMODE_UP);
+	LL_TIM_DisableARRPreload(kp_scope_timer);
+	/* Generate update events (and DMA requests) on overflow only */
+	LL_TIM_SetUpdateSource(kp_scope_timer, LL_TIM_UPDATESOURCE_COUNTER);
+	/* Start counting with the capturer timer */
+	LL_TIM_SetTriggerInput(kp_scope_timer, LL_TIM_TS_ITR0);
+
+	assert(kp_scope_is_initialized());
+}
+
+void
+kp_scope_arm(uint32_t period_us)
+{
+	assert(kp_scope_is_initialized());
+	assert(kp_scope_period_is_valid(period_us));
+
+	/* Stop any previous sampling */
+	kp_scope_disarm();
+
+	/* Transfer the port input on each request, into the next sample */
+	LL_DMA_ConfigTransfer(KP_SCOPE_DMA, KP_SCOPE_DMA_CH,
+			      LL_DMA_DIRECTION_PERIPH_TO_MEMORY |
+			      LL_DMA_PRIORITY_VERYHIGH |
+			      LL_DMA_MODE_NORMAL |
+			      LL_DMA_PERIPH_NOINCREMENT |
+			      LL_DMA_MEMORY_INCREMENT |
+			      LL_DMA_PDATAALIGN_HALFWORD |
+			      LL_DMA_MDATAALIGN_HALFWORD);
+	LL_DMA_ConfigAddresses(KP_SCOPE_DMA, KP_SCOPE_DMA_CH,
+			       (uint32_t)&kp_scope_gpio->IDR,
+			       (uint32_t)kp_scope_sample_list,
+			       LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+	LL_DMA_SetDataLength(KP_SCOPE_DMA, KP_SCOPE_DMA_CH,
+			     ARRAY_SIZE(kp_scope_sample_list));
+	LL_DMA_EnableChannel(KP_SCOPE_DMA, KP_SCOPE_DMA_CH);
+
+	/* Request a sample at the end of each period */
+	LL_TIM_SetCounter(kp_scope_timer, 0);
+	LL_TIM_SetAutoReload(kp_scope_timer,
+			     k_us_to_cyc_floor32(period_us) - 1);
+	LL_TIM_EnableDMAReq_UPDATE(kp_scope_timer);
+	/* Wait for the capturer timer to start */
+	LL_TIM_SetSlaveMode(kp_scope_timer, LL_TIM_SLAVEMODE_TRIGGER);
+}
+
+size_t
+kp_scope_get_num(void)
+{
+	assert(kp_scope_is_initialized());
+	return ARRAY_SIZE(kp_scope_sample_list) -
+		LL_DMA_GetDataLength(KP_SCOPE_DMA, KP_SCOPE_DMA_CH);
+}
+
+const uint16_t *
+kp_scope_get_sample_list(void)
+{
+	assert(kp_scope_is_initialized());
+	return kp_scope_sample_list;
+}
+
+size_t
+kp_scope_disarm(void)
+{
+	assert(kp_scope_is_initialized());
+
+	/* Stop the timer and its requests */
+	LL_TIM_SetSlaveMode(kp_scope_timer, LL_TIM_SLAVEMODE_DISABLED);
+	LL_TIM_DisableCounter(kp_scope_timer);
+	LL_TIM_DisableDMAReq_UPDATE(kp_scope_timer);
+	/* Stop the transfer */
+	LL_DMA_DisableChannel(KP_SCOPE_DMA, KP_SCOPE_DMA_CH);
+
+	return kp_scope_get_num();
+}
+
+void
+kp_scope_print_vcd(const struct shell *shell,
+		   uint32_t period_us, size_t num,
+		   const struct kp_scope_sig *sig_list,
+		   size_t sig_num)
+{
+	size_t i;
+	size_t sample;
+	uint16_t mask = 0;
+	uint16_t prev;
+	uint16_t changed;
+	size_t last_changed = 0;
+
+	assert(shell != NULL);
+	assert(kp_scope_period_is_valid(period_us));
+	assert(num <= ARRAY_SIZE(kp_scope_sample_list));
+	assert(sig_list != NULL || sig_num == 0);
+	/* Identifiers are single printable characters */
+	assert(sig_num <= '~' - '!' + 1);
+
+	/* Output the header, identifying signals with '!', '"', '#', ... */
+	shell_print(shell, "$timescale 1us $end");
+	shell_print(shell, "$scope module keypecker $end");
+	for (i = 0; i < sig_num; i++) {
+		assert(sig_list[i].pin < 16);
+		shell_print(shell, "$var wire 1 %c %s $end",
+			    (char)('!' + i), sig_list[i].name);
+		mask |= BIT(sig_list[i].pin);
+	}
+	shell_print(shell, "$upscope $end");
+	shell_print(shell, "$enddefinitions $end");
+	if (num == 0) {
+		return;
+	}
+
+	/* Output the initial values */
+	prev = kp_scope_sample_list[0];
+	shell_print(shell, "#%u", period_us);
+	shell_print(shell, "$dumpvars");
+	for (i = 0; i < sig_num; i++) {
+		shell_print(shell, "%c%c",
+			    (prev & BIT(sig_list[i].pin)) ? '1' : '0',
+			    (char)('!' + i));
+	}
+	shell_print(shell, "$end");
+
+	/* Output the changes, sample N taken after N + 1 periods */
+	for (sample = 1; sample < num; sample++) {
+		changed = (kp_scope_sample_list[sample] ^ prev) & mask;
+		prev = kp_scope_sample_list[sample];
+		if (changed == 0) {
+			continue;
+		}
+		last_changed = sample;
+		shell_print(shell, "#%u", (uint32_t)(sample + 1) * period_us);
+		for (i = 0; i < sig_num; i++) {
+			if (changed & BIT(sig_list[i].pin)) {
+				shell_print(shell, "%c%c",
+					    (prev & BIT(sig_list[i].pin))
+						? '1' : '0',
+					    (char)('!' + i));
+			}
+		}
+	}
+	/* Mark the end of sampling */
+	if (last_changed + 1 < num) {
+		shell_print(shell, "#%u", (uint32_t)num * period_us);
+	}
+}
@@ -0,0 +1,124 @@
+/** @file
+ *  @brief Keypecker logic analyzer ("scope")
+ *
+ *  The scope samples a whole GPIO port into RAM at a fixed rate, with DMA
+ *  requested by a timer's update events. The timer is started by the
+ *  capturer's timer trigger output, so sampling starts with the capture.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_SCOPE_H_
+#define KP_SCOPE_H_
+
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/kernel.h>
+#include <stm32_ll_tim.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of samples the scope can take */
+#define KP_SCOPE_SAMPLE_NUM	1024
+
+/** Maximum sampling period, us, fitting the 16-bit timer at 72MHz */
+#define KP_SCOPE_PERIOD_MAX_US	900
+
+/** A signal to output from the scope samples */
+struct kp_scope_sig {
+	/** The signal name, no whitespace */
+	const char *name;
+	/** The GPIO port pin carrying the signal */
+	gpio_pin_t pin;
+};
+
+/**
+ * Check if a sampling period is valid.
+ *
+ * @param period_us	The period to check, us.
+ *
+ * @return True if the period is valid, false otherwise.
+ */
+static inline bool
+kp_scope_period_is_valid(uint32_t period_us)
+{
+	return period_us > 0 && period_us <= KP_SCOPE_PERIOD_MAX_US;
+}
+
+/**
+ * Check if the scope is initialized.
+ *
+ * @return True if the scope is initialized, false otherwise.
+ */
+extern bool kp_scope_is_initialized(void);
+
+/**
+ * Initialize the scope.
+ *
+ * @param timer	The STM32 timer to request sampling with. Must be triggered
+ *		by the capturer timer's trigger output through its ITR0 input,
+ *		and have its update DMA requests served by DMA1 channel 3
+ *		(i.e. be TIM3 triggered by TIM1).
+ * @param gpio	The STM32 GPIO port to sample.
+ */
+extern void kp_scope_init(TIM_TypeDef *timer, GPIO_TypeDef *gpio);
+
+/**
+ * Arm the scope to start sampling with the next capture trigger. Any
+ * previously taken samples are discarded.
+ *
+ * @param period_us	The sampling period, us. Must be valid.
+ */
+extern void kp_scope_arm(uint32_t period_us);
+
+/**
+ * Get the number of samples taken since the scope was armed.
+ *
+ * @return The number of samples taken, up to KP_SCOPE_SAMPLE_NUM.
+ */
+extern size_t kp_scope_get_num(void);
+
+/**
+ * Get the samples taken since the scope was armed.
+ *
+ * @return The samples of the GPIO port input, as many as returned by
+ *	   kp_scope_get_num(). Sample N is taken after N + 1 periods.
+ */
+extern const uint16_t *kp_scope_get_sample_list(void);
+
+/**
+ * Stop sampling, if still going.
+ *
+ * @return The number of samples taken.
+ */
+extern size_t kp_scope_disarm(void);
+
+/**
+ * Output the taken samples of the specified signals to a shell, in the Value
+ * Change Dump (VCD) format. Only signal changes are output.
+ *
+ * @param shell		The shell to output to.
+ * @param period_us	The sampling period used, us.
+ * @param num		The number of samples to output.
+ * @param sig_list	The list of signals to output.
+ * @param sig_num	The number of signals in the list.
+ */
+extern void kp_scope_print_vcd(const struct shell *shell,
+			       uint32_t period_us, size_t num,
+			       const struct kp_scope_sig *sig_list,
+			       size_t sig_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_SCOPE_H_ */
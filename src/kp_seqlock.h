@@ -0,0 +1,128 @@
+/** @file
+ *  @brief Keypecker sequence lock
+ *
+ *  A sequence lock lets readers take consistent snapshots of state updated
+ *  by a single writer, without ever making the writer wait, or disabling
+ *  interrupts. The writer makes the sequence number odd before updating the
+ *  state, and even again after, and the readers retry copying the state,
+ *  if the sequence number was odd, or changed while they were copying.
+ *
+ *  The writer must not be preempted by a reader while updating, or the
+ *  reader would spin until the writer runs again. That holds, if the writer
+ *  holds a spinlock (or runs in an ISR), or has the scheduler locked, and
+ *  the readers are threads. The CPU is single-core, and doesn't reorder
+ *  normal memory accesses, so only the compiler has to be kept from
+ *  reordering them.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_SEQLOCK_H_
+#define KP_SEQLOCK_H_
+
+#include <zephyr/kernel.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A sequence lock */
+struct kp_seqlock {
+	/** The sequence number, odd while the state is being updated */
+	volatile uint32_t seq;
+};
+
+/** A sequence lock initializer */
+#define KP_SEQLOCK_INIT	(struct kp_seqlock){0}
+
+/**
+ * Start updating the state protected by a sequence lock.
+ *
+ * @param lock	The lock to start updating under.
+ *		Must not be being updated already.
+ */
+static inline void
+kp_seqlock_write_begin(struct kp_seqlock *lock)
+{
+	assert(lock != NULL);
+	assert(!(lock->seq & 1));
+	lock->seq++;
+	compiler_barrier();
+}
+
+/**
+ * Finish updating the state protected by a sequence lock.
+ *
+ * @param lock	The lock to finish updating under.
+ *		Must be being updated.
+ */
+static inline void
+kp_seqlock_write_end(struct kp_seqlock *lock)
+{
+	assert(lock != NULL);
+	assert(lock->seq & 1);
+	compiler_barrier();
+	lock->seq++;
+}
+
+/**
+ * Start reading the state protected by a sequence lock, waiting for the
+ * update in progress, if any, to finish.
+ *
+ * @param lock	The lock to start reading under.
+ *
+ * @return The sequence number to pass to kp_seqlock_read_retry().
+ */
+static inline uint32_t
+kp_seqlock_read_begin(const struct kp_seqlock *lock)
+{
+	uint32_t seq;
+	assert(lock != NULL);
+	while ((seq = lock->seq) & 1);
+	compiler_barrier();
+	return seq;
+}
+
+/**
+ * Check if the state read under a sequence lock has to be read again,
+ * because it was updated in the meantime.
+ *
+ * @param lock	The lock the state was read under.
+ * @param seq	The sequence number returned by kp_seqlock_read_begin().
+ *
+ * @return True if the state has to be read again, false if it is
+ *	   consistent.
+ */
+static inline bool
+kp_seqlock_read_retry(const struct kp_seqlock *lock, uint32_t seq)
+{
+	assert(lock != NULL);
+	compiler_barrier();
+	return lock->seq != seq;
+}
+
+/**
+ * Execute the following statement reading the state under a sequence lock,
+ * and repeat it, until the state read is consistent. The statement must not
+ * break out of the loop.
+ *
+ * @param _lock	The lock to read under.
+ */
+#define KP_SEQLOCK_READ(_lock) \
+	for (uint32_t _seq = kp_seqlock_read_begin(_lock), _done = 0;   \
+	     !_done;                                                    \
+	     _done = !kp_seqlock_read_retry(_lock, _seq) ||             \
+		     ((_seq = kp_seqlock_read_begin(_lock)), 0))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_SEQLOCK_H_ */
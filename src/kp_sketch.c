@@ -0,0 +1,383 @@
+/** @file
+ *  @brief Keypecker mergeable measurement summary sketch
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_sketch.h"
+#include "kp_table.h"
+#include "kp_misc.h"
+#include <string.h>
+
+/** Number of buckets within a power of two */
+#define KP_SKETCH_SUB_NUM	(1 << KP_SKETCH_SUB_BITS)
+
+/**
+ * Get the index of the histogram bucket a captured time falls into.
+ *
+ * @param value_us	The captured time, us.
+ *
+ * @return The bucket index.
+ */
+static size_t
+kp_sketch_bucket_from_us(uint32_t value_us)
+{
+	uint32_t ticks = MIN(value_us / KP_CAP_RES_US, UINT16_MAX);
+	uint32_t exp;
+
+	if (ticks < KP_SKETCH_SUB_NUM) {
+		return ticks;
+	}
+	/* The index of the most significant bit */
+	exp = 31 - __builtin_clz(ticks);
+	return ((exp - KP_SKETCH_SUB_BITS + 1) << KP_SKETCH_SUB_BITS) |
+		((ticks >> (exp - KP_SKETCH_SUB_BITS)) &
+		 (KP_SKETCH_SUB_NUM - 1));
+}
+
+/**
+ * Get the middle of a histogram bucket.
+ *
+ * @param bucket	The index of the bucket.
+ *
+ * @return The time in the middle of the bucket, us.
+ */
+static uint32_t
+kp_sketch_bucket_to_us(size_t bucket)
+{
+	uint32_t shift;
+	uint32_t low;
+
+	assert(bucket < KP_SKETCH_BUCKET_NUM);
+
+	if (bucket < KP_SKETCH_SUB_NUM) {
+		return bucket * KP_CAP_RES_US;
+	}
+	shift = bucket / KP_SKETCH_SUB_NUM - 1;
+	low = (KP_SKETCH_SUB_NUM + bucket % KP_SKETCH_SUB_NUM) << shift;
+	return (low + (((uint32_t)1 << shift) - 1) / 2) * KP_CAP_RES_US;
+}
+
+bool
+kp_sketch_is_valid(const struct kp_sketch *sketch)
+{
+	const struct kp_sketch_ch *ch_sketch;
+	enum kp_cap_ne_dirs ne_dirs;
+	uint32_t bucket_sum;
+	size_t ch, bucket;
+
+	if (sketch == NULL) {
+		return false;
+	}
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (!kp_cap_dirs_is_valid(sketch->head.ch_list[ch].dirs)) {
+			return false;
+		}
+		for (ne_dirs = 0; ne_dirs < KP_CAP_NE_DIRS_BOTH; ne_dirs++) {
+			ch_sketch = &sketch->ch_list[ch][ne_dirs];
+			if (ch_sketch->acc.triggers > ch_sketch->acc.passes ||
+			    (ch_sketch->acc.triggers != 0 &&
+			     ch_sketch->acc.min_us > ch_sketch->acc.max_us)) {
+				return false;
+			}
+			bucket_sum = 0;
+			for (bucket = 0; bucket < KP_SKETCH_BUCKET_NUM;
+			     bucket++) {
+				bucket_sum += ch_sketch->bucket_list[bucket];
+			}
+			if (bucket_sum != ch_sketch->acc.triggers) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool
+kp_sketch_is_compatible(const struct kp_sketch *sketch,
+			const struct kp_cap_ch_conf *ch_list)
+{
+	size_t ch;
+
+	assert(kp_sketch_is_valid(sketch));
+	assert(ch_list != NULL);
+
+	if (sketch->head.runs == 0) {
+		return true;
+	}
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (sketch->head.ch_list[ch].dirs != ch_list[ch].dirs ||
+		    sketch->head.ch_list[ch].rising != ch_list[ch].rising) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+kp_sketch_add_meas(struct kp_sketch *sketch, const struct kp_meas *meas)
+{
+	struct kp_sketch_ch *ch_sketch;
+	const struct kp_cap_ch_res *ch_res;
+	enum kp_cap_dirs dirs;
+	size_t pass, ch;
+
+	assert(kp_sketch_is_valid(sketch));
+	assert(kp_meas_is_valid(meas));
+	assert(meas->lanes.alt_num == 0);
+	assert(!meas->sketched);
+	assert(kp_sketch_is_compatible(sketch, meas->conf.ch_list));
+
+	for (pass = 0; pass < meas->passes; pass++) {
+		dirs = kp_meas_get_pass_dir(meas, pass);
+		for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+			if (!(meas->conf.ch_list[ch].dirs & dirs)) {
+				continue;
+			}
+			ch_sketch = &sketch->ch_list[ch][
+				kp_cap_dirs_to_ne(dirs)
+			];
+			ch_res = kp_meas_get_ch_res_const(meas, pass, ch);
+			if (!kp_meas_ch_acc_add(&ch_sketch->acc, ch_res)) {
+				continue;
+			}
+			ch_sketch->bucket_list[
+				kp_sketch_bucket_from_us(ch_res->value_us)
+			]++;
+		}
+	}
+
+	memcpy(sketch->head.ch_list, meas->conf.ch_list,
+	       sizeof(sketch->head.ch_list));
+	sketch->head.runs++;
+	assert(kp_sketch_is_valid(sketch));
+}
+
+uint32_t
+kp_sketch_ch_get_quantile(const struct kp_sketch_ch *ch_sketch,
+			  uint32_t permille)
+{
+	uint32_t rank;
+	uint32_t count = 0;
+	size_t bucket;
+
+	assert(ch_sketch != NULL);
+	assert(ch_sketch->acc.triggers != 0);
+	assert(permille <= 1000);
+
+	/* The (one-based) rank of the time at the quantile */
+	rank = MAX(((uint64_t)ch_sketch->acc.triggers * permille + 999) /
+		   1000, 1);
+	for (bucket = 0; bucket < KP_SKETCH_BUCKET_NUM - 1; bucket++) {
+		count += ch_sketch->bucket_list[bucket];
+		if (count >= rank) {
+			break;
+		}
+	}
+	return CLAMP(kp_sketch_bucket_to_us(bucket),
+		     ch_sketch->acc.min_us, ch_sketch->acc.max_us);
+}
+
+size_t
+kp_sketch_pack_head(const struct kp_sketch *sketch,
+		    uint8_t *buf, size_t size)
+{
+	size_t len = 0;
+	size_t ch, name_len;
+	const struct kp_cap_ch_conf *ch_conf;
+
+	assert(kp_sketch_is_valid(sketch));
+
+	KP_PACK_FIELD(KP_SKETCH_VERSION);
+	KP_PACK_FIELD(sketch->head.runs);
+	for (ch = 0; ch < ARRAY_SIZE(sketch->head.ch_list); ch++) {
+		ch_conf = &sketch->head.ch_list[ch];
+		KP_PACK_FIELD(ch_conf->dirs | (ch_conf->rising << 2));
+		name_len = strnlen(ch_conf->name, sizeof(ch_conf->name) - 1);
+		KP_PACK_FIELD(name_len);
+		if (size - len < name_len) {
+			return 0;
+		}
+		memcpy(buf + len, ch_conf->name, name_len);
+		len += name_len;
+	}
+
+	return len;
+}
+
+size_t
+kp_sketch_pack_ch_head(const struct kp_sketch *sketch, size_t ch,
+		       enum kp_cap_ne_dirs ne_dirs,
+		       uint8_t *buf, size_t size)
+{
+	size_t len = 0;
+	size_t bucket;
+	uint32_t bucket_num = 0;
+	const struct kp_sketch_ch *ch_sketch;
+
+	assert(kp_sketch_is_valid(sketch));
+	assert(ch < KP_CAP_CH_NUM);
+	assert(ne_dirs < KP_CAP_NE_DIRS_BOTH);
+
+	ch_sketch = &sketch->ch_list[ch][ne_dirs];
+	for (bucket = 0; bucket < KP_SKETCH_BUCKET_NUM; bucket++) {
+		bucket_num += (ch_sketch->bucket_list[bucket] != 0);
+	}
+
+	KP_PACK_FIELD(ch_sketch->acc.passes);
+	KP_PACK_FIELD(ch_sketch->acc.triggers);
+	KP_PACK_FIELD(ch_sketch->acc.min_us);
+	KP_PACK_FIELD(ch_sketch->acc.max_us);
+	KP_PACK_FIELD((uint32_t)ch_sketch->acc.sum_us);
+	KP_PACK_FIELD((uint32_t)(ch_sketch->acc.sum_us >> 32));
+	KP_PACK_FIELD((uint32_t)ch_sketch->acc.sum_sq_us);
+	KP_PACK_FIELD((uint32_t)(ch_sketch->acc.sum_sq_us >> 32));
+	KP_PACK_FIELD(bucket_num);
+
+	return len;
+}
+
+size_t
+kp_sketch_pack_ch_buckets(const struct kp_sketch *sketch, size_t ch,
+			  enum kp_cap_ne_dirs ne_dirs, size_t *pbucket,
+			  uint8_t *buf, size_t size)
+{
+	size_t len = 0;
+	size_t bucket;
+	const struct kp_sketch_ch *ch_sketch;
+
+	assert(kp_sketch_is_valid(sketch));
+	assert(ch < KP_CAP_CH_NUM);
+	assert(ne_dirs < KP_CAP_NE_DIRS_BOTH);
+	assert(pbucket != NULL);
+	assert(*pbucket <= KP_SKETCH_BUCKET_NUM);
+	assert(buf != NULL);
+	assert(size >= KP_SKETCH_BUCKET_MAX_SIZE);
+
+	ch_sketch = &sketch->ch_list[ch][ne_dirs];
+	for (bucket = *pbucket; bucket < KP_SKETCH_BUCKET_NUM &&
+				size - len >= KP_SKETCH_BUCKET_MAX_SIZE;
+	     bucket++) {
+		if (ch_sketch->bucket_list[bucket] == 0) {
+			continue;
+		}
+		/* Skipped empty buckets since the last packed one */
+		len += kp_pack_varint(buf + len, size - len,
+				      bucket - *pbucket);
+		len += kp_pack_varint(buf + len, size - len,
+				      ch_sketch->bucket_list[bucket]);
+		*pbucket = bucket + 1;
+	}
+
+	return len;
+}
+
+void
+kp_sketch_print(const struct shell *shell, const struct kp_sketch *sketch)
+{
+	static const char *metric_names[] = {
+		"Passes",
+		"Trigs, %",
+		"Min, us",
+		"Mean, us",
+		"Std, us",
+		"P50, us",
+		"P90, us",
+		"P99, us",
+		"Max, us",
+	};
+	struct kp_table table;
+	const struct kp_sketch_ch *ch_sketch;
+	const struct kp_meas_ch_acc *acc;
+	const struct kp_cap_ch_conf *ch_list = sketch->head.ch_list;
+	enum kp_cap_ne_dirs ne_dirs;
+	enum kp_cap_dirs dirs;
+	size_t ch, metric;
+	uint32_t mean_us;
+	uint32_t value;
+
+	assert(shell != NULL);
+	assert(kp_sketch_is_valid(sketch));
+
+	shell_print(shell, "Runs: %u", sketch->head.runs);
+
+	kp_table_ch_init(&table, shell, ch_list);
+
+	/* For each unit direction with enabled channels */
+	for (ne_dirs = KP_CAP_NE_DIRS_UP; ne_dirs < KP_CAP_NE_DIRS_BOTH;
+	     ne_dirs++) {
+		if (!kp_table_ch_dir_head(&table, ch_list, ne_dirs)) {
+			continue;
+		}
+		dirs = kp_cap_dirs_from_ne(ne_dirs);
+		for (metric = 0; metric < ARRAY_SIZE(metric_names);
+		     metric++) {
+			kp_table_col(&table, "%s", metric_names[metric]);
+			for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+				if (!ch_list[ch].dirs) {
+					continue;
+				}
+				ch_sketch = &sketch->ch_list[ch][ne_dirs];
+				acc = &ch_sketch->acc;
+				/* Skip times of channels never triggered */
+				if (!(ch_list[ch].dirs & dirs) ||
+				    (metric > 1 && acc->triggers == 0)) {
+					kp_table_col(&table, "");
+					continue;
+				}
+				mean_us = acc->triggers == 0 ? 0 :
+					acc->sum_us / acc->triggers;
+				switch (metric) {
+				case 0:
+					value = acc->passes;
+					break;
+				case 1:
+					value = acc->passes == 0 ? 0 :
+						(uint64_t)acc->triggers *
+						100 / acc->passes;
+					break;
+				case 2:
+					value = acc->min_us;
+					break;
+				case 3:
+					value = mean_us;
+					break;
+				case 4:
+					value = kp_isqrt64(
+						acc->sum_sq_us /
+						acc->triggers -
+						MIN((uint64_t)mean_us * mean_us,
+						    acc->sum_sq_us /
+						    acc->triggers)
+					);
+					break;
+				case 5:
+					value = kp_sketch_ch_get_quantile(
+						ch_sketch, 500
+					);
+					break;
+				case 6:
+					value = kp_sketch_ch_get_quantile(
+						ch_sketch, 900
+					);
+					break;
+				case 7:
+					value = kp_sketch_ch_get_quantile(
+						ch_sketch, 990
+					);
+					break;
+				default:
+					value = acc->max_us;
+					break;
+				}
+				kp_table_col(&table, "%u", value);
+			}
+			kp_table_nl(&table);
+		}
+	}
+	kp_table_sep(&table);
+}
@@ -0,0 +1,227 @@
+/** @file
+ *  @brief Keypecker mergeable measurement summary sketch
+ *
+ *  A sketch summarizes the channel results of any number of measurements
+ *  (runs) for each channel and direction with the number of passes and
+ *  triggers, the sum of the captured times and of their squares, their
+ *  minimum and maximum, and a log-linear histogram of them. Every field is
+ *  either a sum or an extreme, so sketches of runs with the same channel
+ *  directions and edges merge exactly, field by field, regardless of the
+ *  session or the board they came from, and percentiles of the merged runs
+ *  come from the merged histograms.
+ *
+ *  The histogram buckets are KP_CAP_RES_US-wide for the times below
+ *  (1 << KP_SKETCH_SUB_BITS) * KP_CAP_RES_US, and above that each power of
+ *  two is split into (1 << KP_SKETCH_SUB_BITS) equal buckets.
+ *
+ *  A packed sketch is a header followed by a record per channel and
+ *  direction (up, then down, for each channel in order). Everything is
+ *  encoded with unsigned LEB128 varints, 64-bit values as the low and the
+ *  high 32 bits. The header contains (in order): the format version, the
+ *  number of runs, and each channel's directions and edge, and
+ *  length-prefixed name, as in a packed measurement. Each record contains the
+ *  number of passes and triggers, the minimum and maximum time, the sum of
+ *  times and of their squares, the number of non-empty buckets, and then a
+ *  pair of the number of empty buckets skipped and the count, for each of
+ *  them.
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_SKETCH_H_
+#define KP_SKETCH_H_
+
+#include "kp_meas.h"
+#include "kp_pack.h"
+#include <zephyr/shell/shell.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Packed sketch format version */
+#define KP_SKETCH_VERSION	1
+
+/** Number of bits of a time selecting a bucket within a power of two */
+#define KP_SKETCH_SUB_BITS	3
+
+/** Number of histogram buckets, covering every 16-bit capture timer value */
+#define KP_SKETCH_BUCKET_NUM \
+	((16 - KP_SKETCH_SUB_BITS + 1) << KP_SKETCH_SUB_BITS)
+
+/** Maximum size of a packed sketch header, bytes */
+#define KP_SKETCH_HEAD_MAX_SIZE \
+	(KP_PACK_VARINT_MAX_SIZE * 2 + \
+	 (2 + KP_CAP_CH_NAME_MAX_LEN) * KP_CAP_CH_NUM)
+
+/**
+ * Maximum size of the fixed fields of a packed sketch channel record
+ * (everything before the bucket pairs), bytes
+ */
+#define KP_SKETCH_CH_HEAD_MAX_SIZE	(KP_PACK_VARINT_MAX_SIZE * 9)
+
+/** Maximum size of a packed pair of skipped buckets and a count, bytes */
+#define KP_SKETCH_BUCKET_MAX_SIZE	(KP_PACK_VARINT_MAX_SIZE * 2)
+
+/** Sketch of a channel's results in one direction */
+struct kp_sketch_ch {
+	/** The accumulated results */
+	struct kp_meas_ch_acc acc;
+	/** Number of captured times falling into each bucket */
+	uint32_t bucket_list[KP_SKETCH_BUCKET_NUM];
+};
+
+/** Sketch header */
+struct kp_sketch_head {
+	/** Number of runs (measurements) summarized */
+	uint32_t runs;
+	/**
+	 * Configuration of the channels the runs were captured with.
+	 * Only the directions and the edges have to match between runs, the
+	 * names are those of the last run.
+	 */
+	struct kp_cap_ch_conf ch_list[KP_CAP_CH_NUM];
+};
+
+/** A measurement summary sketch */
+struct kp_sketch {
+	/** The header */
+	struct kp_sketch_head head;
+	/** Sketches of each channel in each unit direction */
+	struct kp_sketch_ch ch_list[KP_CAP_CH_NUM][KP_CAP_NE_DIRS_BOTH];
+};
+
+/**
+ * Initialize an empty sketch.
+ *
+ * @param sketch	The sketch to initialize.
+ */
+static inline void
+kp_sketch_init(struct kp_sketch *sketch)
+{
+	assert(sketch != NULL);
+	/* Zero the padding too, to have identical checkpoints compare equal */
+	memset(sketch, 0, sizeof(*sketch));
+}
+
+/**
+ * Check if a sketch is valid.
+ *
+ * @param sketch	The sketch to check.
+ *
+ * @return True if the sketch is valid, false otherwise.
+ */
+extern bool kp_sketch_is_valid(const struct kp_sketch *sketch);
+
+/**
+ * Check if a sketch can summarize runs captured with a channel
+ * configuration, i.e. if it's empty, or has the same channel directions and
+ * edges.
+ *
+ * @param sketch	The sketch to check. Must be valid.
+ * @param ch_list	The list of KP_CAP_CH_NUM channel configurations.
+ *
+ * @return True if the sketch is compatible, false otherwise.
+ */
+extern bool kp_sketch_is_compatible(const struct kp_sketch *sketch,
+				    const struct kp_cap_ch_conf *ch_list);
+
+/**
+ * Add the results of a measurement to a sketch, as one more run.
+ *
+ * @param sketch	The sketch to add to. Must be valid, and compatible
+ *			with the measurement's channel configuration.
+ * @param meas		The measurement to add. Must be valid, have no
+ *			alternative configuration lanes, and not be added to
+ *			a sketch already (see kp_meas.sketched).
+ */
+extern void kp_sketch_add_meas(struct kp_sketch *sketch,
+			       const struct kp_meas *meas);
+
+/**
+ * Get the time at a quantile of a channel sketch's histogram.
+ *
+ * @param ch_sketch	The channel sketch to get the quantile of.
+ *			Must have triggers.
+ * @param permille	The quantile, in thousandths, 0-1000.
+ *
+ * @return The middle of the bucket the quantile falls into, us,
+ *	   within the minimum and the maximum time.
+ */
+extern uint32_t kp_sketch_ch_get_quantile(const struct kp_sketch_ch *ch_sketch,
+					  uint32_t permille);
+
+/**
+ * Pack the header of a sketch.
+ *
+ * @param sketch	The sketch to pack the header of. Must be valid.
+ * @param buf		The buffer to pack into.
+ * @param size		The size of the buffer.
+ *
+ * @return The number of bytes packed, or zero if the buffer is too small.
+ */
+extern size_t kp_sketch_pack_head(const struct kp_sketch *sketch,
+				  uint8_t *buf, size_t size);
+
+/**
+ * Pack the fixed fields of the record of a sketch's channel in a
+ * direction, i.e. everything before the bucket pairs.
+ *
+ * @param sketch	The sketch to pack the channel record of.
+ *			Must be valid.
+ * @param ch		The index of the channel to pack the record of.
+ * @param ne_dirs	The unit direction to pack the record of.
+ * @param buf		The buffer to pack into.
+ * @param size		The size of the buffer.
+ *
+ * @return The number of bytes packed, or zero if the buffer is too small.
+ */
+extern size_t kp_sketch_pack_ch_head(const struct kp_sketch *sketch,
+				     size_t ch, enum kp_cap_ne_dirs ne_dirs,
+				     uint8_t *buf, size_t size);
+
+/**
+ * Pack as many of the bucket pairs of the record of a sketch's channel in a
+ * direction as fit into a buffer, continuing from a bucket. Call repeatedly
+ * after kp_sketch_pack_ch_head(), until it returns zero, to pack the whole
+ * record through a small buffer.
+ *
+ * @param sketch	The sketch to pack the channel record of.
+ *			Must be valid.
+ * @param ch		The index of the channel to pack the record of.
+ * @param ne_dirs	The unit direction to pack the record of.
+ * @param pbucket	Location of the index of the bucket to continue
+ *			packing from, zero for the first call. Updated to
+ *			the index to continue from on the next call.
+ * @param buf		The buffer to pack into.
+ * @param size		The size of the buffer. Must be at least
+ *			KP_SKETCH_BUCKET_MAX_SIZE.
+ *
+ * @return The number of bytes packed, or zero if there were no more
+ *	   non-empty buckets to pack.
+ */
+extern size_t kp_sketch_pack_ch_buckets(const struct kp_sketch *sketch,
+					size_t ch, enum kp_cap_ne_dirs ne_dirs,
+					size_t *pbucket,
+					uint8_t *buf, size_t size);
+
+/**
+ * Output a sketch's statistics to a shell.
+ *
+ * @param shell		The shell to output to.
+ * @param sketch	The sketch to output. Must be valid.
+ */
+extern void kp_sketch_print(const struct shell *shell,
+			    const struct kp_sketch *sketch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_SKETCH_H_ */
@@ -20,7 +20,6 @@ kp_table_init(struct kp_table *table, const struct shell *shell,
 	int rc;
 
 	assert(table != NULL);
-	assert(shell != NULL);
 	assert(col0_width <= KP_TABLE_COL_WIDTH_MAX);
 	assert(coln_width <= KP_TABLE_COL_WIDTH_MAX);
 
@@ -58,10 +57,12 @@ kp_table_col(struct kp_table *table, const char *restrict fmt, ...)
 	assert(rc >= 0);
 	assert(rc < sizeof(table->col_buf));
 
-	shell_fprintf(table->shell, SHELL_NORMAL,
-		      (table->col_idx == 0 ? table->col0_fmt
-					   : table->coln_fmt),
-		      table->col_buf);
+	if (table->shell != NULL) {
+		shell_fprintf(table->shell, SHELL_NORMAL,
+			      (table->col_idx == 0 ? table->col0_fmt
+						   : table->coln_fmt),
+			      table->col_buf);
+	}
 	table->col_idx++;
 }
 
@@ -70,8 +71,11 @@ kp_table_nl(struct kp_table *table)
 {
 	assert(kp_table_is_valid(table));
 	assert(table->col_idx == 0 || table->col_idx == table->col_num);
-	shell_fprintf(table->shell, SHELL_NORMAL, "\n");
+	if (table->shell != NULL) {
+		shell_fprintf(table->shell, SHELL_NORMAL, "\n");
+	}
 	table->col_idx = 0;
+	table->line_num++;
 }
 
 void
@@ -85,11 +89,76 @@ kp_table_sep(struct kp_table *table)
 	memset(table->col_buf, '-', sizeof(table->col_buf) - 1);
 	table->col_buf[sizeof(table->col_buf) - 1] = '\0';
 
-	for (i = 0; i < table->col_num; i++) {
-		shell_fprintf(table->shell, SHELL_NORMAL,
-			      (i == 0 ? table->col0_fmt : table->coln_fmt),
-			      table->col_buf);
+	if (table->shell != NULL) {
+		for (i = 0; i < table->col_num; i++) {
+			shell_fprintf(table->shell, SHELL_NORMAL,
+				      (i == 0 ? table->col0_fmt
+					      : table->coln_fmt),
+				      table->col_buf);
+		}
+		shell_fprintf(table->shell, SHELL_NORMAL, "\n");
 	}
-	shell_fprintf(table->shell, SHELL_NORMAL, "\n");
 	table->col_idx = 0;
+	table->line_num++;
+}
+
+void
+kp_table_ch_init(struct kp_table *table, const struct shell *shell,
+		 const struct kp_cap_ch_conf *ch_list)
+{
+	size_t ch, ch_num;
+
+	assert(table != NULL);
+	assert(shell != NULL);
+	assert(ch_list != NULL);
+
+	for (ch_num = 0, ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		ch_num += (ch_list[ch].dirs != KP_CAP_DIRS_NONE);
+	}
+
+	kp_table_init(table, shell, 8, 15, 1 + ch_num);
+	kp_table_col(table, "");
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (ch_list[ch].dirs) {
+			kp_table_col(table, "#%zu", ch);
+		}
+	}
+	kp_table_nl(table);
+	kp_table_col(table, "");
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (ch_list[ch].dirs) {
+			kp_table_col(table, "%s", ch_list[ch].name);
+		}
+	}
+	kp_table_nl(table);
+}
+
+bool
+kp_table_ch_dir_head(struct kp_table *table,
+		     const struct kp_cap_ch_conf *ch_list,
+		     enum kp_cap_ne_dirs ne_dirs)
+{
+	enum kp_cap_dirs dirs;
+	size_t ch;
+
+	assert(kp_table_is_valid(table));
+	assert(ch_list != NULL);
+	assert(ne_dirs < KP_CAP_NE_DIRS_BOTH);
+
+	dirs = kp_cap_dirs_from_ne(ne_dirs);
+	for (ch = 0; ch < KP_CAP_CH_NUM && !(ch_list[ch].dirs & dirs); ch++);
+	if (ch == KP_CAP_CH_NUM) {
+		return false;
+	}
+
+	kp_table_sep(table);
+	kp_table_col(table, ne_dirs == KP_CAP_NE_DIRS_DOWN ? "Down" : "Up");
+	for (ch = 0; ch < KP_CAP_CH_NUM; ch++) {
+		if (ch_list[ch].dirs) {
+			kp_table_col(table, "Value");
+		}
+	}
+	kp_table_nl(table);
+	kp_table_sep(table);
+	return true;
 }
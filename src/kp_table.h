@@ -11,6 +11,7 @@
 #ifndef KP_TABLE_H_
 #define KP_TABLE_H_
 
+#include "kp_cap.h"
 #include <zephyr/shell/shell.h>
 #include <zephyr/toolchain.h>
 #include <string.h>
@@ -25,7 +26,7 @@ extern "C" {
 
 /** The table output state */
 struct kp_table {
-	/** The shell to output to */
+	/** The shell to output to, or NULL to only format the columns */
 	const struct shell *shell;
 	/** Format string for the first column */
 	char col0_fmt[16];
@@ -37,6 +38,8 @@ struct kp_table {
 	size_t col_idx;
 	/** The column formatting buffer */
 	char col_buf[KP_TABLE_COL_WIDTH_MAX + 1];
+	/** The number of lines output so far */
+	size_t line_num;
 };
 
 /**
@@ -49,7 +52,6 @@ struct kp_table {
 static inline bool kp_table_is_valid(const struct kp_table *table)
 {
 	return table != NULL &&
-	       table->shell != NULL &&
 	       table->col_idx <= table->col_num &&
 	       memchr(table->col0_fmt, 0, sizeof(table->col0_fmt)) != NULL &&
 	       memchr(table->coln_fmt, 0, sizeof(table->coln_fmt)) != NULL;
@@ -59,7 +61,8 @@ static inline bool kp_table_is_valid(const struct kp_table *table)
  * Initialize a table output.
  *
  * @param table		The table output to initialize.
- * @param shell		The shell to output to.
+ * @param shell		The shell to output to, or NULL to only format the
+ *			columns, without output (e.g. for benchmarking).
  * @param col0_width	Width of the first column.
  *			Cannot be higher than KP_TABLE_COL_WIDTH_MAX.
  * @param coln_width	Width of the successive columns.
@@ -94,6 +97,34 @@ extern void kp_table_nl(struct kp_table *table);
  */
 extern void kp_table_sep(struct kp_table *table);
 
+/**
+ * Initialize a table output of per-channel statistics, and output its
+ * channel index/name header, with a column for each enabled channel.
+ *
+ * @param table		The table output to initialize.
+ * @param shell		The shell to output to.
+ * @param ch_list	The list of KP_CAP_CH_NUM channel configurations.
+ */
+extern void kp_table_ch_init(struct kp_table *table,
+			     const struct shell *shell,
+			     const struct kp_cap_ch_conf *ch_list);
+
+/**
+ * Output the header of a unit direction's section of a per-channel
+ * statistics table, if any enabled channel captures in that direction.
+ *
+ * @param table		The table output initialized with kp_table_ch_init().
+ * @param ch_list	The list of KP_CAP_CH_NUM channel configurations
+ *			the table was initialized with.
+ * @param ne_dirs	The unit direction of the section.
+ *
+ * @return True if the header was output, false if no enabled channel
+ *	   captures in the direction, and the section should be skipped.
+ */
+extern bool kp_table_ch_dir_head(struct kp_table *table,
+				 const struct kp_cap_ch_conf *ch_list,
+				 enum kp_cap_ne_dirs ne_dirs);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,158 @@
+/** @file
+ *  @brief Keypecker X axis (key indexing) actuator
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kp_xact.h"
+
+/** Step pulse width, us */
+#define KP_XACT_PULSE_US	10
+
+/*
+ * Only changed upon initialization.
+ */
+
+/** The GPIO port device */
+static const struct device * volatile kp_xact_gpio = NULL;
+
+/** The "disable" output GPIO pin */
+static gpio_pin_t kp_xact_gpio_pin_disable;
+
+/** The "dir" output GPIO pin */
+static gpio_pin_t kp_xact_gpio_pin_dir;
+
+/** The "step" output GPIO pin */
+static gpio_pin_t kp_xact_gpio_pin_step;
+
+/*
+ * State changed by all functions
+ */
+/** The spinlock protecting the state */
+static struct k_spinlock kp_xact_lock = {};
+
+/** Execute the following statement with the state lock held */
+#define KP_XACT_WITH_LOCK \
+	for (k_spinlock_key_t _key = k_spin_lock(&kp_xact_lock), \
+			      _i = {0}; \
+	     _i.key == 0; \
+	     k_spin_unlock(&kp_xact_lock, _key), _i.key = 1)
+
+/** The current actuator position, in steps */
+static volatile int32_t kp_xact_pos;
+
+/*
+ * End of state
+ */
+
+/**
+ * Check if the actuator power is off, assuming the state lock is held.
+ *
+ * @return True if the power is off, false if on.
+ */
+static inline bool
+kp_xact_is_off_locked(void)
+{
+	return gpio_pin_get(kp_xact_gpio, kp_xact_gpio_pin_disable);
+}
+
+bool
+kp_xact_on(void)
+{
+	bool turned_on = false;
+	assert(kp_xact_is_initialized());
+	KP_XACT_WITH_LOCK {
+		if (kp_xact_is_off_locked()) {
+			gpio_pin_set(kp_xact_gpio,
+				     kp_xact_gpio_pin_disable, 0);
+			kp_xact_pos = 0;
+			turned_on = true;
+		}
+	}
+	return turned_on;
+}
+
+bool
+kp_xact_off(void)
+{
+	bool turned_off = false;
+	assert(kp_xact_is_initialized());
+	KP_XACT_WITH_LOCK {
+		if (!kp_xact_is_off_locked()) {
+			gpio_pin_set(kp_xact_gpio,
+				     kp_xact_gpio_pin_disable, 1);
+			turned_off = true;
+		}
+	}
+	return turned_off;
+}
+
+int32_t
+kp_xact_locate(void)
+{
+	int32_t pos;
+	assert(kp_xact_is_initialized());
+	KP_XACT_WITH_LOCK {
+		pos = kp_xact_is_off_locked()
+			? KP_ACT_POS_INVALID
+			: kp_xact_pos;
+	}
+	return pos;
+}
+
+bool
+kp_xact_step(bool positive)
+{
+	bool stepped = false;
+	assert(kp_xact_is_initialized());
+	KP_XACT_WITH_LOCK {
+		if (kp_xact_is_off_locked()) {
+			continue;
+		}
+		gpio_pin_set(kp_xact_gpio, kp_xact_gpio_pin_dir, !positive);
+		gpio_pin_set(kp_xact_gpio, kp_xact_gpio_pin_step, 1);
+		k_busy_wait(KP_XACT_PULSE_US);
+		gpio_pin_set(kp_xact_gpio, kp_xact_gpio_pin_step, 0);
+		kp_xact_pos += positive ? 1 : -1;
+		stepped = true;
+	}
+	return stepped;
+}
+
+bool
+kp_xact_is_initialized(void)
+{
+	return kp_xact_gpio != NULL;
+}
+
+void
+kp_xact_init(const struct device *gpio,
+	     gpio_pin_t disable_pin,
+	     gpio_pin_t dir_pin,
+	     gpio_pin_t step_pin)
+{
+	assert(gpio != NULL);
+	assert(device_is_ready(gpio));
+	assert(!kp_xact_is_initialized());
+
+	kp_xact_pos = 0;
+
+	kp_xact_gpio_pin_disable = disable_pin;
+	kp_xact_gpio_pin_dir = dir_pin;
+	kp_xact_gpio_pin_step = step_pin;
+	gpio_pin_configure(gpio, kp_xact_gpio_pin_disable,
+				GPIO_OPEN_DRAIN | GPIO_OUTPUT_HIGH);
+	gpio_pin_configure(gpio, kp_xact_gpio_pin_dir,
+				GPIO_PUSH_PULL | GPIO_OUTPUT_LOW);
+	gpio_pin_configure(gpio, kp_xact_gpio_pin_step,
+				GPIO_PUSH_PULL | GPIO_OUTPUT_LOW);
+
+	/* Mark actuator initialized */
+	kp_xact_gpio = gpio;
+
+	assert(kp_xact_is_initialized());
+}
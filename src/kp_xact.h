@@ -0,0 +1,81 @@
+/** @file
+ *  @brief Keypecker X axis (key indexing) actuator
+ */
+
+/*
+ * Copyright (c) 2023 Nikolai Kondrashov
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KP_XACT_H_
+#define KP_XACT_H_
+
+#include "kp_act.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Minimum duration of a step on the X axis, us */
+#define KP_XACT_STEP_US	2000
+
+/**
+ * Initialize the X axis actuator to a powered-off state.
+ *
+ * @param gpio		The device for the GPIO port to use to control the
+ *			actuator.
+ * @param disable_pin	The disable pin number on the GPIO port.
+ * @param dir_pin	The dir pin number on the GPIO port.
+ * @param step_pin	The step pin number on the GPIO port.
+ */
+extern void kp_xact_init(const struct device *gpio,
+			 gpio_pin_t disable_pin,
+			 gpio_pin_t dir_pin,
+			 gpio_pin_t step_pin);
+
+/**
+ * Check if the X axis actuator is initialized.
+ *
+ * @return True if the actuator is initialized, false if not.
+ */
+extern bool kp_xact_is_initialized(void);
+
+/**
+ * Turn on the X axis actuator power, making the current position zero.
+ *
+ * @return True if the power was turned on, false if it was already on.
+ */
+extern bool kp_xact_on(void);
+
+/**
+ * Turn off the X axis actuator power.
+ *
+ * @return True if the power was turned off, false if it was already off.
+ */
+extern bool kp_xact_off(void);
+
+/**
+ * Get the X axis actuator position.
+ *
+ * @return The position, if successful, or KP_ACT_POS_INVALID, if the actuator
+ * 	   is powered off.
+ */
+extern int32_t kp_xact_locate(void);
+
+/**
+ * Make a single step with the X axis actuator. The caller is responsible
+ * for waiting at least KP_XACT_STEP_US between steps.
+ *
+ * @param positive	True to step in the positive direction (right),
+ *			false to step in the negative direction (left).
+ *
+ * @return True if the step was made, false if the actuator is off.
+ */
+extern bool kp_xact_step(bool positive);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KP_XACT_H_ */